@@ -0,0 +1,184 @@
+//
+//  CURLBenchmark.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class CURLMultiHandle;
+@class CURLNetworkConditions;
+
+/**
+ Describes one benchmark run: a protocol, a payload size and a number of
+ transfers to keep in flight at once.
+ */
+
+@interface CURLBenchmarkScenario : NSObject
+{
+    NSString                *_scheme;
+    NSUInteger              _payloadSize;
+    NSUInteger              _concurrency;
+    NSUInteger              _requestCount;
+    CURLNetworkConditions   *_conditions;
+    NSString                *_decoding;
+}
+
+/**
+ Make every combination of the given schemes, payload sizes and concurrency levels.
+
+ @param schemes Array of scheme strings (`http` or `ftp`).
+ @param sizes Array of NSNumbers, giving payload sizes in bytes.
+ @param concurrencies Array of NSNumbers, giving the number of transfers to keep in flight.
+ @param requestCount How many transfers to perform in each scenario.
+ @return An array of CURLBenchmarkScenario objects.
+ */
+
++ (NSArray*)scenariosWithSchemes:(NSArray*)schemes sizes:(NSArray*)sizes concurrencies:(NSArray*)concurrencies requestCount:(NSUInteger)requestCount;
+
+@property (copy, nonatomic) NSString* scheme;
+@property (assign, nonatomic) NSUInteger payloadSize;
+@property (assign, nonatomic) NSUInteger concurrency;
+@property (assign, nonatomic) NSUInteger requestCount;
+
+/**
+ If set, the transfers go through a CURLConditioningProxy which applies these conditions,
+ so that WAN-like latency, bandwidth and stalls can be reproduced on loopback.
+ */
+
+@property (copy, nonatomic) CURLNetworkConditions* conditions;
+
+/**
+ Make a copy of each of the given scenarios for each of the given conditions.
+
+ @param scenarios Array of CURLBenchmarkScenario objects.
+ @param conditions Array of CURLNetworkConditions objects.
+ @return An array of CURLBenchmarkScenario objects.
+ */
+
++ (NSArray*)scenarios:(NSArray*)scenarios withConditions:(NSArray*)conditions;
+
+/**
+ If set, HTTP payloads are served gzipped, and decoded either `inline` by libcurl as they arrive, or in the
+ `background` with curl_decodesContentInBackground. `none`, like nil, serves the payload uncompressed.
+ */
+
+@property (copy, nonatomic) NSString* decoding;
+
+/**
+ Make a copy of each of the given scenarios for each of the given ways of decoding.
+
+ @param scenarios Array of CURLBenchmarkScenario objects.
+ @param decodings Array of strings: `none`, `inline` or `background`.
+ @return An array of CURLBenchmarkScenario objects.
+ */
+
++ (NSArray*)scenarios:(NSArray*)scenarios withDecodings:(NSArray*)decodings;
+
+/** Whether the payload is served compressed. */
+- (BOOL)isCompressed;
+
+- (NSString*)name;
+- (NSDictionary*)dictionaryRepresentation;
+
+@end
+
+
+/**
+ The measurements taken for a single scenario.
+ */
+
+@interface CURLBenchmarkResult : NSObject
+{
+    CURLBenchmarkScenario   *_scenario;
+    NSUInteger              _completed;
+    NSUInteger              _failed;
+    uint64_t                _bytes;
+    NSTimeInterval          _elapsed;
+    NSTimeInterval          _cpuTime;
+    double                  *_latencies;
+    NSUInteger              _latencyCount;
+}
+
+@property (readonly, strong, nonatomic) CURLBenchmarkScenario* scenario;
+@property (readonly, nonatomic) NSUInteger completed;
+@property (readonly, nonatomic) NSUInteger failed;
+@property (readonly, nonatomic) uint64_t bytes;
+@property (readonly, nonatomic) NSTimeInterval elapsed;
+
+/**
+ User + system CPU time for the whole process while the scenario ran.
+
+ Note that the stand-in server runs in-process, so this includes its work too. It's still
+ useful for spotting regressions, as the server side stays constant between runs.
+ */
+
+@property (readonly, nonatomic) NSTimeInterval cpuTime;
+
+- (double)requestsPerSecond;
+- (double)megabytesPerSecond;
+- (NSTimeInterval)cpuTimePerTransfer;
+
+/**
+ Returns a latency percentile, using the nearest-rank method.
+
+ @param percentile The percentile, from 0 to 100.
+ @return The latency in seconds, or zero if nothing completed.
+ */
+
+- (NSTimeInterval)latencyPercentile:(double)percentile;
+
+/**
+ A JSON-compatible summary of the result.
+ */
+
+- (NSDictionary*)dictionaryRepresentation;
+
+@end
+
+
+/**
+ Runs scenarios against in-process stand-in servers, and measures the results.
+
+ Each scenario is run closed-loop: `concurrency` transfers are started, and every
+ time one finishes another is started, until `requestCount` have been performed.
+
+ The calling thread's run loop is spun while waiting, so that the stand-in servers
+ can do their work.
+ */
+
+@interface CURLBenchmark : NSObject
+{
+    NSMutableDictionary *_servers;
+    NSMutableDictionary *_proxies;
+    NSOperationQueue    *_queue;
+    CURLMultiHandle     *_multi;
+}
+
+/**
+ The multi used for all transfers. Defaults to the shared instance.
+ */
+
+@property (strong, nonatomic) CURLMultiHandle* multi;
+
+- (CURLBenchmarkResult*)runScenario:(CURLBenchmarkScenario*)scenario;
+- (NSArray*)runScenarios:(NSArray*)scenarios;
+
+/**
+ Stop any stand-in servers and proxies that were started by the receiver.
+ */
+
+- (void)stopServers;
+
+/**
+ Describes the environment the benchmark was run in - curl version, host, date and so on -
+ so that results files can be compared sensibly.
+
+ @return A JSON-compatible dictionary.
+ */
+
++ (NSDictionary*)environment;
+
+@end
@@ -0,0 +1,591 @@
+//
+//  CURLBenchmark.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLBenchmark.h"
+
+#import "CURLConditioningProxy.h"
+#import "CURLMultiHandle.h"
+#import "CURLNetworkConditions.h"
+#import "CURLRequest.h"
+#import "CURLStandInServer.h"
+#import "CURLTransfer+TestingSupport.h"
+
+#include <mach/mach_time.h>
+#include <sys/resource.h>
+#include <sys/sysctl.h>
+
+#pragma mark - Time
+
+static NSTimeInterval CURLBenchmarkSecondsFromMachTime(uint64_t elapsed)
+{
+    static mach_timebase_info_data_t sTimebase;
+    if (sTimebase.denom == 0)
+    {
+        mach_timebase_info(&sTimebase);
+    }
+
+    return ((double)elapsed * sTimebase.numer / sTimebase.denom) / NSEC_PER_SEC;
+}
+
+static NSTimeInterval CURLBenchmarkProcessCPUTime()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / (double)USEC_PER_SEC;
+}
+
+static int CURLBenchmarkCompareLatencies(const void* a, const void* b)
+{
+    double lhs = *(const double*)a;
+    double rhs = *(const double*)b;
+    return (lhs < rhs) ? -1 : (lhs > rhs) ? 1 : 0;
+}
+
+#pragma mark - Scenario
+
+@implementation CURLBenchmarkScenario
+
+@synthesize scheme = _scheme;
+@synthesize payloadSize = _payloadSize;
+@synthesize concurrency = _concurrency;
+@synthesize requestCount = _requestCount;
+@synthesize conditions = _conditions;
+@synthesize decoding = _decoding;
+
++ (NSArray*)scenariosWithSchemes:(NSArray *)schemes sizes:(NSArray *)sizes concurrencies:(NSArray *)concurrencies requestCount:(NSUInteger)requestCount
+{
+    NSMutableArray* result = [NSMutableArray arrayWithCapacity:[schemes count] * [sizes count] * [concurrencies count]];
+    for (NSString* scheme in schemes)
+    {
+        for (NSNumber* size in sizes)
+        {
+            for (NSNumber* concurrency in concurrencies)
+            {
+                CURLBenchmarkScenario* scenario = [[CURLBenchmarkScenario alloc] init];
+                scenario.scheme = scheme;
+                scenario.payloadSize = [size unsignedIntegerValue];
+                scenario.concurrency = MAX([concurrency unsignedIntegerValue], 1);
+                scenario.requestCount = MAX(requestCount, scenario.concurrency);
+                [result addObject:scenario];
+                [scenario release];
+            }
+        }
+    }
+
+    return result;
+}
+
++ (NSArray*)scenarios:(NSArray *)scenarios withConditions:(NSArray *)conditions
+{
+    NSMutableArray* result = [NSMutableArray arrayWithCapacity:[scenarios count] * [conditions count]];
+    for (CURLNetworkConditions* condition in conditions)
+    {
+        for (CURLBenchmarkScenario* scenario in scenarios)
+        {
+            CURLBenchmarkScenario* copy = [[CURLBenchmarkScenario alloc] init];
+            copy.scheme = scenario.scheme;
+            copy.payloadSize = scenario.payloadSize;
+            copy.concurrency = scenario.concurrency;
+            copy.requestCount = scenario.requestCount;
+            copy.conditions = condition;
+            copy.decoding = scenario.decoding;
+            [result addObject:copy];
+            [copy release];
+        }
+    }
+
+    return result;
+}
+
++ (NSArray*)scenarios:(NSArray *)scenarios withDecodings:(NSArray *)decodings
+{
+    NSMutableArray* result = [NSMutableArray arrayWithCapacity:[scenarios count] * [decodings count]];
+    for (NSString* decoding in decodings)
+    {
+        for (CURLBenchmarkScenario* scenario in scenarios)
+        {
+            // FTP has no Content-Encoding, so there's nothing to compare
+            if (![scenario.scheme isEqualToString:@"http"] && ![decoding isEqualToString:@"none"]) continue;
+
+            CURLBenchmarkScenario* copy = [[CURLBenchmarkScenario alloc] init];
+            copy.scheme = scenario.scheme;
+            copy.payloadSize = scenario.payloadSize;
+            copy.concurrency = scenario.concurrency;
+            copy.requestCount = scenario.requestCount;
+            copy.conditions = scenario.conditions;
+            copy.decoding = decoding;
+            [result addObject:copy];
+            [copy release];
+        }
+    }
+
+    return result;
+}
+
+- (void)dealloc
+{
+    [_scheme release];
+    [_conditions release];
+    [_decoding release];
+
+    [super dealloc];
+}
+
+- (BOOL)isCompressed
+{
+    return self.decoding && ![self.decoding isEqualToString:@"none"];
+}
+
+- (NSString*)name
+{
+    NSString* result = [NSString stringWithFormat:@"%@-%lub-x%lu", self.scheme, (unsigned long)self.payloadSize, (unsigned long)self.concurrency];
+    if (self.conditions)
+    {
+        result = [result stringByAppendingFormat:@"-%@", self.conditions.name];
+    }
+
+    if ([self isCompressed])
+    {
+        result = [result stringByAppendingFormat:@"-gzip-%@", self.decoding];
+    }
+
+    return result;
+}
+
+- (NSDictionary*)dictionaryRepresentation
+{
+    return @{
+             @"name" : [self name],
+             @"scheme" : self.scheme,
+             @"payload_bytes" : @(self.payloadSize),
+             @"concurrency" : @(self.concurrency),
+             @"requests" : @(self.requestCount),
+             @"conditions" : self.conditions ? self.conditions.name : @"none",
+             @"decoding" : self.decoding ? self.decoding : @"none",
+             };
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"<SCENARIO %@>", [self name]];
+}
+
+@end
+
+#pragma mark - Result
+
+@interface CURLBenchmarkResult()
+
+- (id)initWithScenario:(CURLBenchmarkScenario*)scenario;
+- (void)recordLatency:(NSTimeInterval)latency bytes:(uint64_t)bytes failed:(BOOL)failed;
+- (void)finishWithElapsedTime:(NSTimeInterval)elapsed cpuTime:(NSTimeInterval)cpuTime;
+
+@end
+
+@implementation CURLBenchmarkResult
+
+@synthesize scenario = _scenario;
+@synthesize completed = _completed;
+@synthesize failed = _failed;
+@synthesize bytes = _bytes;
+@synthesize elapsed = _elapsed;
+@synthesize cpuTime = _cpuTime;
+
+- (id)initWithScenario:(CURLBenchmarkScenario *)scenario
+{
+    if ((self = [super init]) != nil)
+    {
+        _scenario = [scenario retain];
+        _latencies = malloc(sizeof(double) * MAX(scenario.requestCount, 1));
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_scenario release];
+    free(_latencies);
+
+    [super dealloc];
+}
+
+- (void)recordLatency:(NSTimeInterval)latency bytes:(uint64_t)bytes failed:(BOOL)failed
+{
+    if (failed)
+    {
+        ++_failed;
+    }
+    else
+    {
+        ++_completed;
+        _bytes += bytes;
+
+        if (_latencyCount < self.scenario.requestCount)
+        {
+            _latencies[_latencyCount++] = latency;
+        }
+    }
+}
+
+- (void)finishWithElapsedTime:(NSTimeInterval)elapsed cpuTime:(NSTimeInterval)cpuTime
+{
+    _elapsed = elapsed;
+    _cpuTime = cpuTime;
+
+    qsort(_latencies, _latencyCount, sizeof(double), CURLBenchmarkCompareLatencies);
+}
+
+- (double)requestsPerSecond
+{
+    return (self.elapsed > 0) ? self.completed / self.elapsed : 0;
+}
+
+- (double)megabytesPerSecond
+{
+    return (self.elapsed > 0) ? (self.bytes / (1024.0 * 1024.0)) / self.elapsed : 0;
+}
+
+- (NSTimeInterval)cpuTimePerTransfer
+{
+    NSUInteger transfers = self.completed + self.failed;
+    return transfers ? self.cpuTime / transfers : 0;
+}
+
+- (NSTimeInterval)latencyPercentile:(double)percentile
+{
+    if (_latencyCount == 0) return 0;
+
+    NSUInteger rank = (NSUInteger)ceil((percentile / 100.0) * _latencyCount);
+    rank = MIN(MAX(rank, 1), _latencyCount);
+    return _latencies[rank - 1];
+}
+
+- (NSDictionary*)dictionaryRepresentation
+{
+    NSMutableDictionary* result = [NSMutableDictionary dictionaryWithDictionary:[self.scenario dictionaryRepresentation]];
+    [result addEntriesFromDictionary:@{
+                                       @"completed" : @(self.completed),
+                                       @"failed" : @(self.failed),
+                                       @"bytes" : @(self.bytes),
+                                       @"elapsed_s" : @(self.elapsed),
+                                       @"requests_per_s" : @([self requestsPerSecond]),
+                                       @"mb_per_s" : @([self megabytesPerSecond]),
+                                       @"latency_p50_ms" : @([self latencyPercentile:50] * 1000.0),
+                                       @"latency_p99_ms" : @([self latencyPercentile:99] * 1000.0),
+                                       @"latency_max_ms" : @([self latencyPercentile:100] * 1000.0),
+                                       @"cpu_s" : @(self.cpuTime),
+                                       @"cpu_per_transfer_ms" : @([self cpuTimePerTransfer] * 1000.0),
+                                       }];
+    return result;
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"%@: %lu ok, %lu failed, %.1f req/s, %.2f MB/s, p50 %.2fms, p99 %.2fms, cpu %.3fms/transfer",
+            [self.scenario name], (unsigned long)self.completed, (unsigned long)self.failed,
+            [self requestsPerSecond], [self megabytesPerSecond],
+            [self latencyPercentile:50] * 1000.0, [self latencyPercentile:99] * 1000.0,
+            [self cpuTimePerTransfer] * 1000.0];
+}
+
+@end
+
+#pragma mark - Run State
+
+/**
+ Tracks a single scenario while it runs.
+ Only touched on the benchmark's (serial) delegate queue, apart from the finished flag.
+ */
+
+@interface CURLBenchmarkRun : NSObject <CURLTransferDelegate>
+{
+    CURLBenchmark           *_benchmark;    // not retained
+    CURLBenchmarkResult     *_result;
+    NSURLRequest            *_request;
+    NSMutableArray          *_transfers;
+    NSMapTable              *_startTimes;
+    NSMapTable              *_byteCounts;
+    NSUInteger              _started;
+    NSUInteger              _finishedCount;
+    BOOL                    _finished;
+}
+
+@property (readonly, strong, nonatomic) CURLBenchmarkResult* result;
+@property (assign, atomic) BOOL finished;
+
+- (id)initWithBenchmark:(CURLBenchmark*)benchmark result:(CURLBenchmarkResult*)result request:(NSURLRequest*)request;
+- (void)startTransfer;
+
+@end
+
+@interface CURLBenchmark()
+
+@property (readonly, strong, nonatomic) NSOperationQueue* queue;
+
+@end
+
+@implementation CURLBenchmarkRun
+
+@synthesize result = _result;
+@synthesize finished = _finished;
+
+- (id)initWithBenchmark:(CURLBenchmark *)benchmark result:(CURLBenchmarkResult *)result request:(NSURLRequest *)request
+{
+    if ((self = [super init]) != nil)
+    {
+        _benchmark = benchmark;
+        _result = [result retain];
+        _request = [request copy];
+        _transfers = [[NSMutableArray alloc] initWithCapacity:result.scenario.concurrency];
+        _startTimes = [[NSMapTable mapTableWithKeyOptions:NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality valueOptions:NSPointerFunctionsStrongMemory] retain];
+        _byteCounts = [[NSMapTable mapTableWithKeyOptions:NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality valueOptions:NSPointerFunctionsStrongMemory] retain];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_result release];
+    [_request release];
+    [_transfers release];
+    [_startTimes release];
+    [_byteCounts release];
+
+    [super dealloc];
+}
+
+- (void)startTransfer
+{
+    ++_started;
+
+    // record the start time before the transfer exists, so that setup costs are included in the latency
+    uint64_t start = mach_absolute_time();
+    CURLTransfer* transfer = [[CURLTransfer alloc] initWithRequest:_request credential:nil delegate:self delegateQueue:_benchmark.queue multi:_benchmark.multi];
+    [_startTimes setObject:@(start) forKey:transfer];
+    [_byteCounts setObject:@(0) forKey:transfer];
+    [_transfers addObject:transfer];
+    [transfer release];
+}
+
+- (void)transfer:(CURLTransfer *)transfer didReceiveData:(NSData *)data
+{
+    NSNumber* count = [_byteCounts objectForKey:transfer];
+    [_byteCounts setObject:@([count unsignedLongLongValue] + [data length]) forKey:transfer];
+}
+
+- (void)transfer:(CURLTransfer *)transfer didCompleteWithError:(NSError *)error
+{
+    uint64_t end = mach_absolute_time();
+    uint64_t start = [[_startTimes objectForKey:transfer] unsignedLongLongValue];
+    uint64_t bytes = [[_byteCounts objectForKey:transfer] unsignedLongLongValue];
+
+    if (error)
+    {
+        NSLog(@"benchmark: %@ failed with error %@", transfer, error);
+    }
+
+    [self.result recordLatency:CURLBenchmarkSecondsFromMachTime(end - start) bytes:bytes failed:(error != nil)];
+
+    [_startTimes removeObjectForKey:transfer];
+    [_byteCounts removeObjectForKey:transfer];
+    [_transfers removeObjectIdenticalTo:transfer];
+
+    ++_finishedCount;
+    if (_started < self.result.scenario.requestCount)
+    {
+        [self startTransfer];
+    }
+    else if (_finishedCount == _started)
+    {
+        self.finished = YES;
+    }
+}
+
+@end
+
+#pragma mark - Benchmark
+
+@implementation CURLBenchmark
+
+@synthesize queue = _queue;
+@synthesize multi = _multi;
+
+- (id)init
+{
+    if ((self = [super init]) != nil)
+    {
+        _servers = [[NSMutableDictionary alloc] init];
+        _proxies = [[NSMutableDictionary alloc] init];
+
+        // a single serial queue for all delegate messages, so that run state needs no locking
+        _queue = [[NSOperationQueue alloc] init];
+        _queue.maxConcurrentOperationCount = 1;
+
+        _multi = [[CURLMultiHandle sharedInstance] retain];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [self stopServers];
+
+    [_servers release];
+    [_proxies release];
+    [_queue release];
+    [_multi release];
+
+    [super dealloc];
+}
+
+- (CURLStandInServer*)serverForScenario:(CURLBenchmarkScenario*)scenario
+{
+    NSString* key = [NSString stringWithFormat:@"%@-%lu%@", scenario.scheme, (unsigned long)scenario.payloadSize, [scenario isCompressed] ? @"-gzip" : @""];
+    CURLStandInServer* server = [_servers objectForKey:key];
+    if (!server)
+    {
+        NSMutableData* payload = [NSMutableData dataWithLength:scenario.payloadSize];
+        uint8_t* bytes = [payload mutableBytes];
+        for (NSUInteger n = 0; n < scenario.payloadSize; ++n)
+        {
+            bytes[n] = 'a' + (n % 26);
+        }
+
+        if ([scenario.scheme isEqualToString:@"ftp"])
+        {
+            server = [CURLStandInServer FTPServerWithPayload:payload];
+        }
+        else
+        {
+            server = [CURLStandInServer HTTPServerWithPayload:payload contentEncoding:([scenario isCompressed] ? @"gzip" : nil)];
+        }
+
+        [server start];
+        [_servers setObject:server forKey:key];
+    }
+
+    return server;
+}
+
+- (NSURL*)URLForScenario:(CURLBenchmarkScenario*)scenario
+{
+    CURLStandInServer* server = [self serverForScenario:scenario];
+    NSURL* result = [server URLForPath:@"/benchmark/payload.bin"];
+
+    CURLNetworkConditions* conditions = scenario.conditions;
+    if (conditions)
+    {
+        NSString* key = [NSString stringWithFormat:@"%@-%lu%@-%@", scenario.scheme, (unsigned long)scenario.payloadSize, [scenario isCompressed] ? @"-gzip" : @"", conditions.name];
+        CURLConditioningProxy* proxy = [_proxies objectForKey:key];
+        if (!proxy)
+        {
+            proxy = [CURLConditioningProxy proxyForURL:result];
+            proxy.defaultConditions = conditions;
+            [proxy start];
+            [_proxies setObject:proxy forKey:key];
+        }
+
+        result = [proxy URLByRoutingURL:result];
+    }
+
+    return result;
+}
+
+- (void)stopServers
+{
+    for (CURLConditioningProxy* proxy in [_proxies allValues])
+    {
+        [proxy stop];
+    }
+
+    for (CURLStandInServer* server in [_servers allValues])
+    {
+        [server stop];
+    }
+
+    [_proxies removeAllObjects];
+    [_servers removeAllObjects];
+}
+
+- (CURLBenchmarkResult*)runScenario:(CURLBenchmarkScenario *)scenario
+{
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[self URLForScenario:scenario]];
+    if ([scenario isCompressed])
+    {
+        [request setValue:@"gzip" forHTTPHeaderField:@"Accept-Encoding"];
+        [request curl_setDecodesContentInBackground:[scenario.decoding isEqualToString:@"background"]];
+    }
+
+    CURLBenchmarkResult* result = [[[CURLBenchmarkResult alloc] initWithScenario:scenario] autorelease];
+    CURLBenchmarkRun* run = [[CURLBenchmarkRun alloc] initWithBenchmark:self result:result request:request];
+
+    NSTimeInterval cpuStart = CURLBenchmarkProcessCPUTime();
+    uint64_t start = mach_absolute_time();
+
+    [self.queue addOperationWithBlock:^{
+        for (NSUInteger n = 0; n < scenario.concurrency; ++n)
+        {
+            [run startTransfer];
+        }
+    }];
+
+    // the stand-in servers need the run loop to be serviced
+    while (!run.finished)
+    {
+        [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+
+    [result finishWithElapsedTime:CURLBenchmarkSecondsFromMachTime(mach_absolute_time() - start)
+                          cpuTime:CURLBenchmarkProcessCPUTime() - cpuStart];
+
+    [run release];
+    return result;
+}
+
+- (NSArray*)runScenarios:(NSArray *)scenarios
+{
+    NSMutableArray* results = [NSMutableArray arrayWithCapacity:[scenarios count]];
+    for (CURLBenchmarkScenario* scenario in scenarios)
+    {
+        @autoreleasepool
+        {
+            CURLBenchmarkResult* result = [self runScenario:scenario];
+            NSLog(@"benchmark: %@", result);
+            [results addObject:result];
+        }
+    }
+
+    return results;
+}
+
++ (NSDictionary*)environment
+{
+    char model[256] = { 0 };
+    size_t length = sizeof(model);
+    sysctlbyname("hw.model", model, &length, NULL, 0);
+
+    NSDateFormatter* formatter = [[[NSDateFormatter alloc] init] autorelease];
+    formatter.locale = [[[NSLocale alloc] initWithLocaleIdentifier:@"en_US_POSIX"] autorelease];
+    formatter.dateFormat = @"yyyy-MM-dd'T'HH:mm:ssZ";
+
+    NSProcessInfo* info = [NSProcessInfo processInfo];
+    return @{
+             @"curl_version" : [CURLTransfer curlVersion],
+             @"host" : [info hostName],
+             @"model" : [NSString stringWithUTF8String:model],
+             @"cpus" : @([info activeProcessorCount]),
+             @"os" : [info operatingSystemVersionString],
+             @"date" : [formatter stringFromDate:[NSDate date]],
+             };
+}
+
+@end
@@ -0,0 +1,62 @@
+//
+//  CURLEventBackendBenchmark.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@protocol CURLEventBackend;
+
+/**
+ Measures the cost of an event backend on its own, without libcurl or any transfers.
+
+ A number of socket pairs are opened, and one end of each is watched for reading. Then:
+
+ - ping-pong: a byte is written to one random socket at a time, and the time until the handler
+   is called for it is measured. This shows what each wakeup costs with that many idle sockets watched.
+
+ - burst: bytes are written to a batch of random sockets at once, and the time until the handler has been
+   called for all of them is measured. This shows the throughput, and CPU cost per event, under load.
+
+ Registering and unregistering all the sockets is timed too.
+ */
+
+@interface CURLEventBackendBenchmark : NSObject
+{
+    NSString    *_backendName;
+    NSUInteger  _socketCount;
+    NSUInteger  _rounds;
+}
+
+/**
+ The names of the backends that can be benchmarked: `gcd` and `poll`.
+ */
+
++ (NSArray*)backendNames;
+
+/**
+ Make a new, unstarted, backend.
+
+ @param name One of the backendNames.
+ @return The backend, or nil if the name isn't known.
+ */
+
++ (id <CURLEventBackend>)backendNamed:(NSString*)name;
+
+- (id)initWithBackendName:(NSString*)name socketCount:(NSUInteger)count;
+
+/** How many ping-pong and burst rounds to run. */
+@property (assign, nonatomic) NSUInteger rounds;
+
+/**
+ Run the benchmark.
+
+ @return A JSON-compatible dictionary of results, or nil if the sockets couldn't be opened or the backend wouldn't start.
+ */
+
+- (NSDictionary*)run;
+
+@end
@@ -0,0 +1,278 @@
+//
+//  CURLEventBackendBenchmark.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLEventBackendBenchmark.h"
+
+#import "CURLDispatchEventBackend.h"
+#import "CURLPollEventBackend.h"
+
+#include <fcntl.h>
+#include <mach/mach_time.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+static const NSUInteger kBurstSize = 1000;
+
+static NSTimeInterval CURLEventBenchmarkSecondsFromMachTime(uint64_t elapsed)
+{
+    static mach_timebase_info_data_t sTimebase;
+    if (sTimebase.denom == 0)
+    {
+        mach_timebase_info(&sTimebase);
+    }
+
+    return ((double)elapsed * sTimebase.numer / sTimebase.denom) / NSEC_PER_SEC;
+}
+
+static NSTimeInterval CURLEventBenchmarkProcessCPUTime()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / (double)USEC_PER_SEC;
+}
+
+static int CURLEventBenchmarkCompareLatencies(const void* a, const void* b)
+{
+    double lhs = *(const double*)a;
+    double rhs = *(const double*)b;
+    return (lhs < rhs) ? -1 : (lhs > rhs) ? 1 : 0;
+}
+
+static double CURLEventBenchmarkPercentile(const double* sorted, NSUInteger count, double percentile)
+{
+    if (!count) return 0;
+
+    NSUInteger rank = (NSUInteger)ceil(percentile / 100.0 * count);
+    return sorted[MIN(MAX(rank, 1), count) - 1];
+}
+
+@implementation CURLEventBackendBenchmark
+
+@synthesize rounds = _rounds;
+
++ (NSArray*)backendNames
+{
+    return @[@"gcd", @"poll"];
+}
+
++ (id <CURLEventBackend>)backendNamed:(NSString*)name
+{
+    if ([name isEqualToString:@"gcd"])
+    {
+        return [[[CURLDispatchEventBackend alloc] init] autorelease];
+    }
+    else if ([name isEqualToString:@"poll"])
+    {
+        return [[[CURLPollEventBackend alloc] init] autorelease];
+    }
+
+    return nil;
+}
+
+- (id)initWithBackendName:(NSString *)name socketCount:(NSUInteger)count
+{
+    if ((self = [super init]) != nil)
+    {
+        _backendName = [name copy];
+        _socketCount = count;
+        _rounds = 1000;
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_backendName release];
+
+    [super dealloc];
+}
+
+#pragma mark - Sockets
+
+- (void)raiseFileLimitTo:(rlim_t)needed
+{
+    struct rlimit limit;
+    if ((getrlimit(RLIMIT_NOFILE, &limit) == 0) && (limit.rlim_cur < needed))
+    {
+        limit.rlim_cur = MIN(needed, limit.rlim_max);
+        if (setrlimit(RLIMIT_NOFILE, &limit) != 0)
+        {
+            NSLog(@"benchmark: couldn't raise the open file limit to %llu", (unsigned long long)needed);
+        }
+    }
+}
+
+- (NSUInteger)openPairs:(int*)pairs
+{
+    [self raiseFileLimitTo:_socketCount * 2 + 256];
+
+    for (NSUInteger n = 0; n < _socketCount; ++n)
+    {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, &pairs[n * 2]) != 0)
+        {
+            NSLog(@"benchmark: could only open %lu of %lu socket pairs: %s", (unsigned long)n, (unsigned long)_socketCount, strerror(errno));
+            return n;
+        }
+
+        fcntl(pairs[n * 2], F_SETFL, O_NONBLOCK);
+    }
+
+    return _socketCount;
+}
+
+#pragma mark - Running
+
+- (NSDictionary*)run
+{
+    id <CURLEventBackend> backend = [[self class] backendNamed:_backendName];
+    NSAssert(backend, @"unknown backend %@", _backendName);
+
+    int* pairs = malloc(sizeof(int) * 2 * _socketCount);
+    NSUInteger opened = [self openPairs:pairs];
+    if (opened < _socketCount)
+    {
+        for (NSUInteger n = 0; n < opened * 2; ++n) close(pairs[n]);
+        free(pairs);
+        return nil;
+    }
+
+    NSUInteger count = _socketCount;
+    NSUInteger rounds = _rounds;
+    dispatch_queue_t queue = dispatch_queue_create("com.karelia.CURLEventBackendBenchmark", NULL);
+    dispatch_semaphore_t done = dispatch_semaphore_create(0);
+
+    // only touched on the queue, apart from the target, which is set before the bytes that lead to it being checked are written
+    __block NSUInteger delivered = 0;
+    __block volatile NSUInteger target = 0;
+
+    BOOL started = [backend startWithQueue:queue handler:^(curl_socket_t socket, int action) {
+        // drain the socket, as libcurl would
+        char buffer[64];
+        while (read(socket, buffer, sizeof(buffer)) > 0)
+        {
+        }
+
+        if (++delivered == target)
+        {
+            dispatch_semaphore_signal(done);
+        }
+    }];
+
+    if (!started)
+    {
+        [backend stop];
+        dispatch_release(done);
+        dispatch_release(queue);
+        for (NSUInteger n = 0; n < count * 2; ++n) close(pairs[n]);
+        free(pairs);
+        return nil;
+    }
+
+    // registration
+    uint64_t start = mach_absolute_time();
+    dispatch_sync(queue, ^{
+        for (NSUInteger n = 0; n < count; ++n)
+        {
+            [backend watchSocket:pairs[n * 2] reading:YES writing:NO];
+        }
+    });
+    NSTimeInterval registration = CURLEventBenchmarkSecondsFromMachTime(mach_absolute_time() - start);
+
+    // ping-pong
+    double* latencies = malloc(sizeof(double) * rounds);
+    for (NSUInteger round = 0; round < rounds; ++round)
+    {
+        NSUInteger index = arc4random_uniform((uint32_t)count);
+        target = target + 1;
+
+        start = mach_absolute_time();
+        write(pairs[index * 2 + 1], "x", 1);
+        dispatch_semaphore_wait(done, DISPATCH_TIME_FOREVER);
+        latencies[round] = CURLEventBenchmarkSecondsFromMachTime(mach_absolute_time() - start);
+    }
+    qsort(latencies, rounds, sizeof(double), CURLEventBenchmarkCompareLatencies);
+
+    // bursts
+    NSUInteger burst = MIN(count, kBurstSize);
+    NSUInteger* chosen = malloc(sizeof(NSUInteger) * burst);
+    NSUInteger burstEvents = 0;
+    NSTimeInterval burstTime = 0;
+    NSTimeInterval burstCPU = 0;
+    for (NSUInteger round = 0; round < MAX(rounds / 10, 1); ++round)
+    {
+        // a random selection of distinct sockets, so that each write becomes exactly one event
+        NSUInteger offset = arc4random_uniform((uint32_t)count);
+        NSUInteger stride = (count > burst) ? count / burst : 1;
+        for (NSUInteger n = 0; n < burst; ++n)
+        {
+            chosen[n] = (offset + n * stride) % count;
+        }
+
+        target = target + burst;
+
+        NSTimeInterval cpu = CURLEventBenchmarkProcessCPUTime();
+        start = mach_absolute_time();
+        for (NSUInteger n = 0; n < burst; ++n)
+        {
+            write(pairs[chosen[n] * 2 + 1], "x", 1);
+        }
+        dispatch_semaphore_wait(done, DISPATCH_TIME_FOREVER);
+
+        burstTime += CURLEventBenchmarkSecondsFromMachTime(mach_absolute_time() - start);
+        burstCPU += CURLEventBenchmarkProcessCPUTime() - cpu;
+        burstEvents += burst;
+    }
+
+    // unregistration
+    start = mach_absolute_time();
+    dispatch_sync(queue, ^{
+        for (NSUInteger n = 0; n < count; ++n)
+        {
+            [backend watchSocket:pairs[n * 2] reading:NO writing:NO];
+        }
+    });
+    NSTimeInterval unregistration = CURLEventBenchmarkSecondsFromMachTime(mach_absolute_time() - start);
+
+    dispatch_sync(queue, ^{
+        [backend stop];
+    });
+
+    NSMutableDictionary* result = [NSMutableDictionary dictionaryWithDictionary:@{
+                                                                                  @"backend" : _backendName,
+                                                                                  @"sockets" : @(count),
+                                                                                  @"register_ms" : @(registration * 1000.0),
+                                                                                  @"unregister_ms" : @(unregistration * 1000.0),
+                                                                                  @"pingpong_p50_us" : @(CURLEventBenchmarkPercentile(latencies, rounds, 50) * USEC_PER_SEC),
+                                                                                  @"pingpong_p99_us" : @(CURLEventBenchmarkPercentile(latencies, rounds, 99) * USEC_PER_SEC),
+                                                                                  @"pingpong_max_us" : @(CURLEventBenchmarkPercentile(latencies, rounds, 100) * USEC_PER_SEC),
+                                                                                  @"burst_size" : @(burst),
+                                                                                  @"burst_events_per_second" : @(burstTime > 0 ? burstEvents / burstTime : 0),
+                                                                                  @"burst_cpu_us_per_event" : @(burstEvents ? burstCPU * USEC_PER_SEC / burstEvents : 0),
+                                                                                  }];
+
+    if ([backend respondsToSelector:@selector(wakeups)])
+    {
+        [result setObject:@([(CURLPollEventBackend*)backend wakeups]) forKey:@"wakeups"];
+    }
+
+    free(chosen);
+    free(latencies);
+    for (NSUInteger n = 0; n < count * 2; ++n)
+    {
+        close(pairs[n]);
+    }
+    free(pairs);
+    dispatch_release(done);
+    dispatch_release(queue);
+
+    return result;
+}
+
+@end
@@ -0,0 +1,40 @@
+//
+//  CURLFormEncodingBenchmark.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ Measures building a form body from a dictionary, without any transfers.
+
+ Each round encodes the same dictionary of fields with -formDataForHTTPUsingEncoding:ordering:, and with
+ the string-based implementation that -formatForHTTPUsingEncoding:ordering: used to have, turned into data
+ the way a caller would set it as a request's body. The values are a mix of plain words, text with spaces
+ and punctuation, numbers, and (for UTF-8) some text which isn't ASCII.
+ */
+
+@interface CURLFormEncodingBenchmark : NSObject
+{
+    NSUInteger          _fieldCount;
+    NSStringEncoding    _encoding;
+    NSUInteger          _rounds;
+}
+
+- (id)initWithFieldCount:(NSUInteger)count encoding:(NSStringEncoding)encoding;
+
+/** How many times to encode the dictionary each way. */
+@property (assign, nonatomic) NSUInteger rounds;
+
+/**
+ Run the benchmark.
+
+ @return A JSON-compatible dictionary of results.
+ */
+
+- (NSDictionary*)run;
+
+@end
@@ -0,0 +1,162 @@
+//
+//  CURLFormEncodingBenchmark.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLFormEncodingBenchmark.h"
+
+#import "NSDictionary+CURLHandle.h"
+
+#include <mach/mach_time.h>
+
+static NSTimeInterval CURLFormBenchmarkSecondsFromMachTime(uint64_t elapsed)
+{
+    static mach_timebase_info_data_t sTimebase;
+    if (sTimebase.denom == 0)
+    {
+        mach_timebase_info(&sTimebase);
+    }
+
+    return ((double)elapsed * sTimebase.numer / sTimebase.denom) / NSEC_PER_SEC;
+}
+
+/**
+ What -formatForHTTPUsingEncoding:ordering: used to do, for comparison: two CFURLCreateStringByAddingPercentEscapes
+ and an -appendFormat: for every pair.
+ */
+
+static NSString* CURLFormBenchmarkLegacyFormat(NSDictionary* dictionary, NSStringEncoding encoding, NSArray* ordering)
+{
+    NSMutableString* s = [NSMutableString stringWithCapacity:256];
+    NSEnumerator* e = (nil == ordering) ? [dictionary keyEnumerator] : [ordering objectEnumerator];
+    CFStringEncoding cfStrEnc = CFStringConvertNSStringEncodingToEncoding(encoding);
+    id key;
+
+    while ((key = [e nextObject]))
+    {
+        id keyObject = [dictionary objectForKey:key];
+        NSString* escapedKey = (NSString*)CFURLCreateStringByAddingPercentEscapes(NULL, (CFStringRef)key, NULL, (CFStringRef)@";:@&=/+", cfStrEnc);
+        NSEnumerator* values = [keyObject respondsToSelector:@selector(objectEnumerator)] ? [keyObject objectEnumerator] : [@[keyObject] objectEnumerator];
+        id value;
+        while ((value = [values nextObject]))
+        {
+            NSString* escapedObject = (NSString*)CFURLCreateStringByAddingPercentEscapes(NULL, (CFStringRef)[value description], NULL, (CFStringRef)@";:@&=/+", cfStrEnc);
+            [s appendFormat:@"%@=%@&", escapedKey, escapedObject];
+            [escapedObject release];
+        }
+        [escapedKey release];
+    }
+
+    if (![s isEqualToString:@""])
+    {
+        [s deleteCharactersInRange:NSMakeRange([s length] - 1, 1)];
+    }
+
+    return s;
+}
+
+@implementation CURLFormEncodingBenchmark
+
+@synthesize rounds = _rounds;
+
+- (id)initWithFieldCount:(NSUInteger)count encoding:(NSStringEncoding)encoding
+{
+    if ((self = [super init]) != nil)
+    {
+        _fieldCount = count;
+        _encoding = encoding;
+        _rounds = 100;
+    }
+
+    return self;
+}
+
+#pragma mark - Fields
+
+- (NSDictionary*)fields
+{
+    NSArray* samples = @[
+                         @"plain",
+                         @"Some text with spaces, and punctuation: like this; and that & the other.",
+                         @"someone@example.com",
+                         @"https://example.com/path/to/something?query=1&other=2",
+                         @"2026-10-18T12:34:56Z",
+                         ];
+
+    NSMutableDictionary* fields = [NSMutableDictionary dictionaryWithCapacity:_fieldCount];
+    for (NSUInteger index = 0; index < _fieldCount; ++index)
+    {
+        NSString* key = [NSString stringWithFormat:@"field%lu", (unsigned long)index];
+        id value;
+        switch (index % 8)
+        {
+            case 0:
+                value = @(index * 37);
+                break;
+            case 1:
+                value = (_encoding == NSUTF8StringEncoding) ? @"Grüße aus Köln — 日本" : @"Greetings from Cologne";
+                break;
+            case 2:
+                value = @[ @"first", @"second value", @"third" ];
+                break;
+            default:
+                value = [samples objectAtIndex:index % [samples count]];
+                break;
+        }
+
+        [fields setObject:value forKey:key];
+    }
+
+    return fields;
+}
+
+#pragma mark - Running
+
+- (NSDictionary*)run
+{
+    NSDictionary* fields = [self fields];
+    NSArray* ordering = [[fields allKeys] sortedArrayUsingSelector:@selector(compare:)];
+    NSUInteger rounds = MAX(_rounds, 1);
+    NSUInteger length = 0;
+
+    uint64_t start = mach_absolute_time();
+    for (NSUInteger round = 0; round < rounds; ++round)
+    {
+        @autoreleasepool
+        {
+            // as a caller would turn the string into a body
+            length = [[CURLFormBenchmarkLegacyFormat(fields, _encoding, ordering) dataUsingEncoding:NSASCIIStringEncoding] length];
+        }
+    }
+    NSTimeInterval legacy = CURLFormBenchmarkSecondsFromMachTime(mach_absolute_time() - start);
+
+    start = mach_absolute_time();
+    for (NSUInteger round = 0; round < rounds; ++round)
+    {
+        @autoreleasepool
+        {
+            length = [[fields formDataForHTTPUsingEncoding:_encoding ordering:ordering] length];
+        }
+    }
+    NSTimeInterval bytes = CURLFormBenchmarkSecondsFromMachTime(mach_absolute_time() - start);
+
+    // CFURL's idea of which characters are legal in a URL has changed over time, so this is reported rather than enforced
+    NSData* legacyData = [CURLFormBenchmarkLegacyFormat(fields, _encoding, ordering) dataUsingEncoding:NSASCIIStringEncoding];
+    BOOL matches = [legacyData isEqualToData:[fields formDataForHTTPUsingEncoding:_encoding ordering:ordering]];
+
+    return @{
+             @"fields" : @(_fieldCount),
+             @"encoding" : (_encoding == NSUTF8StringEncoding) ? @"utf-8" : @"ascii",
+             @"rounds" : @(rounds),
+             @"body_bytes" : @(length),
+             @"legacy_us_per_body" : @(legacy * USEC_PER_SEC / rounds),
+             @"bytes_us_per_body" : @(bytes * USEC_PER_SEC / rounds),
+             @"speedup" : @(bytes > 0 ? legacy / bytes : 0),
+             @"matches_legacy" : @(matches),
+             };
+}
+
+@end
@@ -0,0 +1,280 @@
+//
+//  main.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+//  Runs the end-to-end benchmarks against in-process stand-in servers.
+//
+//  Usage:
+//      Benchmark [-protocols http,ftp] [-sizes 1024,65536,1048576] [-concurrency 1,8,32] [-requests 200]
+//                [-conditions none,wan,lossy] [-decoding none,inline,background] [-output results.json]
+//
+//  -decoding serves the HTTP payloads gzipped, and compares libcurl decoding them inline with decoding
+//  them in the background; try it with large sizes and plenty of concurrency.
+//
+//  Or, to compare the multi's event backends on their own, without any transfers:
+//      Benchmark -events 1000,10000 [-backends gcd,poll] [-rounds 1000] [-output results.json]
+//
+//  Or, to compare building form bodies from dictionaries with the old string-based way:
+//      Benchmark -form 100,1000,10000 [-encodings ascii,utf-8] [-rounds 100] [-output results.json]
+//
+
+#import <Foundation/Foundation.h>
+
+#import "CURLBenchmark.h"
+#import "CURLEventBackendBenchmark.h"
+#import "CURLFormEncodingBenchmark.h"
+#import "CURLNetworkConditions.h"
+
+static NSArray* CURLBenchmarkListArgument(NSUserDefaults* defaults, NSString* key, NSString* fallback, BOOL numeric)
+{
+    NSString* string = [defaults stringForKey:key];
+    if (!string)
+    {
+        string = fallback;
+    }
+
+    NSMutableArray* result = [NSMutableArray array];
+    for (NSString* item in [string componentsSeparatedByString:@","])
+    {
+        NSString* trimmed = [item stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        if ([trimmed length])
+        {
+            [result addObject:numeric ? (id)@([trimmed longLongValue]) : (id)[trimmed lowercaseString]];
+        }
+    }
+
+    return result;
+}
+
+static NSArray* CURLBenchmarkRunEventBackends(NSUserDefaults* defaults, NSArray* socketCounts)
+{
+    NSArray* backends = CURLBenchmarkListArgument(defaults, @"backends", [[CURLEventBackendBenchmark backendNames] componentsJoinedByString:@","], NO);
+    NSInteger rounds = [defaults integerForKey:@"rounds"];
+
+    NSMutableArray* results = [NSMutableArray array];
+    for (NSNumber* count in socketCounts)
+    {
+        for (NSString* name in backends)
+        {
+            if (![CURLEventBackendBenchmark backendNamed:name])
+            {
+                NSLog(@"benchmark: unknown backend '%@', expected one of %@", name, [CURLEventBackendBenchmark backendNames]);
+                return nil;
+            }
+
+            CURLEventBackendBenchmark* benchmark = [[CURLEventBackendBenchmark alloc] initWithBackendName:name socketCount:[count unsignedIntegerValue]];
+            if (rounds > 0)
+            {
+                benchmark.rounds = rounds;
+            }
+
+            NSDictionary* result = [benchmark run];
+            [benchmark release];
+
+            if (!result)
+            {
+                return nil;
+            }
+
+            NSLog(@"benchmark: %@", result);
+            [results addObject:result];
+        }
+    }
+
+    return results;
+}
+
+static NSArray* CURLBenchmarkRunFormEncoding(NSUserDefaults* defaults, NSArray* fieldCounts)
+{
+    NSArray* encodings = CURLBenchmarkListArgument(defaults, @"encodings", @"ascii,utf-8", NO);
+    NSInteger rounds = [defaults integerForKey:@"rounds"];
+
+    NSMutableArray* results = [NSMutableArray array];
+    for (NSNumber* count in fieldCounts)
+    {
+        for (NSString* name in encodings)
+        {
+            NSStringEncoding encoding;
+            if ([name isEqualToString:@"ascii"])
+            {
+                encoding = NSASCIIStringEncoding;
+            }
+            else if ([name isEqualToString:@"utf-8"])
+            {
+                encoding = NSUTF8StringEncoding;
+            }
+            else
+            {
+                NSLog(@"benchmark: unknown encoding '%@', expected ascii or utf-8", name);
+                return nil;
+            }
+
+            CURLFormEncodingBenchmark* benchmark = [[CURLFormEncodingBenchmark alloc] initWithFieldCount:[count unsignedIntegerValue] encoding:encoding];
+            if (rounds > 0)
+            {
+                benchmark.rounds = rounds;
+            }
+
+            NSDictionary* result = [benchmark run];
+            [benchmark release];
+
+            NSLog(@"benchmark: %@", result);
+            [results addObject:result];
+        }
+    }
+
+    return results;
+}
+
+static int CURLBenchmarkWriteOutput(NSUserDefaults* defaults, NSDictionary* output)
+{
+    NSData* json = [NSJSONSerialization dataWithJSONObject:output options:NSJSONWritingPrettyPrinted error:NULL];
+    NSString* path = [defaults stringForKey:@"output"];
+    if (path)
+    {
+        return [json writeToFile:[path stringByExpandingTildeInPath] atomically:YES] ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    [[NSFileHandle fileHandleWithStandardOutput] writeData:json];
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, const char * argv[])
+{
+    int result = EXIT_SUCCESS;
+
+    @autoreleasepool
+    {
+        // NSUserDefaults picks up "-key value" pairs from the command line
+        NSUserDefaults* defaults = [NSUserDefaults standardUserDefaults];
+
+        NSArray* socketCounts = CURLBenchmarkListArgument(defaults, @"events", @"", YES);
+        if ([socketCounts count])
+        {
+            NSArray* results = CURLBenchmarkRunEventBackends(defaults, socketCounts);
+            if (!results)
+            {
+                return EXIT_FAILURE;
+            }
+
+            NSDictionary* output = @{
+                                     @"schema" : @1,
+                                     @"environment" : [CURLBenchmark environment],
+                                     @"event_results" : results,
+                                     };
+
+            return CURLBenchmarkWriteOutput(defaults, output);
+        }
+
+        NSArray* fieldCounts = CURLBenchmarkListArgument(defaults, @"form", @"", YES);
+        if ([fieldCounts count])
+        {
+            NSArray* results = CURLBenchmarkRunFormEncoding(defaults, fieldCounts);
+            if (!results)
+            {
+                return EXIT_FAILURE;
+            }
+
+            NSDictionary* output = @{
+                                     @"schema" : @1,
+                                     @"environment" : [CURLBenchmark environment],
+                                     @"form_results" : results,
+                                     };
+
+            return CURLBenchmarkWriteOutput(defaults, output);
+        }
+
+        NSArray* schemes = CURLBenchmarkListArgument(defaults, @"protocols", @"http,ftp", NO);
+        NSArray* sizes = CURLBenchmarkListArgument(defaults, @"sizes", @"1024,65536,1048576", YES);
+        NSArray* concurrencies = CURLBenchmarkListArgument(defaults, @"concurrency", @"1,8,32", YES);
+        NSInteger requests = [defaults integerForKey:@"requests"];
+        if (requests <= 0)
+        {
+            requests = 200;
+        }
+
+        NSArray* scenarios = [CURLBenchmarkScenario scenariosWithSchemes:schemes sizes:sizes concurrencies:concurrencies requestCount:requests];
+
+        // without any -conditions, connect straight to the servers
+        NSArray* conditionNames = CURLBenchmarkListArgument(defaults, @"conditions", @"", NO);
+        if ([conditionNames count])
+        {
+            NSMutableArray* conditions = [NSMutableArray arrayWithCapacity:[conditionNames count]];
+            for (NSString* name in conditionNames)
+            {
+                CURLNetworkConditions* condition = [CURLNetworkConditions conditionsNamed:name];
+                if (!condition)
+                {
+                    NSLog(@"benchmark: unknown conditions '%@', expected none, wan or lossy", name);
+                    return EXIT_FAILURE;
+                }
+                [conditions addObject:condition];
+            }
+
+            scenarios = [CURLBenchmarkScenario scenarios:scenarios withConditions:conditions];
+        }
+
+        // likewise, without any -decoding, payloads aren't compressed
+        NSArray* decodings = CURLBenchmarkListArgument(defaults, @"decoding", @"", NO);
+        if ([decodings count])
+        {
+            for (NSString* decoding in decodings)
+            {
+                if (![@[ @"none", @"inline", @"background" ] containsObject:decoding])
+                {
+                    NSLog(@"benchmark: unknown decoding '%@', expected none, inline or background", decoding);
+                    return EXIT_FAILURE;
+                }
+            }
+
+            scenarios = [CURLBenchmarkScenario scenarios:scenarios withDecodings:decodings];
+        }
+
+        CURLBenchmark* benchmark = [[CURLBenchmark alloc] init];
+        NSArray* results = [benchmark runScenarios:scenarios];
+        [benchmark stopServers];
+        [benchmark release];
+
+        NSMutableArray* resultDictionaries = [NSMutableArray arrayWithCapacity:[results count]];
+        for (CURLBenchmarkResult* item in results)
+        {
+            [resultDictionaries addObject:[item dictionaryRepresentation]];
+            if (item.failed)
+            {
+                result = EXIT_FAILURE;
+            }
+        }
+
+        NSDictionary* output = @{
+                                 @"schema" : @1,
+                                 @"environment" : [CURLBenchmark environment],
+                                 @"results" : resultDictionaries,
+                                 };
+
+        NSError* error = nil;
+        NSData* json = [NSJSONSerialization dataWithJSONObject:output options:NSJSONWritingPrettyPrinted error:&error];
+        NSString* path = [defaults stringForKey:@"output"];
+        if (!json)
+        {
+            NSLog(@"benchmark: couldn't encode results: %@", error);
+            result = EXIT_FAILURE;
+        }
+        else if (path)
+        {
+            if (![json writeToFile:[path stringByExpandingTildeInPath] options:NSDataWritingAtomic error:&error])
+            {
+                NSLog(@"benchmark: couldn't write results to %@: %@", path, error);
+                result = EXIT_FAILURE;
+            }
+        }
+        else
+        {
+            [[NSFileHandle fileHandleWithStandardOutput] writeData:json];
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,178 @@
+//
+//  CURLCircuitBreaker.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <curl/curl.h>
+
+@protocol CURLCircuitBreakerObserver;
+
+typedef NS_ENUM(NSInteger, CURLCircuitState) {
+    CURLCircuitStateClosed = 0,     // transfers run as normal
+    CURLCircuitStateOpen = 1,       // transfers fail straight away
+    CURLCircuitStateHalfOpen = 2,   // a few probe transfers are let through, to see if the server is back
+};
+
+/**
+ Stops transfers from going to a server that's down, so that they fail straight away
+ rather than each waiting out its own DNS and connect timeouts.
+
+ Give a CURLMultiHandle a breaker with its circuitBreaker property. Each server - a host and port - has its own circuit:
+
+ - While it's closed, transfers run as normal. If failureThreshold of them in a row fail to resolve the host or
+ connect to it, the circuit opens.
+ - While it's open, new transfers to the server fail straight away with CURLCircuitBreakerErrorOpen.
+ - After openDuration, the circuit goes half-open, and lets up to probeCount transfers through. If one of them connects,
+ the circuit closes again; if one fails to, it opens for another openDuration.
+
+ Anything else that happens once a connection has been made, such as a 404 or a bad password, counts as the server being up.
+
+ A breaker can be shared by several multis, and is safe to use from any thread.
+ */
+
+@interface CURLCircuitBreaker : NSObject
+{
+    NSUInteger          _failureThreshold;
+    NSTimeInterval      _openDuration;
+    NSUInteger          _probeCount;
+    id <CURLCircuitBreakerObserver> _observer;
+
+    NSMutableDictionary *_circuits;
+    NSUInteger          _openCount;
+    NSUInteger          _rejectedCount;
+}
+
+/**
+ A breaker with the default settings: opening after 5 failures in a row, and probing again after 30 seconds with one transfer.
+ */
+
++ (CURLCircuitBreaker*)breaker;
+
+/** How many connect or resolve failures in a row open the circuit. Default is 5. */
+@property (assign, atomic) NSUInteger failureThreshold;
+
+/** How long the circuit stays open before letting probes through. Default is 30 seconds. */
+@property (assign, atomic) NSTimeInterval openDuration;
+
+/** How many probe transfers can run at once while the circuit is half-open. Default is 1. */
+@property (assign, atomic) NSUInteger probeCount;
+
+/** Told whenever a circuit changes state. Not retained. */
+@property (assign, atomic) id <CURLCircuitBreakerObserver> observer;
+
+/**
+ Is a failure one that means the server couldn't be reached?
+
+ @param code The CURLcode the transfer finished with.
+ @param connected Whether the transfer got as far as having a connection to use.
+ @return YES for failures to resolve or connect, including timeouts and TLS failures before the connection was ready.
+ */
+
+- (BOOL)isConnectFailureCode:(CURLcode)code connected:(BOOL)connected;
+
+/**
+ The circuit key for a URL: its lowercased host and port, with the scheme's default port filled in.
+
+ @param url The URL.
+ @return The key, or nil if the URL has no host.
+ */
+
++ (NSString*)keyForURL:(NSURL*)url;
+
+/** @name Used by CURLMultiHandle */
+
+/**
+ Decide whether a transfer can go ahead.
+
+ @param url The transfer's URL.
+ @param isProbe Set to YES if the transfer is being let through as a probe of a half-open circuit. The result
+ should be reported with isProbe set to YES, or the probe abandoned.
+ @return NO if the circuit is open and the transfer should fail.
+ */
+
+- (BOOL)shouldAllowTransferToURL:(NSURL*)url isProbe:(BOOL*)isProbe;
+
+/**
+ Report how a transfer ended.
+
+ @param code The CURLcode it finished with.
+ @param connected Whether it got as far as having a connection to use.
+ @param url The transfer's URL.
+ @param isProbe Whether it was let through as a probe.
+ */
+
+- (void)recordCode:(CURLcode)code connected:(BOOL)connected forURL:(NSURL*)url isProbe:(BOOL)isProbe;
+
+/**
+ Give up a probe without a result, as when the transfer is cancelled.
+
+ @param url The transfer's URL.
+ */
+
+- (void)abandonProbeForURL:(NSURL*)url;
+
+/**
+ The error for a transfer that's been refused because its circuit is open.
+
+ @param url The transfer's URL.
+ @return An error in CURLCircuitBreakerErrorDomain.
+ */
+
+- (NSError*)errorForURL:(NSURL*)url;
+
+/** @name Introspection */
+
+/**
+ The state of the circuit for a URL's server.
+
+ @param url The URL.
+ @return The state; an open circuit whose time is up is reported as half-open.
+ */
+
+- (CURLCircuitState)stateForURL:(NSURL*)url;
+
+/** @name Statistics */
+
+/** Times a circuit has opened. */
+@property (readonly, atomic) NSUInteger openCount;
+
+/** Transfers failed straight away because their circuit was open. */
+@property (readonly, atomic) NSUInteger rejectedCount;
+
+@end
+
+
+/**
+ Told about changes to a CURLCircuitBreaker's circuits.
+ */
+
+@protocol CURLCircuitBreakerObserver <NSObject>
+
+/**
+ A circuit has changed state.
+
+ Called on whichever thread reported the transfer result that caused the change (usually a multi's queue), so keep it short.
+
+ @param breaker The breaker.
+ @param key The circuit's server, as returned by +keyForURL:.
+ @param state The new state.
+ */
+
+- (void)circuitBreaker:(CURLCircuitBreaker*)breaker circuit:(NSString*)key didChangeToState:(CURLCircuitState)state;
+
+@end
+
+#pragma mark - Errors
+
+extern NSString * const CURLCircuitBreakerErrorDomain;
+
+typedef NS_ENUM(NSInteger, CURLCircuitBreakerError) {
+    CURLCircuitBreakerErrorOpen = 1,    // the server's circuit is open, so the transfer wasn't attempted
+};
+
+/** In the userInfo of a CURLCircuitBreakerErrorOpen error: the NSDate when the circuit will next let a probe through. */
+extern NSString * const CURLCircuitBreakerRetryDateKey;
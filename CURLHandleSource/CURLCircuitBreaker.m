@@ -0,0 +1,263 @@
+//
+//  CURLCircuitBreaker.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLCircuitBreaker.h"
+
+NSString * const CURLCircuitBreakerErrorDomain = @"com.karelia.curlhandle.circuitbreaker";
+NSString * const CURLCircuitBreakerRetryDateKey = @"CURLCircuitBreakerRetryDate";
+
+#pragma mark - Circuit
+
+/**
+ The state of one server's circuit.
+ */
+
+@interface CURLCircuit : NSObject
+{
+@public
+    CURLCircuitState    _state;
+    NSUInteger          _failures;      // in a row
+    NSTimeInterval      _openedAt;
+    NSUInteger          _probes;        // in flight
+}
+@end
+
+@implementation CURLCircuit
+@end
+
+#pragma mark - Breaker
+
+@implementation CURLCircuitBreaker
+
+@synthesize failureThreshold = _failureThreshold;
+@synthesize openDuration = _openDuration;
+@synthesize probeCount = _probeCount;
+@synthesize observer = _observer;
+@synthesize openCount = _openCount;
+@synthesize rejectedCount = _rejectedCount;
+
++ (CURLCircuitBreaker*)breaker
+{
+    return [[[self alloc] init] autorelease];
+}
+
+- (id)init
+{
+    if (self = [super init])
+    {
+        _failureThreshold = 5;
+        _openDuration = 30.0;
+        _probeCount = 1;
+        _circuits = [[NSMutableDictionary alloc] init];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_circuits release];
+
+    [super dealloc];
+}
+
+- (BOOL)isConnectFailureCode:(CURLcode)code connected:(BOOL)connected
+{
+    switch (code)
+    {
+        case CURLE_COULDNT_RESOLVE_HOST:
+        case CURLE_COULDNT_CONNECT:
+            return YES;
+
+        case CURLE_OPERATION_TIMEDOUT:
+        case CURLE_SSL_CONNECT_ERROR:
+        case CURLE_GOT_NOTHING:
+            return !connected;
+
+        default:
+            return NO;
+    }
+}
+
++ (NSString*)keyForURL:(NSURL *)url
+{
+    NSString* host = [[url host] lowercaseString];
+    if (!host) return nil;
+
+    NSNumber* port = [url port];
+    if (!port)
+    {
+        NSString* scheme = [[url scheme] lowercaseString];
+        NSDictionary* defaults = @{ @"http" : @80, @"https" : @443, @"ftp" : @21, @"ftps" : @990, @"sftp" : @22, @"scp" : @22 };
+        port = [defaults objectForKey:scheme];
+    }
+
+    return (port ? [NSString stringWithFormat:@"%@:%@", host, port] : host);
+}
+
+#pragma mark Transfers
+
+- (CURLCircuit*)circuitForKey:(NSString*)key create:(BOOL)create
+{
+    // call with self locked
+    CURLCircuit* circuit = [_circuits objectForKey:key];
+    if (!circuit && create)
+    {
+        circuit = [[CURLCircuit alloc] init];
+        [_circuits setObject:circuit forKey:key];
+        [circuit release];
+    }
+
+    return circuit;
+}
+
+- (void)notifyCircuit:(NSString*)key changedToState:(CURLCircuitState)state
+{
+    [self.observer circuitBreaker:self circuit:key didChangeToState:state];
+}
+
+- (BOOL)shouldAllowTransferToURL:(NSURL *)url isProbe:(BOOL *)isProbe
+{
+    *isProbe = NO;
+
+    NSString* key = [[self class] keyForURL:url];
+    if (!key) return YES;
+
+    BOOL allowed = YES;
+    BOOL becameHalfOpen = NO;
+
+    @synchronized(self)
+    {
+        CURLCircuit* circuit = [self circuitForKey:key create:NO];
+        if (circuit && circuit->_state != CURLCircuitStateClosed)
+        {
+            if (circuit->_state == CURLCircuitStateOpen && [NSDate timeIntervalSinceReferenceDate] >= circuit->_openedAt + _openDuration)
+            {
+                circuit->_state = CURLCircuitStateHalfOpen;
+                circuit->_probes = 0;
+                becameHalfOpen = YES;
+            }
+
+            if (circuit->_state == CURLCircuitStateHalfOpen && circuit->_probes < MAX(_probeCount, 1U))
+            {
+                ++circuit->_probes;
+                *isProbe = YES;
+            }
+            else
+            {
+                allowed = NO;
+                ++_rejectedCount;
+            }
+        }
+    }
+
+    if (becameHalfOpen) [self notifyCircuit:key changedToState:CURLCircuitStateHalfOpen];
+    return allowed;
+}
+
+- (void)recordCode:(CURLcode)code connected:(BOOL)connected forURL:(NSURL *)url isProbe:(BOOL)isProbe
+{
+    NSString* key = [[self class] keyForURL:url];
+    if (!key) return;
+
+    BOOL failed = [self isConnectFailureCode:code connected:connected];
+    CURLCircuitState before;
+    CURLCircuitState after;
+
+    @synchronized(self)
+    {
+        CURLCircuit* circuit = [self circuitForKey:key create:failed];
+        if (!circuit) return;   // never failed, and still hasn't
+
+        before = circuit->_state;
+        if (isProbe && circuit->_probes) --circuit->_probes;
+
+        if (!failed)
+        {
+            // the server's up, whatever else went wrong
+            [_circuits removeObjectForKey:key];
+            after = CURLCircuitStateClosed;
+        }
+        else
+        {
+            ++circuit->_failures;
+
+            // a failed probe sends the circuit straight back to open; stragglers from before it opened don't extend it
+            if ((before == CURLCircuitStateClosed && circuit->_failures >= _failureThreshold) ||
+                (before == CURLCircuitStateHalfOpen && isProbe))
+            {
+                circuit->_state = CURLCircuitStateOpen;
+                circuit->_openedAt = [NSDate timeIntervalSinceReferenceDate];
+                ++_openCount;
+            }
+
+            after = circuit->_state;
+        }
+    }
+
+    if (after != before) [self notifyCircuit:key changedToState:after];
+}
+
+- (void)abandonProbeForURL:(NSURL *)url
+{
+    NSString* key = [[self class] keyForURL:url];
+    if (!key) return;
+
+    @synchronized(self)
+    {
+        CURLCircuit* circuit = [self circuitForKey:key create:NO];
+        if (circuit && circuit->_probes) --circuit->_probes;
+    }
+}
+
+- (NSError*)errorForURL:(NSURL *)url
+{
+    NSString* key = [[self class] keyForURL:url];
+    NSTimeInterval retry = [NSDate timeIntervalSinceReferenceDate];
+
+    @synchronized(self)
+    {
+        CURLCircuit* circuit = [self circuitForKey:key create:NO];
+        if (circuit && circuit->_state == CURLCircuitStateOpen) retry = circuit->_openedAt + _openDuration;
+    }
+
+    NSString* description = [NSString stringWithFormat:NSLocalizedString(@"%@ isn't responding, so the request wasn't attempted.", @"circuit breaker error"), [url host]];
+    NSDictionary* info = @{ NSURLErrorFailingURLErrorKey : url,
+                            NSLocalizedDescriptionKey : description,
+                            CURLCircuitBreakerRetryDateKey : [NSDate dateWithTimeIntervalSinceReferenceDate:retry] };
+
+    return [NSError errorWithDomain:CURLCircuitBreakerErrorDomain code:CURLCircuitBreakerErrorOpen userInfo:info];
+}
+
+#pragma mark Introspection
+
+- (CURLCircuitState)stateForURL:(NSURL *)url
+{
+    NSString* key = [[self class] keyForURL:url];
+    if (!key) return CURLCircuitStateClosed;
+
+    @synchronized(self)
+    {
+        CURLCircuit* circuit = [self circuitForKey:key create:NO];
+        if (!circuit) return CURLCircuitStateClosed;
+
+        if (circuit->_state == CURLCircuitStateOpen && [NSDate timeIntervalSinceReferenceDate] >= circuit->_openedAt + _openDuration)
+        {
+            return CURLCircuitStateHalfOpen;
+        }
+
+        return circuit->_state;
+    }
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"<%@ %p: %lu opened, %lu rejected>", [self class], self, (unsigned long)self.openCount, (unsigned long)self.rejectedCount];
+}
+
+@end
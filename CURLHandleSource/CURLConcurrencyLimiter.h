@@ -0,0 +1,148 @@
+//
+//  CURLConcurrencyLimiter.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <curl/curl.h>
+
+/**
+ Limits how many transfers a CURLMultiHandle runs at once to each host, adapting the limit to how the host copes.
+
+ Give a multi a limiter with its concurrencyLimiter property. Transfers beyond a host's limit wait in the multi,
+ in the order they were started, until one of the host's running transfers finishes.
+
+ Each host's limit starts at initialLimit and is adjusted as transfers finish (AIMD, as in TCP congestion control):
+
+ - A success grows the limit by additiveIncrease / limit, so it rises by about additiveIncrease for every full
+ window of successes. It only grows once the host has used its whole window.
+ - A sign of overload cuts the limit to limit * decreaseFactor. The signs are a connection failure or timeout,
+ a status in overloadStatusCodes (by default 421 Too Many Connections, 429 and 503), or a time to first byte more than
+ latencySpikeFactor times the host's recent average. Transfers already running when the limit was cut can't cut it again,
+ so that one burst of failures only counts once.
+
+ Other failures, such as a 404 or a bad password, say nothing about load, and leave the limit alone.
+ The limit always stays between minimumLimit and maximumLimit.
+
+ A limiter can be shared by several multis, and is safe to use from any thread.
+ */
+
+@interface CURLConcurrencyLimiter : NSObject
+{
+    NSUInteger          _initialLimit;
+    NSUInteger          _minimumLimit;
+    NSUInteger          _maximumLimit;
+    double              _additiveIncrease;
+    double              _decreaseFactor;
+    double              _latencySpikeFactor;
+    NSIndexSet          *_overloadStatusCodes;
+
+    NSMutableDictionary *_hosts;
+    NSUInteger          _increaseCount;
+    NSUInteger          _decreaseCount;
+}
+
+/**
+ A limiter with the default settings: starting at 4 transfers per host, between 1 and 32, growing by 1 per window
+ and halving on overload, with a latency spike being three times the average.
+ */
+
++ (CURLConcurrencyLimiter*)limiter;
+
+/** The limit for a host that hasn't been seen before. Default is 4; anything less than 1 is taken as 1. */
+@property (assign, atomic) NSUInteger initialLimit;
+
+/** The lowest the limit can go. Default is 1, which is also as low as it can be set, since a host with no slots would never admit another transfer. */
+@property (assign, atomic) NSUInteger minimumLimit;
+
+/** The highest the limit can go. Default is 32; anything less than 1 is taken as 1. */
+@property (assign, atomic) NSUInteger maximumLimit;
+
+/** How much the limit grows over a full window of successes. Default is 1. */
+@property (assign, atomic) double additiveIncrease;
+
+/** What the limit is multiplied by on overload. Default is 0.5. */
+@property (assign, atomic) double decreaseFactor;
+
+/** How many times the host's average time to first byte counts as a latency spike. Default is 3; zero turns spike detection off. */
+@property (assign, atomic) double latencySpikeFactor;
+
+/** The statuses (HTTP or FTP) that mean the server is overloaded. */
+@property (copy, atomic) NSIndexSet* overloadStatusCodes;
+
+/**
+ Does a failure mean the host is overloaded?
+
+ @param code The CURLcode the transfer finished with.
+ @param statusCode The response status, if there was one.
+ @return YES for connection failures, timeouts and overload statuses.
+ */
+
+- (BOOL)isOverloadCode:(CURLcode)code statusCode:(NSInteger)statusCode;
+
+/** @name Used by CURLMultiHandle */
+
+/**
+ Claim a slot for a transfer to a host, if the host has one free.
+
+ @param host The host.
+ @return YES if the transfer can start now; NO if it should wait for a slot to be released.
+ */
+
+- (BOOL)acquireSlotForHost:(NSString*)host;
+
+/**
+ Give back a slot without saying anything about the host, as when a transfer is cancelled.
+
+ @param host The host.
+ */
+
+- (void)releaseSlotForHost:(NSString*)host;
+
+/**
+ Give back a slot for a transfer that's finished, adjusting the host's limit according to how it went.
+
+ @param host The host.
+ @param code The CURLcode the transfer finished with.
+ @param statusCode The response status, if there was one.
+ @param firstByteTime How long the transfer took to get its first byte, or zero if it didn't.
+ @param startTime When the transfer started, as an NSDate reference date interval.
+ */
+
+- (void)releaseSlotForHost:(NSString*)host code:(CURLcode)code statusCode:(NSInteger)statusCode firstByteTime:(NSTimeInterval)firstByteTime startTime:(NSTimeInterval)startTime;
+
+/** @name Introspection */
+
+/**
+ The current limit for a host.
+
+ @param host The host.
+ @return How many transfers to the host can run at once.
+ */
+
+- (NSUInteger)limitForHost:(NSString*)host;
+
+/**
+ How many slots are in use for a host.
+
+ @param host The host.
+ @return How many transfers to the host are running.
+ */
+
+- (NSUInteger)activeCountForHost:(NSString*)host;
+
+/** The current limit for every host seen so far, as NSNumbers keyed by lowercased host name. */
+@property (readonly, atomic) NSDictionary* limits;
+
+/** @name Statistics */
+
+/** Times a host's limit has been raised. */
+@property (readonly, atomic) NSUInteger increaseCount;
+
+/** Times a host's limit has been cut. */
+@property (readonly, atomic) NSUInteger decreaseCount;
+
+@end
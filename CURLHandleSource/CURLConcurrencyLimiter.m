@@ -0,0 +1,281 @@
+//
+//  CURLConcurrencyLimiter.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLConcurrencyLimiter.h"
+
+static const double kLatencyWeight = 0.125;            // same smoothing as TCP's round trip estimate
+static const NSUInteger kMinimumLatencySamples = 5;    // don't call anything a spike until we know what normal is
+
+#pragma mark - Host Window
+
+/**
+ What the limiter knows about one host.
+ */
+
+@interface CURLHostWindow : NSObject
+{
+@public
+    double          _limit;
+    NSUInteger      _active;
+    BOOL            _full;          // has the window been filled since the host was last idle?
+    NSTimeInterval  _averageFirstByteTime;
+    NSUInteger      _latencySamples;
+    NSTimeInterval  _lastDecrease;
+}
+@end
+
+@implementation CURLHostWindow
+@end
+
+#pragma mark - Limiter
+
+@implementation CURLConcurrencyLimiter
+
+@synthesize additiveIncrease = _additiveIncrease;
+@synthesize decreaseFactor = _decreaseFactor;
+@synthesize latencySpikeFactor = _latencySpikeFactor;
+@synthesize overloadStatusCodes = _overloadStatusCodes;
+@synthesize increaseCount = _increaseCount;
+@synthesize decreaseCount = _decreaseCount;
+
++ (CURLConcurrencyLimiter*)limiter
+{
+    return [[[self alloc] init] autorelease];
+}
+
+- (id)init
+{
+    if (self = [super init])
+    {
+        _initialLimit = 4;
+        _minimumLimit = 1;
+        _maximumLimit = 32;
+        _additiveIncrease = 1.0;
+        _decreaseFactor = 0.5;
+        _latencySpikeFactor = 3.0;
+        _hosts = [[NSMutableDictionary alloc] init];
+
+        NSMutableIndexSet* statuses = [NSMutableIndexSet indexSet];
+        [statuses addIndex:421];
+        [statuses addIndex:429];
+        [statuses addIndex:503];
+        _overloadStatusCodes = [statuses copy];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_overloadStatusCodes release];
+    [_hosts release];
+
+    [super dealloc];
+}
+
+#pragma mark Limits
+
+// A limit below one slot would never admit anything again, since no transfer would finish to raise it,
+// so each of these is kept at one or more.
+
+- (NSUInteger)initialLimit
+{
+    @synchronized(self)
+    {
+        return _initialLimit;
+    }
+}
+
+- (void)setInitialLimit:(NSUInteger)limit
+{
+    @synchronized(self)
+    {
+        _initialLimit = MAX(limit, (NSUInteger)1);
+    }
+}
+
+- (NSUInteger)minimumLimit
+{
+    @synchronized(self)
+    {
+        return _minimumLimit;
+    }
+}
+
+- (void)setMinimumLimit:(NSUInteger)limit
+{
+    @synchronized(self)
+    {
+        _minimumLimit = MAX(limit, (NSUInteger)1);
+    }
+}
+
+- (NSUInteger)maximumLimit
+{
+    @synchronized(self)
+    {
+        return _maximumLimit;
+    }
+}
+
+- (void)setMaximumLimit:(NSUInteger)limit
+{
+    @synchronized(self)
+    {
+        _maximumLimit = MAX(limit, (NSUInteger)1);
+    }
+}
+
+- (BOOL)isOverloadCode:(CURLcode)code statusCode:(NSInteger)statusCode
+{
+    if (statusCode > 0 && [self.overloadStatusCodes containsIndex:statusCode]) return YES;
+
+    switch (code)
+    {
+        case CURLE_COULDNT_CONNECT:
+        case CURLE_OPERATION_TIMEDOUT:
+        case CURLE_SSL_CONNECT_ERROR:
+        case CURLE_GOT_NOTHING:
+        case CURLE_SEND_ERROR:
+        case CURLE_RECV_ERROR:
+            return YES;
+
+        default:
+            return NO;
+    }
+}
+
+#pragma mark Slots
+
+- (CURLHostWindow*)windowForHost:(NSString*)host
+{
+    // call with self locked
+    NSString* key = [host lowercaseString];
+    CURLHostWindow* window = [_hosts objectForKey:key];
+    if (!window)
+    {
+        window = [[CURLHostWindow alloc] init];
+        window->_limit = MAX(_initialLimit, _minimumLimit);
+        [_hosts setObject:window forKey:key];
+        [window release];
+    }
+
+    return window;
+}
+
+- (BOOL)acquireSlotForHost:(NSString *)host
+{
+    @synchronized(self)
+    {
+        CURLHostWindow* window = [self windowForHost:host];
+        if (window->_active >= (NSUInteger)window->_limit) return NO;
+
+        ++window->_active;
+        if (window->_active >= (NSUInteger)window->_limit) window->_full = YES;
+    }
+
+    return YES;
+}
+
+- (void)releaseSlotForHost:(NSString *)host
+{
+    @synchronized(self)
+    {
+        CURLHostWindow* window = [self windowForHost:host];
+        NSAssert(window->_active > 0, @"releasing a slot that wasn't acquired");
+        if (--window->_active == 0) window->_full = NO;
+    }
+}
+
+- (void)releaseSlotForHost:(NSString *)host code:(CURLcode)code statusCode:(NSInteger)statusCode firstByteTime:(NSTimeInterval)firstByteTime startTime:(NSTimeInterval)startTime
+{
+    BOOL overloaded = [self isOverloadCode:code statusCode:statusCode];
+
+    @synchronized(self)
+    {
+        CURLHostWindow* window = [self windowForHost:host];
+        NSAssert(window->_active > 0, @"releasing a slot that wasn't acquired");
+        BOOL wasFull = window->_full;
+        if (--window->_active == 0) window->_full = NO;
+
+        if (code == CURLE_OK && firstByteTime > 0)
+        {
+            if (_latencySpikeFactor > 0 && window->_latencySamples >= kMinimumLatencySamples &&
+                firstByteTime > _latencySpikeFactor * window->_averageFirstByteTime)
+            {
+                overloaded = YES;
+            }
+
+            window->_averageFirstByteTime = (window->_latencySamples ?
+                                             window->_averageFirstByteTime + kLatencyWeight * (firstByteTime - window->_averageFirstByteTime) :
+                                             firstByteTime);
+            ++window->_latencySamples;
+        }
+
+        if (overloaded)
+        {
+            // anything that was already running when the limit was last cut is from the same burst
+            if (startTime >= window->_lastDecrease)
+            {
+                window->_limit = MAX(window->_limit * _decreaseFactor, (double)_minimumLimit);
+                window->_lastDecrease = [NSDate timeIntervalSinceReferenceDate];
+                ++_decreaseCount;
+            }
+        }
+        else if (code == CURLE_OK && wasFull)
+        {
+            NSUInteger before = (NSUInteger)window->_limit;
+            // a share of the increase for each slot, so a whole window of successes adds all of it
+            window->_limit = MIN(window->_limit + _additiveIncrease / before, (double)_maximumLimit);
+            if ((NSUInteger)window->_limit > before) ++_increaseCount;
+        }
+    }
+}
+
+#pragma mark Introspection
+
+- (NSUInteger)limitForHost:(NSString *)host
+{
+    @synchronized(self)
+    {
+        CURLHostWindow* window = [_hosts objectForKey:[host lowercaseString]];
+        return (window ? (NSUInteger)window->_limit : MAX(_initialLimit, _minimumLimit));
+    }
+}
+
+- (NSUInteger)activeCountForHost:(NSString *)host
+{
+    @synchronized(self)
+    {
+        CURLHostWindow* window = [_hosts objectForKey:[host lowercaseString]];
+        return (window ? window->_active : 0);
+    }
+}
+
+- (NSDictionary*)limits
+{
+    NSMutableDictionary* result = [NSMutableDictionary dictionary];
+
+    @synchronized(self)
+    {
+        for (NSString* host in _hosts)
+        {
+            CURLHostWindow* window = [_hosts objectForKey:host];
+            [result setObject:@((NSUInteger)window->_limit) forKey:host];
+        }
+    }
+
+    return result;
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"<%@ %p: %@, %lu increases, %lu decreases>", [self class], self, self.limits, (unsigned long)self.increaseCount, (unsigned long)self.decreaseCount];
+}
+
+@end
@@ -0,0 +1,80 @@
+//
+//  CURLContentDecoder.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#include <zlib.h>
+
+/**
+ * Internal helper which inflates a gzip or deflate response body off the multi's queue.
+ * CURLTransfer uses this internally, when the request asks for curl_decodesContentInBackground - not intended for public consumption.
+ *
+ * Each decoder has a serial queue of its own, targeting a global concurrent queue, so that the bodies of
+ * different transfers are decoded in parallel while each one's pieces come out in the order they went in.
+ * Once decoding fails, any more data is ignored, and the failure is reported when finishing.
+ */
+
+@interface CURLContentDecoder : NSObject
+{
+    z_stream            _stream;
+    BOOL                _isDeflate;
+    BOOL                _isRawDeflate;      // a "deflate" body without the zlib wrapper it should have
+    BOOL                _hasInput;
+    BOOL                _isComplete;        // the last of the input ended a stream
+    dispatch_queue_t    _queue;
+    void                (^_outputHandler)(NSData *decoded);
+    volatile BOOL       _cancelled;
+    volatile BOOL       _failed;
+    NSString            *_failureReason;
+}
+
+/**
+ * The value to send as Accept-Encoding when the request leaves it empty.
+ */
+
++ (NSString *)acceptedContentEncodings;
+
+/**
+ * Whether a response with the given Content-Encoding can be decoded.
+ *
+ * @param encoding The header's value. Only a single encoding is supported; `identity`, like no encoding at all, needs no decoder.
+ * @return YES for gzip and deflate.
+ */
+
++ (BOOL)canDecodeContentEncoding:(NSString *)encoding;
+
+/**
+ * @param encoding The response's Content-Encoding, which canDecodeContentEncoding: should have said yes to.
+ * @param handler Given each piece of the decoded body, in order, on the decoder's queue.
+ */
+
+- (id)initWithContentEncoding:(NSString *)encoding outputHandler:(void (^)(NSData *decoded))handler;
+
+/**
+ * Queue up another piece of the encoded body. Returns straight away.
+ */
+
+- (void)decodeData:(NSData *)data;
+
+/**
+ * Once everything queued so far has been decoded and passed on, calls the handler on the decoder's queue.
+ *
+ * @param handler Given a description of what went wrong, or nil if the body decoded cleanly and completely.
+ */
+
+- (void)finishWithCompletionHandler:(void (^)(NSString *failureReason))handler;
+
+/**
+ * Stop passing on the body. Anything still queued is thrown away, although finishing still works as normal.
+ */
+
+- (void)cancel;
+
+/** YES once the body has turned out not to be decodable. Can be checked from any thread. */
+@property (readonly, nonatomic) BOOL failed;
+
+@end
@@ -0,0 +1,186 @@
+//
+//  CURLContentDecoder.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLContentDecoder.h"
+
+#import "CURLTransfer.h"
+
+static const size_t kOutputBufferSize = 64 * 1024;
+
+@interface CURLContentDecoder()
+
+- (void)inflateData:(NSData *)data;
+- (void)failWithReason:(NSString *)reason;
+
+@end
+
+@implementation CURLContentDecoder
+
++ (NSString *)acceptedContentEncodings
+{
+    return @"gzip, deflate";
+}
+
++ (BOOL)canDecodeContentEncoding:(NSString *)encoding
+{
+    encoding = [encoding stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+    for (NSString *supported in @[ @"gzip", @"x-gzip", @"deflate" ])
+    {
+        if ([encoding caseInsensitiveCompare:supported] == NSOrderedSame) return YES;
+    }
+
+    return NO;
+}
+
+- (id)initWithContentEncoding:(NSString *)encoding outputHandler:(void (^)(NSData *))handler
+{
+    NSParameterAssert(handler);
+
+    if ((self = [super init]) != nil)
+    {
+        // 32 more than the window size has zlib detect a gzip or zlib header for itself
+        if (inflateInit2(&_stream, MAX_WBITS + 32) != Z_OK)
+        {
+            [self release];
+            return nil;
+        }
+
+        _isDeflate = ([encoding rangeOfString:@"deflate" options:NSCaseInsensitiveSearch].location != NSNotFound);
+        _outputHandler = [handler copy];
+        _queue = dispatch_queue_create("com.karelia.CURLContentDecoder", DISPATCH_QUEUE_SERIAL);
+        dispatch_set_target_queue(_queue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0));
+
+        CURLHandleLogDetail(@"decoding %@ body", encoding);
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    inflateEnd(&_stream);
+    if (_queue) dispatch_release(_queue);
+    [_outputHandler release];
+    [_failureReason release];
+
+    [super dealloc];
+}
+
+#pragma mark - Decoding
+
+- (void)decodeData:(NSData *)data
+{
+    dispatch_async(_queue, ^{
+        [self inflateData:data];
+    });
+}
+
+- (void)inflateData:(NSData *)data
+{
+    if (_cancelled || _failed) return;
+
+    BOOL isFirstData = !_hasInput;
+    _hasInput = _hasInput || [data length];
+    NSMutableData *output = [[NSMutableData alloc] init];
+    uint8_t *buffer = malloc(kOutputBufferSize);
+
+    // libcurl hands over at most CURL_MAX_WRITE_SIZE at a time, so the length always fits
+    _stream.next_in = (Bytef *)[data bytes];
+    _stream.avail_in = (uInt)[data length];
+
+    while (_stream.avail_in > 0 || _stream.avail_out == 0)
+    {
+        _stream.next_out = buffer;
+        _stream.avail_out = (uInt)kOutputBufferSize;
+
+        int status = inflate(&_stream, Z_NO_FLUSH);
+        _isComplete = (status == Z_STREAM_END);
+        [output appendBytes:buffer length:kOutputBufferSize - _stream.avail_out];
+
+        if (status == Z_DATA_ERROR && _isDeflate && isFirstData && _stream.total_out == 0 && !_isRawDeflate)
+        {
+            // some servers send deflate without the zlib header, as libcurl also allows for
+            inflateEnd(&_stream);
+            memset(&_stream, 0, sizeof(_stream));
+            if (inflateInit2(&_stream, -MAX_WBITS) != Z_OK)
+            {
+                [self failWithReason:@"Couldn't start decoding the body"];
+                break;
+            }
+
+            _isRawDeflate = YES;
+            _stream.next_in = (Bytef *)[data bytes];
+            _stream.avail_in = (uInt)[data length];
+            [output setLength:0];
+            continue;
+        }
+
+        if (status == Z_STREAM_END)
+        {
+            if (_stream.avail_in == 0) break;
+
+            // gzip allows for several members, one after another
+            inflateReset(&_stream);
+        }
+        else if (status == Z_BUF_ERROR)
+        {
+            break;  // wants more input
+        }
+        else if (status != Z_OK)
+        {
+            [self failWithReason:[NSString stringWithFormat:@"Error while processing content unencoding: %s", (_stream.msg ? _stream.msg : "unknown")]];
+            break;
+        }
+    }
+
+    free(buffer);
+
+    if ([output length] && !_failed && !_cancelled)
+    {
+        _outputHandler(output);
+    }
+
+    [output release];
+}
+
+- (void)failWithReason:(NSString *)reason
+{
+    CURLHandleLog(@"decoding failed: %@", reason);
+
+    [_failureReason release];
+    _failureReason = [reason copy];
+    _failed = YES;
+}
+
+#pragma mark - Finishing
+
+- (void)finishWithCompletionHandler:(void (^)(NSString *))handler
+{
+    NSParameterAssert(handler);
+
+    dispatch_async(_queue, ^{
+
+        // a body that stops part way through a stream wasn't all there
+        if (!_failed && !_cancelled && _hasInput && !_isComplete)
+        {
+            [self failWithReason:@"The compressed body ended before it was complete"];
+        }
+
+        [_outputHandler release]; _outputHandler = nil;     // it generally refers back to the transfer
+        handler(_failed ? _failureReason : nil);
+    });
+}
+
+- (void)cancel
+{
+    _cancelled = YES;
+}
+
+@synthesize failed = _failed;
+
+@end
@@ -0,0 +1,110 @@
+//
+//  CURLContentEncoder.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#include <zlib.h>
+
+/**
+ * What -read:maxLength:waitUntilReady: returns when nothing has been compressed yet, and it's not allowed to wait.
+ */
+
+extern const NSInteger CURLContentEncoderNotReady;
+
+/**
+ * Internal helper which compresses a request body with gzip or deflate, ahead of it being sent.
+ * CURLTransfer uses this internally, when the request has a curl_uploadContentEncoding - not intended for public consumption.
+ *
+ * Each encoder has a serial queue of its own, targeting a global concurrent queue, which reads the source stream
+ * and compresses it into a bounded buffer for the transfer to read from. Once the buffer is full the queue stops,
+ * and starts again once the transfer has taken some of it.
+ */
+
+@interface CURLContentEncoder : NSObject
+{
+    z_stream            _stream;
+    NSInputStream       *_inputStream;
+    dispatch_queue_t    _queue;
+    NSCondition         *_condition;        // guards everything below
+    NSMutableData       *_buffer;           // compressed, but not read yet (from _readOffset on)
+    NSUInteger          _readOffset;
+    NSUInteger          _bufferLimit;
+    BOOL                _isProducing;       // the queue is busy compressing
+    BOOL                _isComplete;        // the whole body is in the buffer
+    BOOL                _failed;
+    BOOL                _readerWaiting;     // the reader found nothing, and wants to be told when there is
+    BOOL                _cancelled;
+    BOOL                _rewindsInputStream;    // the source is the replaced encoder's, so starts over (on the queue)
+    void                (^_readyHandler)(void);
+}
+
+/**
+ * Whether a request body can be compressed with the given Content-Encoding.
+ *
+ * @return YES for gzip and deflate.
+ */
+
++ (BOOL)canEncodeContentEncoding:(NSString *)encoding;
+
+/**
+ * Starts compressing straight away.
+ *
+ * @param encoding `gzip` or `deflate`, which canEncodeContentEncoding: should have said yes to.
+ * @param level zlib's compression level: 1 to 9, or -1 for its default.
+ * @param stream The body to compress, already opened. It's read on the encoder's queue, until the encoder is cancelled.
+ * @param limit How much compressed body to keep ahead of the reader.
+ */
+
+- (id)initWithContentEncoding:(NSString *)encoding level:(NSInteger)level inputStream:(NSInputStream *)stream bufferLimit:(NSUInteger)limit;
+
+/**
+ * Takes over from an earlier encoder, for sending the body again. The earlier one is cancelled, and this one doesn't
+ * start until it has finished with its stream, so nothing ever has to wait for that.
+ *
+ * @param encoding `gzip` or `deflate`, which canEncodeContentEncoding: should have said yes to.
+ * @param level zlib's compression level: 1 to 9, or -1 for its default.
+ * @param stream The body to compress, already opened. If it's the earlier encoder's stream, it's rewound to the start
+ * on the encoder's queue; if that fails, so do reads.
+ * @param limit How much compressed body to keep ahead of the reader.
+ * @param previous The encoder being replaced, or nil.
+ */
+
+- (id)initWithContentEncoding:(NSString *)encoding level:(NSInteger)level inputStream:(NSInputStream *)stream bufferLimit:(NSUInteger)limit replacingEncoder:(CURLContentEncoder *)previous;
+
+/**
+ * Take the next of the compressed body. Can be called from any thread, but only one at a time.
+ *
+ * @param wait Whether to wait for the encoder to catch up, rather than returning CURLContentEncoderNotReady.
+ * @return The length read, 0 once the whole body has been read, -1 if reading the source failed,
+ * or CURLContentEncoderNotReady, in which case readyHandler is called once there is more.
+ */
+
+- (NSInteger)read:(uint8_t *)buffer maxLength:(NSUInteger)length waitUntilReady:(BOOL)wait;
+
+/**
+ * Called on the encoder's queue, once, after a read has returned CURLContentEncoderNotReady and that's no longer true.
+ */
+
+@property (copy) void (^readyHandler)(void);
+
+/**
+ * Stop compressing, and throw away the readyHandler. Returns straight away, although the queue may still be reading
+ * the source stream.
+ */
+
+- (void)cancel;
+
+/**
+ * As -cancel, and closes the source stream once the queue has finished with it. Returns straight away too.
+ */
+
+- (void)cancelAndCloseStream;
+
+/** The source stream's error, once a read has returned -1. */
+@property (readonly) NSError *streamError;
+
+@end
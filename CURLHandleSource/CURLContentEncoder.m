@@ -0,0 +1,296 @@
+//
+//  CURLContentEncoder.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLContentEncoder.h"
+
+#import "CURLTransfer.h"
+
+const NSInteger CURLContentEncoderNotReady = -2;
+
+static const size_t kSourceBufferSize = 64 * 1024;
+
+@interface CURLContentEncoder()
+
+- (void)startProducingIfNeeded;
+- (void)produce;
+- (NSData *)deflateBytes:(const uint8_t *)bytes length:(NSUInteger)length finish:(BOOL)finish;
+
+@end
+
+@implementation CURLContentEncoder
+
++ (BOOL)canEncodeContentEncoding:(NSString *)encoding
+{
+    encoding = [encoding stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+    return ([encoding caseInsensitiveCompare:@"gzip"] == NSOrderedSame || [encoding caseInsensitiveCompare:@"deflate"] == NSOrderedSame);
+}
+
+- (id)initWithContentEncoding:(NSString *)encoding level:(NSInteger)level inputStream:(NSInputStream *)stream bufferLimit:(NSUInteger)limit
+{
+    return [self initWithContentEncoding:encoding level:level inputStream:stream bufferLimit:limit replacingEncoder:nil];
+}
+
+- (id)initWithContentEncoding:(NSString *)encoding level:(NSInteger)level inputStream:(NSInputStream *)stream bufferLimit:(NSUInteger)limit replacingEncoder:(CURLContentEncoder *)previous
+{
+    NSParameterAssert(stream);
+    NSParameterAssert(limit > 0);
+
+    if ((self = [super init]) != nil)
+    {
+        // 16 more than the window size has zlib write a gzip wrapper rather than a zlib one
+        BOOL isGzip = ([encoding rangeOfString:@"gzip" options:NSCaseInsensitiveSearch].location != NSNotFound);
+        if (level < Z_DEFAULT_COMPRESSION || level > Z_BEST_COMPRESSION) level = Z_DEFAULT_COMPRESSION;
+        if (deflateInit2(&_stream, (int)level, Z_DEFLATED, (isGzip ? MAX_WBITS + 16 : MAX_WBITS), 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            [self release];
+            return nil;
+        }
+
+        _inputStream = [stream retain];
+        _bufferLimit = limit;
+        _buffer = [[NSMutableData alloc] init];
+        _condition = [[NSCondition alloc] init];
+        _queue = dispatch_queue_create("com.karelia.CURLContentEncoder", DISPATCH_QUEUE_SERIAL);
+        dispatch_set_target_queue(_queue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0));
+
+        // nothing of this one's runs until the encoder it replaces has finished with the stream
+        if (previous)
+        {
+            [previous cancel];
+            _rewindsInputStream = (previous->_inputStream == stream);
+            dispatch_suspend(_queue);
+            dispatch_async(previous->_queue, ^{
+                dispatch_resume(_queue);
+            });
+        }
+
+        CURLHandleLogDetail(@"encoding body as %@, level %ld", encoding, (long)level);
+
+        [_condition lock];
+        [self startProducingIfNeeded];
+        [_condition unlock];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    deflateEnd(&_stream);
+    [_inputStream release];
+    if (_queue) dispatch_release(_queue);
+    [_condition release];
+    [_buffer release];
+    [_readyHandler release];
+
+    [super dealloc];
+}
+
+#pragma mark - Compressing
+
+// Called with the condition locked
+- (void)startProducingIfNeeded
+{
+    if (_isProducing || _isComplete || _failed || _cancelled) return;
+    if ([_buffer length] - _readOffset > _bufferLimit / 2) return;
+
+    _isProducing = YES;
+    dispatch_async(_queue, ^{
+        [self produce];
+    });
+}
+
+- (void)produce
+{
+    uint8_t *source = malloc(kSourceBufferSize);
+
+    while (YES)
+    {
+        [_condition lock];
+        BOOL isFull = ([_buffer length] - _readOffset >= _bufferLimit);
+        if (_cancelled || isFull)
+        {
+            _isProducing = NO;
+            [_condition unlock];
+            break;
+        }
+        [_condition unlock];
+
+        // the stream can take its time, so is read without holding up the reader
+        NSInteger length = -1;
+        if (!_rewindsInputStream || [_inputStream setProperty:@0 forKey:NSStreamFileCurrentOffsetKey])
+        {
+            length = [_inputStream read:source maxLength:kSourceBufferSize];
+        }
+        _rewindsInputStream = NO;
+        NSData *compressed = (length >= 0 ? [self deflateBytes:source length:length finish:(length == 0)] : nil);
+
+        [_condition lock];
+
+        if (compressed)
+        {
+            // throw away what's been read, once there's a fair bit of it
+            if (_readOffset > _bufferLimit)
+            {
+                [_buffer replaceBytesInRange:NSMakeRange(0, _readOffset) withBytes:NULL length:0];
+                _readOffset = 0;
+            }
+
+            [_buffer appendData:compressed];
+            _isComplete = (length == 0);
+        }
+        else
+        {
+            CURLHandleLog(@"reading body to compress failed: %@", [_inputStream streamError]);
+            _failed = YES;
+        }
+
+        BOOL isFinished = (_isComplete || _failed);
+        if (isFinished) _isProducing = NO;
+
+        void (^readyHandler)(void) = nil;
+        if (_readerWaiting && (isFinished || [_buffer length] > _readOffset))
+        {
+            _readerWaiting = NO;
+            readyHandler = [_readyHandler retain];
+        }
+
+        [_condition broadcast];
+        [_condition unlock];
+
+        if (readyHandler)
+        {
+            readyHandler();
+            [readyHandler release];
+        }
+
+        if (isFinished) break;
+    }
+
+    free(source);
+}
+
+- (NSData *)deflateBytes:(const uint8_t *)bytes length:(NSUInteger)length finish:(BOOL)finish
+{
+    NSMutableData *output = [NSMutableData dataWithLength:deflateBound(&_stream, length) + 64];
+    NSUInteger written = 0;
+
+    _stream.next_in = (Bytef *)bytes;
+    _stream.avail_in = (uInt)length;
+
+    while (YES)
+    {
+        // at the finish, zlib may have more of what it's held on to than will fit
+        if (written == [output length]) [output increaseLengthBy:kSourceBufferSize];
+
+        _stream.next_out = (Bytef *)[output mutableBytes] + written;
+        _stream.avail_out = (uInt)([output length] - written);
+
+        int status = deflate(&_stream, (finish ? Z_FINISH : Z_NO_FLUSH));
+        written = [output length] - _stream.avail_out;
+
+        if (status == Z_STREAM_END) break;
+        if (status != Z_OK && status != Z_BUF_ERROR) return nil;
+        if (!finish && _stream.avail_in == 0 && _stream.avail_out > 0) break;
+    }
+
+    [output setLength:written];
+    return output;
+}
+
+#pragma mark - Reading
+
+- (NSInteger)read:(uint8_t *)buffer maxLength:(NSUInteger)length waitUntilReady:(BOOL)wait
+{
+    NSInteger result;
+
+    [_condition lock];
+
+    while (YES)
+    {
+        NSUInteger available = [_buffer length] - _readOffset;
+        if (available > 0)
+        {
+            result = MIN(available, length);
+            memcpy(buffer, (const uint8_t *)[_buffer bytes] + _readOffset, result);
+            _readOffset += result;
+            [self startProducingIfNeeded];
+            break;
+        }
+
+        if (_failed || _cancelled)
+        {
+            result = -1;
+            break;
+        }
+
+        if (_isComplete)
+        {
+            result = 0;
+            break;
+        }
+
+        if (!wait)
+        {
+            _readerWaiting = YES;
+            result = CURLContentEncoderNotReady;
+            break;
+        }
+
+        [_condition wait];
+    }
+
+    [_condition unlock];
+
+    return result;
+}
+
+- (NSError *)streamError
+{
+    return [_inputStream streamError];
+}
+
+#pragma mark - Finishing
+
+- (void (^)(void))readyHandler
+{
+    [_condition lock];
+    void (^handler)(void) = [[_readyHandler retain] autorelease];
+    [_condition unlock];
+
+    return handler;
+}
+
+- (void)setReadyHandler:(void (^)(void))handler
+{
+    handler = [handler copy];
+
+    [_condition lock];
+    [_readyHandler release];
+    _readyHandler = handler;
+    [_condition unlock];
+}
+
+- (void)cancel
+{
+    [_condition lock];
+    _cancelled = YES;
+    [_readyHandler release]; _readyHandler = nil;     // it generally refers back to the transfer
+    [_condition broadcast];
+    [_condition unlock];
+}
+
+- (void)cancelAndCloseStream
+{
+    [self cancel];
+    dispatch_async(_queue, ^{
+        [_inputStream close];
+    });
+}
+
+@end
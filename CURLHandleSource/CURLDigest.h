@@ -0,0 +1,87 @@
+//
+//  CURLDigest.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <CommonCrypto/CommonDigest.h>
+
+typedef NS_ENUM(NSInteger, CURLDigestAlgorithm) {
+    CURLDigestAlgorithmNone = 0,
+    CURLDigestAlgorithmSHA256,
+    CURLDigestAlgorithmCRC32C,      // Castagnoli, as used by iSCSI, ext4 and Google Cloud Storage
+};
+
+/**
+ A digest worked out a piece at a time, so that a body can be checked as it goes by rather than read back afterwards.
+
+ SHA-256 comes from CommonCrypto, which uses whatever the processor offers to speed it up. CRC32C uses the
+ SSE4.2 or ARMv8 CRC32 instructions where the processor has them, and a slicing-by-8 table where it doesn't.
+ The CRC is given as four bytes, most significant first, which is how it's usually written down.
+
+ CURLTransfer keeps one of these for the body it receives and one for the body it sends, when the request
+ asks for it with -[NSMutableURLRequest curl_setDigestAlgorithm:].
+
+ A digest isn't thread safe; feed it from one thread at a time.
+ */
+
+@interface CURLDigest : NSObject
+{
+    CURLDigestAlgorithm     _algorithm;
+    CC_SHA256_CTX           _sha256;
+    uint32_t                _crc;
+    unsigned long long      _length;
+}
+
+/**
+ The digest of some data, all in one go.
+
+ @param data The data.
+ @param algorithm The algorithm to use.
+ @return The digest.
+ */
+
++ (NSData*)digestOfData:(NSData*)data algorithm:(CURLDigestAlgorithm)algorithm;
+
+- (id)initWithAlgorithm:(CURLDigestAlgorithm)algorithm;
+
+/**
+ Add more bytes to the digest.
+
+ @param bytes The bytes.
+ @param length How many there are.
+ */
+
+- (void)updateWithBytes:(const void*)bytes length:(size_t)length;
+- (void)updateWithData:(NSData*)data;
+
+/**
+ Start again, as though nothing had been added.
+ */
+
+- (void)reset;
+
+@property (readonly, nonatomic) CURLDigestAlgorithm algorithm;
+
+/** The digest of everything added so far. More can still be added afterwards. */
+@property (readonly, nonatomic) NSData* digest;
+
+/** How many bytes have been added. */
+@property (readonly, nonatomic) unsigned long long length;
+
+@end
+
+#pragma mark - Errors
+
+extern NSString * const CURLDigestErrorDomain;
+
+typedef NS_ENUM(NSInteger, CURLDigestError) {
+    CURLDigestErrorMismatch = 1,    // the body's digest wasn't the one expected
+};
+
+/** In the userInfo of a CURLDigestErrorMismatch error: the digest that was expected, and the one the body actually had. */
+extern NSString * const CURLDigestExpectedDigestKey;
+extern NSString * const CURLDigestActualDigestKey;
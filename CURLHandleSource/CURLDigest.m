@@ -0,0 +1,259 @@
+//
+//  CURLDigest.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLDigest.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#include <sys/sysctl.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+NSString * const CURLDigestErrorDomain = @"com.karelia.curlhandle.digest";
+NSString * const CURLDigestExpectedDigestKey = @"CURLDigestExpectedDigest";
+NSString * const CURLDigestActualDigestKey = @"CURLDigestActualDigest";
+
+#pragma mark - CRC32C
+
+typedef uint32_t (*CURLCRC32CFunction)(uint32_t crc, const uint8_t* bytes, size_t length);
+
+static uint32_t sCRC32CTable[8][256];
+static CURLCRC32CFunction sCRC32CFunction;
+
+// Eight bytes at a time, with a table for each of their positions. The bytes are read little-endian, as every Mac and iOS device is.
+static uint32_t CURLCRC32CSoftware(uint32_t crc, const uint8_t* bytes, size_t length)
+{
+    while (length && ((uintptr_t)bytes & 7))
+    {
+        crc = sCRC32CTable[0][(crc ^ *bytes++) & 0xff] ^ (crc >> 8);
+        --length;
+    }
+
+    while (length >= 8)
+    {
+        uint32_t low, high;
+        memcpy(&low, bytes, 4);
+        memcpy(&high, bytes + 4, 4);
+        low ^= crc;
+
+        crc = sCRC32CTable[7][low & 0xff] ^ sCRC32CTable[6][(low >> 8) & 0xff] ^ sCRC32CTable[5][(low >> 16) & 0xff] ^ sCRC32CTable[4][low >> 24] ^
+              sCRC32CTable[3][high & 0xff] ^ sCRC32CTable[2][(high >> 8) & 0xff] ^ sCRC32CTable[1][(high >> 16) & 0xff] ^ sCRC32CTable[0][high >> 24];
+
+        bytes += 8;
+        length -= 8;
+    }
+
+    while (length--)
+    {
+        crc = sCRC32CTable[0][(crc ^ *bytes++) & 0xff] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("sse4.2")))
+static uint32_t CURLCRC32CHardware(uint32_t crc, const uint8_t* bytes, size_t length)
+{
+    while (length && ((uintptr_t)bytes & 7))
+    {
+        crc = _mm_crc32_u8(crc, *bytes++);
+        --length;
+    }
+
+#if defined(__x86_64__)
+    while (length >= 8)
+    {
+        uint64_t word;
+        memcpy(&word, bytes, 8);
+        crc = (uint32_t)_mm_crc32_u64(crc, word);
+        bytes += 8;
+        length -= 8;
+    }
+#endif
+
+    while (length--)
+    {
+        crc = _mm_crc32_u8(crc, *bytes++);
+    }
+
+    return crc;
+}
+
+static BOOL CURLHasCRC32CInstructions(void)
+{
+    int available = 0;
+    size_t size = sizeof(available);
+    return (sysctlbyname("hw.optional.sse4_2", &available, &size, NULL, 0) == 0) && available;
+}
+
+#elif defined(__ARM_FEATURE_CRC32)
+
+static uint32_t CURLCRC32CHardware(uint32_t crc, const uint8_t* bytes, size_t length)
+{
+    while (length && ((uintptr_t)bytes & 7))
+    {
+        crc = __crc32cb(crc, *bytes++);
+        --length;
+    }
+
+    while (length >= 8)
+    {
+        uint64_t word;
+        memcpy(&word, bytes, 8);
+        crc = __crc32cd(crc, word);
+        bytes += 8;
+        length -= 8;
+    }
+
+    while (length--)
+    {
+        crc = __crc32cb(crc, *bytes++);
+    }
+
+    return crc;
+}
+
+static BOOL CURLHasCRC32CInstructions(void)
+{
+    return YES;     // built for a processor that has them
+}
+
+#endif
+
+static void CURLCRC32CSetup(void)
+{
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+
+        for (uint32_t index = 0; index < 256; ++index)
+        {
+            uint32_t crc = index;
+            for (NSUInteger bit = 0; bit < 8; ++bit)
+            {
+                crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78 : (crc >> 1);     // the Castagnoli polynomial, reversed
+            }
+            sCRC32CTable[0][index] = crc;
+        }
+
+        for (uint32_t index = 0; index < 256; ++index)
+        {
+            for (NSUInteger table = 1; table < 8; ++table)
+            {
+                uint32_t previous = sCRC32CTable[table - 1][index];
+                sCRC32CTable[table][index] = (previous >> 8) ^ sCRC32CTable[0][previous & 0xff];
+            }
+        }
+
+        sCRC32CFunction = CURLCRC32CSoftware;
+#if defined(__x86_64__) || defined(__i386__) || defined(__ARM_FEATURE_CRC32)
+        if (CURLHasCRC32CInstructions()) sCRC32CFunction = CURLCRC32CHardware;
+#endif
+    });
+}
+
+#pragma mark - Digest
+
+@implementation CURLDigest
+
+@synthesize algorithm = _algorithm;
+@synthesize length = _length;
+
++ (NSData*)digestOfData:(NSData *)data algorithm:(CURLDigestAlgorithm)algorithm
+{
+    CURLDigest* digest = [[self alloc] initWithAlgorithm:algorithm];
+    [digest updateWithData:data];
+    NSData* result = [digest digest];
+    [digest release];
+
+    return result;
+}
+
+- (id)initWithAlgorithm:(CURLDigestAlgorithm)algorithm
+{
+    if (self = [super init])
+    {
+        _algorithm = algorithm;
+        if (_algorithm == CURLDigestAlgorithmCRC32C) CURLCRC32CSetup();
+
+        [self reset];
+    }
+
+    return self;
+}
+
+- (void)reset
+{
+    _length = 0;
+    _crc = 0xFFFFFFFF;
+    CC_SHA256_Init(&_sha256);
+}
+
+- (void)updateWithBytes:(const void *)bytes length:(size_t)length
+{
+    _length += length;
+
+    switch (_algorithm)
+    {
+        case CURLDigestAlgorithmSHA256:
+            // CC_SHA256_Update takes a 32-bit length
+            while (length)
+            {
+                CC_LONG count = (CC_LONG)MIN(length, (size_t)UINT32_MAX);
+                CC_SHA256_Update(&_sha256, bytes, count);
+                bytes = (const uint8_t*)bytes + count;
+                length -= count;
+            }
+            break;
+
+        case CURLDigestAlgorithmCRC32C:
+            _crc = sCRC32CFunction(_crc, bytes, length);
+            break;
+
+        default:
+            break;
+    }
+}
+
+- (void)updateWithData:(NSData *)data
+{
+    [self updateWithBytes:[data bytes] length:[data length]];
+}
+
+- (NSData*)digest
+{
+    switch (_algorithm)
+    {
+        case CURLDigestAlgorithmSHA256:
+        {
+            // finishing spoils the context, so work on a copy in case there's more to come
+            CC_SHA256_CTX context = _sha256;
+            unsigned char result[CC_SHA256_DIGEST_LENGTH];
+            CC_SHA256_Final(result, &context);
+            return [NSData dataWithBytes:result length:sizeof(result)];
+        }
+
+        case CURLDigestAlgorithmCRC32C:
+        {
+            uint32_t crc = CFSwapInt32HostToBig(~_crc);
+            return [NSData dataWithBytes:&crc length:sizeof(crc)];
+        }
+
+        default:
+            return nil;
+    }
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"<%@ %p: %@ of %llu bytes>", [self class], self, [self digest], _length];
+}
+
+@end
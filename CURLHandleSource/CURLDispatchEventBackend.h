@@ -0,0 +1,26 @@
+//
+//  CURLDispatchEventBackend.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLEventBackend.h"
+
+/**
+ The default event backend, which makes a GCD read and/or write source for each socket,
+ and uses a GCD timer source for libcurl's timeout. All of the sources target the multi's queue,
+ so this backend can't be the listener of a multi on an external event loop; starting it without a queue fails.
+ */
+
+@interface CURLDispatchEventBackend : NSObject <CURLEventBackend>
+{
+    dispatch_queue_t    _queue;
+    CURLEventHandler    _handler;
+    dispatch_source_t   _timer;
+    BOOL                _timerIsSuspended;
+    NSMutableDictionary *_sockets;
+}
+
+@end
@@ -0,0 +1,217 @@
+//
+//  CURLDispatchEventBackend.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLDispatchEventBackend.h"
+#import "CURLMultiHandle.h"
+
+/**
+ The reader and writer sources for one socket.
+ */
+
+@interface CURLDispatchSocketSources : NSObject
+{
+@public
+    dispatch_source_t _reader;
+    dispatch_source_t _writer;
+}
+@end
+
+@implementation CURLDispatchSocketSources
+@end
+
+@implementation CURLDispatchEventBackend
+
+#pragma mark - Object Lifecycle
+
+- (id)init
+{
+    if ((self = [super init]) != nil)
+    {
+        _sockets = [[NSMutableDictionary alloc] init];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    NSAssert(_timer == NULL, @"should have been stopped by the time we're dealloced");
+
+    [_sockets release];
+    [_handler release];
+    if (_queue)
+    {
+        dispatch_release(_queue);
+    }
+
+    [super dealloc];
+}
+
+#pragma mark - CURLEventBackend
+
+- (BOOL)startWithQueue:(dispatch_queue_t)queue handler:(CURLEventHandler)handler
+{
+    // a source with no queue would call the handler on a global queue, off the loop's thread
+    if (!queue)
+    {
+        CURLMultiLogError(@"the dispatch backend needs a queue, so can't listen for a multi on an external event loop");
+        return NO;
+    }
+
+    dispatch_retain(queue);
+    _queue = queue;
+    _handler = [handler copy];
+
+    _timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, queue);
+    if (!_timer)
+    {
+        CURLMultiLogError(@"couldn't create timer source");
+        return NO;
+    }
+
+    _timerIsSuspended = YES;
+    // libcurl will tell us when to resume the timer
+
+    dispatch_source_set_event_handler(_timer, ^{
+        CURLMultiLog(@"timer fired");
+        _handler(CURL_SOCKET_TIMEOUT, 0);
+    });
+
+    dispatch_source_t timer = _timer;
+    dispatch_source_set_cancel_handler(timer, ^{
+        dispatch_release(timer);
+    });
+
+    return YES;
+}
+
+- (void)watchSocket:(curl_socket_t)socket reading:(BOOL)reading writing:(BOOL)writing
+{
+    NSNumber* key = @(socket);
+    CURLDispatchSocketSources* sources = [_sockets objectForKey:key];
+    if (!sources)
+    {
+        if (!reading && !writing) return;
+
+        sources = [[CURLDispatchSocketSources alloc] init];
+        [_sockets setObject:sources forKey:key];
+        [sources release];
+    }
+
+    sources->_reader = [self updateSource:sources->_reader type:DISPATCH_SOURCE_TYPE_READ socket:socket sources:sources required:reading];
+    sources->_writer = [self updateSource:sources->_writer type:DISPATCH_SOURCE_TYPE_WRITE socket:socket sources:sources required:writing];
+
+    if (!reading && !writing)
+    {
+        [_sockets removeObjectForKey:key];
+    }
+}
+
+- (void)setTimeout:(long)timeout_ms
+{
+    if (!_timer) return;
+
+    if (timeout_ms < 0)
+    {
+        if (!_timerIsSuspended)
+        {
+            _timerIsSuspended = YES;
+            dispatch_suspend(_timer);
+        }
+    }
+    else
+    {
+        int64_t timeout_ns = timeout_ms * NSEC_PER_MSEC;
+
+        dispatch_source_set_timer(_timer,
+                                  dispatch_time(DISPATCH_TIME_NOW, timeout_ns), // fire when timeout is reached
+                                  DISPATCH_TIME_FOREVER,                        // libcurl takes care of rescheduling
+                                  timeout_ns/100);                              // we're fairly delay tolerant
+
+        if (_timerIsSuspended)
+        {
+            _timerIsSuspended = NO;
+            dispatch_resume(_timer);
+        }
+    }
+}
+
+- (void)stop
+{
+    for (NSNumber* socket in [_sockets allKeys])
+    {
+        [self watchSocket:[socket intValue] reading:NO writing:NO];
+    }
+
+    if (_timer)
+    {
+        dispatch_source_cancel(_timer); // the cancel handler will release the source
+        if (_timerIsSuspended)
+        {
+            // a suspended source never gets its cancel handler called
+            _timerIsSuspended = NO;
+            dispatch_resume(_timer);
+        }
+        _timer = NULL;
+    }
+
+    // the sources are cancelled, and we're on the queue, so nothing can call the handler now
+    [_handler release]; _handler = nil;
+}
+
+#pragma mark - Sources
+
+- (NSString*)nameForType:(dispatch_source_type_t)type
+{
+    return (type == DISPATCH_SOURCE_TYPE_READ) ? @"reader" : @"writer";
+}
+
+- (dispatch_source_t)updateSource:(dispatch_source_t)source type:(dispatch_source_type_t)type socket:(int)socket sources:(CURLDispatchSocketSources*)sources required:(BOOL)required
+{
+    if (required)
+    {
+        if (!source)
+        {
+            CURLMultiLog(@"added %@ dispatch source for socket %d", [self nameForType:type], socket);
+            source = dispatch_source_create(type, socket, 0, _queue);
+
+            int action = (type == DISPATCH_SOURCE_TYPE_READ) ? CURL_CSELECT_IN : CURL_CSELECT_OUT;
+            dispatch_source_set_event_handler(source, ^{
+                CURLMultiLog(@"%@ dispatch source fired for socket %d with value %ld", [self nameForType:type], socket, dispatch_source_get_data(source));
+                BOOL sourceIsActive = ([_sockets objectForKey:@(socket)] == sources) && ((sources->_reader == source) || (sources->_writer == source));
+                NSAssert(sourceIsActive, @"should have active source");
+                if (sourceIsActive)
+                {
+                    _handler(socket, action);
+                }
+            });
+
+            dispatch_source_set_cancel_handler(source, ^{
+                CURLMultiLog(@"removed %@ dispatch source for socket %d", [self nameForType:type], socket);
+                dispatch_release(source);
+            });
+
+            dispatch_resume(source);
+        }
+    }
+    else if (source)
+    {
+        CURLMultiLog(@"removing %@ dispatch source for socket %d", [self nameForType:type], socket);
+        dispatch_source_cancel(source);
+        source = nil;
+    }
+
+    return source;
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"<GCD BACKEND %p, %lu sockets>", self, (unsigned long)[_sockets count]];
+}
+
+@end
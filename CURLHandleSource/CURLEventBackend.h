@@ -0,0 +1,74 @@
+//
+//  CURLEventBackend.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#import <curl/curl.h>
+
+/**
+ Called by a backend when something needs the multi's attention.
+
+ @param socket The socket which is ready, or CURL_SOCKET_TIMEOUT if the timer fired.
+ @param action CURL_CSELECT_IN or CURL_CSELECT_OUT for a socket, or zero for the timer.
+ */
+
+typedef void (^CURLEventHandler)(curl_socket_t socket, int action);
+
+/**
+ The interface between CURLMultiHandle and whatever waits for its sockets and timer.
+
+ When a multi is using socket actions, libcurl tells it which sockets to watch and when it next
+ needs a timeout; the multi passes that on to its backend, and the backend calls back when one
+ of them is due. CURLDispatchEventBackend (which uses GCD sources) is the default; CURLPollEventBackend
+ waits on a thread of its own instead. Anything else that implements this protocol can be passed
+ to -[CURLMultiHandle initWithEventBackend:].
+
+ The backend is started when the multi is created; after that, every method is called on the multi's queue,
+ and the handler must only ever be called on that queue too.
+ */
+
+@protocol CURLEventBackend <NSObject>
+
+/**
+ Start delivering events. Called once, before anything else.
+
+ @param queue The multi's serial queue, which the handler must be called on. NULL when the backend is the listener of a
+ multi on an external event loop (see -[CURLMultiHandle initForExternalEventLoop:]), in which case the handler must be
+ called on the loop's thread. A backend which can only deliver events through a queue should return NO for NULL.
+ @param handler The block to call when a watched socket is ready or the timer fires.
+ @return YES if the backend is ready. NO if it couldn't set up what it needs to wait for events, in which case it
+ won't call the handler, and the multi fails to initialise rather than leaving its transfers waiting forever.
+ */
+
+- (BOOL)startWithQueue:(dispatch_queue_t)queue handler:(CURLEventHandler)handler;
+
+/**
+ Change what a socket is watched for. Passing NO for both stops watching it.
+
+ @param socket The socket.
+ @param reading YES to report when the socket is readable.
+ @param writing YES to report when the socket is writable.
+ */
+
+- (void)watchSocket:(curl_socket_t)socket reading:(BOOL)reading writing:(BOOL)writing;
+
+/**
+ Set the one-shot timer.
+
+ @param timeout_ms How long from now the timer should fire, in milliseconds; a negative value stops the timer.
+ */
+
+- (void)setTimeout:(long)timeout_ms;
+
+/**
+ Stop everything. The handler mustn't be called again once this returns, and should be released.
+ */
+
+- (void)stop;
+
+@end
@@ -0,0 +1,194 @@
+//
+//  CURLHTTPCache.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ A response held by a CURLHTTPCache.
+ */
+
+@interface CURLCachedHTTPResponse : NSObject
+{
+    NSURL           *_URL;
+    NSInteger       _statusCode;
+    NSString        *_headerString;
+    NSData          *_data;
+    NSString        *_entityTag;
+    NSString        *_lastModified;
+
+    NSString        *_key;
+    uint64_t        _fingerprint;
+    NSTimeInterval  _freshUntil;
+    NSDictionary    *_varyValues;
+    NSURL           *_temporaryURL;
+    int             _fileDescriptor;
+    uint64_t        _size;
+}
+
+/** The URL the response came from, after any redirects. */
+@property (readonly, copy, nonatomic) NSURL* URL;
+@property (readonly, nonatomic) NSInteger statusCode;
+
+/** The raw response headers, including the status line, as received. */
+@property (readonly, copy, nonatomic) NSString* headerString;
+
+/** The body, mapped from disk. Nil while the response is still being stored. */
+@property (readonly, strong, nonatomic) NSData* data;
+
+/** The ETag validator, if the response had one. */
+@property (readonly, copy, nonatomic) NSString* entityTag;
+
+/** The Last-Modified validator, if the response had one. */
+@property (readonly, copy, nonatomic) NSString* lastModified;
+
+@end
+
+
+/**
+ An on-disk cache of HTTP responses, so that CURLTransfer can honour a request's cachePolicy.
+
+ Install a cache with +[CURLTransfer setHTTPCache:]. From then on, GET requests without a body (or their own
+ conditional or Range headers) are looked up before they're sent. Requests made as somebody - with a credential,
+ a login in the URL, or an Authorization or Cookie header - are left alone, since the cache is keyed by URL and
+ would otherwise hand one user's responses to another:
+
+ - A fresh response is delivered straight from the cache, without the request going anywhere near a multi.
+ - A stale response with an ETag or Last-Modified date is revalidated: the request is sent with If-None-Match
+   and If-Modified-Since, and a 304 delivers the cached copy (and refreshes it).
+ - Otherwise the request goes out as normal. A 200 response is stored as it streams in, if its headers allow it.
+
+ Freshness follows Cache-Control max-age, no-cache and no-store, then Expires, and otherwise 10% of the time since
+ Last-Modified (up to a day). Responses marked Cache-Control private aren't kept. Responses with Vary are only used for requests which send the same values for the
+ varying headers. NSURLRequestReturnCacheDataElseLoad and NSURLRequestReturnCacheDataDontLoad use a cached response
+ however old it is; NSURLRequestReloadRevalidatingCacheData always revalidates; and the two ignoring policies
+ skip the lookup, but still store what comes back. Any other method sent to a URL drops its cached response.
+
+ Each response's body and headers are kept in files of their own. They're tracked by an index of fixed-size
+ slots, memory-mapped from the directory, with room for 4096 responses. When the bodies add up to more than
+ the capacity, the least recently used responses are evicted.
+
+ A cache is safe to use from any thread, but only one cache should use a directory at a time.
+ */
+
+@interface CURLHTTPCache : NSObject
+{
+    NSURL               *_directoryURL;
+    unsigned long long  _capacity;
+    void                *_index;
+    size_t              _indexLength;
+    unsigned long long  _currentSize;
+
+    NSUInteger          _hitCount;
+    NSUInteger          _revalidationCount;
+    NSUInteger          _notModifiedCount;
+    NSUInteger          _missCount;
+}
+
+/**
+ Make a cache.
+
+ @param directoryURL Where to keep the cache. Created if need be; anything already cached there is used.
+ @param capacity The most the cached bodies should add up to, in bytes.
+ @return The new cache, or nil if its index couldn't be created.
+ */
+
+- (id)initWithDirectoryURL:(NSURL*)directoryURL capacity:(unsigned long long)capacity;
+
+@property (readonly, copy, nonatomic) NSURL* directoryURL;
+@property (readonly, nonatomic) unsigned long long capacity;
+
+/** How much the cached bodies add up to, in bytes. */
+@property (readonly, atomic) unsigned long long currentSize;
+
+/**
+ Could a request be answered from the cache?
+
+ @param request The request.
+ @return YES for HTTP GET requests without a body, conditional or Range headers of their own, or anything identifying
+ the user: an Authorization or Cookie header, or a user or password in the URL.
+ */
+
++ (BOOL)canCacheRequest:(NSURLRequest*)request;
+
+/** @name Used by CURLTransfer */
+
+/**
+ Look up the response to a request, following its cachePolicy.
+
+ @param request The request.
+ @param mustRevalidate Set to YES if the response has to be revalidated before it can be used.
+ @return The cached response, or nil if there isn't one that can be used.
+ */
+
+- (CURLCachedHTTPResponse*)cachedResponseForRequest:(NSURLRequest*)request mustRevalidate:(BOOL*)mustRevalidate;
+
+/**
+ Start storing the response to a request, if it can be cached.
+
+ @param request The request.
+ @param url The URL the response came from.
+ @param statusCode The response status.
+ @param headerString The raw response headers.
+ @return A response to pass the body to, or nil if it isn't to be cached.
+ */
+
+- (CURLCachedHTTPResponse*)storeResponseToRequest:(NSURLRequest*)request URL:(NSURL*)url statusCode:(NSInteger)statusCode headerString:(NSString*)headerString;
+
+- (void)appendData:(NSData*)data toResponse:(CURLCachedHTTPResponse*)response;
+- (void)finishStoringResponse:(CURLCachedHTTPResponse*)response;
+- (void)abandonStoringResponse:(CURLCachedHTTPResponse*)response;
+
+/**
+ Note that the server says a cached response is still good.
+
+ The 304's header fields replace the stored ones of the same name, in memory and on disk, so a new ETag, Last-Modified
+ date, Cache-Control or Date is what the response is used and revalidated with from then on.
+
+ @param response The response that was revalidated.
+ @param headerString The headers of the 304 response, which may say how long it's good for now.
+ */
+
+- (void)updateResponse:(CURLCachedHTTPResponse*)response withNotModifiedHeaderString:(NSString*)headerString;
+
+/**
+ Drop the cached response for a request, if the request changes the resource.
+
+ @param request A request which is about to be sent.
+ */
+
+- (void)invalidateResponseForRequest:(NSURLRequest*)request;
+
+/**
+ Drop the cached response for a URL.
+
+ @param url The URL.
+ */
+
+- (void)removeResponseForURL:(NSURL*)url;
+
+/**
+ Empty the cache.
+ */
+
+- (void)removeAllResponses;
+
+/** @name Statistics */
+
+/** Requests answered from the cache without being sent. */
+@property (readonly, atomic) NSUInteger hitCount;
+
+/** Requests sent to revalidate a cached response. */
+@property (readonly, atomic) NSUInteger revalidationCount;
+
+/** Revalidations which found the cached response was still good. */
+@property (readonly, atomic) NSUInteger notModifiedCount;
+
+/** Cacheable requests which had no usable response in the cache. */
+@property (readonly, atomic) NSUInteger missCount;
+
+@end
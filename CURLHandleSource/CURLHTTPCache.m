@@ -0,0 +1,759 @@
+//
+//  CURLHTTPCache.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLHTTPCache.h"
+#import "CURLNegativeCache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <xlocale.h>
+
+static const uint32_t kSlotCount = 4096;
+static const uint32_t kWays = 8;                    // slots per bucket; a response can live in any of its bucket's slots
+static const char kMagic[8] = "CURLHC1";
+static const uint32_t kVersion = 1;
+static const NSTimeInterval kMaximumHeuristicLifetime = 24 * 60 * 60;
+
+typedef struct
+{
+    char            magic[8];
+    uint32_t        version;
+    uint32_t        slotCount;
+} CURLHTTPCacheIndexHeader;
+
+typedef struct
+{
+    uint64_t        fingerprint;    // zero for an empty slot
+    uint64_t        size;           // of the body
+    NSTimeInterval  lastUsed;       // since the reference date, so they survive a relaunch
+    NSTimeInterval  freshUntil;
+} CURLHTTPCacheSlot;
+
+#pragma mark - Header Parsing
+
+// 64-bit FNV-1a
+static uint64_t CURLHTTPCacheFingerprint(NSString *string)
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    const char *bytes = [string UTF8String];
+    while (*bytes)
+    {
+        hash ^= (uint8_t)*bytes++;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash ? hash : 1;     // keep zero for empty slots
+}
+
+static NSDictionary *CURLHTTPCacheHeaderFields(NSString *headerString)
+{
+    // with redirects or 100 Continue, there's more than one response; the last one is what's cached
+    NSMutableDictionary *fields = [NSMutableDictionary dictionary];
+    NSCharacterSet *whitespace = [NSCharacterSet whitespaceCharacterSet];
+
+    for (NSString *line in [headerString componentsSeparatedByCharactersInSet:[NSCharacterSet newlineCharacterSet]])
+    {
+        if ([line hasPrefix:@"HTTP/"])
+        {
+            [fields removeAllObjects];
+            continue;
+        }
+
+        NSRange colon = [line rangeOfString:@":"];
+        if (colon.location == NSNotFound) continue;
+
+        NSString *name = [[line substringToIndex:colon.location] lowercaseString];
+        NSString *value = [[line substringFromIndex:colon.location + 1] stringByTrimmingCharactersInSet:whitespace];
+        NSString *existing = [fields objectForKey:name];
+        [fields setObject:(existing ? [NSString stringWithFormat:@"%@, %@", existing, value] : value) forKey:name];
+    }
+
+    return fields;
+}
+
+// The stored headers, with any field a 304 sent replacing the stored one (RFC 7234 section 4.3.4)
+static NSString *CURLHTTPCacheMergedHeaderString(NSString *headerString, NSString *notModifiedHeaderString)
+{
+    NSCharacterSet *returns = [NSCharacterSet characterSetWithCharactersInString:@"\r"];
+    NSMutableArray *updates = [NSMutableArray array];
+    NSMutableSet *updatedNames = [NSMutableSet set];
+
+    for (NSString *line in [notModifiedHeaderString componentsSeparatedByString:@"\n"])
+    {
+        line = [line stringByTrimmingCharactersInSet:returns];
+        if ([line hasPrefix:@"HTTP/"])
+        {
+            [updates removeAllObjects];
+            [updatedNames removeAllObjects];
+            continue;
+        }
+
+        NSRange colon = [line rangeOfString:@":"];
+        if (colon.location == NSNotFound) continue;
+
+        // the length is the body's, and the 304 didn't send one
+        NSString *name = [[line substringToIndex:colon.location] lowercaseString];
+        if ([name isEqualToString:@"content-length"]) continue;
+
+        [updates addObject:line];
+        [updatedNames addObject:name];
+    }
+
+    if (![updates count]) return headerString;
+
+    // only the last response's fields are replaced; any redirects before it stay as they were
+    NSMutableArray *lines = [NSMutableArray array];
+    NSUInteger lastStatus = 0;
+    for (NSString *line in [headerString componentsSeparatedByString:@"\n"])
+    {
+        line = [line stringByTrimmingCharactersInSet:returns];
+        if ([line hasPrefix:@"HTTP/"]) lastStatus = [lines count];
+        [lines addObject:line];
+    }
+
+    NSMutableArray *merged = [NSMutableArray arrayWithArray:[lines subarrayWithRange:NSMakeRange(0, lastStatus + 1)]];
+    for (NSString *line in [lines subarrayWithRange:NSMakeRange(lastStatus + 1, [lines count] - lastStatus - 1)])
+    {
+        if (![line length]) continue;
+
+        NSRange colon = [line rangeOfString:@":"];
+        if (colon.location != NSNotFound && [updatedNames containsObject:[[line substringToIndex:colon.location] lowercaseString]]) continue;
+        [merged addObject:line];
+    }
+    [merged addObjectsFromArray:updates];
+    [merged addObject:@""];
+    [merged addObject:@""];
+
+    return [merged componentsJoinedByString:@"\r\n"];
+}
+
+static NSDictionary *CURLHTTPCacheDirectives(NSString *cacheControl)
+{
+    NSMutableDictionary *directives = [NSMutableDictionary dictionary];
+    NSCharacterSet *whitespace = [NSCharacterSet whitespaceCharacterSet];
+
+    for (NSString *part in [cacheControl componentsSeparatedByString:@","])
+    {
+        NSString *directive = [[part stringByTrimmingCharactersInSet:whitespace] lowercaseString];
+        NSRange equals = [directive rangeOfString:@"="];
+        if (equals.location == NSNotFound)
+        {
+            if ([directive length]) [directives setObject:@"" forKey:directive];
+        }
+        else
+        {
+            NSString *value = [[directive substringFromIndex:equals.location + 1] stringByTrimmingCharactersInSet:[NSCharacterSet characterSetWithCharactersInString:@"\" "]];
+            [directives setObject:value forKey:[[directive substringToIndex:equals.location] stringByTrimmingCharactersInSet:whitespace]];
+        }
+    }
+
+    return directives;
+}
+
+// An RFC 1123 date, as seconds since the reference date, or NAN
+static NSTimeInterval CURLHTTPCacheParseDate(NSString *string)
+{
+    const char *chars = [string UTF8String];
+    if (!chars) return NAN;
+
+    struct tm components;
+    memset(&components, 0, sizeof(components));
+    if (!strptime_l(chars, "%a, %d %b %Y %H:%M:%S", &components, NULL)) return NAN;    // NULL is the C locale
+
+    return (NSTimeInterval)timegm(&components) - NSTimeIntervalSince1970;
+}
+
+// How long from now a response stays fresh; zero or less means it's already stale
+static NSTimeInterval CURLHTTPCacheLifetime(NSDictionary *fields, NSTimeInterval now)
+{
+    NSDictionary *directives = CURLHTTPCacheDirectives([fields objectForKey:@"cache-control"]);
+    if ([directives objectForKey:@"no-cache"]) return 0;
+
+    NSTimeInterval date = CURLHTTPCacheParseDate([fields objectForKey:@"date"]);
+    if (isnan(date)) date = now;
+
+    NSTimeInterval lifetime = 0;
+    NSString *maxAge = [directives objectForKey:@"max-age"];
+    if (maxAge)
+    {
+        lifetime = [maxAge doubleValue];
+    }
+    else if ([fields objectForKey:@"expires"])
+    {
+        // an Expires we can't read means it's already expired
+        NSTimeInterval expires = CURLHTTPCacheParseDate([fields objectForKey:@"expires"]);
+        if (!isnan(expires)) lifetime = expires - date;
+    }
+    else
+    {
+        NSTimeInterval lastModified = CURLHTTPCacheParseDate([fields objectForKey:@"last-modified"]);
+        if (!isnan(lastModified)) lifetime = MIN((date - lastModified) / 10, kMaximumHeuristicLifetime);
+    }
+
+    return lifetime - [[fields objectForKey:@"age"] doubleValue];
+}
+
+static NSDictionary *CURLHTTPCacheVaryValues(NSDictionary *fields, NSURLRequest *request)
+{
+    NSMutableDictionary *values = [NSMutableDictionary dictionary];
+    for (NSString *name in [[fields objectForKey:@"vary"] componentsSeparatedByString:@","])
+    {
+        NSString *field = [[name stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]] lowercaseString];
+        if (![field length]) continue;
+
+        NSString *value = [request valueForHTTPHeaderField:field];
+        [values setObject:(value ? value : @"") forKey:field];
+    }
+
+    return values;
+}
+
+#pragma mark - Response
+
+@interface CURLCachedHTTPResponse()
+
+- (id)initWithURL:(NSURL*)url statusCode:(NSInteger)statusCode headerString:(NSString*)headerString fields:(NSDictionary*)fields;
+
+@property (readwrite, copy, nonatomic) NSString* headerString;
+@property (readwrite, strong, nonatomic) NSData* data;
+@property (readwrite, copy, nonatomic) NSString* entityTag;
+@property (readwrite, copy, nonatomic) NSString* lastModified;
+@property (copy, nonatomic) NSString* key;
+@property (assign, nonatomic) uint64_t fingerprint;
+@property (assign, nonatomic) NSTimeInterval freshUntil;
+@property (copy, nonatomic) NSDictionary* varyValues;
+@property (copy, nonatomic) NSURL* temporaryURL;
+@property (assign, nonatomic) int fileDescriptor;
+@property (assign, nonatomic) uint64_t size;
+
+@end
+
+@implementation CURLCachedHTTPResponse
+
+@synthesize URL = _URL;
+@synthesize statusCode = _statusCode;
+@synthesize headerString = _headerString;
+@synthesize data = _data;
+@synthesize entityTag = _entityTag;
+@synthesize lastModified = _lastModified;
+@synthesize key = _key;
+@synthesize fingerprint = _fingerprint;
+@synthesize freshUntil = _freshUntil;
+@synthesize varyValues = _varyValues;
+@synthesize temporaryURL = _temporaryURL;
+@synthesize fileDescriptor = _fileDescriptor;
+@synthesize size = _size;
+
+- (id)initWithURL:(NSURL *)url statusCode:(NSInteger)statusCode headerString:(NSString *)headerString fields:(NSDictionary *)fields
+{
+    if (self = [super init])
+    {
+        _URL = [url copy];
+        _statusCode = statusCode;
+        _headerString = [headerString copy];
+        _entityTag = [[fields objectForKey:@"etag"] copy];
+        _lastModified = [[fields objectForKey:@"last-modified"] copy];
+        _fileDescriptor = -1;
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    NSAssert(_fileDescriptor < 0, @"a response should be finished or abandoned before it's thrown away");
+
+    [_URL release];
+    [_headerString release];
+    [_data release];
+    [_entityTag release];
+    [_lastModified release];
+    [_key release];
+    [_varyValues release];
+    [_temporaryURL release];
+
+    [super dealloc];
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"<%@ %p: %ld %@>", [self class], self, (long)self.statusCode, self.URL];
+}
+
+@end
+
+#pragma mark - Cache
+
+@implementation CURLHTTPCache
+
+@synthesize directoryURL = _directoryURL;
+@synthesize capacity = _capacity;
+@synthesize currentSize = _currentSize;
+@synthesize hitCount = _hitCount;
+@synthesize revalidationCount = _revalidationCount;
+@synthesize notModifiedCount = _notModifiedCount;
+@synthesize missCount = _missCount;
+
+- (id)initWithDirectoryURL:(NSURL *)directoryURL capacity:(unsigned long long)capacity
+{
+    NSParameterAssert(directoryURL);
+
+    if (self = [super init])
+    {
+        _directoryURL = [directoryURL copy];
+        _capacity = capacity;
+
+        if (![[NSFileManager defaultManager] createDirectoryAtURL:directoryURL withIntermediateDirectories:YES attributes:nil error:NULL] || ![self openIndex])
+        {
+            [self release]; return nil;
+        }
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_index) munmap(_index, _indexLength);
+    [_directoryURL release];
+
+    [super dealloc];
+}
+
+#pragma mark Index
+
+- (BOOL)openIndex
+{
+    _indexLength = sizeof(CURLHTTPCacheIndexHeader) + kSlotCount * sizeof(CURLHTTPCacheSlot);
+
+    int file = open([[[_directoryURL URLByAppendingPathComponent:@"index"] path] fileSystemRepresentation], O_RDWR | O_CREAT, 0644);
+    if (file < 0) return NO;
+
+    // anything but the right size gets replaced by an empty index
+    struct stat info;
+    if ((fstat(file, &info) != 0 || info.st_size != (off_t)_indexLength) &&
+        (ftruncate(file, 0) != 0 || ftruncate(file, _indexLength) != 0))
+    {
+        close(file);
+        return NO;
+    }
+
+    void *index = mmap(NULL, _indexLength, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    close(file);    // the mapping keeps it open
+    if (index == MAP_FAILED) return NO;
+    _index = index;
+
+    CURLHTTPCacheIndexHeader *header = _index;
+    if (memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 || header->version != kVersion || header->slotCount != kSlotCount)
+    {
+        // a new index, or one we don't understand; whatever's in the directory can't be found any more
+        [self removeEntryFiles];
+        memset(_index, 0, _indexLength);
+        memcpy(header->magic, kMagic, sizeof(kMagic));
+        header->version = kVersion;
+        header->slotCount = kSlotCount;
+    }
+
+    CURLHTTPCacheSlot *slots = [self slots];
+    for (NSUInteger index = 0; index < kSlotCount; ++index)
+    {
+        if (slots[index].fingerprint) _currentSize += slots[index].size;
+    }
+
+    return YES;
+}
+
+- (CURLHTTPCacheSlot*)slots
+{
+    return (CURLHTTPCacheSlot*)((char*)_index + sizeof(CURLHTTPCacheIndexHeader));
+}
+
+- (NSURL*)URLForFingerprint:(uint64_t)fingerprint extension:(NSString*)extension
+{
+    return [_directoryURL URLByAppendingPathComponent:[NSString stringWithFormat:@"%016llx.%@", fingerprint, extension]];
+}
+
+- (void)removeEntryFiles
+{
+    NSFileManager *manager = [NSFileManager defaultManager];
+    for (NSURL *url in [manager contentsOfDirectoryAtURL:_directoryURL includingPropertiesForKeys:nil options:0 error:NULL])
+    {
+        NSString *extension = [url pathExtension];
+        if ([extension isEqualToString:@"body"] || [extension isEqualToString:@"headers"] || [extension isEqualToString:@"partial"])
+        {
+            [manager removeItemAtURL:url error:NULL];
+        }
+    }
+}
+
+// The rest of these expect self to be locked
+
+- (CURLHTTPCacheSlot*)slotForFingerprint:(uint64_t)fingerprint
+{
+    CURLHTTPCacheSlot *bucket = [self slots] + (fingerprint % (kSlotCount / kWays)) * kWays;
+    for (NSUInteger way = 0; way < kWays; ++way)
+    {
+        if (bucket[way].fingerprint == fingerprint) return &bucket[way];
+    }
+
+    return NULL;
+}
+
+- (CURLHTTPCacheSlot*)slotToStoreFingerprint:(uint64_t)fingerprint
+{
+    // the fingerprint's own slot if it has one, and otherwise an empty one, or the least recently used
+    CURLHTTPCacheSlot *bucket = [self slots] + (fingerprint % (kSlotCount / kWays)) * kWays;
+    CURLHTTPCacheSlot *victim = NULL;
+    for (NSUInteger way = 0; way < kWays; ++way)
+    {
+        CURLHTTPCacheSlot *slot = &bucket[way];
+        if (slot->fingerprint == fingerprint) return slot;
+
+        if (!victim || (victim->fingerprint && (!slot->fingerprint || slot->lastUsed < victim->lastUsed))) victim = slot;
+    }
+
+    if (victim->fingerprint) [self removeSlot:victim];
+    return victim;
+}
+
+- (void)removeSlot:(CURLHTTPCacheSlot*)slot
+{
+    NSFileManager *manager = [NSFileManager defaultManager];
+    [manager removeItemAtURL:[self URLForFingerprint:slot->fingerprint extension:@"body"] error:NULL];
+    [manager removeItemAtURL:[self URLForFingerprint:slot->fingerprint extension:@"headers"] error:NULL];
+
+    _currentSize -= MIN(slot->size, _currentSize);
+    memset(slot, 0, sizeof(*slot));
+}
+
+- (void)evictToCapacity
+{
+    CURLHTTPCacheSlot *slots = [self slots];
+    while (_currentSize > _capacity)
+    {
+        CURLHTTPCacheSlot *oldest = NULL;
+        for (NSUInteger index = 0; index < kSlotCount; ++index)
+        {
+            if (slots[index].fingerprint && (!oldest || slots[index].lastUsed < oldest->lastUsed)) oldest = &slots[index];
+        }
+
+        if (!oldest) break;
+        [self removeSlot:oldest];
+    }
+}
+
+#pragma mark Looking Up
+
++ (BOOL)canCacheRequest:(NSURLRequest *)request
+{
+    NSString *scheme = [[[request URL] scheme] lowercaseString];
+    if (![scheme isEqualToString:@"http"] && ![scheme isEqualToString:@"https"]) return NO;
+
+    NSString *method = [request HTTPMethod];
+    if (method && ![method isEqualToString:@"GET"]) return NO;
+    if ([request HTTPBody] || [request HTTPBodyStream]) return NO;
+
+    // the caller wants to handle these itself
+    for (NSString *field in @[@"Range", @"If-None-Match", @"If-Modified-Since", @"If-Match", @"If-Unmodified-Since", @"If-Range"])
+    {
+        if ([request valueForHTTPHeaderField:field]) return NO;
+    }
+
+    // and what's answered to one login mustn't be handed to another, which the key can't tell apart
+    NSURL *url = [request URL];
+    if ([url user] || [url password]) return NO;
+    for (NSString *field in @[@"Authorization", @"Cookie"])
+    {
+        if ([request valueForHTTPHeaderField:field]) return NO;
+    }
+
+    return YES;
+}
+
+- (CURLCachedHTTPResponse*)responseInSlot:(CURLHTTPCacheSlot*)slot key:(NSString*)key request:(NSURLRequest*)request
+{
+    // call with self locked
+    NSDictionary *entry = [NSDictionary dictionaryWithContentsOfURL:[self URLForFingerprint:slot->fingerprint extension:@"headers"]];
+    NSData *data = [NSData dataWithContentsOfURL:[self URLForFingerprint:slot->fingerprint extension:@"body"] options:NSDataReadingMappedIfSafe error:NULL];
+    if (!entry || !data)
+    {
+        [self removeSlot:slot];
+        return nil;
+    }
+
+    // a different URL with the same fingerprint, or a different variant
+    if (![[entry objectForKey:@"key"] isEqualToString:key]) return nil;
+
+    NSString *headerString = [entry objectForKey:@"headers"];
+    NSDictionary *fields = CURLHTTPCacheHeaderFields(headerString);
+    if (![CURLHTTPCacheVaryValues(fields, request) isEqualToDictionary:[entry objectForKey:@"vary"]]) return nil;
+
+    CURLCachedHTTPResponse *response = [[CURLCachedHTTPResponse alloc] initWithURL:[NSURL URLWithString:[entry objectForKey:@"url"]]
+                                                                        statusCode:[[entry objectForKey:@"status"] integerValue]
+                                                                      headerString:headerString
+                                                                            fields:fields];
+    response.data = data;
+    response.key = key;
+    response.fingerprint = slot->fingerprint;
+    response.freshUntil = slot->freshUntil;
+
+    return [response autorelease];
+}
+
+- (CURLCachedHTTPResponse*)cachedResponseForRequest:(NSURLRequest *)request mustRevalidate:(BOOL *)mustRevalidate
+{
+    *mustRevalidate = NO;
+
+    NSURLRequestCachePolicy policy = [request cachePolicy];
+    if (policy == NSURLRequestReloadIgnoringLocalCacheData || policy == NSURLRequestReloadIgnoringLocalAndRemoteCacheData) return nil;
+    if (![[self class] canCacheRequest:request]) return nil;
+
+    NSString *key = [CURLNegativeCache normalizedStringForURL:[request URL]];
+    uint64_t fingerprint = CURLHTTPCacheFingerprint(key);
+    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+    CURLCachedHTTPResponse *result = nil;
+
+    @synchronized(self)
+    {
+        CURLHTTPCacheSlot *slot = [self slotForFingerprint:fingerprint];
+        if (slot)
+        {
+            result = [self responseInSlot:slot key:key request:request];
+            if (result) slot->lastUsed = now;
+        }
+
+        if (result)
+        {
+            BOOL revalidate;
+            switch (policy)
+            {
+                case NSURLRequestReturnCacheDataElseLoad:
+                case NSURLRequestReturnCacheDataDontLoad:
+                    revalidate = NO;
+                    break;
+
+                case NSURLRequestReloadRevalidatingCacheData:
+                    revalidate = YES;
+                    break;
+
+                default:
+                    revalidate = (result.freshUntil <= now ||
+                                  [CURLHTTPCacheDirectives([request valueForHTTPHeaderField:@"Cache-Control"]) objectForKey:@"no-cache"] ||
+                                  [[request valueForHTTPHeaderField:@"Pragma"] rangeOfString:@"no-cache" options:NSCaseInsensitiveSearch].location != NSNotFound);
+                    break;
+            }
+
+            // without a validator, a response that needs revalidating is no use
+            if (revalidate && !result.entityTag && !result.lastModified) result = nil;
+            *mustRevalidate = (result && revalidate);
+        }
+
+        if (!result) ++_missCount;
+        else if (*mustRevalidate) ++_revalidationCount;
+        else ++_hitCount;
+    }
+
+    return result;
+}
+
+#pragma mark Storing
+
+- (CURLCachedHTTPResponse*)storeResponseToRequest:(NSURLRequest *)request URL:(NSURL *)url statusCode:(NSInteger)statusCode headerString:(NSString *)headerString
+{
+    if (statusCode != 200 || ![[self class] canCacheRequest:request]) return nil;
+
+    NSDictionary *fields = CURLHTTPCacheHeaderFields(headerString);
+    NSDictionary *directives = CURLHTTPCacheDirectives([fields objectForKey:@"cache-control"]);
+    if ([directives objectForKey:@"no-store"] || [directives objectForKey:@"private"] ||
+        [CURLHTTPCacheDirectives([request valueForHTTPHeaderField:@"Cache-Control"]) objectForKey:@"no-store"] ||
+        [[fields objectForKey:@"vary"] rangeOfString:@"*"].location != NSNotFound)
+    {
+        return nil;
+    }
+
+    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+    NSTimeInterval lifetime = CURLHTTPCacheLifetime(fields, now);
+    CURLCachedHTTPResponse *response = [[[CURLCachedHTTPResponse alloc] initWithURL:url statusCode:statusCode headerString:headerString fields:fields] autorelease];
+    if (lifetime <= 0 && !response.entityTag && !response.lastModified) return nil;     // it could never be used
+
+    NSURL *temporaryURL = [_directoryURL URLByAppendingPathComponent:[[[NSProcessInfo processInfo] globallyUniqueString] stringByAppendingPathExtension:@"partial"]];
+    int file = open([[temporaryURL path] fileSystemRepresentation], O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (file < 0) return nil;
+
+    response.key = [CURLNegativeCache normalizedStringForURL:[request URL]];
+    response.fingerprint = CURLHTTPCacheFingerprint(response.key);
+    response.freshUntil = now + lifetime;
+    response.varyValues = CURLHTTPCacheVaryValues(fields, request);
+    response.temporaryURL = temporaryURL;
+    response.fileDescriptor = file;
+
+    return response;
+}
+
+- (void)appendData:(NSData *)data toResponse:(CURLCachedHTTPResponse *)response
+{
+    int file = (response ? response.fileDescriptor : -1);
+    if (file < 0) return;   // already abandoned
+
+    // a body bigger than the whole cache could never be kept
+    BOOL written = (response.size + [data length] <= _capacity);
+
+    const uint8_t *bytes = [data bytes];
+    NSUInteger remaining = [data length];
+    while (written && remaining)
+    {
+        ssize_t count = write(file, bytes, remaining);
+        if (count < 0)
+        {
+            if (errno != EINTR) written = NO;
+            continue;
+        }
+
+        bytes += count;
+        remaining -= count;
+    }
+
+    if (written)
+    {
+        response.size += [data length];
+    }
+    else
+    {
+        [self abandonStoringResponse:response];
+    }
+}
+
+- (void)abandonStoringResponse:(CURLCachedHTTPResponse *)response
+{
+    if (!response || response.fileDescriptor < 0) return;
+
+    close(response.fileDescriptor);
+    response.fileDescriptor = -1;
+    unlink([[response.temporaryURL path] fileSystemRepresentation]);
+}
+
+- (void)finishStoringResponse:(CURLCachedHTTPResponse *)response
+{
+    if (!response || response.fileDescriptor < 0) return;
+
+    close(response.fileDescriptor);
+    response.fileDescriptor = -1;
+
+    NSDictionary *entry = @{ @"key" : response.key,
+                             @"url" : [response.URL absoluteString],
+                             @"status" : @(response.statusCode),
+                             @"headers" : response.headerString,
+                             @"vary" : response.varyValues };
+
+    @synchronized(self)
+    {
+        CURLHTTPCacheSlot *slot = [self slotToStoreFingerprint:response.fingerprint];
+        if (slot->fingerprint) _currentSize -= MIN(slot->size, _currentSize);     // being replaced
+
+        // renaming over the old body leaves anyone still reading it with the old copy
+        NSURL *bodyURL = [self URLForFingerprint:response.fingerprint extension:@"body"];
+        if (rename([[response.temporaryURL path] fileSystemRepresentation], [[bodyURL path] fileSystemRepresentation]) != 0 ||
+            ![entry writeToURL:[self URLForFingerprint:response.fingerprint extension:@"headers"] atomically:YES])
+        {
+            unlink([[response.temporaryURL path] fileSystemRepresentation]);
+            slot->fingerprint = response.fingerprint;
+            slot->size = 0;
+            [self removeSlot:slot];
+            return;
+        }
+
+        slot->fingerprint = response.fingerprint;
+        slot->size = response.size;
+        slot->lastUsed = [NSDate timeIntervalSinceReferenceDate];
+        slot->freshUntil = response.freshUntil;
+        _currentSize += response.size;
+
+        [self evictToCapacity];
+    }
+}
+
+- (void)updateResponse:(CURLCachedHTTPResponse *)response withNotModifiedHeaderString:(NSString *)headerString
+{
+    // the 304's headers update the ones we kept, validators included
+    NSString *mergedHeaderString = CURLHTTPCacheMergedHeaderString(response.headerString, headerString);
+    NSDictionary *fields = CURLHTTPCacheHeaderFields(mergedHeaderString);
+    response.headerString = mergedHeaderString;
+    response.entityTag = [fields objectForKey:@"etag"];
+    response.lastModified = [fields objectForKey:@"last-modified"];
+
+    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+    response.freshUntil = now + CURLHTTPCacheLifetime(fields, now);
+
+    @synchronized(self)
+    {
+        CURLHTTPCacheSlot *slot = [self slotForFingerprint:response.fingerprint];
+        if (slot)
+        {
+            // on disk too, so the next revalidation sends what the server last said
+            NSURL *headersURL = [self URLForFingerprint:response.fingerprint extension:@"headers"];
+            NSMutableDictionary *entry = [NSMutableDictionary dictionaryWithContentsOfURL:headersURL];
+            if ([[entry objectForKey:@"key"] isEqualToString:response.key])
+            {
+                [entry setObject:mergedHeaderString forKey:@"headers"];
+                [entry writeToURL:headersURL atomically:YES];
+            }
+
+            slot->lastUsed = now;
+            slot->freshUntil = response.freshUntil;
+        }
+
+        ++_notModifiedCount;
+    }
+}
+
+#pragma mark Removing
+
+- (void)invalidateResponseForRequest:(NSURLRequest *)request
+{
+    NSString *method = [request HTTPMethod];
+    if (!method || [method isEqualToString:@"GET"] || [method isEqualToString:@"HEAD"] || [method isEqualToString:@"OPTIONS"]) return;
+
+    [self removeResponseForURL:[request URL]];
+}
+
+- (void)removeResponseForURL:(NSURL *)url
+{
+    uint64_t fingerprint = CURLHTTPCacheFingerprint([CURLNegativeCache normalizedStringForURL:url]);
+
+    @synchronized(self)
+    {
+        CURLHTTPCacheSlot *slot = [self slotForFingerprint:fingerprint];
+        if (slot) [self removeSlot:slot];
+    }
+}
+
+- (void)removeAllResponses
+{
+    @synchronized(self)
+    {
+        CURLHTTPCacheSlot *slots = [self slots];
+        for (NSUInteger index = 0; index < kSlotCount; ++index)
+        {
+            if (slots[index].fingerprint) [self removeSlot:&slots[index]];
+        }
+
+        _currentSize = 0;
+    }
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"<%@ %p: %llu of %llu bytes, %lu hits, %lu revalidations (%lu not modified), %lu misses>", [self class], self,
+            self.currentSize, self.capacity, (unsigned long)self.hitCount, (unsigned long)self.revalidationCount, (unsigned long)self.notModifiedCount, (unsigned long)self.missCount];
+}
+
+@end
@@ -8,6 +8,18 @@
 
 
 #import <CURLHandle/CURLTransfer.h>
+#import <CURLHandle/CURLTransferRecorder.h>
+#import <CURLHandle/CURLHedgedTransfer.h>
+#import <CURLHandle/CURLRetryPolicy.h>
+#import <CURLHandle/CURLConcurrencyLimiter.h>
+#import <CURLHandle/CURLCircuitBreaker.h>
+#import <CURLHandle/CURLNegativeCache.h>
+#import <CURLHandle/CURLHTTPCache.h>
+#import <CURLHandle/CURLSegmentedDownload.h>
+#import <CURLHandle/CURLDigest.h>
 #import <CURLHandle/CURLRequest.h>
+#import <CURLHandle/CURLMultipartFormData.h>
+#import <CURLHandle/CURLRecordBatch.h>
+#import <CURLHandle/CURLResponseReader.h>
 #import <CURLHandle/CURLProtocol.h>
 #import <CURLHandle/CK2SSHCredential.h>
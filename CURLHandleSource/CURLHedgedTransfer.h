@@ -0,0 +1,169 @@
+//
+//  CURLHedgedTransfer.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLTransfer.h"
+
+/**
+ When, and where, to send a duplicate of a slow request.
+
+ If a request hasn't produced a response after the delay - or after the 95th percentile of the
+ times to first byte seen recently for its host, if that's sooner - a second transfer is started
+ on a fresh connection. Whichever transfer responds first is used, and the other is cancelled.
+
+ A policy is meant to be shared by many requests: it keeps the per-host timings that the
+ percentile comes from, and counts how often hedges are sent and how often they win.
+
+ It's safe to use from any thread.
+ */
+
+@interface CURLHedgingPolicy : NSObject
+{
+    NSTimeInterval      _delay;
+    BOOL                _usesObservedLatency;
+    NSUInteger          _minimumSamples;
+    NSArray             *_alternateAddresses;
+
+    NSMutableDictionary *_latencies;
+    NSUInteger          _nextAddress;
+    NSUInteger          _requestCount;
+    NSUInteger          _hedgeCount;
+    NSUInteger          _hedgeWinCount;
+}
+
++ (CURLHedgingPolicy*)policyWithDelay:(NSTimeInterval)delay;
+
+/** The longest to wait for a response before hedging. Zero means only the observed latency is used. */
+@property (assign, atomic) NSTimeInterval delay;
+
+/** YES (the default) to hedge sooner when the host's observed 95th percentile time to first byte is shorter than the delay. */
+@property (assign, atomic) BOOL usesObservedLatency;
+
+/** How many timings a host needs before its percentile is trusted. Default is 20. */
+@property (assign, atomic) NSUInteger minimumSamples;
+
+/**
+ Numeric addresses to send hedges to, in turn, instead of the one the host resolves to.
+ Default is nil, which sends them to the same host, but on a new connection.
+
+ See -[NSURLRequest curl_connectAddress] for how these are used.
+ */
+@property (copy, atomic) NSArray* alternateAddresses;
+
+/**
+ The delay to use for a request to a URL right now.
+
+ @param url The URL being requested.
+ @return How long to wait for a response before hedging, or zero if the request shouldn't be hedged.
+ */
+
+- (NSTimeInterval)hedgeDelayForURL:(NSURL*)url;
+
+/**
+ The 95th percentile of recent times to first byte for a host.
+
+ @param host The host.
+ @return The time, or zero if there aren't yet enough timings.
+ */
+
+- (NSTimeInterval)observedFirstByteTimeForHost:(NSString*)host;
+
+/**
+ Note how long a request to a host took to produce a response.
+
+ @param time The time from starting the transfer to getting the response.
+ @param host The host.
+ */
+
+- (void)recordFirstByteTime:(NSTimeInterval)time forHost:(NSString*)host;
+
+/**
+ Make the request that a hedge should send.
+
+ @param request The original request.
+ @return A request which forces a new connection, and may be pointed at an alternate address.
+ */
+
+- (NSURLRequest*)hedgeRequestForRequest:(NSURLRequest*)request;
+
+/** @name Statistics */
+
+/** Requests which could have been hedged. */
+@property (readonly, atomic) NSUInteger requestCount;
+
+/** Hedges which were sent. */
+@property (readonly, atomic) NSUInteger hedgeCount;
+
+/** Hedges which responded before the original. */
+@property (readonly, atomic) NSUInteger hedgeWinCount;
+
+@end
+
+
+/**
+ Runs a request, hedging it as its policy says.
+
+ Only idempotent requests (GET, HEAD or OPTIONS, with no body) over HTTP or HTTPS are hedged; anything else
+ is simply run as a single transfer. Hedges aren't sent on a multi driven by an external event loop, since
+ they're started from a timer on another thread.
+
+ Delegate messages are delivered as for a single CURLTransfer, but name whichever underlying transfer
+ they came from. Once a response has arrived, only that transfer's messages are delivered, and it's
+ available as winningTransfer. The losing transfer is cancelled, and its completion isn't reported.
+ */
+
+@interface CURLHedgedTransfer : NSObject <CURLTransferDelegate>
+{
+    NSURLRequest            *_request;
+    NSURLCredential         *_credential;
+    id <CURLTransferDelegate> _delegate;
+    NSOperationQueue        *_delegateQueue;
+    CURLMultiHandle         *_multi;
+    CURLHedgingPolicy       *_policy;
+
+    CURLTransfer            *_primary;
+    CURLTransfer            *_hedge;
+    CURLTransfer            *_winner;
+    CFAbsoluteTime          _primaryStart;
+    CFAbsoluteTime          _hedgeStart;
+    BOOL                    _finished;
+}
+
+/**
+ Start a request.
+
+ @param request The request to perform.
+ @param credential A credential to use for the request.
+ @param delegate An object to use as the delegate. It's retained until the request is finished, failed, or cancelled.
+ @param queue The queue for delegate messages, or nil to make a serial one.
+ @param multi The multi to run the transfers on.
+ @param policy The policy to hedge by.
+ @return A new object.
+ */
+
+- (id)initWithRequest:(NSURLRequest *)request
+           credential:(NSURLCredential *)credential
+             delegate:(id <CURLTransferDelegate>)delegate
+        delegateQueue:(NSOperationQueue *)queue
+                multi:(CURLMultiHandle *)multi
+               policy:(CURLHedgingPolicy *)policy __attribute((nonnull(1,5,6)));
+
+/**
+ Stop every transfer. The delegate is sent the NSURLErrorCancelled error as usual.
+ */
+
+- (void)cancel;
+
+/** The transfer whose response is being used, or nil until there is one. */
+@property (readonly, strong, atomic) CURLTransfer* winningTransfer;
+
+/** YES if a hedge was sent for the request. */
+@property (readonly, atomic) BOOL didHedge;
+
++ (BOOL)canHedgeRequest:(NSURLRequest*)request;
+
+@end
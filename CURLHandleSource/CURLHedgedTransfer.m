@@ -0,0 +1,443 @@
+//
+//  CURLHedgedTransfer.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLHedgedTransfer.h"
+
+#import "CURLMultiHandle.h"
+#import "CURLRequest.h"
+
+static const NSUInteger kLatencySampleCount = 64;   // recent enough to follow the host, big enough for a 95th percentile
+
+#pragma mark - Latency Samples
+
+/**
+ The most recent times to first byte for one host, in a ring.
+ */
+
+@interface CURLLatencySamples : NSObject
+{
+@public
+    NSTimeInterval  _samples[kLatencySampleCount];
+    NSUInteger      _count;
+    NSUInteger      _next;
+}
+@end
+
+@implementation CURLLatencySamples
+@end
+
+static int CURLCompareTimes(const void *a, const void *b)
+{
+    NSTimeInterval first = *(const NSTimeInterval *)a;
+    NSTimeInterval second = *(const NSTimeInterval *)b;
+    return (first < second) ? -1 : (first > second) ? 1 : 0;
+}
+
+#pragma mark - Policy
+
+@interface CURLHedgingPolicy()
+
+- (void)noteRequest;
+- (void)noteHedge;
+- (void)noteHedgeWin;
+
+@end
+
+@implementation CURLHedgingPolicy
+
+@synthesize delay = _delay;
+@synthesize usesObservedLatency = _usesObservedLatency;
+@synthesize minimumSamples = _minimumSamples;
+@synthesize alternateAddresses = _alternateAddresses;
+@synthesize requestCount = _requestCount;
+@synthesize hedgeCount = _hedgeCount;
+@synthesize hedgeWinCount = _hedgeWinCount;
+
++ (CURLHedgingPolicy*)policyWithDelay:(NSTimeInterval)delay
+{
+    CURLHedgingPolicy* result = [[[self alloc] init] autorelease];
+    result.delay = delay;
+
+    return result;
+}
+
+- (id)init
+{
+    if (self = [super init])
+    {
+        _usesObservedLatency = YES;
+        _minimumSamples = 20;
+        _latencies = [[NSMutableDictionary alloc] init];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_alternateAddresses release];
+    [_latencies release];
+
+    [super dealloc];
+}
+
+- (NSTimeInterval)hedgeDelayForURL:(NSURL *)url
+{
+    NSTimeInterval delay = self.delay;
+    if (self.usesObservedLatency)
+    {
+        NSTimeInterval observed = [self observedFirstByteTimeForHost:[url host]];
+        if (observed > 0 && (delay <= 0 || observed < delay))
+        {
+            delay = observed;
+        }
+    }
+
+    return delay;
+}
+
+- (NSTimeInterval)observedFirstByteTimeForHost:(NSString *)host
+{
+    if (!host) return 0;
+
+    NSTimeInterval sorted[kLatencySampleCount];
+    NSUInteger count;
+    @synchronized(self)
+    {
+        CURLLatencySamples* samples = [_latencies objectForKey:[host lowercaseString]];
+        count = samples ? samples->_count : 0;
+        if (count < MAX(_minimumSamples, 1)) return 0;
+
+        memcpy(sorted, samples->_samples, count * sizeof(NSTimeInterval));
+    }
+
+    qsort(sorted, count, sizeof(NSTimeInterval), CURLCompareTimes);
+    NSUInteger index = (NSUInteger)ceil(0.95 * count) - 1;
+    return sorted[index];
+}
+
+- (void)recordFirstByteTime:(NSTimeInterval)time forHost:(NSString *)host
+{
+    if (!host) return;
+
+    @synchronized(self)
+    {
+        NSString* key = [host lowercaseString];
+        CURLLatencySamples* samples = [_latencies objectForKey:key];
+        if (!samples)
+        {
+            samples = [[CURLLatencySamples alloc] init];
+            [_latencies setObject:samples forKey:key];
+            [samples release];
+        }
+
+        samples->_samples[samples->_next] = time;
+        samples->_next = (samples->_next + 1) % kLatencySampleCount;
+        if (samples->_count < kLatencySampleCount) ++samples->_count;
+    }
+}
+
+- (NSURLRequest*)hedgeRequestForRequest:(NSURLRequest *)request
+{
+    NSMutableURLRequest* result = [[request mutableCopy] autorelease];
+    [result curl_setForcesFreshConnection:YES];
+
+    NSString* address = nil;
+    @synchronized(self)
+    {
+        NSUInteger count = [_alternateAddresses count];
+        if (count)
+        {
+            address = [_alternateAddresses objectAtIndex:_nextAddress % count];
+            ++_nextAddress;
+        }
+    }
+
+    if (address)
+    {
+        [result curl_setConnectAddress:address];
+    }
+
+    return result;
+}
+
+- (void)noteRequest
+{
+    @synchronized(self) { ++_requestCount; }
+}
+
+- (void)noteHedge
+{
+    @synchronized(self) { ++_hedgeCount; }
+}
+
+- (void)noteHedgeWin
+{
+    @synchronized(self) { ++_hedgeWinCount; }
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"<%@ %p: delay %.3fs, %lu requests, %lu hedged, %lu won>", [self class], self, self.delay, (unsigned long)self.requestCount, (unsigned long)self.hedgeCount, (unsigned long)self.hedgeWinCount];
+}
+
+@end
+
+#pragma mark - Hedged Transfer
+
+@implementation CURLHedgedTransfer
+
++ (BOOL)canHedgeRequest:(NSURLRequest *)request
+{
+    NSString* scheme = [[[request URL] scheme] lowercaseString];
+    if (!([scheme isEqualToString:@"http"] || [scheme isEqualToString:@"https"])) return NO;
+
+    NSString* method = [request HTTPMethod];
+    if (method && !([method isEqualToString:@"GET"] || [method isEqualToString:@"HEAD"] || [method isEqualToString:@"OPTIONS"])) return NO;
+
+    return ([request HTTPBody] == nil && [request HTTPBodyStream] == nil);
+}
+
+- (id)initWithRequest:(NSURLRequest *)request credential:(NSURLCredential *)credential delegate:(id<CURLTransferDelegate>)delegate delegateQueue:(NSOperationQueue *)queue multi:(CURLMultiHandle *)multi policy:(CURLHedgingPolicy *)policy
+{
+    if (self = [super init])
+    {
+        _request = [request copy];
+        _credential = [credential retain];
+        _delegate = [delegate retain];
+        _multi = [multi retain];
+        _policy = [policy retain];
+
+        if (queue)
+        {
+            _delegateQueue = [queue retain];
+        }
+        else
+        {
+            // both transfers have to share a serial queue, so that their messages can't overtake each other
+            _delegateQueue = [[NSOperationQueue alloc] init];
+            _delegateQueue.maxConcurrentOperationCount = 1;
+        }
+
+        // hold the lock so that nothing's delivered until we know which transfer is which
+        @synchronized(self)
+        {
+            _primaryStart = CFAbsoluteTimeGetCurrent();
+            _primary = [[CURLTransfer alloc] initWithRequest:_request credential:_credential delegate:self delegateQueue:_delegateQueue multi:_multi];
+        }
+
+        NSTimeInterval delay = [policy hedgeDelayForURL:[request URL]];
+        if (delay > 0 && [[self class] canHedgeRequest:request] && !multi.usesExternalEventLoop)
+        {
+            [policy noteRequest];
+            dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+                [self startHedge];
+            });
+        }
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_request release];
+    [_credential release];
+    [_delegate release];
+    [_delegateQueue release];
+    [_multi release];
+    [_policy release];
+    [_primary release];
+    [_hedge release];
+    [_winner release];
+
+    [super dealloc];
+}
+
+- (void)startHedge
+{
+    @synchronized(self)
+    {
+        if (_finished || _winner || _hedge) return;
+
+        CURLHandleLog(@"hedging %@", _request);
+        [_policy noteHedge];
+        _hedgeStart = CFAbsoluteTimeGetCurrent();
+        _hedge = [[CURLTransfer alloc] initWithRequest:[_policy hedgeRequestForRequest:_request] credential:_credential delegate:self delegateQueue:_delegateQueue multi:_multi];
+    }
+}
+
+- (void)cancel
+{
+    CURLTransfer* primary;
+    CURLTransfer* hedge;
+    @synchronized(self)
+    {
+        if (_finished) return;
+        _finished = YES;
+
+        primary = [_primary retain];
+        hedge = [_hedge retain];
+    }
+
+    [primary cancel];
+    [hedge cancel];
+
+    [primary release];
+    [hedge release];
+}
+
+- (CURLTransfer*)winningTransfer
+{
+    @synchronized(self)
+    {
+        return [[_winner retain] autorelease];
+    }
+}
+
+- (BOOL)didHedge
+{
+    @synchronized(self)
+    {
+        return _hedge != nil;
+    }
+}
+
+#pragma mark - Arbitration
+
+/**
+ Make a transfer the winner, if there isn't one yet. Must be called with the lock held.
+
+ @param transfer The transfer.
+ @param responded YES if the transfer has produced a response, so its timing is worth keeping.
+ @return The other transfer, which should be cancelled, if any.
+ */
+
+- (CURLTransfer*)claimTransfer:(CURLTransfer*)transfer responded:(BOOL)responded
+{
+    if (_winner) return nil;
+
+    _winner = [transfer retain];
+
+    BOOL isHedge = (transfer == _hedge);
+    if (responded)
+    {
+        NSTimeInterval start = isHedge ? _hedgeStart : _primaryStart;
+        [_policy recordFirstByteTime:CFAbsoluteTimeGetCurrent() - start forHost:[[_request URL] host]];
+        if (isHedge) [_policy noteHedgeWin];
+    }
+
+    return isHedge ? _primary : _hedge;
+}
+
+- (BOOL)shouldDeliverFromTransfer:(CURLTransfer*)transfer
+{
+    CURLTransfer* loser = nil;
+    BOOL result;
+    @synchronized(self)
+    {
+        loser = [[self claimTransfer:transfer responded:YES] retain];
+        result = (transfer == _winner);
+    }
+
+    if (loser)
+    {
+        CURLHandleLog(@"%@ won, cancelling %@", transfer, loser);
+        [loser cancel];
+        [loser release];
+    }
+
+    return result;
+}
+
+#pragma mark - CURLTransferDelegate
+
+- (void)transfer:(CURLTransfer *)transfer didReceiveResponse:(NSURLResponse *)response
+{
+    if ([self shouldDeliverFromTransfer:transfer] && [_delegate respondsToSelector:@selector(transfer:didReceiveResponse:)])
+    {
+        [_delegate transfer:transfer didReceiveResponse:response];
+    }
+}
+
+- (void)transfer:(CURLTransfer *)transfer didReceiveData:(NSData *)data
+{
+    if ([self shouldDeliverFromTransfer:transfer])
+    {
+        [_delegate transfer:transfer didReceiveData:data];
+    }
+}
+
+- (void)transfer:(CURLTransfer *)transfer didCompleteWithError:(NSError *)error
+{
+    BOOL deliver;
+    @synchronized(self)
+    {
+        if (!_winner)
+        {
+            // a transfer which fails before responding only counts if nothing else might still succeed
+            CURLTransfer* other = (transfer == _primary) ? _hedge : _primary;
+            BOOL otherRunning = other && [other state] < CURLTransferStateCompleted;
+            if (error && otherRunning && !_finished)
+            {
+                CURLHandleLog(@"%@ failed, still waiting for %@", transfer, other);
+                return;
+            }
+
+            [self claimTransfer:transfer responded:NO];
+        }
+
+        deliver = (transfer == _winner) && (_delegate != nil);
+        if (deliver) _finished = YES;
+    }
+
+    if (deliver)
+    {
+        id <CURLTransferDelegate> delegate = _delegate;
+        _delegate = nil;    // like CURLTransfer, we only hold on to the delegate until the request is done
+
+        if ([delegate respondsToSelector:@selector(transfer:didCompleteWithError:)])
+        {
+            [delegate transfer:transfer didCompleteWithError:error];
+        }
+        [delegate release];
+    }
+}
+
+- (enum curl_khstat)transfer:(CURLTransfer *)transfer didFindHostFingerprint:(const struct curl_khkey *)foundKey knownFingerprint:(const struct curl_khkey *)knownkey match:(enum curl_khmatch)match
+{
+    if ([_delegate respondsToSelector:@selector(transfer:didFindHostFingerprint:knownFingerprint:match:)])
+    {
+        return [_delegate transfer:transfer didFindHostFingerprint:foundKey knownFingerprint:knownkey match:match];
+    }
+
+    return (match == CURLKHMATCH_OK ? CURLKHSTAT_FINE : CURLKHSTAT_REJECT);
+}
+
+- (void)transfer:(CURLTransfer *)transfer willSendBodyDataOfLength:(NSUInteger)bytesWritten
+{
+    if ([_delegate respondsToSelector:@selector(transfer:willSendBodyDataOfLength:)])
+    {
+        [_delegate transfer:transfer willSendBodyDataOfLength:bytesWritten];
+    }
+}
+
+- (void)transfer:(CURLTransfer *)transfer didReceiveDebugInformation:(NSString *)string ofType:(curl_infotype)type
+{
+    if ([_delegate respondsToSelector:@selector(transfer:didReceiveDebugInformation:ofType:)])
+    {
+        [_delegate transfer:transfer didReceiveDebugInformation:string ofType:type];
+    }
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"<HEDGED %p primary:%@ hedge:%@ winner:%@>", self, _primary, _hedge, _winner];
+}
+
+@end
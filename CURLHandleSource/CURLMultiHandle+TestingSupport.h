@@ -0,0 +1,68 @@
+//
+//  CURLMultiHandle+TestingSupport.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLMultiHandle.h"
+
+/**
+ This functionality is only provided for unit tests and benchmarks, and isn't intended for general use.
+
+ Every call that CURLMultiHandle makes into libcurl, and every timer or socket it asks its event backend to watch,
+ goes through one of the methods below (or -watchSocket:reading:writing:). A subclass can override them to stand in for libcurl and the backend,
+ and drive the multi with a fake clock and simulated socket readiness.
+
+ All of these methods are called on the receiver's queue, and should only be called from there.
+ */
+
+@interface CURLMultiHandle(TestingSupport)
+
+/** @name Modes */
+
+/**
+ Creates a multi which uses either curl_multi_socket_action() driven by dispatch sources and a timer,
+ or a curl_multi_perform() / curl_multi_wait() loop.
+
+ Plain init picks the mode that's currently the default for the library.
+
+ @param usesSocketActions YES for the socket action mode.
+ @return A new multi.
+ */
+
+- (id)initUsingSocketActions:(BOOL)usesSocketActions;
+
+- (BOOL)usesSocketActions;
+
+/** @name libcurl Primitives */
+
+- (CURLMcode)addEasyHandle:(CURL*)easy;
+- (CURLMcode)removeEasyHandle:(CURL*)easy;
+- (CURLMcode)performSocketAction:(int)action forSocket:(curl_socket_t)socket runningHandles:(int*)running;
+- (CURLMsg*)readMessage:(int*)remaining;
+- (void)assignRegistration:(CURLSocketRegistration*)registration toSocket:(curl_socket_t)socket;
+
+/** @name Events */
+
+/**
+ Called when libcurl's timer callback fires. A negative timeout means the timer should be stopped.
+ */
+
+- (void)setTimeout:(long)timeout_ms;
+
+/**
+ Called when libcurl's socket callback fires, with the registration previously assigned to the socket (if any).
+ */
+
+- (void)updateRegistration:(CURLSocketRegistration*)registration forSocket:(curl_socket_t)socket to:(int)what;
+
+/**
+ Tell libcurl that something happened on a socket (or that the timer fired, if socket is CURL_SOCKET_TIMEOUT),
+ then complete any transfers that have finished.
+ */
+
+- (void)processMulti:(CURLM*)multi action:(int)action forSocket:(int)socket;
+
+@end
@@ -10,6 +10,8 @@
 
 #import <curl/curl.h>
 
+#import "CURLEventBackend.h"
+
 #ifndef CURLMultiLog
 #define CURLMultiLog(...) // no logging by default - to enable it, add something like this to the prefix: #define CURLMultiLog NSLog
 #endif
@@ -22,6 +24,9 @@
 #define CURLMultiLogDetail CURLMultiLog
 #endif
 
+@class CURLCircuitBreaker;
+@class CURLConcurrencyLimiter;
+@class CURLNegativeCache;
 @class CURLTransfer;
 @class CURLSocketRegistration;
 
@@ -36,9 +41,14 @@
  * There's nothing to stop you making other instances if you want to - it's just not really necessary, particularly
  * as we don't expose the curl multi externally.
  *
- * This class works by setting up a serial GCD queue to process all events associated with the multi. We add
- * gcd dispatch sources for each socket that the multi makes, and use them to notify curl when something
- * happens that needs attention.
+ * This class works by setting up a serial GCD queue to process all events associated with the multi. When using
+ * socket actions, an event backend watches each socket that the multi makes, and libcurl's timer, and
+ * notifies curl when something happens that needs attention. By default the backend adds gcd dispatch sources
+ * for each socket; see <CURLEventBackend> for the alternatives.
+ *
+ * Alternatively, a multi made with -initForExternalEventLoop: has no queue at all. It exposes the sockets it wants
+ * watched and its next timeout, and the caller's own event loop drives it with -processSocket:events: and
+ * -processTimeout, so that transfers run without any thread hops.
  */
 
 @interface CURLMultiHandle : NSObject
@@ -47,10 +57,34 @@
     NSMutableArray* _transfers;
     BOOL            _isRunningProcessingLoop;
     NSMutableArray* _sockets;
+    NSMapTable      *_retryingTransfers;
+    NSMutableDictionary *_waitingTransfers;
+    NSMapTable      *_limitedTransfers;
+    NSMutableSet    *_probeTransfers;
     dispatch_queue_t _queue;
     
-    dispatch_source_t   _timer;
-    BOOL                _timerIsSuspended;
+    id <CURLEventBackend>   _eventBackend;
+    BOOL                    _usesSocketActions;
+
+    BOOL                    _usesExternalEventLoop;
+    NSUInteger              _externalLoopDepth;
+    NSMutableArray          *_deferredBlocks;
+    CFMutableDictionaryRef  _watchedSockets;
+    uint64_t                _timeoutDeadline;
+
+    NSTimeInterval          _defaultConnectTimeout;
+    NSTimeInterval          _defaultTotalTimeout;
+    NSTimeInterval          _defaultStallTimeout;
+    NSUInteger              _defaultMinimumBytesPerSecond;
+
+    CURLConcurrencyLimiter  *_concurrencyLimiter;
+    CURLCircuitBreaker      *_circuitBreaker;
+    CURLNegativeCache       *_negativeCache;
+
+    BOOL                    _coalescesRequests;
+    NSMutableDictionary     *_flights;                      // key -> flight still taking transfers
+    NSMapTable              *_coalescedTransfers;           // transfer -> flight it's attached to
+    NSUInteger              _coalescedTransferCount;
 }
 
 /**
@@ -63,6 +97,46 @@
 
 + (CURLMultiHandle*)sharedInstance;
 
+/**
+ * Make a multi with a serial queue of its own.
+ *
+ * By default all multis share a single queue, so they never run in parallel. Giving each
+ * of several multis its own queue lets them be used as independent shards - to spread a heavy load
+ * across cores, for example.
+ *
+ * @param name The label for the queue, which shows up in the debugger and crash reports.
+ * @return A new multi, which is ready to use.
+ */
+
+- (id)initWithQueueNamed:(NSString*)name;
+
+/**
+ * Make a multi which uses socket actions, with events delivered by the given backend.
+ *
+ * @param backend The backend to use, which mustn't be shared with any other multi.
+ * @return A new multi, which is ready to use, or nil if the backend couldn't be started.
+ */
+
+- (id)initWithEventBackend:(id <CURLEventBackend>)backend __attribute((nonnull));
+
+/**
+ * Make a multi which is driven by the caller's own event loop, rather than a queue of its own.
+ *
+ * The multi uses socket actions, but nothing waits on its sockets or timer: the loop should watch
+ * the sockets reported by -getWatchedSockets:events:count: (or passed to the listener), wake up no
+ * later than -timeout, and call -processSocket:events: or -processTimeout accordingly.
+ *
+ * Everything - this method, creating and cancelling transfers on the multi, the process calls and -shutdown - must
+ * happen on the loop's thread. Transfers made without a delegate queue call their delegate directly on that thread too.
+ *
+ * @param listener Told about socket and timeout changes as they happen, so that the loop can update
+ * its own registrations, or nil if the loop polls for them instead. It's passed a NULL queue when started,
+ * and its handler is the same as calling -processSocket:events: or -processTimeout.
+ * @return A new multi, which is ready to use, or nil if the listener couldn't be started.
+ */
+
+- (id)initForExternalEventLoop:(id <CURLEventBackend>)listener;
+
 
 /**
  * Shut down the multi and clean up all resources that it was using.
@@ -97,24 +171,151 @@
 
 - (void)suspendTransfer:(CURLTransfer*)transfer __attribute((nonnull));
 
+/** @name Timeouts */
+
+/**
+ * Timeouts for transfers started on the multi, used when a request doesn't set its own with
+ * the NSURLRequest (CURLOptionsTimeouts) methods.
+ *
+ * Zero (the default) leaves the choice to the request's `timeoutInterval`; a negative value turns that
+ * timeout off. Changes only affect transfers started afterwards.
+ */
+
+@property (assign, atomic) NSTimeInterval defaultConnectTimeout;
+@property (assign, atomic) NSTimeInterval defaultTotalTimeout;
+@property (assign, atomic) NSTimeInterval defaultStallTimeout;
+@property (assign, atomic) NSUInteger defaultMinimumBytesPerSecond;
+
+/** @name Concurrency */
+
+/**
+ * Limits how many transfers run at once to each host, adapting each host's limit to how it copes.
+ * Transfers over the limit wait, in the order they were begun, until one of the host's running transfers finishes.
+ * See CURLConcurrencyLimiter for how the limits are adjusted, and for the current limits.
+ *
+ * Default is nil, which runs every transfer straight away. Changes only affect transfers begun afterwards.
+ */
+
+@property (strong, atomic) CURLConcurrencyLimiter *concurrencyLimiter;
+
 /**
- Update the dispatch source for a given socket and type.
- 
+ * Fails transfers straight away when their server has been failing to connect, rather than letting each one
+ * wait out its own timeouts. See CURLCircuitBreaker for the details.
+ *
+ * Default is nil, which lets every transfer try. Changes only affect transfers begun afterwards.
+ */
+
+@property (strong, atomic) CURLCircuitBreaker *circuitBreaker;
+
+/**
+ * Remembers URLs that turned out not to exist, so that asking for them again fails straight away
+ * with the same error. See CURLNegativeCache for which requests and results are cached.
+ *
+ * Default is nil, which makes every request.
+ */
+
+@property (strong, atomic) CURLNegativeCache *negativeCache;
+
+/**
+ * Lets identical requests share one trip to the server. While an HTTP GET (without a body) is on its way,
+ * another for the same URL, with the same headers and options, is attached to it rather than being sent: each
+ * attached transfer's delegate gets the response, data and result of the one that went out.
+ *
+ * An attached transfer can be cancelled without affecting the others; cancelling the last one cancels the request.
+ * Once the response has arrived, identical requests go out on their own again (and are shared in turn).
+ * Requests with a credential, or a login in the URL, are never shared; nor are requests whose timeouts, retry
+ * policy, digest, record delimiter or any other curl_ option differ. Attached transfers don't have connection
+ * details such as -primaryIPAddress.
+ *
+ * Default is NO. Changes only affect transfers begun afterwards.
+ */
+
+@property (assign, atomic) BOOL coalescesRequests;
+
+/**
+ * How many transfers have been attached to an identical request, rather than being sent themselves.
+ */
+
+@property (readonly, atomic) NSUInteger coalescedTransferCount;
+
+/** @name External Event Loops */
+
+/**
+ * YES if the multi was made with -initForExternalEventLoop:.
+ */
+
+@property (readonly, nonatomic) BOOL usesExternalEventLoop;
+
+/**
+ * Tell the multi that one of its sockets is ready.
+ *
+ * @warning Only for multis using an external event loop, and only on the loop's thread.
+ *
+ * @param socket The socket.
+ * @param events Some combination of CURL_CSELECT_IN, CURL_CSELECT_OUT and CURL_CSELECT_ERR.
+ */
+
+- (void)processSocket:(curl_socket_t)socket events:(int)events;
+
+/**
+ * Tell the multi that its timeout has been reached.
+ *
+ * @warning Only for multis using an external event loop, and only on the loop's thread.
+ */
+
+- (void)processTimeout;
+
+/**
+ * How long the loop can wait before calling -processTimeout.
+ *
+ * @return Milliseconds from now (zero if the timeout is already due), or -1 if there's no timeout pending.
+ */
+
+- (long)timeout;
+
+/**
+ * Copy out the sockets that the loop should be watching.
+ *
+ * @param sockets Filled in with the sockets.
+ * @param events Filled in with what each socket should be watched for: CURL_POLL_IN, CURL_POLL_OUT or CURL_POLL_INOUT.
+ * @param count The capacity of the two arrays.
+ * @return The number of sockets being watched, which may be more than count.
+ */
+
+- (NSUInteger)getWatchedSockets:(curl_socket_t*)sockets events:(int*)events count:(NSUInteger)count;
+
+/**
+ * Run a block where the multi's work is done: asynchronously on its queue, or for an external event loop,
+ * straight away - or, if the loop is already inside one of the multi's calls, as soon as that call unwinds.
+ *
+ * @warning Used internally by <CURLTransfer>, and shouldn't be called from your code.
+ *
+ * @param block The block to run.
+ */
+
+- (void)performBlock:(dispatch_block_t)block;
+
+/**
+ Start, change or stop watching a socket.
+
  @warning The routine is used internally by <CURLMulti> / <CURLSocket>, and shouldn't be called from your code.
 
- @param source The current dispatch source for the given type
- @param type Is this the source for reading or writing?
- @param socket The raw system socket that the dispatch source should be monitoring.
- @param registration The <CURLSocketRegistration> object that owns the source.
- @param required Is the source required? If not, an existing source will be cancelled. If required and the source parameter is nil, and new one will be created.
- @return The new/updated dispatch source.
-*/
+ @param socket The raw system socket that the event backend should be monitoring.
+ @param reading Should the backend report when the socket is readable?
+ @param writing Should the backend report when the socket is writable? If neither, the socket is no longer watched.
+ */
 
-- (dispatch_source_t)updateSource:(dispatch_source_t)source type:(dispatch_source_type_t)type socket:(int)socket registration:(CURLSocketRegistration *)registration required:(BOOL)required;
+- (void)watchSocket:(curl_socket_t)socket reading:(BOOL)reading writing:(BOOL)writing;
 
 /**
- The serial queue the instance schedules sources on
+ The serial queue the instance schedules sources on, or NULL for a multi driven by an external event loop.
  */
 @property (readonly, assign, nonatomic) dispatch_queue_t queue;
 
+/**
+ The backend delivering socket and timer events (or the listener, for an external event loop),
+ or nil if there isn't one or the multi has been shut down.
+ */
+@property (readonly, strong, nonatomic) id <CURLEventBackend> eventBackend;
+
 @end
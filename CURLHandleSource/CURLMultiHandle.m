@@ -24,31 +24,51 @@
  which only happens from within the processMulti: call. Therefore, we only set
  multiForSocket at the start of the processMulti call, and we clear it again at the end.
 
- The other GCD structures (self.timer and self.queue) should stay valid until they are destroyed
+ The event backend (self.eventBackend) and self.queue should stay valid until they are destroyed
  as part of the shutdown process. 
  
  # Shutdown
  
- Shutdown just cancels the timer, and removes our reference to it. All other cleanup happens
- in the timer's cancel handler. This removes all easy handles from the multi, cleans it up, and
+ Shutdown just removes our reference to the backend, then stops it on the queue. All other cleanup happens
+ straight after that, on the queue. This removes all easy handles from the multi, cleans it up, and
  disposes of it. It then releases the queue.
  
- Because the timer and the queue blocks both contain references to self, the object itself
- should not get deallocated until both the timer and queue have gone away. 
+ Because the backend's handler block and the queue blocks both contain references to self, the object itself
+ should not get deallocated until both the backend has been stopped and the queue has gone away. 
  
- Since the timer block is the only thing that actually causes activity on the multi, 
- once the timer has been cancelled, nothing else should actually touch the multi,
+ Since the backend's events are the only thing that actually cause activity on the multi, 
+ once the backend has been stopped, nothing else should actually touch the multi,
  other than the cleanup block.
 
  The queue itself is cleaned up on the main queue, once the rest of the shutdown process has finished.
  This additional paranoia (using the main queue for the cleanup) is probably not strictly necessary any more.
+
+ # External Event Loops
+
+ A multi made for an external event loop has no queue; the loop's thread takes its place. Work that would be
+ dispatched onto the queue is run directly by -performBlock: instead, unless we're already inside one of the
+ loop's calls into the multi - perhaps deep inside a libcurl callback, where adding or removing handles isn't
+ allowed - in which case it's deferred until that call unwinds, much as dispatch_async() would have done.
+ Shutdown happens immediately, on the loop's thread.
  */
 
 
 #import "CURLMultiHandle.h"
+#import "CURLMultiHandle+TestingSupport.h"
 
 #import "CURLTransfer+MultiSupport.h"
+#import "CURLCircuitBreaker.h"
+#import "CURLConcurrencyLimiter.h"
+#import "CURLNegativeCache.h"
 #import "CURLSocketRegistration.h"
+#import "CURLTransferFlight.h"
+#import "CURLDispatchEventBackend.h"
+
+#if __linux__
+#include <time.h>
+#else
+#include <mach/mach_time.h>
+#endif
 
 
 @interface CURLMultiHandle()
@@ -57,12 +77,11 @@
 
 @property (readonly, copy, nonatomic) NSArray* transfers;
 @property (strong, nonatomic) NSMutableArray* sockets;
-@property (readonly, nonatomic) dispatch_source_t timer;
 
 @end
 
 
-#define USE_MULTI_SOCKET 0              // buggy for now in my testing
+#define USE_MULTI_SOCKET NO             // default mode for -init; buggy for now in my testing
 #define USE_GLOBAL_QUEUE YES            // turn this on to share one queue across all instances
 #define COUNT_INSTANCES NO              // turn this on for a bit of debugging to ensure that things are getting cleaned up properly
 
@@ -84,6 +103,25 @@ NSString *const kActionNames[] =
 static int timeout_callback(CURLM *multi, long timeout_ms, void *userp);
 static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, void *socketp);
 
+static const uint64_t kNoTimeout = UINT64_MAX;
+
+// A monotonic clock in nanoseconds, for the external event loop's timeout deadline.
+static uint64_t CURLMultiNow(void)
+{
+#if __linux__
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * NSEC_PER_SEC + (uint64_t)now.tv_nsec;
+#else
+    static mach_timebase_info_data_t timebase;
+    if (timebase.denom == 0)
+    {
+        mach_timebase_info(&timebase);
+    }
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+#endif
+}
+
 
 @implementation CURLMultiHandle
 
@@ -91,6 +129,15 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
 
 @synthesize sockets = _sockets;
 @synthesize queue = _queue;
+@synthesize defaultConnectTimeout = _defaultConnectTimeout;
+@synthesize defaultTotalTimeout = _defaultTotalTimeout;
+@synthesize defaultStallTimeout = _defaultStallTimeout;
+@synthesize defaultMinimumBytesPerSecond = _defaultMinimumBytesPerSecond;
+@synthesize concurrencyLimiter = _concurrencyLimiter;
+@synthesize circuitBreaker = _circuitBreaker;
+@synthesize negativeCache = _negativeCache;
+@synthesize coalescesRequests = _coalescesRequests;
+@synthesize coalescedTransferCount = _coalescedTransferCount;
 
 #pragma mark - Object Lifecycle
 
@@ -106,9 +153,77 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
 }
 
 - (id)init
+{
+    return [self initUsingSocketActions:USE_MULTI_SOCKET];
+}
+
+- (id)initWithQueueNamed:(NSString *)name
+{
+    return [self initUsingSocketActions:USE_MULTI_SOCKET queueName:name];
+}
+
+- (id)initWithEventBackend:(id<CURLEventBackend>)backend
+{
+    return [self initUsingSocketActions:YES queueName:nil eventBackend:backend];
+}
+
+- (id)initForExternalEventLoop:(id<CURLEventBackend>)listener
 {
     if (self = [super init])
     {
+        _usesSocketActions = YES;
+        _usesExternalEventLoop = YES;
+
+        [self multiCreate];
+        if (!_multi)
+        {
+            [self release]; return nil;
+        }
+
+        _deferredBlocks = [[NSMutableArray alloc] init];
+        _watchedSockets = CFDictionaryCreateMutable(NULL, 0, NULL, NULL);
+        _timeoutDeadline = kNoTimeout;
+
+        _eventBackend = [listener retain];
+        if (_eventBackend && ![_eventBackend startWithQueue:NULL handler:^(curl_socket_t socket, int action) {
+            if (socket == CURL_SOCKET_TIMEOUT)
+            {
+                [self processTimeout];
+            }
+            else
+            {
+                [self processSocket:socket events:action];
+            }
+        }])
+        {
+            [self abandonEventBackend];
+            [self release]; return nil;
+        }
+
+        [self setupCommonState];
+
+        CURLMultiLog(@"started for external event loop");
+    }
+
+    return self;
+}
+
+- (id)initUsingSocketActions:(BOOL)usesSocketActions
+{
+    return [self initUsingSocketActions:usesSocketActions queueName:nil];
+}
+
+- (id)initUsingSocketActions:(BOOL)usesSocketActions queueName:(NSString*)name
+{
+    return [self initUsingSocketActions:usesSocketActions queueName:name eventBackend:nil];
+}
+
+- (id)initUsingSocketActions:(BOOL)usesSocketActions queueName:(NSString*)name eventBackend:(id<CURLEventBackend>)backend
+{
+    if (self = [super init])
+    {
+        _usesSocketActions = usesSocketActions;
+
         // Setup multi handle
         [self multiCreate];
         if (!_multi)
@@ -118,53 +233,33 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
         
         
         // Setup queue
-        _queue = [self createQueue];
+        _queue = [self createQueueNamed:name];
         if (!_queue)
         {
             [self release]; return nil;
         }
         
         
-#if USE_MULTI_SOCKET
-        // Create timer
-        _timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, _queue);
-        if (!_timer)
+        if (_usesSocketActions)
         {
-            [self release]; return nil;
+            // Start the backend; CURLM will command it to watch sockets and start the timer when it's ready
+            _eventBackend = backend ? [backend retain] : [[CURLDispatchEventBackend alloc] init];
+            if (![_eventBackend startWithQueue:_queue handler:^(curl_socket_t socket, int action) {
+                CURLMultiLog(@"%@ fired", (socket == CURL_SOCKET_TIMEOUT) ? @"timer" : [NSString stringWithFormat:@"socket %d", socket]);
+
+                // perform processing
+                [self processMulti:_multi action:action forSocket:socket];
+            }])
+            {
+                // a multi whose backend will never deliver an event would leave every transfer hanging
+                [self abandonEventBackend];
+                [self release]; return nil;
+            }
         }
         
-        _timerIsSuspended = YES;
-        // CURLM will command us to resume the timer when it's ready
-        
-        dispatch_source_set_event_handler(_timer, ^{
-            CURLMultiLog(@"timer fired");
-            
-            // perform processing
-            [self processMulti:_multi action:0 forSocket:CURL_SOCKET_TIMEOUT];
-        });
-        
-        dispatch_source_set_cancel_handler(_timer, ^{
-            
-            NSAssert(self.timer == nil, @"timer property should have been cleared by now");
-            
-            [self cleanupMulti];
-            
-            dispatch_async(dispatch_get_main_queue(), ^{
-                dispatch_release(_timer); _timer = NULL;
-                dispatch_release(_queue); _queue = NULL;
-                CURLMultiLog(@"released queue and timer");
-            });
-        });
-        
-#endif
-        
         
         // Setup other ivars
-        _transfers = [[NSMutableArray alloc] init];
-        self.sockets = [NSMutableArray array];
-#if COUNT_INSTANCES
-        ++gInstanceCount;
-#endif
+        [self setupCommonState];
         
         CURLMultiLog(@"started");
     }
@@ -172,6 +267,23 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
     return self;
 }
 
+// The state every multi needs, however its events are delivered. Both initialisers call this, so that
+// anything added here is set up for both.
+- (void)setupCommonState
+{
+    _transfers = [[NSMutableArray alloc] init];
+    _retryingTransfers = [[NSMapTable strongToStrongObjectsMapTable] retain];
+    _waitingTransfers = [[NSMutableDictionary alloc] init];
+    _limitedTransfers = [[NSMapTable strongToStrongObjectsMapTable] retain];
+    _probeTransfers = [[NSMutableSet alloc] init];
+    _flights = [[NSMutableDictionary alloc] init];
+    _coalescedTransfers = [[NSMapTable strongToStrongObjectsMapTable] retain];
+    self.sockets = [NSMutableArray array];
+#if COUNT_INSTANCES
+    ++gInstanceCount;
+#endif
+}
+
 - (void)dealloc
 {
     CURLMultiLog(@"deallocing");
@@ -182,10 +294,21 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
         dispatch_release(_queue); _queue = NULL;
     }
     
-    NSAssert((_multi == NULL) && (_timer == NULL) && (_queue == NULL), @"should have been shut down by the time we're dealloced");
+    NSAssert((_multi == NULL) && (_eventBackend == nil) && (_queue == NULL), @"should have been shut down by the time we're dealloced");
 
     [_transfers release];
+    [_retryingTransfers release];
+    [_waitingTransfers release];
+    [_limitedTransfers release];
+    [_probeTransfers release];
+    [_concurrencyLimiter release];
+    [_circuitBreaker release];
+    [_negativeCache release];
+    [_flights release];
+    [_coalescedTransfers release];
     [_sockets release];
+    [_deferredBlocks release];
+    if (_watchedSockets) CFRelease(_watchedSockets);
 
 #if COUNT_INSTANCES
     --gInstanceCount;
@@ -199,22 +322,73 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
 
 #pragma mark - Startup / Shutdown
 
+/*" Throws away a backend that wouldn't start. Nothing has been watched yet, so stopping it just releases its handler, and the hold that has on us.
+"*/
+
+- (void)abandonEventBackend;
+{
+    CURLMultiLogError(@"event backend %@ failed to start", _eventBackend);
+
+    id<CURLEventBackend> backend = _eventBackend;
+    _eventBackend = nil;
+    [backend stop];
+    [backend release];
+}
+
 - (void)shutdown
 {
-#if USE_MULTI_SOCKET
-    // if the queue is gone, we've already been shut down and are probably being disposed
-    dispatch_source_t timer = self.timer;
-    if (timer)
+    if (!self.usesSocketActions) return;
+
+    if (_usesExternalEventLoop)
+    {
+        NSAssert(_externalLoopDepth == 0, @"shouldn't shut down from inside a call into the multi");
+        if (_multi)
+        {
+            CURLMultiLog(@"shutdown");
+            id<CURLEventBackend> listener = _eventBackend;
+            _eventBackend = nil;
+            [listener stop];
+            [listener release];
+
+            [self cleanupMulti];
+
+            CFDictionaryRemoveAllValues(_watchedSockets);
+            _timeoutDeadline = kNoTimeout;
+        }
+        else
+        {
+            CURLMultiLogError(@"shutdown called multiple times");
+        }
+        return;
+    }
+
+    // if the backend is gone, we've already been shut down and are probably being disposed
+    id<CURLEventBackend> backend = self.eventBackend;
+    if (backend)
     {
         CURLMultiLog(@"shutdown");
-        _timer = NULL;  // released later
-        dispatch_source_cancel(timer);
+        _eventBackend = nil;  // released later
+
+        dispatch_queue_t queue = _queue;
+        dispatch_async(queue, ^{
+
+            // once the backend has stopped, nothing else will call into the multi
+            [backend stop];
+            [backend release];
+
+            [self cleanupMulti];
+
+            dispatch_async(dispatch_get_main_queue(), ^{
+                dispatch_release(queue);
+                _queue = NULL;
+                CURLMultiLog(@"released queue and backend");
+            });
+        });
     }
     else
     {
         CURLMultiLogError(@"shutdown called multiple times");
     }
-#endif
 }
 
 #pragma mark - Transfer Management
@@ -223,48 +397,316 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
 
 - (void)beginTransfer:(CURLTransfer *)transfer;
 {
-    NSAssert(self.queue, @"need queue");
+    NSAssert(self.queue || _usesExternalEventLoop, @"need queue");
     
-    dispatch_async(self.queue, ^{
+    [self performBlock:^{
         
         NSAssert(![self.transfers containsObject:transfer], @"shouldn't add a transfer twice");
         
         CURLMultiLog(@"adding transfer %@", transfer);
-        
-        CURLMcode result = curl_multi_add_handle(_multi, [transfer curlHandle]);
-        if (result == CURLM_OK)
+        if (self.coalescesRequests && [self coalesceTransfer:transfer]) return;
+        [self admitTransfer:transfer];
+    }];
+}
+
+- (void)admitTransfer:(CURLTransfer *)transfer
+{
+    // something we already know isn't there fails the same way it did last time
+    CURLNegativeCache *cache = self.negativeCache;
+    NSURLRequest *request = [transfer originalRequest];
+    CURLcode missingCode;
+    NSInteger missingStatus;
+    if (cache && [CURLNegativeCache canCacheRequest:request] && [request cachePolicy] != NSURLRequestReloadIgnoringLocalCacheData &&
+        [cache lookupURL:[request URL] user:[transfer credentialUser] code:&missingCode statusCode:&missingStatus])
+    {
+        CURLMultiLog(@"transfer %@ known to be missing", transfer);
+        [transfer completeWithCode:missingCode responseCode:missingStatus];
+        return;
+    }
+
+    // a server that's known to be down fails the transfer without trying it
+    CURLCircuitBreaker *breaker = self.circuitBreaker;
+    if (breaker)
+    {
+        NSURL *url = [[transfer originalRequest] URL];
+        BOOL isProbe;
+        if (![breaker shouldAllowTransferToURL:url isProbe:&isProbe])
         {
-            [_transfers addObject:transfer];
-            
-#if USE_MULTI_SOCKET
-            // http://curl.haxx.se/libcurl/c/curl_multi_socket_action.html suggests you typically fire a timeout to get it started
-            [self processMulti:_multi action:CURL_SOCKET_TIMEOUT forSocket:0];
-#else
-            // Start up the queue again if needed
-            if (!_isRunningProcessingLoop)
+            CURLMultiLog(@"circuit open, so failing transfer %@", transfer);
+            [transfer completeWithError:[breaker errorForURL:url]];
+            return;
+        }
+
+        if (isProbe) [_probeTransfers addObject:transfer];
+    }
+
+    CURLConcurrencyLimiter *limiter = self.concurrencyLimiter;
+    NSString *host = [[[transfer originalRequest] URL] host];
+    if (limiter && host)
+    {
+        // anything already waiting for the host goes first
+        NSString *key = [host lowercaseString];
+        NSMutableArray *waiting = [_waitingTransfers objectForKey:key];
+        if ([waiting count] || ![limiter acquireSlotForHost:host])
+        {
+            if (!waiting)
             {
-                _isRunningProcessingLoop = [self runProcessingLoop];
+                waiting = [NSMutableArray array];
+                [_waitingTransfers setObject:waiting forKey:key];
             }
-#endif
+
+            CURLMultiLog(@"transfer %@ waiting for one of %lu slots for %@", transfer, (unsigned long)[limiter limitForHost:host], host);
+            [waiting addObject:transfer];
+            return;
         }
-        else
+
+        [_limitedTransfers setObject:limiter forKey:transfer];
+    }
+
+    [self startTransfer:transfer];
+}
+
+- (BOOL)coalesceTransfer:(CURLTransfer *)transfer
+{
+    // a flight's own transfer goes out as normal
+    if ([[transfer delegate] isKindOfClass:[CURLTransferFlight class]] || [transfer usesCredential]) return NO;
+
+    NSString *key = [CURLTransferFlight keyForRequest:[transfer originalRequest]];
+    if (!key) return NO;
+
+    CURLTransferFlight *flight = [_flights objectForKey:key];
+    if (flight && [flight addTransfer:transfer])
+    {
+        CURLMultiLog(@"transfer %@ attached to %@", transfer, flight);
+        [_coalescedTransfers setObject:flight forKey:transfer];
+        ++_coalescedTransferCount;
+        return YES;
+    }
+
+    // nothing to attach to (or it's too late to), so this one goes out for itself and anything identical that follows it
+    flight = [[CURLTransferFlight alloc] initWithRequest:[transfer originalRequest] key:key multi:self];
+    [flight addTransfer:transfer];
+    [_flights setObject:flight forKey:key];
+    [_coalescedTransfers setObject:flight forKey:transfer];
+
+    CURLMultiLog(@"transfer %@ starting %@", transfer, flight);
+    [flight start];
+    [flight release];
+
+    return YES;
+}
+
+- (void)detachTransfer:(CURLTransfer *)transfer fromFlight:(CURLTransferFlight *)flight
+{
+    [flight retain];
+    [_coalescedTransfers removeObjectForKey:transfer];
+
+    CURLTransfer *flightTransfer = flight.transfer;
+    if ([flight removeTransfer:transfer] && [flightTransfer state] < CURLTransferStateCanceling)
+    {
+        // nobody wants the response any more. (We're on the queue, so can't call -cancel, which would wait for it)
+        CURLMultiLog(@"cancelling %@", flight);
+        if ([_flights objectForKey:flight.key] == flight) [_flights removeObjectForKey:flight.key];
+
+        [self suspendTransfer:flightTransfer];
+        [flightTransfer completeWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]];
+    }
+
+    [flight release];
+}
+
+- (void)finishFlight:(CURLTransferFlight *)flight error:(NSError *)error
+{
+    if ([_flights objectForKey:flight.key] == flight) [_flights removeObjectForKey:flight.key];
+
+    for (CURLTransfer *aTransfer in [flight removeAllTransfers])
+    {
+        // one that's being cancelled is completed by that instead
+        if ([aTransfer state] >= CURLTransferStateCanceling) continue;
+
+        [_coalescedTransfers removeObjectForKey:aTransfer];
+        [aTransfer completeWithError:error];
+    }
+}
+
+- (void)admitWaitingTransfersForHost:(NSString *)host
+{
+    if (!_multi) return;    // shut down while the block was on its way
+
+    NSString *key = [host lowercaseString];
+    NSMutableArray *waiting = [_waitingTransfers objectForKey:key];
+    CURLConcurrencyLimiter *limiter = self.concurrencyLimiter;
+
+    while ([waiting count] && (!limiter || [limiter acquireSlotForHost:host]))
+    {
+        CURLTransfer *transfer = [[waiting objectAtIndex:0] retain];
+        [waiting removeObjectAtIndex:0];
+
+        if (limiter) [_limitedTransfers setObject:limiter forKey:transfer];
+        [self startTransfer:transfer];
+        [transfer release];
+    }
+
+    if (waiting && ![waiting count]) [_waitingTransfers removeObjectForKey:key];
+}
+
+- (void)reportTransferToNegativeCache:(CURLTransfer *)transfer code:(CURLcode)code
+{
+    CURLNegativeCache *cache = self.negativeCache;
+    NSURLRequest *request = [transfer originalRequest];
+    if (!cache || ![CURLNegativeCache canCacheRequest:request]) return;
+
+    long statusCode = 0;
+    curl_easy_getinfo([transfer curlHandle], CURLINFO_RESPONSE_CODE, &statusCode);
+
+    if ([CURLNegativeCache isNotFoundCode:code statusCode:statusCode])
+    {
+        [cache addURL:[request URL] user:[transfer credentialUser] code:code statusCode:statusCode];
+    }
+    else if (code == CURLE_OK)
+    {
+        [cache removeURL:[request URL] user:[transfer credentialUser]];
+    }
+}
+
+- (void)reportTransferToCircuitBreaker:(CURLTransfer *)transfer finished:(BOOL)finished code:(CURLcode)code
+{
+    BOOL isProbe = [_probeTransfers containsObject:transfer];
+    [_probeTransfers removeObject:transfer];
+
+    CURLCircuitBreaker *breaker = self.circuitBreaker;
+    if (!breaker) return;
+
+    NSURL *url = [[transfer originalRequest] URL];
+    if (finished)
+    {
+        // libcurl only gets as far as the pre-transfer stage once it has a connection ready to use
+        double pretransferTime = 0;
+        curl_easy_getinfo([transfer curlHandle], CURLINFO_PRETRANSFER_TIME, &pretransferTime);
+
+        [breaker recordCode:code connected:(pretransferTime > 0) forURL:url isProbe:isProbe];
+    }
+    else if (isProbe)
+    {
+        [breaker abandonProbeForURL:url];
+    }
+}
+
+- (void)releaseSlotOfTransfer:(CURLTransfer *)transfer finished:(BOOL)finished code:(CURLcode)code
+{
+    CURLConcurrencyLimiter *limiter = [[_limitedTransfers objectForKey:transfer] retain];
+    if (!limiter) return;
+
+    [_limitedTransfers removeObjectForKey:transfer];
+    NSString *host = [[[transfer originalRequest] URL] host];
+
+    if (finished)
+    {
+        CURL *easy = [transfer curlHandle];
+        long statusCode = 0;
+        double firstByteTime = 0, totalTime = 0;
+        curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &statusCode);
+        curl_easy_getinfo(easy, CURLINFO_STARTTRANSFER_TIME, &firstByteTime);
+        curl_easy_getinfo(easy, CURLINFO_TOTAL_TIME, &totalTime);
+
+        [limiter releaseSlotForHost:host code:code statusCode:statusCode firstByteTime:firstByteTime startTime:[NSDate timeIntervalSinceReferenceDate] - totalTime];
+    }
+    else
+    {
+        [limiter releaseSlotForHost:host];
+    }
+    [limiter release];
+
+    // we may be part way through processing the multi, so start the next one afterwards
+    [self performBlock:^{
+        [self admitWaitingTransfersForHost:host];
+    }];
+}
+
+- (void)startTransfer:(CURLTransfer *)transfer
+{
+    CURLMcode result = [self addEasyHandle:[transfer curlHandle]];
+    if (result == CURLM_OK)
+    {
+        [_transfers addObject:transfer];
+
+        if (self.usesSocketActions)
+        {
+            // http://curl.haxx.se/libcurl/c/curl_multi_socket_action.html suggests you typically fire a timeout to get it started
+            [self processMulti:_multi action:0 forSocket:CURL_SOCKET_TIMEOUT];
+        }
+        else if (!_isRunningProcessingLoop)
         {
-            CURLMultiLogError(@"failed to add transfer %@", transfer);
-            NSAssert(result != CURLM_CALL_MULTI_SOCKET, @"CURLM_CALL_MULTI_SOCKET doesn't make sense as a transfer failure code");
-            [transfer completeWithError:[NSError errorWithDomain:CURLMcodeErrorDomain code:result userInfo:nil]];
+            // Start up the queue again if needed
+            _isRunningProcessingLoop = [self runProcessingLoop];
         }
+    }
+    else
+    {
+        CURLMultiLogError(@"failed to add transfer %@", transfer);
+        [self releaseSlotOfTransfer:transfer finished:NO code:CURLE_OK];
+        [self reportTransferToCircuitBreaker:transfer finished:NO code:CURLE_OK];
+        NSAssert(result != CURLM_CALL_MULTI_SOCKET, @"CURLM_CALL_MULTI_SOCKET doesn't make sense as a transfer failure code");
+        [transfer completeWithError:[NSError errorWithDomain:CURLMcodeErrorDomain code:result userInfo:nil]];
+    }
+}
+
+- (void)retryTransfer:(CURLTransfer *)transfer afterDelay:(NSTimeInterval)delay code:(CURLcode)code
+{
+    // the transfer stays out of the multi while it waits, but we hold on to it (and its failure, in case we're shut down first)
+    [_retryingTransfers setObject:@(code) forKey:transfer];
+
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), self.queue, ^{
+
+        // if it's gone, the transfer was cancelled (or we were shut down) while it waited
+        if (![_retryingTransfers objectForKey:transfer]) return;
+        [_retryingTransfers removeObjectForKey:transfer];
+
+        CURLMultiLog(@"retrying transfer %@", transfer);
+        [self admitTransfer:transfer];
     });
 }
 
 - (void)suspendTransfer:(CURLTransfer *)transfer;
 {
+    CURLTransferFlight *flight = [_coalescedTransfers objectForKey:transfer];
+    if (flight)
+    {
+        // attached to an identical request, so it's not in the multi
+        CURLMultiLog(@"removed transfer %@ from %@", transfer, flight);
+        [self detachTransfer:transfer fromFlight:flight];
+        return;
+    }
+
+    NSString *key = [[[[transfer originalRequest] URL] host] lowercaseString];
+    NSMutableArray *waiting = (key ? [_waitingTransfers objectForKey:key] : nil);
+    if ([waiting containsObject:transfer])
+    {
+        // still waiting for a slot, so it's not in the multi
+        CURLMultiLog(@"removed waiting transfer %@", transfer);
+        [waiting removeObjectIdenticalTo:transfer];
+        if (![waiting count]) [_waitingTransfers removeObjectForKey:key];
+        [self reportTransferToCircuitBreaker:transfer finished:NO code:CURLE_OK];
+        return;
+    }
+
+    if ([_retryingTransfers objectForKey:transfer])
+    {
+        // waiting to be retried, so it's not in the multi
+        CURLMultiLog(@"removed retrying transfer %@", transfer);
+        [_retryingTransfers removeObjectForKey:transfer];
+        return;
+    }
+
     NSAssert([_transfers containsObject:transfer], @"we should be managing this transfer");
     
     CURLMultiLog(@"removed transfer %@", transfer);
-    CURLMcode result = curl_multi_remove_handle(_multi, [transfer curlHandle]);
+    CURLMcode result = [self removeEasyHandle:[transfer curlHandle]];
     
     NSAssert(result == CURLM_OK, @"failed to remove curl easy from curl multi - something odd going on here");
     [_transfers removeObject:transfer];
+    [self releaseSlotOfTransfer:transfer finished:NO code:CURLE_OK];
+    [self reportTransferToCircuitBreaker:transfer finished:NO code:CURLE_OK];
 }
 
 - (CURLTransfer*)transferForHandle:(CURL*)easy
@@ -292,8 +734,7 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
 {
     _multi = curl_multi_init();
     
-#if USE_MULTI_SOCKET
-    if (_multi)
+    if (_multi && self.usesSocketActions)
     {
         CURLMcode result = curl_multi_setopt(_multi, CURLMOPT_TIMERFUNCTION, timeout_callback);
         
@@ -318,38 +759,61 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
             _multi = nil;
         }
     }
-#endif
 }
 
 - (void)cleanupMulti;
 {
     CURLMultiLog(@"cleaning up");
 
-    dispatch_async(_queue, ^{    // might as well serialise access
-        
+    [self performBlock:^{    // might as well serialise access
+
+    if (!_multi) return;
+
+    // nothing that's waiting for a slot will get one now
+    for (NSArray *waiting in [_waitingTransfers allValues])
+    {
+        for (CURLTransfer *aTransfer in waiting)
+        {
+            [self reportTransferToCircuitBreaker:aTransfer finished:NO code:CURLE_OK];
+        }
+    }
+    [_waitingTransfers removeAllObjects];
+
+    // like those in the multi, anything attached to a flight just stops
+    [_flights removeAllObjects];
+    [_coalescedTransfers removeAllObjects];
+
     for (CURLTransfer *aTransfer in self.transfers)
     {
         [self suspendTransfer:aTransfer];
     }
 
-#if USE_MULTI_SOCKET
-    // give handles a last chance to process
-    // I'm not sure this is strictly the right thing to do, since timeout hasn't actually been reached. Mike
-    [self processMulti:_multi action:0 forSocket:CURL_SOCKET_TIMEOUT];;
-#endif
+    // anything waiting to be retried won't be now, so report the failure it was going to retry
+    NSMapTable *retrying = [[_retryingTransfers copy] autorelease];
+    [_retryingTransfers removeAllObjects];
+    for (CURLTransfer *aTransfer in retrying)
+    {
+        [aTransfer completeWithCode:(CURLcode)[[retrying objectForKey:aTransfer] intValue]];
+    }
+
+    if (self.usesSocketActions)
+    {
+        // give handles a last chance to process
+        // I'm not sure this is strictly the right thing to do, since timeout hasn't actually been reached. Mike
+        [self processMulti:_multi action:0 forSocket:CURL_SOCKET_TIMEOUT];
+    }
 
     [_transfers release]; _transfers = nil;
     self.sockets = nil;
 
-    if (!_multi) return;
     CURLMcode result = curl_multi_cleanup(_multi);
     NSAssert(result == CURLM_OK, @"cleaning up multi failed unexpectedly with error %d", result);
     _multi = NULL;
         
-    });
+    }];
 }
 
-#if USE_MULTI_SOCKET
+#pragma mark - Processing
 
 - (void)processMulti:(CURLM*)multi action:(int)action forSocket:(int)socket
 {
@@ -364,7 +828,7 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
         CURLMcode result;
         do
         {
-            result = curl_multi_socket_action(_multi, socket, action, &running);
+            result = [self performSocketAction:action forSocket:socket runningHandles:&running];
         }
         while (result == CURLM_CALL_MULTI_SOCKET);
         
@@ -382,7 +846,66 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
     CURLMultiLogDetail(@"\nDONE processing for socket %d action %@\n\n", socket, kActionNames[action]);
 }
 
-#else
+- (void)performBlock:(dispatch_block_t)block
+{
+    // (a multi that's been shut down has no queue either, and only has cleanup left to do)
+    if (_queue)
+    {
+        dispatch_async(_queue, block);
+    }
+    else if (_externalLoopDepth)
+    {
+        // we might be inside a libcurl callback, so wait until the current call has unwound
+        [_deferredBlocks addObject:[[block copy] autorelease]];
+    }
+    else
+    {
+        [self runExternalLoopBlock:block];
+    }
+}
+
+- (void)runExternalLoopBlock:(dispatch_block_t)block
+{
+    ++_externalLoopDepth;
+    block();
+    --_externalLoopDepth;
+
+    // run anything that was deferred while the block was running (which may defer more)
+    while (_externalLoopDepth == 0 && [_deferredBlocks count])
+    {
+        dispatch_block_t deferred = [[_deferredBlocks objectAtIndex:0] retain];
+        [_deferredBlocks removeObjectAtIndex:0];
+
+        ++_externalLoopDepth;
+        deferred();
+        --_externalLoopDepth;
+
+        [deferred release];
+    }
+}
+
+- (void)processSocket:(curl_socket_t)socket events:(int)events
+{
+    NSAssert(_usesExternalEventLoop, @"only multis using an external event loop should be driven directly");
+    NSAssert(_externalLoopDepth == 0, @"shouldn't be called from inside a call into the multi");
+    if (!_multi) return;
+
+    [self runExternalLoopBlock:^{
+        [self processMulti:_multi action:events forSocket:socket];
+    }];
+}
+
+- (void)processTimeout
+{
+    NSAssert(_usesExternalEventLoop, @"only multis using an external event loop should be driven directly");
+    NSAssert(_externalLoopDepth == 0, @"shouldn't be called from inside a call into the multi");
+    if (!_multi) return;
+
+    _timeoutDeadline = kNoTimeout;
+    [self runExternalLoopBlock:^{
+        [self processMulti:_multi action:0 forSocket:CURL_SOCKET_TIMEOUT];
+    }];
+}
 
 - (BOOL)runProcessingLoop;
 {
@@ -453,13 +976,11 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
     return YES;
 }
 
-#endif
-
 - (void)processTransferMessages
 {
     CURLMsg* message;
     int count;
-    while ((message = curl_multi_info_read(_multi, &count)) != NULL)
+    while ((message = [self readMessage:&count]) != NULL)
     {
         CURLMultiLog(@"got message (%d remaining)", count);
         if (message->msg == CURLMSG_DONE)
@@ -474,11 +995,23 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
                 CURLMultiLog(@"done msg result %d for %@ %s", code, transfer, url);
                 [transfer retain];
                 
-                // the order is important here - we remove the transfer from the multi first...
+                // the order is important here - we let the limiter, circuit breaker and negative cache know how the transfer went, and remove it from the multi first...
+                [self releaseSlotOfTransfer:transfer finished:YES code:code];
+                [self reportTransferToCircuitBreaker:transfer finished:YES code:code];
+                [self reportTransferToNegativeCache:transfer code:code];
                 [self suspendTransfer:transfer];
                 
-                // ...then tell the easy transfer to complete, which can cause curl_easy_cleanup to be called
-                [transfer completeWithCode:code];
+                // ...then, unless the failure's worth another go (which needs a queue to wait on)...
+                NSTimeInterval retryDelay = (code != CURLE_OK && self.queue) ? [transfer retryDelayAfterCode:code] : -1;
+                if (retryDelay >= 0)
+                {
+                    [self retryTransfer:transfer afterDelay:retryDelay code:code];
+                }
+                else
+                {
+                    // ...tell the easy transfer to complete, which can cause curl_easy_cleanup to be called
+                    [transfer completeWithCode:code];
+                }
                 
                 // ...then tell it that it's no longer in use by the multi, which breaks the reference cycle between us
                 //[transfer removedByMulti:self];
@@ -489,7 +1022,7 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
             {
                 // this really shouldn't happen - there should always be a matching CURLTransfer - but just in case...
                 CURLMultiLogError(@"SOMETHING WRONG: done msg result %d for easy without a matching CURLTransfer %p", code, easy);
-                CURLMcode result = curl_multi_remove_handle(_multi, message->easy_handle);
+                CURLMcode result = [self removeEasyHandle:message->easy_handle];
                 NSAssert(result == CURLM_OK, @"failed to remove curl easy from curl multi - something odd going on here");
             }
         }
@@ -514,7 +1047,7 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
             NSAssert(what != CURL_POLL_REMOVE, @"shouldn't need to make a socket if we're being asked to remove it");
             registration = [[CURLSocketRegistration alloc] init];
             [self.sockets addObject:registration];
-            curl_multi_assign(_multi, socket, registration);
+            [self assignRegistration:registration toSocket:socket];
             CURLMultiLog(@"new socket:%@", registration);
             [registration release];
         }
@@ -527,17 +1060,64 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
             NSAssert(registration != nil, @"should have socket");
             CURLMultiLog(@"removed socket:%@", registration);
             [self.sockets removeObject:registration];
-            curl_multi_assign(_multi, socket, nil);
+            [self assignRegistration:nil toSocket:socket];
         }
     }
 }
 
+#pragma mark - libcurl Primitives
+
+- (BOOL)usesSocketActions
+{
+    return _usesSocketActions;
+}
+
+- (BOOL)usesExternalEventLoop
+{
+    return _usesExternalEventLoop;
+}
+
+// Every call into the multi goes through one of these, so that the testing subclass can stand in for libcurl.
+
+- (CURLMcode)addEasyHandle:(CURL *)easy
+{
+    return curl_multi_add_handle(_multi, easy);
+}
+
+- (CURLMcode)removeEasyHandle:(CURL *)easy
+{
+    return curl_multi_remove_handle(_multi, easy);
+}
+
+- (CURLMcode)performSocketAction:(int)action forSocket:(curl_socket_t)socket runningHandles:(int *)running
+{
+    return curl_multi_socket_action(_multi, socket, action, running);
+}
+
+- (CURLMsg*)readMessage:(int *)remaining
+{
+    return curl_multi_info_read(_multi, remaining);
+}
+
+- (void)assignRegistration:(CURLSocketRegistration *)registration toSocket:(curl_socket_t)socket
+{
+    curl_multi_assign(_multi, socket, registration);
+}
+
 #pragma mark - Queue Management
 
-- (dispatch_queue_t)createQueue
+- (dispatch_queue_t)createQueueNamed:(NSString*)name
 {
     dispatch_queue_t queue;
 
+    if (name)
+    {
+        // asked for a queue of our own, regardless of the default
+        queue = dispatch_queue_create([name UTF8String], NULL);
+        CURLMultiLog(@"created queue %@", name);
+        return queue;
+    }
+
 #if USE_GLOBAL_QUEUE
 
     // make a single queue, stored in a static, which we use for all CURLMulti instances
@@ -562,95 +1142,96 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
 }
 
 
-#pragma mark - Timer Management
+#pragma mark - Event Management
 
-@synthesize timer = _timer;
+@synthesize eventBackend = _eventBackend;
 
 - (void)setTimeout:(long)timeout_ms
 {
-    // if multi is nil, the object is being thrown away
-    if ([self notShutdown])
+    if (_usesExternalEventLoop)
     {
-        dispatch_source_t timer = self.timer;
-        NSAssert(timer != nil, @"should still have a timer");
+        if (timeout_ms < 0)
+        {
+            _timeoutDeadline = kNoTimeout;
+        }
+        else
+        {
+            _timeoutDeadline = CURLMultiNow() + (uint64_t)timeout_ms * NSEC_PER_MSEC;
+        }
 
         CURLMultiLog(@"timeout changed to %ldms", (long)timeout_ms);
-        
-        if (timer)
+        [self.eventBackend setTimeout:timeout_ms];
+        return;
+    }
+
+    // if the backend is nil, the object is being thrown away
+    if ([self notShutdown])
+    {
+        CURLMultiLog(@"timeout changed to %ldms", (long)timeout_ms);
+        [self.eventBackend setTimeout:timeout_ms];
+    }
+}
+
+- (void)watchSocket:(curl_socket_t)socket reading:(BOOL)reading writing:(BOOL)writing
+{
+    NSAssert(_multi != nil, @"should never be called without a multi value");
+    CURLMultiLog(@"watching socket %d for%@%@", socket, reading ? @" reading" : @"", writing ? @" writing" : @"");
+
+    if (_usesExternalEventLoop)
+    {
+        int events = (reading ? CURL_POLL_IN : 0) | (writing ? CURL_POLL_OUT : 0);
+        if (events)
         {
-            if (timeout_ms < 0)
-            {
-                if (!_timerIsSuspended)
-                {
-                    _timerIsSuspended = YES;
-                    dispatch_suspend(timer);
-                }
-            }
-            else
-            {
-                int64_t timeout_ns = timeout_ms * NSEC_PER_MSEC;
-                
-                dispatch_source_set_timer(timer,
-                                          dispatch_time(DISPATCH_TIME_NOW, timeout_ns), // fire when timeout is reached
-                                          DISPATCH_TIME_FOREVER,                        // libcurl takes care of rescheduling
-                                          timeout_ns/100);                              // we're fairly delay tolerant
-                
-                if (_timerIsSuspended)
-                {
-                    _timerIsSuspended = NO;
-                    dispatch_resume(timer);
-                }
-            }
+            CFDictionarySetValue(_watchedSockets, (const void*)(intptr_t)socket, (const void*)(intptr_t)events);
+        }
+        else
+        {
+            CFDictionaryRemoveValue(_watchedSockets, (const void*)(intptr_t)socket);
         }
     }
-}
 
-#pragma mark - Callback Support
+    [self.eventBackend watchSocket:socket reading:reading writing:writing];
+}
 
-- (NSString*)nameForType:(dispatch_source_type_t)type
+- (long)timeout
 {
-    return (type == DISPATCH_SOURCE_TYPE_READ) ? @"reader" : @"writer";
+    if (_timeoutDeadline == kNoTimeout) return -1;
+
+    uint64_t now = CURLMultiNow();
+    if (now >= _timeoutDeadline) return 0;
+
+    uint64_t remaining = _timeoutDeadline - now;
+
+    // round up, so that the loop doesn't wake up just too early and spin
+    return (long)((remaining + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC);
 }
 
-- (dispatch_source_t)updateSource:(dispatch_source_t)source type:(dispatch_source_type_t)type socket:(int)socket registration:(CURLSocketRegistration *)registration required:(BOOL)required
+typedef struct
 {
-#if USE_MULTI_SOCKET
-    if (required)
-    {
-        if (!source)
-        {
-            CURLMultiLog(@"added %@ dispatch source for socket %d", [self nameForType:type], socket);
-            source = dispatch_source_create(type, socket, 0, self.queue);
-
-            NSAssert(_multi != nil, @"should never be called without a multi value");
-            int action = (type == DISPATCH_SOURCE_TYPE_READ) ? CURL_CSELECT_IN : CURL_CSELECT_OUT;
-            dispatch_source_set_event_handler(source, ^{
-                CURLMultiLog(@"%@ dispatch source fired for socket %d with value %ld", [self nameForType:type], socket, dispatch_source_get_data(source));
-                BOOL sourceIsActive = [self.sockets containsObject:registration] && [registration ownsSource:source];
-                NSAssert(sourceIsActive, @"should have active source");
-                if (sourceIsActive)
-                {
-                    [self processMulti:_multi action:action forSocket:socket];
-                }
-            });
-
-            dispatch_source_set_cancel_handler(source, ^{
-                CURLMultiLog(@"removed %@ dispatch source for socket %d", [self nameForType:type], socket);
-                dispatch_release(source);
-            });
+    curl_socket_t   *sockets;
+    int             *events;
+    NSUInteger      capacity;
+    NSUInteger      count;
+} CURLWatchedSocketsContext;
 
-            dispatch_resume(source);
-        }
-    }
-    else if (source)
+static void CURLCopyWatchedSocket(const void *key, const void *value, void *context)
+{
+    CURLWatchedSocketsContext *copy = context;
+    if (copy->count < copy->capacity)
     {
-        CURLMultiLog(@"removing %@ dispatch source for socket %d", [self nameForType:type], socket);
-        dispatch_source_cancel(source);
-        source = nil;
+        copy->sockets[copy->count] = (curl_socket_t)(intptr_t)key;
+        copy->events[copy->count] = (int)(intptr_t)value;
     }
-#endif
+    ++copy->count;
+}
+
+- (NSUInteger)getWatchedSockets:(curl_socket_t *)sockets events:(int *)events count:(NSUInteger)count
+{
+    NSAssert(_usesExternalEventLoop, @"only multis using an external event loop keep track of their sockets");
 
-    return source;
+    CURLWatchedSocketsContext context = { sockets, events, count, 0 };
+    CFDictionaryApplyFunction(_watchedSockets, CURLCopyWatchedSocket, &context);
+    return context.count;
 }
 
 
@@ -658,7 +1239,7 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
 
 - (BOOL)notShutdown
 {
-    return self.timer != nil;
+    return self.eventBackend != nil;
 }
 
 - (NSString*)description
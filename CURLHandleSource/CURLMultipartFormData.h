@@ -0,0 +1,94 @@
+//
+//  CURLMultipartFormData.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ Builds a multipart/form-data request body out of strings, data and files, without loading the files into memory.
+
+ Parts are added in order. Nothing is read from a file until the body is sent: each body stream reads files
+ a piece at a time with pread(), straight into libcurl's buffer. A file's length is taken when it's added, so the
+ length of the whole body is known up front, and is sent as the Content-Length rather than chunking the body.
+ If a file has changed length by the time it's sent, reading the body fails rather than sending something that
+ doesn't match.
+
+ The body streams can be moved to any offset with NSStreamFileCurrentOffsetKey, which CURLTransfer uses to
+ rewind an upload that libcurl needs to send again, or to resume one part way through.
+
+ Once the parts have been added, applyToRequest: sets everything a request needs.
+ */
+
+@interface CURLMultipartFormData : NSObject
+{
+    NSString            *_boundary;
+    NSMutableArray      *_segments;
+    unsigned long long  _contentLength;
+}
+
+/**
+ Make an empty body, with a boundary that's unique to it.
+ */
+
+- (id)init;
+
+/**
+ Add a plain field.
+
+ @param name The field's name.
+ @param string Its value, which is sent as UTF-8.
+ */
+
+- (void)appendPartWithName:(NSString *)name string:(NSString *)string;
+
+/**
+ Add a part from memory.
+
+ @param name The field's name.
+ @param data The part's contents.
+ @param fileName The file name to send, or nil to send the data as a plain field.
+ @param mimeType The Content-Type of the part, or nil for none (or application/octet-stream, if there's a file name).
+ */
+
+- (void)appendPartWithName:(NSString *)name data:(NSData *)data fileName:(NSString *)fileName mimeType:(NSString *)mimeType;
+
+/**
+ Add a part which is read from a file as the body is sent.
+
+ @param name The field's name.
+ @param url A file URL.
+ @param fileName The file name to send, or nil for the URL's last path component.
+ @param mimeType The Content-Type of the part, or nil for application/octet-stream.
+ @param error Set if the file couldn't be found, or isn't a regular file.
+ @return YES if the part was added.
+ */
+
+- (BOOL)appendPartWithName:(NSString *)name fileURL:(NSURL *)url fileName:(NSString *)fileName mimeType:(NSString *)mimeType error:(NSError **)error;
+
+/**
+ A new stream of the whole body, as it stands. Parts added afterwards aren't included.
+ */
+
+- (NSInputStream *)inputStream;
+
+/**
+ Set the request's HTTPBodyStream, Content-Type and Content-Length for the body.
+
+ @param request The request to upload the body with.
+ */
+
+- (void)applyToRequest:(NSMutableURLRequest *)request;
+
+@property (readonly, copy, nonatomic) NSString *boundary;
+
+/** `multipart/form-data`, with the boundary. */
+@property (readonly, nonatomic) NSString *contentType;
+
+/** The length of the whole body, including the closing boundary. */
+@property (readonly, nonatomic) unsigned long long contentLength;
+
+@end
@@ -0,0 +1,424 @@
+//
+//  CURLMultipartFormData.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLMultipartFormData.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#pragma mark - File Segments
+
+/**
+ A file's contents, within the body.
+ */
+
+@interface CURLMultipartFileSegment : NSObject
+{
+    NSString            *_path;
+    unsigned long long  _length;
+}
+
+- (id)initWithPath:(NSString *)path length:(unsigned long long)length;
+
+@property (readonly, copy, nonatomic) NSString *path;
+@property (readonly, nonatomic) unsigned long long length;
+
+@end
+
+@implementation CURLMultipartFileSegment
+
+@synthesize path = _path;
+@synthesize length = _length;
+
+- (id)initWithPath:(NSString *)path length:(unsigned long long)length
+{
+    if ((self = [super init]) != nil)
+    {
+        _path = [path copy];
+        _length = length;
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_path release];
+
+    [super dealloc];
+}
+
+@end
+
+// Segments are either NSData or CURLMultipartFileSegment
+static unsigned long long CURLMultipartSegmentLength(id segment)
+{
+    return ([segment isKindOfClass:[NSData class]] ? [(NSData *)segment length] : [(CURLMultipartFileSegment *)segment length]);
+}
+
+#pragma mark - Body Stream
+
+/**
+ Reads through the segments of a body - data, and file segments - one after another.
+ */
+
+@interface CURLMultipartInputStream : NSInputStream
+{
+    NSArray             *_segments;
+    unsigned long long  *_offsets;          // where each segment starts, with the total length at the end
+    NSUInteger          _segmentIndex;      // the segment _position is in
+    unsigned long long  _position;
+    int                 _fileDescriptor;    // for the file segment at _fileSegmentIndex, or -1
+    NSUInteger          _fileSegmentIndex;
+    NSStreamStatus      _status;
+    NSError             *_error;
+    id <NSStreamDelegate> _delegate;
+}
+
+- (id)initWithSegments:(NSArray *)segments;
+
+@end
+
+@implementation CURLMultipartInputStream
+
+- (id)initWithSegments:(NSArray *)segments
+{
+    if ((self = [super init]) != nil)
+    {
+        _segments = [segments copy];
+        _offsets = malloc(sizeof(unsigned long long) * ([_segments count] + 1));
+        _fileDescriptor = -1;
+        _status = NSStreamStatusNotOpen;
+
+        unsigned long long offset = 0;
+        for (NSUInteger index = 0; index < [_segments count]; ++index)
+        {
+            _offsets[index] = offset;
+            offset += CURLMultipartSegmentLength([_segments objectAtIndex:index]);
+        }
+        _offsets[[_segments count]] = offset;
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_fileDescriptor >= 0) close(_fileDescriptor);
+    free(_offsets);
+    [_segments release];
+    [_error release];
+
+    [super dealloc];
+}
+
+#pragma mark Opening and Closing
+
+- (void)open
+{
+    if (_status == NSStreamStatusNotOpen) _status = ([self length] ? NSStreamStatusOpen : NSStreamStatusAtEnd);
+}
+
+- (void)close
+{
+    if (_fileDescriptor >= 0)
+    {
+        close(_fileDescriptor);
+        _fileDescriptor = -1;
+    }
+
+    _status = NSStreamStatusClosed;
+}
+
+- (unsigned long long)length
+{
+    return _offsets[[_segments count]];
+}
+
+- (void)failWithError:(NSError *)error
+{
+    [_error release];
+    _error = [error retain];
+    _status = NSStreamStatusError;
+}
+
+#pragma mark Reading
+
+// Opens the file for a segment, and checks it's still the length it was when it was added
+- (BOOL)openFileSegmentAtIndex:(NSUInteger)index
+{
+    if (_fileDescriptor >= 0 && _fileSegmentIndex == index) return YES;
+
+    if (_fileDescriptor >= 0) close(_fileDescriptor);
+
+    CURLMultipartFileSegment *segment = [_segments objectAtIndex:index];
+    _fileDescriptor = open([segment.path fileSystemRepresentation], O_RDONLY);
+    _fileSegmentIndex = index;
+
+    struct stat info;
+    if (_fileDescriptor < 0 || fstat(_fileDescriptor, &info) != 0)
+    {
+        [self failWithError:[NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{ NSFilePathErrorKey : segment.path }]];
+        return NO;
+    }
+
+    if ((unsigned long long)info.st_size != segment.length)
+    {
+        [self failWithError:[NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadUnknownError userInfo:@{
+                                NSFilePathErrorKey : segment.path,
+                                NSLocalizedFailureReasonErrorKey : @"The file changed length after it was added to the body",
+                             }]];
+        return NO;
+    }
+
+    return YES;
+}
+
+- (NSInteger)read:(uint8_t *)buffer maxLength:(NSUInteger)length
+{
+    if (_status == NSStreamStatusError) return -1;
+    if (_status != NSStreamStatusOpen) return 0;
+
+    NSUInteger count = 0;
+    unsigned long long total = [self length];
+    while (count < length && _position < total)
+    {
+        while (_position >= _offsets[_segmentIndex + 1]) ++_segmentIndex;
+
+        id segment = [_segments objectAtIndex:_segmentIndex];
+        unsigned long long within = _position - _offsets[_segmentIndex];
+        NSUInteger wanted = (NSUInteger)MIN(length - count, _offsets[_segmentIndex + 1] - _position);
+
+        if ([segment isKindOfClass:[NSData class]])
+        {
+            memcpy(buffer + count, (const uint8_t *)[(NSData *)segment bytes] + within, wanted);
+        }
+        else
+        {
+            if (![self openFileSegmentAtIndex:_segmentIndex]) return -1;
+
+            ssize_t result;
+            do
+            {
+                result = pread(_fileDescriptor, buffer + count, wanted, (off_t)within);
+            } while (result < 0 && errno == EINTR);
+
+            if (result <= 0)
+            {
+                [self failWithError:[NSError errorWithDomain:NSPOSIXErrorDomain code:(result < 0 ? errno : EIO) userInfo:@{ NSFilePathErrorKey : [(CURLMultipartFileSegment *)segment path] }]];
+                return -1;
+            }
+
+            wanted = result;
+        }
+
+        count += wanted;
+        _position += wanted;
+    }
+
+    if (_position >= total) _status = NSStreamStatusAtEnd;
+    return count;
+}
+
+- (BOOL)getBuffer:(uint8_t **)buffer length:(NSUInteger *)len
+{
+    return NO;
+}
+
+- (BOOL)hasBytesAvailable
+{
+    return (_status == NSStreamStatusOpen);
+}
+
+- (NSStreamStatus)streamStatus
+{
+    return _status;
+}
+
+- (NSError *)streamError
+{
+    return _error;
+}
+
+#pragma mark Seeking
+
+- (id)propertyForKey:(NSString *)key
+{
+    if ([key isEqualToString:NSStreamFileCurrentOffsetKey]) return @(_position);
+    return nil;
+}
+
+- (BOOL)setProperty:(id)property forKey:(NSString *)key
+{
+    if (![key isEqualToString:NSStreamFileCurrentOffsetKey]) return NO;
+    if (_status == NSStreamStatusError || _status == NSStreamStatusClosed) return NO;
+
+    unsigned long long offset = [property unsignedLongLongValue];
+    if (offset > [self length]) return NO;
+
+    _position = offset;
+    _segmentIndex = 0;
+    while (_segmentIndex < [_segments count] && _position >= _offsets[_segmentIndex + 1]) ++_segmentIndex;
+
+    if (_status != NSStreamStatusNotOpen) _status = (_position < [self length] ? NSStreamStatusOpen : NSStreamStatusAtEnd);
+    return YES;
+}
+
+#pragma mark Run Loops
+
+// The body is always available straight away, so there's nothing to schedule
+
+- (id <NSStreamDelegate>)delegate { return _delegate; }
+- (void)setDelegate:(id <NSStreamDelegate>)delegate { _delegate = delegate; }
+
+- (void)scheduleInRunLoop:(NSRunLoop *)runLoop forMode:(NSString *)mode { }
+- (void)removeFromRunLoop:(NSRunLoop *)runLoop forMode:(NSString *)mode { }
+
+// CFReadStream calls these on toll-free bridged subclasses, such as when the request goes through NSURLConnection instead
+- (void)_scheduleInCFRunLoop:(CFRunLoopRef)runLoop forMode:(CFStringRef)mode { }
+- (void)_unscheduleFromCFRunLoop:(CFRunLoopRef)runLoop forMode:(CFStringRef)mode { }
+- (BOOL)_setCFClientFlags:(CFOptionFlags)flags callback:(CFReadStreamClientCallBack)callback context:(CFStreamClientContext *)context { return NO; }
+
+@end
+
+#pragma mark - Form Data
+
+@interface CURLMultipartFormData()
+
+- (void)appendPartWithHeaders:(NSString *)headers content:(id)content;
+
+@end
+
+@implementation CURLMultipartFormData
+
+@synthesize boundary = _boundary;
+
+- (id)init
+{
+    if ((self = [super init]) != nil)
+    {
+        _boundary = [[NSString alloc] initWithFormat:@"CURLHandleBoundary-%@", [[NSProcessInfo processInfo] globallyUniqueString]];
+        _segments = [[NSMutableArray alloc] init];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_boundary release];
+    [_segments release];
+
+    [super dealloc];
+}
+
+#pragma mark Parts
+
+// Quotes and line breaks in names are escaped as browsers do, so that they can't break out of the header
+static NSString *CURLMultipartQuotedName(NSString *name)
+{
+    name = [name stringByReplacingOccurrencesOfString:@"\"" withString:@"%22"];
+    name = [name stringByReplacingOccurrencesOfString:@"\r" withString:@"%0D"];
+    name = [name stringByReplacingOccurrencesOfString:@"\n" withString:@"%0A"];
+    return [NSString stringWithFormat:@"\"%@\"", name];
+}
+
+static NSString *CURLMultipartHeaders(NSString *name, NSString *fileName, NSString *mimeType)
+{
+    NSMutableString *headers = [NSMutableString stringWithFormat:@"Content-Disposition: form-data; name=%@", CURLMultipartQuotedName(name)];
+    if (fileName) [headers appendFormat:@"; filename=%@", CURLMultipartQuotedName(fileName)];
+    [headers appendString:@"\r\n"];
+
+    if (mimeType) [headers appendFormat:@"Content-Type: %@\r\n", mimeType];
+    return headers;
+}
+
+- (void)appendPartWithHeaders:(NSString *)headers content:(id)content
+{
+    NSString *head = [NSString stringWithFormat:@"--%@\r\n%@\r\n", _boundary, headers];
+    NSData *headData = [head dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *tail = [NSData dataWithBytes:"\r\n" length:2];
+
+    [_segments addObject:headData];
+    [_segments addObject:content];
+    [_segments addObject:tail];
+
+    _contentLength += [headData length] + CURLMultipartSegmentLength(content) + [tail length];
+}
+
+- (void)appendPartWithName:(NSString *)name string:(NSString *)string
+{
+    [self appendPartWithName:name data:[string dataUsingEncoding:NSUTF8StringEncoding] fileName:nil mimeType:nil];
+}
+
+- (void)appendPartWithName:(NSString *)name data:(NSData *)data fileName:(NSString *)fileName mimeType:(NSString *)mimeType
+{
+    NSParameterAssert(name);
+    NSParameterAssert(data);
+
+    if (fileName && !mimeType) mimeType = @"application/octet-stream";
+    [self appendPartWithHeaders:CURLMultipartHeaders(name, fileName, mimeType) content:[[data copy] autorelease]];
+}
+
+- (BOOL)appendPartWithName:(NSString *)name fileURL:(NSURL *)url fileName:(NSString *)fileName mimeType:(NSString *)mimeType error:(NSError **)error
+{
+    NSParameterAssert(name);
+    NSParameterAssert([url isFileURL]);
+
+    NSString *path = [url path];
+    struct stat info;
+    if (stat([path fileSystemRepresentation], &info) != 0)
+    {
+        if (error) *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{ NSURLErrorKey : url }];
+        return NO;
+    }
+
+    if (!S_ISREG(info.st_mode))
+    {
+        if (error) *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadInvalidFileNameError userInfo:@{ NSURLErrorKey : url }];
+        return NO;
+    }
+
+    CURLMultipartFileSegment *segment = [[CURLMultipartFileSegment alloc] initWithPath:path length:info.st_size];
+    [self appendPartWithHeaders:CURLMultipartHeaders(name, (fileName ? fileName : [url lastPathComponent]), (mimeType ? mimeType : @"application/octet-stream")) content:segment];
+    [segment release];
+
+    return YES;
+}
+
+#pragma mark Body
+
+- (NSData *)closingBoundary
+{
+    return [[NSString stringWithFormat:@"--%@--\r\n", _boundary] dataUsingEncoding:NSUTF8StringEncoding];
+}
+
+- (NSInputStream *)inputStream
+{
+    NSArray *segments = [_segments arrayByAddingObject:[self closingBoundary]];
+    return [[[CURLMultipartInputStream alloc] initWithSegments:segments] autorelease];
+}
+
+- (void)applyToRequest:(NSMutableURLRequest *)request
+{
+    [request setHTTPBodyStream:[self inputStream]];
+    [request setValue:[self contentType] forHTTPHeaderField:@"Content-Type"];
+    [request setValue:[NSString stringWithFormat:@"%llu", [self contentLength]] forHTTPHeaderField:@"Content-Length"];
+}
+
+- (NSString *)contentType
+{
+    return [NSString stringWithFormat:@"multipart/form-data; boundary=%@", _boundary];
+}
+
+- (unsigned long long)contentLength
+{
+    return _contentLength + [[self closingBoundary] length];
+}
+
+@end
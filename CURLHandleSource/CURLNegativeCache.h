@@ -0,0 +1,177 @@
+//
+//  CURLNegativeCache.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <curl/curl.h>
+
+/**
+ Remembers which URLs turned out not to exist, so that asking for them again within timeToLive fails straight away
+ rather than paying for another round trip.
+
+ Give a CURLMultiHandle a cache with its negativeCache property. Whenever a GET or HEAD request without a body
+ finishes with an HTTP 404 or 410, or with CURLE_REMOTE_FILE_NOT_FOUND (FTP and SFTP), the URL is remembered. A later
+ request for it fails with the same error code the transfer would have produced. A success for the URL forgets it, and
+ requests with a cache policy of NSURLRequestReloadIgnoringLocalCacheData skip the cache altogether (and refresh it).
+
+ URLs are normalised first: the scheme and host are lowercased, a default port and any fragment are dropped,
+ and an empty path becomes "/". The user is part of the key - whether it's written into the URL or comes from the
+ transfer's credential - so a file one login can't see doesn't fail requests made with another. The password isn't.
+
+ Only results meaning the resource doesn't exist are cached. Authentication failures never are: they say more
+ about the login than about the URL.
+
+ The cache doesn't hold the URLs themselves. It keeps 64-bit fingerprints in a fixed-size table, so its memory
+ is bounded by its capacity. When the table is full, the entries closest to expiring make way. Unlike a Bloom filter
+ it can forget a URL, and with 64-bit fingerprints the chance of a false hit is negligible - which matters, as a false hit
+ would fail a request for something that exists.
+
+ A cache can be shared by several multis, and is safe to use from any thread.
+ */
+
+@interface CURLNegativeCache : NSObject
+{
+    NSTimeInterval  _timeToLive;
+    NSUInteger      _bucketCount;
+    void            *_entries;
+    NSTimeInterval  _epoch;
+
+    NSUInteger      _hitCount;
+}
+
+/**
+ A cache with room for 1024 URLs, remembering each for a minute.
+ */
+
++ (CURLNegativeCache*)cache;
+
+/**
+ Make a cache.
+
+ @param capacity How many URLs the cache can remember at once. Rounded up to a multiple of four.
+ @return The new cache, using about 24 bytes per URL.
+ */
+
+- (id)initWithCapacity:(NSUInteger)capacity;
+
+/** How long a URL is remembered for. Default is 60 seconds. */
+@property (assign, atomic) NSTimeInterval timeToLive;
+
+/** How many URLs the cache can remember at once. */
+@property (readonly, nonatomic) NSUInteger capacity;
+
+/**
+ Should a request's result be cached?
+
+ @param request The request.
+ @return YES for GET and HEAD requests without a body.
+ */
+
++ (BOOL)canCacheRequest:(NSURLRequest*)request;
+
+/**
+ Does a result mean the resource doesn't exist?
+
+ @param code The CURLcode the transfer finished with.
+ @param statusCode The response status, if there was one.
+ @return YES for CURLE_REMOTE_FILE_NOT_FOUND, and HTTP 404 and 410.
+ */
+
++ (BOOL)isNotFoundCode:(CURLcode)code statusCode:(NSInteger)statusCode;
+
+/**
+ The form of a URL that's used as the cache key.
+
+ @param url The URL.
+ @return The normalised URL string.
+ */
+
++ (NSString*)normalizedStringForURL:(NSURL*)url;
+
+/**
+ The form of a URL that's used as the cache key, for a particular user.
+
+ @param url The URL.
+ @param user Who the request is made as. Pass nil to use the user in the URL, if there is one.
+ @return The normalised URL string, including the user.
+ */
+
++ (NSString*)normalizedStringForURL:(NSURL*)url user:(NSString*)user;
+
+/**
+ Look up a URL.
+
+ @param url The URL.
+ @param code Set to the CURLcode the URL's last request failed with, if it's in the cache.
+ @param statusCode Set to the status its last request failed with, if it's in the cache.
+ @return YES if the URL is known not to exist.
+ */
+
+- (BOOL)lookupURL:(NSURL*)url code:(CURLcode*)code statusCode:(NSInteger*)statusCode;
+
+/**
+ Look up a URL, as a particular user.
+
+ @param url The URL.
+ @param user Who the request is made as. Pass nil to use the user in the URL, if there is one.
+ @param code Set to the CURLcode the URL's last request failed with, if it's in the cache.
+ @param statusCode Set to the status its last request failed with, if it's in the cache.
+ @return YES if the URL is known not to exist for that user.
+ */
+
+- (BOOL)lookupURL:(NSURL*)url user:(NSString*)user code:(CURLcode*)code statusCode:(NSInteger*)statusCode;
+
+/**
+ Remember that a URL doesn't exist.
+
+ @param url The URL.
+ @param code The CURLcode its request failed with.
+ @param statusCode The status its request failed with.
+ */
+
+- (void)addURL:(NSURL*)url code:(CURLcode)code statusCode:(NSInteger)statusCode;
+
+/**
+ Remember that a URL doesn't exist for a particular user.
+
+ @param url The URL.
+ @param user Who the request was made as. Pass nil to use the user in the URL, if there is one.
+ @param code The CURLcode its request failed with.
+ @param statusCode The status its request failed with.
+ */
+
+- (void)addURL:(NSURL*)url user:(NSString*)user code:(CURLcode)code statusCode:(NSInteger)statusCode;
+
+/**
+ Forget a URL, if it's in the cache.
+
+ @param url The URL.
+ */
+
+- (void)removeURL:(NSURL*)url;
+
+/**
+ Forget a URL for a particular user, if it's in the cache.
+
+ @param url The URL.
+ @param user Who the request was made as. Pass nil to use the user in the URL, if there is one.
+ */
+
+- (void)removeURL:(NSURL*)url user:(NSString*)user;
+
+/**
+ Forget everything.
+ */
+
+- (void)removeAllURLs;
+
+/** @name Statistics */
+
+/** Requests answered from the cache. */
+@property (readonly, atomic) NSUInteger hitCount;
+
+@end
@@ -0,0 +1,246 @@
+//
+//  CURLNegativeCache.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLNegativeCache.h"
+
+static const NSUInteger kWays = 4;     // entries per bucket; a URL can live in any of its bucket's entries
+
+typedef struct
+{
+    uint64_t        fingerprint;    // zero for an empty entry
+    NSTimeInterval  expires;        // relative to the cache's epoch
+    int32_t         statusCode;
+    int32_t         code;
+} CURLNegativeCacheEntry;
+
+#pragma mark - Hashing
+
+// 64-bit FNV-1a
+static uint64_t CURLFingerprint(NSString *string)
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    const char *bytes = [string UTF8String];
+    while (*bytes)
+    {
+        hash ^= (uint8_t)*bytes++;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash ? hash : 1;     // keep zero for empty entries
+}
+
+#pragma mark - Cache
+
+@implementation CURLNegativeCache
+
+@synthesize timeToLive = _timeToLive;
+@synthesize hitCount = _hitCount;
+
++ (CURLNegativeCache*)cache
+{
+    return [[[self alloc] init] autorelease];
+}
+
+- (id)init
+{
+    return [self initWithCapacity:1024];
+}
+
+- (id)initWithCapacity:(NSUInteger)capacity
+{
+    if (self = [super init])
+    {
+        _timeToLive = 60.0;
+        _bucketCount = MAX((capacity + kWays - 1) / kWays, 1U);
+        _entries = calloc(_bucketCount * kWays, sizeof(CURLNegativeCacheEntry));
+        _epoch = [NSDate timeIntervalSinceReferenceDate];
+
+        if (!_entries)
+        {
+            [self release]; return nil;
+        }
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_entries);
+
+    [super dealloc];
+}
+
+- (NSUInteger)capacity
+{
+    return _bucketCount * kWays;
+}
+
+#pragma mark Classification
+
++ (BOOL)canCacheRequest:(NSURLRequest *)request
+{
+    NSString* method = [request HTTPMethod];
+    if (method && ![method isEqualToString:@"GET"] && ![method isEqualToString:@"HEAD"]) return NO;
+    return !([request HTTPBody] || [request HTTPBodyStream]);
+}
+
++ (BOOL)isNotFoundCode:(CURLcode)code statusCode:(NSInteger)statusCode
+{
+    if (code == CURLE_REMOTE_FILE_NOT_FOUND) return YES;
+    return (code == CURLE_HTTP_RETURNED_ERROR && (statusCode == 404 || statusCode == 410));
+}
+
++ (NSString*)normalizedStringForURL:(NSURL *)url
+{
+    return [self normalizedStringForURL:url user:nil];
+}
+
++ (NSString*)normalizedStringForURL:(NSURL *)url user:(NSString *)user
+{
+    NSString* scheme = [[url scheme] lowercaseString];
+    NSString* host = [[url host] lowercaseString];
+    if (!scheme || !host) return [url absoluteString];
+
+    NSNumber* port = [url port];
+    NSDictionary* defaults = @{ @"http" : @80, @"https" : @443, @"ftp" : @21, @"ftps" : @990, @"sftp" : @22, @"scp" : @22 };
+    if (port && [port isEqual:[defaults objectForKey:scheme]]) port = nil;
+
+    // the path as it was written, without decoding any escapes
+    NSString* path = (NSString*)CFURLCopyPath((CFURLRef)url);
+    if (![path length]) path = [@"/" retain];
+    [path autorelease];
+
+    // the user stays in, so that what one login can't see doesn't count against another
+    if (!user) user = [url user];
+    NSMutableString* result = [NSMutableString stringWithFormat:@"%@://", scheme];
+    if ([user length])
+    {
+        NSString* escapedUser = (NSString*)CFURLCreateStringByAddingPercentEscapes(NULL, (CFStringRef)user, NULL, CFSTR(":@/?#%"), kCFStringEncodingUTF8);
+        [result appendFormat:@"%@@", escapedUser];
+        [escapedUser release];
+    }
+    [result appendString:host];
+    if (port) [result appendFormat:@":%@", port];
+    [result appendString:path];
+
+    NSString* query = [url query];
+    if (query) [result appendFormat:@"?%@", query];
+
+    return result;
+}
+
+#pragma mark Entries
+
+- (CURLNegativeCacheEntry*)bucketForFingerprint:(uint64_t)fingerprint
+{
+    return (CURLNegativeCacheEntry*)_entries + (fingerprint % _bucketCount) * kWays;
+}
+
+- (BOOL)lookupURL:(NSURL *)url code:(CURLcode *)code statusCode:(NSInteger *)statusCode
+{
+    return [self lookupURL:url user:nil code:code statusCode:statusCode];
+}
+
+- (BOOL)lookupURL:(NSURL *)url user:(NSString *)user code:(CURLcode *)code statusCode:(NSInteger *)statusCode
+{
+    uint64_t fingerprint = CURLFingerprint([[self class] normalizedStringForURL:url user:user]);
+    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate] - _epoch;
+
+    @synchronized(self)
+    {
+        CURLNegativeCacheEntry* bucket = [self bucketForFingerprint:fingerprint];
+        for (NSUInteger way = 0; way < kWays; ++way)
+        {
+            CURLNegativeCacheEntry* entry = &bucket[way];
+            if (entry->fingerprint != fingerprint) continue;
+
+            if (entry->expires <= now)
+            {
+                entry->fingerprint = 0;
+                return NO;
+            }
+
+            if (code) *code = (CURLcode)entry->code;
+            if (statusCode) *statusCode = entry->statusCode;
+            ++_hitCount;
+            return YES;
+        }
+    }
+
+    return NO;
+}
+
+- (void)addURL:(NSURL *)url code:(CURLcode)code statusCode:(NSInteger)statusCode
+{
+    [self addURL:url user:nil code:code statusCode:statusCode];
+}
+
+- (void)addURL:(NSURL *)url user:(NSString *)user code:(CURLcode)code statusCode:(NSInteger)statusCode
+{
+    uint64_t fingerprint = CURLFingerprint([[self class] normalizedStringForURL:url user:user]);
+    NSTimeInterval expires = [NSDate timeIntervalSinceReferenceDate] - _epoch + self.timeToLive;
+
+    @synchronized(self)
+    {
+        // use the URL's existing entry if it has one, and otherwise an empty one, or the one that would be gone soonest
+        CURLNegativeCacheEntry* bucket = [self bucketForFingerprint:fingerprint];
+        CURLNegativeCacheEntry* victim = NULL;
+        for (NSUInteger way = 0; way < kWays; ++way)
+        {
+            CURLNegativeCacheEntry* entry = &bucket[way];
+            if (entry->fingerprint == fingerprint)
+            {
+                victim = entry;
+                break;
+            }
+
+            if (!victim || (victim->fingerprint && (!entry->fingerprint || entry->expires < victim->expires))) victim = entry;
+        }
+
+        victim->fingerprint = fingerprint;
+        victim->expires = expires;
+        victim->statusCode = (int32_t)statusCode;
+        victim->code = (int32_t)code;
+    }
+}
+
+- (void)removeURL:(NSURL *)url
+{
+    [self removeURL:url user:nil];
+}
+
+- (void)removeURL:(NSURL *)url user:(NSString *)user
+{
+    uint64_t fingerprint = CURLFingerprint([[self class] normalizedStringForURL:url user:user]);
+
+    @synchronized(self)
+    {
+        CURLNegativeCacheEntry* bucket = [self bucketForFingerprint:fingerprint];
+        for (NSUInteger way = 0; way < kWays; ++way)
+        {
+            if (bucket[way].fingerprint == fingerprint) bucket[way].fingerprint = 0;
+        }
+    }
+}
+
+- (void)removeAllURLs
+{
+    @synchronized(self)
+    {
+        memset(_entries, 0, _bucketCount * kWays * sizeof(CURLNegativeCacheEntry));
+    }
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"<%@ %p: capacity %lu, %lu hits>", [self class], self, (unsigned long)self.capacity, (unsigned long)self.hitCount];
+}
+
+@end
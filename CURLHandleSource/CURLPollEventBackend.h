@@ -0,0 +1,45 @@
+//
+//  CURLPollEventBackend.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLEventBackend.h"
+
+/**
+ An event backend which waits for sockets and the timer on a dedicated thread, using kqueue
+ (or epoll and a timerfd, when built for Linux), rather than a GCD source per socket.
+
+ Everything that's ready after one wait is handed to the multi's queue in a single batch, so a busy
+ multi with thousands of sockets costs one queue hop per wakeup instead of one per socket.
+
+ Readiness is level-triggered: libcurl doesn't promise to drain a socket each time it's told about it,
+ so edge-triggered notifications could leave a transfer stranded. To avoid reporting the same readiness
+ twice, the thread doesn't wait again until the previous batch has been handled.
+
+ Batches are always handed over through the multi's queue, so this backend can't be the listener of a multi on an
+ external event loop; starting it without a queue fails.
+ */
+
+@interface CURLPollEventBackend : NSObject <CURLEventBackend>
+{
+    int                 _poller;
+    int                 _wakeup[2];
+    int                 _timerDescriptor;
+    dispatch_queue_t    _queue;
+    CURLEventHandler    _handler;
+    CFMutableDictionaryRef _interest;
+    BOOL                _timerArmed;
+    BOOL                _stopped;
+    NSUInteger          _wakeups;
+}
+
+/**
+ How many times the thread has woken up with something to deliver.
+ */
+
+@property (readonly, atomic) NSUInteger wakeups;
+
+@end
@@ -0,0 +1,391 @@
+//
+//  CURLPollEventBackend.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLPollEventBackend.h"
+#import "CURLMultiHandle.h"
+
+#if __linux__
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#else
+#include <sys/event.h>
+#endif
+
+static const int kMaxEventsPerWait = 256;
+static const NSUInteger kWaitStopped = NSNotFound;
+
+static const uintptr_t kWatchRead = 1 << 0;
+static const uintptr_t kWatchWrite = 1 << 1;
+
+#if !__linux__
+static const uintptr_t kTimerIdent = 1; // timers have their own namespace, so this can't clash with a socket
+#endif
+
+typedef struct
+{
+    curl_socket_t   socket;
+    int             action;
+} CURLPollEvent;
+
+@interface CURLPollEventBackend()
+
+@property (readwrite, atomic) NSUInteger wakeups;
+
+@end
+
+@implementation CURLPollEventBackend
+
+@synthesize wakeups = _wakeups;
+
+#pragma mark - Object Lifecycle
+
+- (id)init
+{
+    if ((self = [super init]) != nil)
+    {
+        _poller = -1;
+        _wakeup[0] = _wakeup[1] = -1;
+        _timerDescriptor = -1;
+
+        // socket -> watch mask, without boxing either
+        _interest = CFDictionaryCreateMutable(kCFAllocatorDefault, 0, NULL, NULL);
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    // the thread keeps us alive while it's running, so nothing can be using these any more
+    [self closeDescriptors];
+
+    CFRelease(_interest);
+    [_handler release];
+    if (_queue)
+    {
+        dispatch_release(_queue);
+    }
+
+    [super dealloc];
+}
+
+- (void)closeDescriptors
+{
+    int* descriptors[] = { &_poller, &_wakeup[0], &_wakeup[1], &_timerDescriptor };
+    for (NSUInteger n = 0; n < sizeof(descriptors) / sizeof(descriptors[0]); ++n)
+    {
+        if (*descriptors[n] >= 0)
+        {
+            close(*descriptors[n]);
+            *descriptors[n] = -1;
+        }
+    }
+}
+
+#pragma mark - CURLEventBackend
+
+- (BOOL)startWithQueue:(dispatch_queue_t)queue handler:(CURLEventHandler)handler
+{
+    // batches are delivered by hopping onto the queue, so there's nothing to deliver them to without one
+    if (!queue)
+    {
+        CURLMultiLogError(@"the poll backend needs a queue, so can't listen for a multi on an external event loop");
+        return NO;
+    }
+
+    dispatch_retain(queue);
+    _queue = queue;
+    _handler = [handler copy];
+
+#if __linux__
+    _poller = epoll_create1(EPOLL_CLOEXEC);
+    _timerDescriptor = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    BOOL hasTimer = (_timerDescriptor >= 0);
+#else
+    _poller = kqueue();
+    BOOL hasTimer = YES;    // kqueue has timers built in
+#endif
+
+    // without any of these, no event would ever be delivered
+    if ((_poller < 0) || !hasTimer || (pipe(_wakeup) != 0))
+    {
+        CURLMultiLogError(@"couldn't set up event backend: %s", strerror(errno));
+        [self closeDescriptors];
+        return NO;
+    }
+
+    [self watchDescriptor:_wakeup[0] reading:YES writing:NO previous:0];
+#if __linux__
+    [self watchDescriptor:_timerDescriptor reading:YES writing:NO previous:0];
+#endif
+
+    [NSThread detachNewThreadSelector:@selector(runPollLoop) toTarget:self withObject:nil];
+    return YES;
+}
+
+- (void)watchSocket:(curl_socket_t)socket reading:(BOOL)reading writing:(BOOL)writing
+{
+    uintptr_t previous = (uintptr_t)CFDictionaryGetValue(_interest, (const void*)(intptr_t)socket);
+    uintptr_t mask = (reading ? kWatchRead : 0) | (writing ? kWatchWrite : 0);
+    if (mask == previous) return;
+
+    if (mask)
+    {
+        CFDictionarySetValue(_interest, (const void*)(intptr_t)socket, (const void*)mask);
+    }
+    else
+    {
+        CFDictionaryRemoveValue(_interest, (const void*)(intptr_t)socket);
+    }
+
+    if (_poller >= 0)
+    {
+        [self watchDescriptor:socket reading:reading writing:writing previous:previous];
+    }
+}
+
+- (void)setTimeout:(long)timeout_ms
+{
+    if (_poller < 0) return;
+
+    _timerArmed = (timeout_ms >= 0);
+
+#if __linux__
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    if (timeout_ms >= 0)
+    {
+        spec.it_value.tv_sec = timeout_ms / 1000;
+        spec.it_value.tv_nsec = (timeout_ms % 1000) * NSEC_PER_MSEC;
+        if (timeout_ms == 0)
+        {
+            spec.it_value.tv_nsec = 1; // an all-zero value would disarm the timer
+        }
+    }
+    timerfd_settime(_timerDescriptor, 0, &spec, NULL);
+#else
+    struct kevent change;
+    if (timeout_ms >= 0)
+    {
+        // adding a timer that already exists just resets it
+        EV_SET(&change, kTimerIdent, EVFILT_TIMER, EV_ADD | EV_ONESHOT, 0, timeout_ms, NULL);
+    }
+    else
+    {
+        EV_SET(&change, kTimerIdent, EVFILT_TIMER, EV_DELETE, 0, 0, NULL);
+    }
+    kevent(_poller, &change, 1, NULL, 0, NULL); // deleting a timer which has already fired fails harmlessly
+#endif
+}
+
+- (void)stop
+{
+    if (_stopped) return;
+
+    // the thread may be blocked waiting, or waiting for the queue so it can deliver a batch;
+    // either way it'll see that we've stopped, and exit without calling the handler
+    @synchronized(self)
+    {
+        _stopped = YES;
+    }
+
+    if (_wakeup[1] >= 0)
+    {
+        char byte = 0;
+        write(_wakeup[1], &byte, 1);
+    }
+
+    [_handler release]; _handler = nil;
+}
+
+#pragma mark - Kernel Interface
+
+- (void)watchDescriptor:(int)descriptor reading:(BOOL)reading writing:(BOOL)writing previous:(uintptr_t)previous
+{
+#if __linux__
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = (reading ? EPOLLIN : 0) | (writing ? EPOLLOUT : 0);
+    event.data.fd = descriptor;
+
+    if (!reading && !writing)
+    {
+        epoll_ctl(_poller, EPOLL_CTL_DEL, descriptor, &event); // fails harmlessly if libcurl has already closed the socket
+    }
+    else if (previous)
+    {
+        epoll_ctl(_poller, EPOLL_CTL_MOD, descriptor, &event);
+    }
+    else if ((epoll_ctl(_poller, EPOLL_CTL_ADD, descriptor, &event) != 0) && (errno == EEXIST))
+    {
+        epoll_ctl(_poller, EPOLL_CTL_MOD, descriptor, &event);
+    }
+#else
+    // one change at a time, because a failure part way through a list stops the rest being applied,
+    // and deleting the filters of a socket that libcurl has already closed does fail
+    struct kevent change;
+    if (reading != ((previous & kWatchRead) != 0))
+    {
+        EV_SET(&change, descriptor, EVFILT_READ, reading ? EV_ADD : EV_DELETE, 0, 0, NULL);
+        kevent(_poller, &change, 1, NULL, 0, NULL);
+    }
+
+    if (writing != ((previous & kWatchWrite) != 0))
+    {
+        EV_SET(&change, descriptor, EVFILT_WRITE, writing ? EV_ADD : EV_DELETE, 0, 0, NULL);
+        kevent(_poller, &change, 1, NULL, 0, NULL);
+    }
+#endif
+}
+
+/**
+ Block until something is ready, and fill in the batch.
+
+ @return The number of events in the batch, or kWaitStopped if the backend has been stopped.
+ */
+
+- (NSUInteger)waitForEvents:(CURLPollEvent*)batch
+{
+    NSUInteger result = 0;
+
+#if __linux__
+    struct epoll_event events[kMaxEventsPerWait];
+    int count = epoll_wait(_poller, events, kMaxEventsPerWait, -1);
+#else
+    struct kevent events[kMaxEventsPerWait];
+    int count = kevent(_poller, NULL, 0, events, kMaxEventsPerWait, NULL);
+#endif
+
+    if (count < 0)
+    {
+        if (errno == EINTR) return 0;
+
+        CURLMultiLogError(@"event backend wait failed: %s", strerror(errno));
+        return kWaitStopped;
+    }
+
+    for (int n = 0; n < count; ++n)
+    {
+#if __linux__
+        int descriptor = events[n].data.fd;
+        uint32_t flags = events[n].events;
+        if (descriptor == _wakeup[0])
+        {
+            return kWaitStopped;
+        }
+        else if (descriptor == _timerDescriptor)
+        {
+            uint64_t expirations;
+            read(_timerDescriptor, &expirations, sizeof(expirations));
+            batch[result++] = (CURLPollEvent){ CURL_SOCKET_TIMEOUT, 0 };
+        }
+        else
+        {
+            // errors and hangups are reported as readiness, so that libcurl finds out about them when it tries the socket
+            if (flags & (EPOLLIN | EPOLLHUP | EPOLLERR))
+            {
+                batch[result++] = (CURLPollEvent){ descriptor, CURL_CSELECT_IN };
+            }
+
+            if (flags & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+            {
+                batch[result++] = (CURLPollEvent){ descriptor, CURL_CSELECT_OUT };
+            }
+        }
+#else
+        if (events[n].filter == EVFILT_TIMER)
+        {
+            batch[result++] = (CURLPollEvent){ CURL_SOCKET_TIMEOUT, 0 };
+        }
+        else if ((int)events[n].ident == _wakeup[0])
+        {
+            return kWaitStopped;
+        }
+        else if (!(events[n].flags & EV_ERROR))
+        {
+            batch[result++] = (CURLPollEvent){ (curl_socket_t)events[n].ident, (events[n].filter == EVFILT_READ) ? CURL_CSELECT_IN : CURL_CSELECT_OUT };
+        }
+#endif
+    }
+
+    return result;
+}
+
+#pragma mark - Thread
+
+- (BOOL)isStopped
+{
+    @synchronized(self)
+    {
+        return _stopped;
+    }
+}
+
+- (void)runPollLoop
+{
+    [[NSThread currentThread] setName:@"com.karelia.CURLPollEventBackend"];
+
+    // epoll can report a socket as both readable and writable in one event, which becomes two of ours
+    CURLPollEvent* batch = malloc(sizeof(CURLPollEvent) * kMaxEventsPerWait * 2);
+
+    while (![self isStopped])
+    {
+        @autoreleasepool
+        {
+            NSUInteger count = [self waitForEvents:batch];
+            if (count == kWaitStopped)
+            {
+                break;
+            }
+
+            if (count)
+            {
+                self.wakeups = self.wakeups + 1;
+
+                // waiting for the batch to be handled means the same level-triggered readiness isn't reported twice
+                dispatch_sync(_queue, ^{
+                    [self deliverEvents:batch count:count];
+                });
+            }
+        }
+    }
+
+    free(batch);
+}
+
+- (void)deliverEvents:(const CURLPollEvent*)batch count:(NSUInteger)count
+{
+    for (NSUInteger n = 0; (n < count) && !_stopped; ++n)
+    {
+        CURLPollEvent event = batch[n];
+        if (event.socket == CURL_SOCKET_TIMEOUT)
+        {
+            if (_timerArmed)
+            {
+                _timerArmed = NO;
+                _handler(CURL_SOCKET_TIMEOUT, 0);
+            }
+        }
+        else
+        {
+            // an earlier event in the batch may have led to the socket being closed, or no longer watched this way
+            uintptr_t mask = (uintptr_t)CFDictionaryGetValue(_interest, (const void*)(intptr_t)event.socket);
+            if (mask & ((event.action == CURL_CSELECT_IN) ? kWatchRead : kWatchWrite))
+            {
+                _handler(event.socket, event.action);
+            }
+        }
+    }
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"<POLL BACKEND %p, %ld sockets, %lu wakeups>", self, (long)CFDictionaryGetCount(_interest), (unsigned long)self.wakeups];
+}
+
+@end
@@ -0,0 +1,58 @@
+//
+//  CURLRecordBatch.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ Some records from a response body that's been split up at a delimiter (see curl_recordDelimiter).
+
+ A batch holds on to the pieces of the body the records came from, rather than copying each record out, so the
+ bytes of a record stay valid for as long as the batch does. Only a record that spans two or more pieces of the
+ body gets copied, into a buffer of its own.
+
+ Records don't include their delimiter. With a delimiter of `\n`, a `\r` before it isn't included either.
+ */
+
+@interface CURLRecordBatch : NSObject
+{
+    NSArray     *_buffers;
+    void        *_ranges;
+    NSUInteger  _count;
+}
+
+/** How many records there are. */
+@property (readonly, nonatomic) NSUInteger count;
+
+/**
+ The bytes of a record, without copying them.
+
+ @param index The record's index, less than count.
+ @param length Set to the record's length.
+ @return The record's first byte, which is valid for as long as the batch is.
+ */
+
+- (const void *)bytesOfRecordAtIndex:(NSUInteger)index length:(NSUInteger *)length;
+
+/**
+ A copy of a record, for keeping after the batch has gone.
+
+ @param index The record's index, less than count.
+ @return The record's bytes.
+ */
+
+- (NSData *)recordAtIndex:(NSUInteger)index;
+
+/**
+ Go through the records in order, without copying them.
+
+ @param block Given each record's bytes, which are valid for as long as the batch is, and its length. Set `stop` to YES to go no further.
+ */
+
+- (void)enumerateRecordsUsingBlock:(void (^)(const void *bytes, NSUInteger length, BOOL *stop))block;
+
+@end
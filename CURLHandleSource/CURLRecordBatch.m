@@ -0,0 +1,73 @@
+//
+//  CURLRecordBatch.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLRecordBatch.h"
+
+#import "CURLRecordSplitter.h"
+
+@implementation CURLRecordBatch
+
+@synthesize count = _count;
+
+- (id)initWithBuffers:(NSArray *)buffers ranges:(CURLRecordRange *)ranges count:(NSUInteger)count;
+{
+    if ((self = [super init]) != nil)
+    {
+        _buffers = [buffers copy];
+        _ranges = ranges;
+        _count = count;
+    }
+    else
+    {
+        free(ranges);
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_buffers release];
+    free(_ranges);
+
+    [super dealloc];
+}
+
+- (const void *)bytesOfRecordAtIndex:(NSUInteger)index length:(NSUInteger *)length;
+{
+    NSParameterAssert(index < _count);
+
+    CURLRecordRange range = ((CURLRecordRange *)_ranges)[index];
+    if (length) *length = range.length;
+    return (const uint8_t *)[[_buffers objectAtIndex:range.buffer] bytes] + range.location;
+}
+
+- (NSData *)recordAtIndex:(NSUInteger)index;
+{
+    NSUInteger length;
+    const void *bytes = [self bytesOfRecordAtIndex:index length:&length];
+    return [NSData dataWithBytes:bytes length:length];
+}
+
+- (void)enumerateRecordsUsingBlock:(void (^)(const void *bytes, NSUInteger length, BOOL *stop))block;
+{
+    BOOL stop = NO;
+    for (NSUInteger index = 0; index < _count && !stop; ++index)
+    {
+        NSUInteger length;
+        const void *bytes = [self bytesOfRecordAtIndex:index length:&length];
+        block(bytes, length, &stop);
+    }
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@ %p: %lu records>", [self class], self, (unsigned long)_count];
+}
+
+@end
@@ -0,0 +1,67 @@
+//
+//  CURLRecordSplitter.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "CURLRecordBatch.h"
+
+/**
+ * Internal helper which splits a response body into records, as it arrives.
+ * CURLTransfer uses this internally, when the request has a curl_recordDelimiter - not intended for public consumption.
+ *
+ * Each piece of the body is scanned with memchr(), which libc vectorises, and the records it ends are handed back as
+ * ranges of that piece. A record left unfinished at the end of a piece is kept until the delimiter turns up, and
+ * only its own bytes are copied. Not thread safe; the pieces of a body have to come in order anyway.
+ */
+
+@interface CURLRecordSplitter : NSObject
+{
+    uint8_t         _delimiter;
+    NSMutableData   *_partialRecord;    // the start of a record that hasn't ended yet
+}
+
+- (id)initWithDelimiter:(uint8_t)delimiter;
+
+/**
+ * Split up the next piece of the body.
+ *
+ * @param data The piece, which the batch holds on to rather than copying.
+ * @return The records it finishes, or nil if it doesn't finish any.
+ */
+
+- (CURLRecordBatch *)batchBySplittingData:(NSData *)data;
+
+/**
+ * @return The last record, if the body didn't end with a delimiter, or nil.
+ */
+
+- (CURLRecordBatch *)finish;
+
+@end
+
+/**
+ * Where a record is, within a batch.
+ */
+
+typedef struct {
+    NSUInteger  buffer;     // index into the batch's buffers
+    NSUInteger  location;
+    NSUInteger  length;
+} CURLRecordRange;
+
+@interface CURLRecordBatch (CURLRecordSplitter)
+
+/**
+ * @param buffers The pieces of body the records are in.
+ * @param ranges A malloc()ed array of the records, which the batch takes over.
+ * @param count How many records there are.
+ */
+
+- (id)initWithBuffers:(NSArray *)buffers ranges:(CURLRecordRange *)ranges count:(NSUInteger)count;
+
+@end
@@ -0,0 +1,121 @@
+//
+//  CURLRecordSplitter.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLRecordSplitter.h"
+
+@implementation CURLRecordSplitter
+
+- (id)initWithDelimiter:(uint8_t)delimiter;
+{
+    if ((self = [super init]) != nil)
+    {
+        _delimiter = delimiter;
+        _partialRecord = [[NSMutableData alloc] init];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_partialRecord release];
+
+    [super dealloc];
+}
+
+#pragma mark Splitting
+
+// Records split at newlines lose a carriage return too, so CRLF text comes out the same as LF
+- (NSUInteger)lengthOfRecordAt:(const uint8_t *)bytes length:(NSUInteger)length;
+{
+    if (_delimiter == '\n' && length && bytes[length - 1] == '\r') --length;
+    return length;
+}
+
+- (void)addRange:(CURLRecordRange)range to:(CURLRecordRange **)ranges count:(NSUInteger *)count capacity:(NSUInteger *)capacity;
+{
+    if (*count == *capacity)
+    {
+        *capacity = (*capacity ? *capacity * 2 : 16);
+        *ranges = reallocf(*ranges, *capacity * sizeof(CURLRecordRange));
+        NSAssert(*ranges, @"out of memory");
+    }
+
+    (*ranges)[(*count)++] = range;
+}
+
+- (CURLRecordBatch *)batchBySplittingData:(NSData *)data;
+{
+    const uint8_t *bytes = [data bytes];
+    NSUInteger length = [data length];
+
+    const uint8_t *end = memchr(bytes, _delimiter, length);
+    if (!end)
+    {
+        [_partialRecord appendBytes:bytes length:length];
+        return nil;
+    }
+
+    NSMutableArray *buffers = [NSMutableArray arrayWithCapacity:2];
+    CURLRecordRange *ranges = NULL;
+    NSUInteger count = 0;
+    NSUInteger capacity = 0;
+
+    // the record carried over from earlier pieces is finished off in a buffer of its own
+    if ([_partialRecord length])
+    {
+        [_partialRecord appendBytes:bytes length:(end - bytes)];
+
+        CURLRecordRange range = { [buffers count], 0, [self lengthOfRecordAt:[_partialRecord bytes] length:[_partialRecord length]] };
+        [self addRange:range to:&ranges count:&count capacity:&capacity];
+        [buffers addObject:_partialRecord];
+
+        [_partialRecord release];
+        _partialRecord = [[NSMutableData alloc] init];
+    }
+    else
+    {
+        CURLRecordRange range = { 0, 0, [self lengthOfRecordAt:bytes length:(end - bytes)] };
+        [self addRange:range to:&ranges count:&count capacity:&capacity];
+    }
+
+    // the rest are ranges of the piece itself
+    NSUInteger dataIndex = [buffers count];
+    [buffers addObject:data];
+
+    const uint8_t *start = end + 1;
+    const uint8_t *limit = bytes + length;
+    while (start < limit && (end = memchr(start, _delimiter, limit - start)))
+    {
+        CURLRecordRange range = { dataIndex, start - bytes, [self lengthOfRecordAt:start length:(end - start)] };
+        [self addRange:range to:&ranges count:&count capacity:&capacity];
+        start = end + 1;
+    }
+
+    if (start < limit) [_partialRecord appendBytes:start length:(limit - start)];
+
+    CURLRecordBatch *batch = [[CURLRecordBatch alloc] initWithBuffers:buffers ranges:ranges count:count];
+    return [batch autorelease];
+}
+
+- (CURLRecordBatch *)finish;
+{
+    if (![_partialRecord length]) return nil;
+
+    CURLRecordRange *ranges = malloc(sizeof(CURLRecordRange));
+    NSAssert(ranges, @"out of memory");
+    ranges[0] = (CURLRecordRange){ 0, 0, [self lengthOfRecordAt:[_partialRecord bytes] length:[_partialRecord length]] };
+
+    CURLRecordBatch *batch = [[CURLRecordBatch alloc] initWithBuffers:@[ _partialRecord ] ranges:ranges count:1];
+    [_partialRecord release];
+    _partialRecord = [[NSMutableData alloc] init];
+
+    return [batch autorelease];
+}
+
+@end
@@ -8,6 +8,10 @@
 #import <Foundation/Foundation.h>
 #import <curl/curl.h>
 
+#import "CURLDigest.h"
+
+@class CURLRetryPolicy;
+
 @interface NSURLRequest (CURLOptionsFTP)
 
 // CURLUSESSL_NONE, CURLUSESSL_TRY, CURLUSESSL_CONTROL, or CURLUSESSL_ALL
@@ -57,7 +61,208 @@
 
 @end
 
+@interface NSURLRequest (CURLOptionsConnection)
+
+// YES to make a new connection for the request, rather than re-using one that's already open (CURLOPT_FRESH_CONNECT)
+// Default is NO
+@property(nonatomic, readonly) BOOL curl_forcesFreshConnection;
+
+/**
+ A numeric IPv4 or IPv6 address to connect to, in place of whatever the URL's host resolves to.
+
+ The host name is still used for everything else (the Host header, and TLS certificate checks), so this is
+ a way to reach one particular server behind a name. The address is only used when it's of the same family
+ as the one the host resolved to; otherwise the connection goes to the resolved address as normal.
+
+ Default is `nil`.
+ */
+@property(nonatomic, copy, readonly) NSString *curl_connectAddress;
+
+@end
+
+@interface NSMutableURLRequest (CURLOptionsConnection)
+
+- (void)curl_setForcesFreshConnection:(BOOL)fresh;
+- (void)curl_setConnectAddress:(NSString *)address;
+
+@end
+
+@interface NSURLRequest (CURLOptionsRetry)
+
+/**
+ How to retry the request if it fails. See CURLRetryPolicy for details.
+
+ Default is `nil`, which means failures are reported straight away.
+ */
+@property(nonatomic, readonly) CURLRetryPolicy *curl_retryPolicy;
+
+/**
+ YES for a retry to carry on from where an interrupted transfer got to, rather than starting again from the beginning.
+
+ Normally a failure is final once the delegate has seen the response. With this on, a download that's cut off is
+ retried with CURLOPT_RESUME_FROM_LARGE set to the amount the delegate already has, and the delegate is just sent
+ the rest of the body. HTTP downloads need a strong ETag or a Last-Modified date to send as If-Range, and can't
+ resume a response with a Content-Encoding; FTP and SFTP downloads check the file's modification time (MDTM) and
+ size haven't changed. If the file has changed, the transfer fails with CURLE_RANGE_ERROR or CURLE_BAD_DOWNLOAD_RESUME
+ rather than mixing two versions.
+
+ FTP and SFTP uploads that had started sending are retried from however much the server ended up with.
+
+ Only has an effect along with a curl_retryPolicy. Default is `NO`.
+ */
+@property(nonatomic, readonly) BOOL curl_resumesInterruptedTransfers;
+
+@end
+
+@interface NSMutableURLRequest (CURLOptionsRetry)
+
+- (void)curl_setRetryPolicy:(CURLRetryPolicy *)policy;
+- (void)curl_setResumesInterruptedTransfers:(BOOL)resumes;
+
+@end
+
+/**
+ Timeouts for the request, on top of its `timeoutInterval`.
+
+ Each value left at zero falls back to the one set on the CURLMultiHandle running the transfer, and failing
+ that to the request's `timeoutInterval` - which is used as the connect timeout, and as the stall window
+ below one byte per second, much as NSURLConnection treats it as the longest time to go without any data.
+ A negative value turns that timeout off altogether.
+
+ Whichever timeout expires, the transfer fails with `NSURLErrorTimedOut`.
+ */
+
+@interface NSURLRequest (CURLOptionsTimeouts)
+
+// The longest to spend making the connection, including any name lookup and TLS handshake (CURLOPT_CONNECTTIMEOUT_MS)
+@property(nonatomic, readonly) NSTimeInterval curl_connectTimeout;
+
+// The longest the whole transfer may take, however much data is moving (CURLOPT_TIMEOUT_MS)
+// There's no total deadline by default
+@property(nonatomic, readonly) NSTimeInterval curl_totalTimeout;
+
+// The transfer fails if it runs slower than curl_minimumBytesPerSecond for curl_stallTimeout seconds
+// (CURLOPT_LOW_SPEED_TIME and CURLOPT_LOW_SPEED_LIMIT); the window is rounded up to whole seconds
+@property(nonatomic, readonly) NSTimeInterval curl_stallTimeout;
+@property(nonatomic, readonly) NSUInteger curl_minimumBytesPerSecond;
+
+@end
+
+@interface NSMutableURLRequest (CURLOptionsTimeouts)
+
+- (void)curl_setConnectTimeout:(NSTimeInterval)timeout;
+- (void)curl_setTotalTimeout:(NSTimeInterval)timeout;
+- (void)curl_setStallTimeout:(NSTimeInterval)timeout minimumBytesPerSecond:(NSUInteger)bytesPerSecond;
+
+@end
+
+/**
+ Checking the bodies of the request and response as they go by, rather than reading them back afterwards.
+
+ With an algorithm set, the transfer works out the digest of everything it receives and sends, and makes them
+ available as its downloadDigest and uploadDigest once it completes. With an expected digest as well, a body that
+ doesn't match fails the transfer with CURLDigestErrorMismatch. When the length of the response body is known, that
+ happens before its last piece is passed on, so that anything waiting on the transfer's success (FTP post-transfer
+ commands, say, or the HTTP cache) never sees it; an upload is stopped before its last piece is sent.
+
+ Default is CURLDigestAlgorithmNone, and no expected digests.
+ */
+
+@interface NSURLRequest (CURLOptionsIntegrity)
+
+@property(nonatomic, readonly) CURLDigestAlgorithm curl_digestAlgorithm;
+@property(nonatomic, copy, readonly) NSData *curl_expectedDownloadDigest;
+@property(nonatomic, copy, readonly) NSData *curl_expectedUploadDigest;
+
+@end
+
+@interface NSMutableURLRequest (CURLOptionsIntegrity)
+
+- (void)curl_setDigestAlgorithm:(CURLDigestAlgorithm)algorithm;
+- (void)curl_setExpectedDownloadDigest:(NSData *)digest;
+- (void)curl_setExpectedUploadDigest:(NSData *)digest;
+
+@end
+
+@interface NSURLRequest (CURLOptionsDecoding)
+
+/**
+ YES to decode a compressed response body away from the multi's queue.
+
+ Normally an Accept-Encoding header becomes CURLOPT_ENCODING, and libcurl inflates the body as it arrives, on the
+ same queue that runs every other transfer's socket I/O; one big compressed download holds them all up. With this
+ on, the body is received as the server sent it, and a gzip or deflate body is decoded in the background, the
+ pieces of each transfer's body going to the delegate in order as before. An empty Accept-Encoding asks for gzip
+ and deflate. Any other Content-Encoding is passed on as it is, and a body that fails to decode fails the transfer
+ with CURLE_BAD_CONTENT_ENCODING.
+
+ Only has an effect for transfers with a delegate queue; one run by an external event loop with no queue, or
+ synchronously, leaves decoding to libcurl. Default is `NO`.
+ */
+@property(nonatomic, readonly) BOOL curl_decodesContentInBackground;
+
+@end
+
+@interface NSMutableURLRequest (CURLOptionsDecoding)
+
+- (void)curl_setDecodesContentInBackground:(BOOL)decodes;
+
+@end
+
+/**
+ Compressing the request body on the way out, for HTTP uploads.
+
+ With an encoding set, the body is compressed in the background, a little ahead of libcurl asking for it, and sent
+ with chunked transfer encoding and a Content-Encoding header; its compressed length isn't known up front. The
+ multi's queue never waits for the compression: if libcurl asks for more before it's ready, the transfer pauses until
+ it is. (Synchronous transfers, and multis driven by an external event loop, do wait.) A body the request has already encoded (it has a Content-Encoding header of its own), or an `HTTPBody` shorter
+ than the minimum length, is sent as it is. So is an `HTTPBodyStream` whose Content-Length header says it's too short;
+ any other stream is compressed.
+
+ The transfer's uploadDigest, and any curl_expectedUploadDigest, are of the body as sent, compressed.
+
+ Default is no encoding, at zlib's default level (-1, which is 6), with no minimum length.
+ */
+
+@interface NSURLRequest (CURLOptionsUploadCompression)
+
+// `gzip` or `deflate`, or nil to send the body as it is
+@property(nonatomic, copy, readonly) NSString *curl_uploadContentEncoding;
+
+// 1 (fastest) to 9 (smallest), or -1 for zlib's default
+@property(nonatomic, readonly) NSInteger curl_uploadCompressionLevel;
+
+@property(nonatomic, readonly) unsigned long long curl_minimumCompressedUploadLength;
+
+@end
+
+@interface NSMutableURLRequest (CURLOptionsUploadCompression)
 
+- (void)curl_setUploadContentEncoding:(NSString *)encoding level:(NSInteger)level minimumLength:(unsigned long long)length;
 
+@end
+
+/**
+ Splitting a line-delimited response body, such as NDJSON or CSV, into records as it arrives.
+
+ With a delimiter set, and a delegate that implements transfer:didReceiveRecords:, the body is split up on the multi's
+ queue (or the decoder's, when curl_decodesContentInBackground applies) and the delegate is sent batches of whole
+ records instead of transfer:didReceiveData:. Each batch points into the pieces of the body as they were received;
+ only a record that spans pieces is copied. A last record without a delimiter after it comes just before the transfer
+ completes successfully. Delegates that don't implement the method get the body in pieces as usual.
+
+ Default is -1, for no splitting.
+ */
 
+@interface NSURLRequest (CURLOptionsRecords)
 
+// the byte, 0 to 255, that ends each record, or -1
+@property(nonatomic, readonly) NSInteger curl_recordDelimiter;
+
+@end
+
+@interface NSMutableURLRequest (CURLOptionsRecords)
+
+- (void)curl_setRecordDelimiter:(NSInteger)delimiter;
+
+@end
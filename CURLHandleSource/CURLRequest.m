@@ -123,3 +123,215 @@
 
 @end
 
+@implementation NSURLRequest (CURLOptionsConnection)
+
+- (BOOL)curl_forcesFreshConnection;
+{
+    return [[NSURLProtocol propertyForKey:@"curl_forcesFreshConnection" inRequest:self] boolValue];
+}
+
+- (NSString *)curl_connectAddress; { return [NSURLProtocol propertyForKey:@"curl_connectAddress" inRequest:self]; }
+
+@end
+
+@implementation NSMutableURLRequest (CURLOptionsConnection)
+
+- (void)curl_setForcesFreshConnection:(BOOL)fresh;
+{
+    [NSURLProtocol setProperty:@(fresh) forKey:@"curl_forcesFreshConnection" inRequest:self];
+}
+
+- (void)curl_setConnectAddress:(NSString *)address;
+{
+    if (address)
+    {
+        address = [address copy];
+        [NSURLProtocol setProperty:address forKey:@"curl_connectAddress" inRequest:self];
+        [address release];
+    }
+    else
+    {
+        [NSURLProtocol removePropertyForKey:@"curl_connectAddress" inRequest:self];
+    }
+}
+
+@end
+
+@implementation NSURLRequest (CURLOptionsRetry)
+
+- (CURLRetryPolicy *)curl_retryPolicy; { return [NSURLProtocol propertyForKey:@"curl_retryPolicy" inRequest:self]; }
+
+- (BOOL)curl_resumesInterruptedTransfers;
+{
+    return [[NSURLProtocol propertyForKey:@"curl_resumesInterruptedTransfers" inRequest:self] boolValue];
+}
+
+@end
+
+@implementation NSMutableURLRequest (CURLOptionsRetry)
+
+- (void)curl_setRetryPolicy:(CURLRetryPolicy *)policy;
+{
+    if (policy)
+    {
+        [NSURLProtocol setProperty:policy forKey:@"curl_retryPolicy" inRequest:self];
+    }
+    else
+    {
+        [NSURLProtocol removePropertyForKey:@"curl_retryPolicy" inRequest:self];
+    }
+}
+
+- (void)curl_setResumesInterruptedTransfers:(BOOL)resumes;
+{
+    [NSURLProtocol setProperty:@(resumes) forKey:@"curl_resumesInterruptedTransfers" inRequest:self];
+}
+
+@end
+
+@implementation NSURLRequest (CURLOptionsTimeouts)
+
+- (NSTimeInterval)curl_connectTimeout; { return [[NSURLProtocol propertyForKey:@"curl_connectTimeout" inRequest:self] doubleValue]; }
+- (NSTimeInterval)curl_totalTimeout; { return [[NSURLProtocol propertyForKey:@"curl_totalTimeout" inRequest:self] doubleValue]; }
+- (NSTimeInterval)curl_stallTimeout; { return [[NSURLProtocol propertyForKey:@"curl_stallTimeout" inRequest:self] doubleValue]; }
+- (NSUInteger)curl_minimumBytesPerSecond; { return [[NSURLProtocol propertyForKey:@"curl_minimumBytesPerSecond" inRequest:self] unsignedIntegerValue]; }
+
+@end
+
+@implementation NSMutableURLRequest (CURLOptionsTimeouts)
+
+- (void)curl_setConnectTimeout:(NSTimeInterval)timeout;
+{
+    [NSURLProtocol setProperty:@(timeout) forKey:@"curl_connectTimeout" inRequest:self];
+}
+
+- (void)curl_setTotalTimeout:(NSTimeInterval)timeout;
+{
+    [NSURLProtocol setProperty:@(timeout) forKey:@"curl_totalTimeout" inRequest:self];
+}
+
+- (void)curl_setStallTimeout:(NSTimeInterval)timeout minimumBytesPerSecond:(NSUInteger)bytesPerSecond;
+{
+    [NSURLProtocol setProperty:@(timeout) forKey:@"curl_stallTimeout" inRequest:self];
+    [NSURLProtocol setProperty:@(bytesPerSecond) forKey:@"curl_minimumBytesPerSecond" inRequest:self];
+}
+
+@end
+
+@implementation NSURLRequest (CURLOptionsIntegrity)
+
+- (CURLDigestAlgorithm)curl_digestAlgorithm; { return [[NSURLProtocol propertyForKey:@"curl_digestAlgorithm" inRequest:self] integerValue]; }
+- (NSData *)curl_expectedDownloadDigest; { return [NSURLProtocol propertyForKey:@"curl_expectedDownloadDigest" inRequest:self]; }
+- (NSData *)curl_expectedUploadDigest; { return [NSURLProtocol propertyForKey:@"curl_expectedUploadDigest" inRequest:self]; }
+
+@end
+
+@implementation NSMutableURLRequest (CURLOptionsIntegrity)
+
+- (void)curl_setDigestAlgorithm:(CURLDigestAlgorithm)algorithm;
+{
+    [NSURLProtocol setProperty:@(algorithm) forKey:@"curl_digestAlgorithm" inRequest:self];
+}
+
+- (void)curl_setExpectedDownloadDigest:(NSData *)digest;
+{
+    if (digest)
+    {
+        digest = [digest copy];
+        [NSURLProtocol setProperty:digest forKey:@"curl_expectedDownloadDigest" inRequest:self];
+        [digest release];
+    }
+    else
+    {
+        [NSURLProtocol removePropertyForKey:@"curl_expectedDownloadDigest" inRequest:self];
+    }
+}
+
+- (void)curl_setExpectedUploadDigest:(NSData *)digest;
+{
+    if (digest)
+    {
+        digest = [digest copy];
+        [NSURLProtocol setProperty:digest forKey:@"curl_expectedUploadDigest" inRequest:self];
+        [digest release];
+    }
+    else
+    {
+        [NSURLProtocol removePropertyForKey:@"curl_expectedUploadDigest" inRequest:self];
+    }
+}
+
+@end
+
+@implementation NSURLRequest (CURLOptionsDecoding)
+
+- (BOOL)curl_decodesContentInBackground;
+{
+    return [[NSURLProtocol propertyForKey:@"curl_decodesContentInBackground" inRequest:self] boolValue];
+}
+
+@end
+
+@implementation NSMutableURLRequest (CURLOptionsDecoding)
+
+- (void)curl_setDecodesContentInBackground:(BOOL)decodes;
+{
+    [NSURLProtocol setProperty:@(decodes) forKey:@"curl_decodesContentInBackground" inRequest:self];
+}
+
+@end
+
+@implementation NSURLRequest (CURLOptionsUploadCompression)
+
+- (NSString *)curl_uploadContentEncoding; { return [NSURLProtocol propertyForKey:@"curl_uploadContentEncoding" inRequest:self]; }
+
+- (NSInteger)curl_uploadCompressionLevel;
+{
+    NSNumber *level = [NSURLProtocol propertyForKey:@"curl_uploadCompressionLevel" inRequest:self];
+    return (level ? [level integerValue] : -1);
+}
+
+- (unsigned long long)curl_minimumCompressedUploadLength; { return [[NSURLProtocol propertyForKey:@"curl_minimumCompressedUploadLength" inRequest:self] unsignedLongLongValue]; }
+
+@end
+
+@implementation NSMutableURLRequest (CURLOptionsUploadCompression)
+
+- (void)curl_setUploadContentEncoding:(NSString *)encoding level:(NSInteger)level minimumLength:(unsigned long long)length;
+{
+    if (encoding)
+    {
+        encoding = [encoding copy];
+        [NSURLProtocol setProperty:encoding forKey:@"curl_uploadContentEncoding" inRequest:self];
+        [encoding release];
+    }
+    else
+    {
+        [NSURLProtocol removePropertyForKey:@"curl_uploadContentEncoding" inRequest:self];
+    }
+
+    [NSURLProtocol setProperty:@(level) forKey:@"curl_uploadCompressionLevel" inRequest:self];
+    [NSURLProtocol setProperty:@(length) forKey:@"curl_minimumCompressedUploadLength" inRequest:self];
+}
+
+@end
+
+@implementation NSURLRequest (CURLOptionsRecords)
+
+- (NSInteger)curl_recordDelimiter;
+{
+    NSNumber *delimiter = [NSURLProtocol propertyForKey:@"curl_recordDelimiter" inRequest:self];
+    return (delimiter ? [delimiter integerValue] : -1);
+}
+
+@end
+
+@implementation NSMutableURLRequest (CURLOptionsRecords)
+
+- (void)curl_setRecordDelimiter:(NSInteger)delimiter;
+{
+    NSParameterAssert(delimiter >= -1 && delimiter <= UINT8_MAX);
+    [NSURLProtocol setProperty:@(delimiter) forKey:@"curl_recordDelimiter" inRequest:self];
+}
+
+@end
@@ -0,0 +1,40 @@
+//
+//  CURLResponseReader+TransferSupport.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLResponseReader.h"
+
+/**
+ Private API used by CURLTransfer, to fill a reader's buffer straight from libcurl.
+ Not exported in the framework, and not recommended for general use.
+ */
+
+@interface CURLResponseReader (TransferSupport)
+
+/**
+ Checks there's room for the next piece of the body. If not, the transfer should pause; resumeHandler is
+ called once there is.
+
+ @param length The length of the piece.
+ @return YES if writeBytes:length: can go ahead.
+ */
+
+- (BOOL)reserveSpaceForLength:(NSUInteger)length;
+
+/**
+ Adds a piece of the body, which reserveSpaceForLength: has made room for.
+
+ @param bytes The piece.
+ @param length Its length.
+ */
+
+- (void)writeBytes:(const void *)bytes length:(NSUInteger)length;
+
+/** Called, on the reading thread, when a paused transfer can carry on. */
+@property (copy) void (^resumeHandler)(void);
+
+@end
@@ -0,0 +1,88 @@
+//
+//  CURLResponseReader.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLTransfer.h"
+
+/**
+ Runs a transfer, and lets the response body be read from it at the reader's own pace, without a delegate.
+
+ The body goes into a ring buffer of a fixed size. When it's full the transfer pauses, and once reading has made
+ room again it carries on, so however big the body and however slow the reader, memory use stays the same. The
+ buffer is filled on the multi's queue, straight from libcurl; reading can happen on any one thread, and blocks
+ until there's something to read.
+
+ A compressed response is decoded by libcurl as it arrives (curl_decodesContentInBackground is ignored). A body
+ which doesn't come straight off the network - one answered from the HTTP cache, or shared with an identical request
+ that's already running - can't be paused, so whatever doesn't fit in the buffer is held on to until it's read.
+ */
+
+@interface CURLResponseReader : NSObject <CURLTransferDelegate>
+{
+    CURLTransfer        *_transfer;
+    NSCondition         *_condition;        // guards everything below
+    uint8_t             *_ring;
+    NSUInteger          _capacity;
+    NSUInteger          _start;             // where the next byte to read is
+    NSUInteger          _length;            // how much is in the ring
+    NSMutableArray      *_overflow;         // data which couldn't be paused for, waiting for the ring to empty
+    NSUInteger          _overflowOffset;    // how much of the first piece has been read
+    BOOL                _transferPaused;
+    NSUInteger          _pausedLength;      // how much room the paused transfer needs
+    void                (^_resumeHandler)(void);
+    NSURLResponse       *_response;
+    NSError             *_error;
+    BOOL                _finished;
+    BOOL                _closed;
+}
+
+/**
+ Starts the transfer straight away, on the shared multi.
+
+ @param request The request to send.
+ @param credential A credential to use for the request, or nil.
+ @param size How much of the body to buffer; it's at least CURL_MAX_WRITE_SIZE, libcurl's biggest piece of body.
+ @return A new reader.
+ */
+
+- (id)initWithRequest:(NSURLRequest *)request credential:(NSURLCredential *)credential bufferSize:(NSUInteger)size __attribute((nonnull(1)));
+
+/**
+ Waits for the response to arrive.
+
+ @return The response, or nil if the transfer failed (or the reader was closed) before there was one.
+ */
+
+- (NSURLResponse *)waitForResponse;
+
+/**
+ Reads some of the body, waiting until there's something to read.
+
+ @param buffer Where to put the bytes.
+ @param length The most to read.
+ @return How many bytes were read; 0 once the whole body has been read, or the reader has been closed; or -1 if the transfer failed, in which case see error.
+ */
+
+- (NSInteger)read:(uint8_t *)buffer maxLength:(NSUInteger)length;
+
+/**
+ Stops reading, cancelling the transfer if it hasn't finished. Any reads waiting return 0.
+ */
+
+- (void)close;
+
+@property (readonly, strong) CURLTransfer *transfer;
+
+/** The response, if it's arrived yet. */
+@property (readonly, strong) NSURLResponse *response;
+
+/** Why the transfer failed, once it has. */
+@property (readonly, strong) NSError *error;
+
+@property (readonly, nonatomic) NSUInteger bufferSize;
+
+@end
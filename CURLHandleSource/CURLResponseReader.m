@@ -0,0 +1,279 @@
+//
+//  CURLResponseReader.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLResponseReader.h"
+#import "CURLResponseReader+TransferSupport.h"
+
+@interface CURLResponseReader()
+
+- (void)resumeTransferIfRoom;
+- (void)copyBytesIntoRing:(const void *)bytes length:(NSUInteger)length;
+
+@end
+
+@implementation CURLResponseReader
+
+@synthesize transfer = _transfer;
+
+- (id)initWithRequest:(NSURLRequest *)request credential:(NSURLCredential *)credential bufferSize:(NSUInteger)size;
+{
+    if ((self = [super init]) != nil)
+    {
+        _capacity = MAX(size, (NSUInteger)CURL_MAX_WRITE_SIZE);
+        _ring = malloc(_capacity);
+        _condition = [[NSCondition alloc] init];
+        _overflow = [[NSMutableArray alloc] init];
+
+        // CURLTransfer spots that its delegate is a reader, and fills the ring itself
+        _transfer = [[CURLTransfer alloc] initWithRequest:request credential:credential delegate:self delegateQueue:nil];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_transfer release];
+    [_condition release];
+    free(_ring);
+    [_overflow release];
+    [_resumeHandler release];
+    [_response release];
+    [_error release];
+
+    [super dealloc];
+}
+
+#pragma mark - Reading
+
+- (NSURLResponse *)waitForResponse;
+{
+    [_condition lock];
+    while (!_response && !_finished && !_closed) [_condition wait];
+    NSURLResponse *response = [[_response retain] autorelease];
+    [_condition unlock];
+
+    return response;
+}
+
+- (NSInteger)read:(uint8_t *)buffer maxLength:(NSUInteger)length;
+{
+    [_condition lock];
+    while (!_length && ![_overflow count] && !_finished && !_closed) [_condition wait];
+
+    NSInteger result = 0;
+    if (_closed)
+    {
+        result = 0;
+    }
+    else if (_length)
+    {
+        // at most two copies, either side of the end of the ring
+        NSUInteger count = MIN(length, _length);
+        NSUInteger first = MIN(count, _capacity - _start);
+        memcpy(buffer, _ring + _start, first);
+        memcpy(buffer + first, _ring, count - first);
+
+        _start = (_start + count) % _capacity;
+        _length -= count;
+        if (!_length) _start = 0;
+        result = count;
+    }
+    else if ([_overflow count])
+    {
+        NSData *data = [_overflow objectAtIndex:0];
+        NSUInteger count = MIN(length, [data length] - _overflowOffset);
+        memcpy(buffer, (const uint8_t *)[data bytes] + _overflowOffset, count);
+
+        _overflowOffset += count;
+        if (_overflowOffset == [data length])
+        {
+            [_overflow removeObjectAtIndex:0];
+            _overflowOffset = 0;
+        }
+        result = count;
+    }
+    else if (_error)
+    {
+        result = -1;
+    }
+
+    [_condition unlock];
+
+    [self resumeTransferIfRoom];
+    return result;
+}
+
+- (void)close;
+{
+    [_condition lock];
+    BOOL finished = _finished;
+    _closed = YES;
+    [_resumeHandler release]; _resumeHandler = nil;
+    [_condition broadcast];
+    [_condition unlock];
+
+    if (!finished) [_transfer cancel];
+}
+
+// Once half the ring is free (or as much as the paused piece needs, if that's more), the transfer can carry on
+- (void)resumeTransferIfRoom;
+{
+    [_condition lock];
+    void (^resumeHandler)(void) = nil;
+    if (_transferPaused && _capacity - _length >= MAX(_capacity / 2, _pausedLength))
+    {
+        _transferPaused = NO;
+        resumeHandler = [_resumeHandler retain];
+    }
+    [_condition unlock];
+
+    if (resumeHandler)
+    {
+        resumeHandler();
+        [resumeHandler release];
+    }
+}
+
+#pragma mark - Properties
+
+- (NSURLResponse *)response;
+{
+    [_condition lock];
+    NSURLResponse *response = [[_response retain] autorelease];
+    [_condition unlock];
+
+    return response;
+}
+
+- (NSError *)error;
+{
+    [_condition lock];
+    NSError *error = [[_error retain] autorelease];
+    [_condition unlock];
+
+    return error;
+}
+
+- (NSUInteger)bufferSize;
+{
+    return _capacity;
+}
+
+#pragma mark - Transfer Support
+
+- (BOOL)reserveSpaceForLength:(NSUInteger)length;
+{
+    [_condition lock];
+
+    // libcurl shouldn't hand over more than CURL_MAX_WRITE_SIZE at once, but if it does, the ring grows to fit rather than never having room
+    if (length > _capacity && !_length && ![_overflow count])
+    {
+        uint8_t *ring = realloc(_ring, length);
+        if (ring)
+        {
+            _ring = ring;
+            _capacity = length;
+            _start = 0;
+        }
+    }
+
+    BOOL fits = (![_overflow count] && _capacity - _length >= length);
+    if (!fits && !_closed)
+    {
+        _transferPaused = YES;
+        _pausedLength = length;
+    }
+    [_condition unlock];
+
+    // a piece that will never fit is only refused once the reader's been closed, which cancels the transfer anyway
+    return (fits || _closed);
+}
+
+- (void)writeBytes:(const void *)bytes length:(NSUInteger)length;
+{
+    [_condition lock];
+    if (!_closed)
+    {
+        NSAssert(_capacity - _length >= length, @"space should have been reserved");
+        [self copyBytesIntoRing:bytes length:length];
+    }
+    [_condition unlock];
+}
+
+// Called with the condition locked
+- (void)copyBytesIntoRing:(const void *)bytes length:(NSUInteger)length;
+{
+    NSUInteger end = (_start + _length) % _capacity;
+    NSUInteger first = MIN(length, _capacity - end);
+    memcpy(_ring + end, bytes, first);
+    memcpy(_ring, (const uint8_t *)bytes + first, length - first);
+    _length += length;
+
+    [_condition broadcast];
+}
+
+- (void (^)(void))resumeHandler
+{
+    [_condition lock];
+    void (^handler)(void) = [[_resumeHandler retain] autorelease];
+    [_condition unlock];
+
+    return handler;
+}
+
+- (void)setResumeHandler:(void (^)(void))handler
+{
+    handler = [handler copy];
+
+    [_condition lock];
+    [_resumeHandler release];
+    _resumeHandler = handler;
+    [_condition unlock];
+}
+
+#pragma mark - Delegate
+
+- (void)transfer:(CURLTransfer *)transfer didReceiveResponse:(NSURLResponse *)response;
+{
+    [_condition lock];
+    [_response release]; _response = [response retain];
+    [_condition broadcast];
+    [_condition unlock];
+}
+
+// Only for a body that CURLTransfer couldn't pause for; it goes in the ring if it fits, or waits its turn if not
+- (void)transfer:(CURLTransfer *)transfer didReceiveData:(NSData *)data;
+{
+    [_condition lock];
+    if (!_closed)
+    {
+        if (![_overflow count] && _capacity - _length >= [data length])
+        {
+            [self copyBytesIntoRing:[data bytes] length:[data length]];
+        }
+        else
+        {
+            [_overflow addObject:data];
+            [_condition broadcast];
+        }
+    }
+    [_condition unlock];
+}
+
+- (void)transfer:(CURLTransfer *)transfer didCompleteWithError:(NSError *)error;
+{
+    [_condition lock];
+    [_error release]; _error = [error retain];
+    _finished = YES;
+    [_resumeHandler release]; _resumeHandler = nil;
+    [_condition broadcast];
+    [_condition unlock];
+}
+
+@end
@@ -0,0 +1,130 @@
+//
+//  CURLRetryPolicy.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <curl/curl.h>
+
+/**
+ Says which failures are worth trying again, and how long to wait before each attempt.
+
+ Attach a policy to a request with -[NSMutableURLRequest curl_setRetryPolicy:]. When a transfer fails
+ with a retryable CURLcode, or an HTTP status that's retryable, the multi waits and then runs the same
+ transfer again - the delegate only hears about the final attempt. Uploads are rewound for each attempt.
+
+ A transfer is only retried if nothing has been reported to its delegate yet: once a response or any
+ body data has been delivered, a failure is final - unless the request's curl_resumesInterruptedTransfers
+ is on, in which case the retry carries on from where the body got to. Transfers on a multi driven by an
+ external event loop aren't retried, since there's no timer to wait on.
+
+ The wait before attempt n+1 is up to initialDelay * 2^(n-1), capped at maximumDelay, with
+ jitter taking a random amount off it so that many clients failing together don't retry together.
+
+ Retries to each host are also limited by a budget, so that a struggling server isn't hit with a
+ multiple of its normal load. Every request to the host adds retryBudgetRatio to the host's budget,
+ up to retryBudgetBurst; every retry spends one. When the budget is spent, failures are final.
+
+ A policy can be shared by many requests, and is safe to use from any thread.
+ */
+
+@interface CURLRetryPolicy : NSObject
+{
+    NSUInteger          _maximumAttempts;
+    NSTimeInterval      _initialDelay;
+    NSTimeInterval      _maximumDelay;
+    double              _jitter;
+    NSIndexSet          *_retryableCodes;
+    NSIndexSet          *_retryableStatusCodes;
+    double              _retryBudgetRatio;
+    NSUInteger          _retryBudgetBurst;
+
+    NSMutableDictionary *_budgets;
+    NSUInteger          _retryCount;
+    NSUInteger          _exhaustedBudgetCount;
+}
+
+/**
+ A policy with the default settings: three attempts, starting at 100ms and doubling, with full jitter.
+ Connection failures, timeouts, dropped connections, and the statuses 408, 429, 500, 502, 503 and 504 are retried.
+ */
+
++ (CURLRetryPolicy*)policy;
+
+/** The most attempts to make, including the first. Default is 3. */
+@property (assign, atomic) NSUInteger maximumAttempts;
+
+/** The longest wait before the first retry. Default is 0.1 seconds. */
+@property (assign, atomic) NSTimeInterval initialDelay;
+
+/** The longest wait before any retry. Default is 5 seconds. */
+@property (assign, atomic) NSTimeInterval maximumDelay;
+
+/** How much of each wait is randomised, from 0 (none) to 1 (anywhere between zero and the full wait, the default). */
+@property (assign, atomic) double jitter;
+
+/** The CURLcodes that are worth retrying. */
+@property (copy, atomic) NSIndexSet* retryableCodes;
+
+/** The HTTP statuses that are worth retrying. */
+@property (copy, atomic) NSIndexSet* retryableStatusCodes;
+
+/** How much each request adds to its host's retry budget. Default is 0.2, so at most one retry for every five requests in the long run. */
+@property (assign, atomic) double retryBudgetRatio;
+
+/** The most retries a host's budget can hold, which is also what it starts with. Default is 10. */
+@property (assign, atomic) NSUInteger retryBudgetBurst;
+
+/**
+ Is a failure worth retrying at all, regardless of attempts and budget?
+
+ @param code The CURLcode the transfer failed with.
+ @param statusCode The HTTP status, if there was one.
+ @return YES if the failure is retryable.
+ */
+
+- (BOOL)shouldRetryCode:(CURLcode)code statusCode:(NSInteger)statusCode;
+
+/**
+ How long to wait before an attempt, including jitter.
+
+ @param attempt The attempt about to be made; the first retry is attempt 2.
+ @return The delay.
+ */
+
+- (NSTimeInterval)delayBeforeAttempt:(NSUInteger)attempt;
+
+/** @name Used by CURLTransfer */
+
+/**
+ Note that a request to a host is starting, adding to the host's budget.
+
+ @param host The host.
+ */
+
+- (void)noteRequestToHost:(NSString*)host;
+
+/**
+ Decide whether to retry a failed attempt, spending from the host's budget if so.
+
+ @param attempt The attempt that failed, counting from 1.
+ @param code The CURLcode it failed with.
+ @param statusCode The HTTP status, if there was one.
+ @param host The host.
+ @return How long to wait before the next attempt, or a negative value if the failure is final.
+ */
+
+- (NSTimeInterval)retryDelayAfterAttempt:(NSUInteger)attempt code:(CURLcode)code statusCode:(NSInteger)statusCode host:(NSString*)host;
+
+/** @name Statistics */
+
+/** Retries made. */
+@property (readonly, atomic) NSUInteger retryCount;
+
+/** Retryable failures that were final because the host's budget was spent. */
+@property (readonly, atomic) NSUInteger exhaustedBudgetCount;
+
+@end
@@ -0,0 +1,141 @@
+//
+//  CURLRetryPolicy.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLRetryPolicy.h"
+
+@implementation CURLRetryPolicy
+
+@synthesize maximumAttempts = _maximumAttempts;
+@synthesize initialDelay = _initialDelay;
+@synthesize maximumDelay = _maximumDelay;
+@synthesize jitter = _jitter;
+@synthesize retryableCodes = _retryableCodes;
+@synthesize retryableStatusCodes = _retryableStatusCodes;
+@synthesize retryBudgetRatio = _retryBudgetRatio;
+@synthesize retryBudgetBurst = _retryBudgetBurst;
+@synthesize retryCount = _retryCount;
+@synthesize exhaustedBudgetCount = _exhaustedBudgetCount;
+
++ (CURLRetryPolicy*)policy
+{
+    return [[[self alloc] init] autorelease];
+}
+
+- (id)init
+{
+    if (self = [super init])
+    {
+        _maximumAttempts = 3;
+        _initialDelay = 0.1;
+        _maximumDelay = 5.0;
+        _jitter = 1.0;
+        _retryBudgetRatio = 0.2;
+        _retryBudgetBurst = 10;
+        _budgets = [[NSMutableDictionary alloc] init];
+
+        NSMutableIndexSet* codes = [NSMutableIndexSet indexSet];
+        [codes addIndex:CURLE_COULDNT_RESOLVE_HOST];
+        [codes addIndex:CURLE_COULDNT_CONNECT];
+        [codes addIndex:CURLE_OPERATION_TIMEDOUT];
+        [codes addIndex:CURLE_SSL_CONNECT_ERROR];
+        [codes addIndex:CURLE_GOT_NOTHING];
+        [codes addIndex:CURLE_SEND_ERROR];
+        [codes addIndex:CURLE_RECV_ERROR];
+        [codes addIndex:CURLE_PARTIAL_FILE];
+        _retryableCodes = [codes copy];
+
+        NSMutableIndexSet* statuses = [NSMutableIndexSet indexSet];
+        [statuses addIndex:408];
+        [statuses addIndex:429];
+        [statuses addIndex:500];
+        [statuses addIndex:502];
+        [statuses addIndex:503];
+        [statuses addIndex:504];
+        _retryableStatusCodes = [statuses copy];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_retryableCodes release];
+    [_retryableStatusCodes release];
+    [_budgets release];
+
+    [super dealloc];
+}
+
+- (BOOL)shouldRetryCode:(CURLcode)code statusCode:(NSInteger)statusCode
+{
+    if (code == CURLE_HTTP_RETURNED_ERROR)
+    {
+        return statusCode > 0 && [self.retryableStatusCodes containsIndex:statusCode];
+    }
+
+    return (code != CURLE_OK) && [self.retryableCodes containsIndex:code];
+}
+
+- (NSTimeInterval)delayBeforeAttempt:(NSUInteger)attempt
+{
+    if (attempt < 2) return 0;
+
+    NSTimeInterval delay = self.initialDelay * pow(2.0, (double)(attempt - 2));
+    delay = MIN(delay, self.maximumDelay);
+
+    double jitter = MAX(0.0, MIN(1.0, self.jitter));
+    double random = (double)arc4random_uniform(UINT32_MAX) / (double)UINT32_MAX;
+    return delay * (1.0 - jitter * random);
+}
+
+- (void)noteRequestToHost:(NSString *)host
+{
+    if (!host) return;
+
+    @synchronized(self)
+    {
+        NSString* key = [host lowercaseString];
+        NSNumber* budget = [_budgets objectForKey:key];
+        double tokens = budget ? [budget doubleValue] : _retryBudgetBurst;
+        tokens = MIN(tokens + _retryBudgetRatio, (double)_retryBudgetBurst);
+        [_budgets setObject:@(tokens) forKey:key];
+    }
+}
+
+- (NSTimeInterval)retryDelayAfterAttempt:(NSUInteger)attempt code:(CURLcode)code statusCode:(NSInteger)statusCode host:(NSString *)host
+{
+    if (attempt >= self.maximumAttempts || ![self shouldRetryCode:code statusCode:statusCode]) return -1;
+
+    @synchronized(self)
+    {
+        NSString* key = [host lowercaseString];
+        if (key)
+        {
+            NSNumber* budget = [_budgets objectForKey:key];
+            double tokens = budget ? [budget doubleValue] : _retryBudgetBurst;
+            if (tokens < 1.0)
+            {
+                ++_exhaustedBudgetCount;
+                return -1;
+            }
+
+            [_budgets setObject:@(tokens - 1.0) forKey:key];
+        }
+
+        ++_retryCount;
+    }
+
+    return [self delayBeforeAttempt:attempt + 1];
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"<%@ %p: %lu attempts, %lu retries, %lu over budget>", [self class], self, (unsigned long)self.maximumAttempts, (unsigned long)self.retryCount, (unsigned long)self.exhaustedBudgetCount];
+}
+
+@end
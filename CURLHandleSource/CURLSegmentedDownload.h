@@ -0,0 +1,139 @@
+//
+//  CURLSegmentedDownload.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLTransfer.h"
+
+@class CURLSegmentedDownload;
+
+@protocol CURLSegmentedDownloadDelegate <NSObject>
+
+/**
+ Sent as the last message related to the download.
+
+ @param download The download that has completed.
+ @param error The error it failed with, if there was one. The destination file is left as it was when it failed.
+ */
+
+- (void)segmentedDownload:(CURLSegmentedDownload*)download didCompleteWithError:(NSError*)error;
+
+@optional
+
+/**
+ Optional method, called after some of the file has been written.
+
+ @param download The download.
+ @param length How much was just written.
+ @param totalBytesWritten How much has been written altogether.
+ */
+
+- (void)segmentedDownload:(CURLSegmentedDownload*)download didWriteDataOfLength:(NSUInteger)length totalBytesWritten:(unsigned long long)totalBytesWritten;
+
+@end
+
+
+/**
+ Downloads a file over several connections at once, straight into a destination file.
+
+ Unless the length is given, a HEAD request (which FTP answers with SIZE) asks for it first. The file is then
+ split into segments, each fetched by a CURLTransfer of its own with a `Range: bytes=` header - which CURLTransfer
+ turns into a byte range for HTTP, and a resume offset for FTP and SFTP - and written where it belongs with pwrite().
+ HTTP segments carry an If-Range validator from the HEAD response, so that a file which changes part way through
+ fails the download rather than mixing two versions.
+
+ When a segment finishes, it takes over half of whatever is left of the segment expected to finish last, so that
+ a slow connection doesn't hold everything up. So no more than segmentCount transfers run at once.
+
+ If the length can't be found out, or the server doesn't say it accepts byte ranges, the file is downloaded by a
+ single transfer. SFTP servers don't report sizes this way, so pass the length in (from a directory listing, say)
+ to download from them in segments.
+ */
+
+@interface CURLSegmentedDownload : NSObject <CURLTransferDelegate>
+{
+    NSURLRequest            *_request;
+    NSURLCredential         *_credential;
+    NSURL                   *_destinationURL;
+    id <CURLSegmentedDownloadDelegate> _delegate;
+    NSOperationQueue        *_delegateQueue;
+    CURLMultiHandle         *_multi;
+    NSUInteger              _maximumSegmentCount;
+
+    CURLTransfer            *_probe;
+    NSURLResponse           *_probeResponse;
+    NSString                *_validator;
+    NSMutableArray          *_segments;
+    int                     _fileDescriptor;
+    unsigned long long      _length;
+    unsigned long long      _bytesWritten;
+    BOOL                    _isSegmented;
+    NSUInteger              _segmentCount;
+    NSUInteger              _stealCount;
+    NSError                 *_error;
+    BOOL                    _finished;
+}
+
+/**
+ Start a download.
+
+ @param request The request for the file. It should be a plain GET, without a Range header of its own.
+ @param credential A credential to use for the requests.
+ @param destinationURL The file to write to. It's created, or replaced.
+ @param length The size of the file if it's already known, or zero to ask the server.
+ @param count The most segments to fetch at once.
+ @param delegate An object to use as the delegate. It's retained until the download is finished, failed, or cancelled.
+ @param queue The queue for delegate messages, or nil to make a serial one.
+ @param multi The multi to run the transfers on.
+ @return A new object.
+ */
+
+- (id)initWithRequest:(NSURLRequest *)request
+           credential:(NSURLCredential *)credential
+       destinationURL:(NSURL *)destinationURL
+               length:(unsigned long long)length
+         segmentCount:(NSUInteger)count
+             delegate:(id <CURLSegmentedDownloadDelegate>)delegate
+        delegateQueue:(NSOperationQueue *)queue
+                multi:(CURLMultiHandle *)multi __attribute((nonnull(1,3,6,8)));
+
+/**
+ Stop every transfer. The delegate is sent the NSURLErrorCancelled error as usual.
+ */
+
+- (void)cancel;
+
+@property (readonly, copy, nonatomic) NSURL* destinationURL;
+
+/** The size of the file, or zero until it's known. */
+@property (readonly, atomic) unsigned long long length;
+
+/** How much of the file has been written. */
+@property (readonly, atomic) unsigned long long bytesWritten;
+
+/**
+ Split a file into segments.
+
+ @param length The size of the file.
+ @param count The most segments to split it into.
+ @param minimumLength The smallest a segment should be (the last one may be smaller).
+ @return The offset each segment starts at, in order. The first is always zero.
+ */
+
++ (NSArray*)segmentOffsetsForLength:(unsigned long long)length count:(NSUInteger)count minimumLength:(unsigned long long)minimumLength;
+
+/** @name Statistics */
+
+/** YES if the file is being fetched in segments, rather than by a single transfer. */
+@property (readonly, atomic) BOOL isSegmented;
+
+/** How many segments have been started, including those split off slow ones. */
+@property (readonly, atomic) NSUInteger segmentCount;
+
+/** How many times a finished segment has taken over part of a slow one. */
+@property (readonly, atomic) NSUInteger stealCount;
+
+@end
@@ -0,0 +1,526 @@
+//
+//  CURLSegmentedDownload.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLSegmentedDownload.h"
+
+#import "CURLHTTPParsing.h"
+#import "CURLMultiHandle.h"
+#import "CURLResponse.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+static const unsigned long long kMinimumSegmentLength = 256 * 1024;    // less than this isn't worth a connection of its own
+
+#pragma mark - Segments
+
+/**
+ One range of the file, and the transfer fetching it.
+ */
+
+@interface CURLDownloadSegment : NSObject
+{
+@public
+    CURLTransfer        *_transfer;
+    unsigned long long  _offset;        // where the next byte goes
+    unsigned long long  _end;           // just past the last byte wanted
+    unsigned long long  _received;
+    CFAbsoluteTime      _started;
+    BOOL                _isCut;         // some of the range it asked for has been handed to another segment
+    BOOL                _isCancelled;
+}
+
+- (NSTimeInterval)estimatedTimeRemaining;
+
+@end
+
+@implementation CURLDownloadSegment
+
+- (void)dealloc
+{
+    [_transfer release];
+
+    [super dealloc];
+}
+
+- (NSTimeInterval)estimatedTimeRemaining
+{
+    // one that hasn't got going yet could take any amount of time
+    NSTimeInterval elapsed = CFAbsoluteTimeGetCurrent() - _started;
+    if (_received == 0 || elapsed <= 0) return DBL_MAX;
+
+    return (_end - _offset) / (_received / elapsed);
+}
+
+@end
+
+#pragma mark - Headers
+
+// the value of a response header, however the server capitalised its name
+static NSString* CURLResponseHeaderValue(NSURLResponse* response, NSString* name)
+{
+    if ([response isKindOfClass:[NSHTTPURLResponse class]])
+    {
+        NSDictionary* fields = [(NSHTTPURLResponse*)response allHeaderFields];
+        for (NSString* key in fields)
+        {
+            if ([key caseInsensitiveCompare:name] == NSOrderedSame) return [fields objectForKey:key];
+        }
+    }
+    else if ([response isKindOfClass:[CURLResponse class]])
+    {
+        // libcurl makes up headers for FTP, which don't start with a status line
+        for (NSString* line in [[(CURLResponse*)response headerString] componentsSeparatedByLineSeparators])
+        {
+            if ([[line headerKey] caseInsensitiveCompare:name] == NSOrderedSame) return [line headerValue];
+        }
+    }
+
+    return nil;
+}
+
+#pragma mark - Download
+
+@implementation CURLSegmentedDownload
+
+@synthesize destinationURL = _destinationURL;
+
++ (NSArray*)segmentOffsetsForLength:(unsigned long long)length count:(NSUInteger)count minimumLength:(unsigned long long)minimumLength
+{
+    unsigned long long segments = MAX(count, 1U);
+    if (minimumLength) segments = MIN(segments, MAX(length / minimumLength, 1ULL));
+
+    unsigned long long size = (length + segments - 1) / segments;
+    NSMutableArray* result = [NSMutableArray arrayWithObject:@0ULL];
+    for (unsigned long long index = 1; index < segments && index * size < length; ++index)
+    {
+        [result addObject:@(index * size)];
+    }
+
+    return result;
+}
+
+- (id)initWithRequest:(NSURLRequest *)request credential:(NSURLCredential *)credential destinationURL:(NSURL *)destinationURL length:(unsigned long long)length segmentCount:(NSUInteger)count delegate:(id<CURLSegmentedDownloadDelegate>)delegate delegateQueue:(NSOperationQueue *)queue multi:(CURLMultiHandle *)multi
+{
+    if (self = [super init])
+    {
+        _request = [request copy];
+        _credential = [credential retain];
+        _destinationURL = [destinationURL copy];
+        _delegate = [delegate retain];
+        _multi = [multi retain];
+        _maximumSegmentCount = MAX(count, 1U);
+        _segments = [[NSMutableArray alloc] init];
+        _fileDescriptor = -1;
+
+        // a length we're given is taken on trust
+        _length = length;
+        _isSegmented = (length > 0);
+
+        if (queue)
+        {
+            _delegateQueue = [queue retain];
+        }
+        else
+        {
+            // every transfer shares a serial queue, so that the segments are only changed by one at a time
+            _delegateQueue = [[NSOperationQueue alloc] init];
+            _delegateQueue.maxConcurrentOperationCount = 1;
+        }
+
+        [_delegateQueue addOperationWithBlock:^{
+            [self begin];
+        }];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    NSAssert(_fileDescriptor < 0, @"the file should have been closed when the download finished");
+
+    [_request release];
+    [_credential release];
+    [_destinationURL release];
+    [_delegate release];
+    [_delegateQueue release];
+    [_multi release];
+    [_probe release];
+    [_probeResponse release];
+    [_validator release];
+    [_segments release];
+    [_error release];
+
+    [super dealloc];
+}
+
+- (void)begin
+{
+    @synchronized(self)
+    {
+        if (!_error)
+        {
+            if (_length)
+            {
+                [self startSegments];
+            }
+            else
+            {
+                // ask how big it is first (for FTP, libcurl turns HEAD into SIZE)
+                NSMutableURLRequest* probe = [[_request mutableCopy] autorelease];
+                [probe setHTTPMethod:@"HEAD"];
+
+                CURLHandleLog(@"asking for the length of %@", [_request URL]);
+                _probe = [[CURLTransfer alloc] initWithRequest:probe credential:_credential delegate:self delegateQueue:_delegateQueue multi:_multi];
+            }
+        }
+    }
+
+    [self finishIfIdle];
+}
+
+- (void)cancel
+{
+    [self stopWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]];
+}
+
+#pragma mark Properties
+
+- (unsigned long long)length
+{
+    @synchronized(self)
+    {
+        return _length;
+    }
+}
+
+- (unsigned long long)bytesWritten
+{
+    @synchronized(self)
+    {
+        return _bytesWritten;
+    }
+}
+
+- (BOOL)isSegmented
+{
+    @synchronized(self)
+    {
+        return _isSegmented;
+    }
+}
+
+- (NSUInteger)segmentCount
+{
+    @synchronized(self)
+    {
+        return _segmentCount;
+    }
+}
+
+- (NSUInteger)stealCount
+{
+    @synchronized(self)
+    {
+        return _stealCount;
+    }
+}
+
+#pragma mark - Segments
+
+// The methods in this section must be called with the lock held
+
+- (void)takeProbeResponse
+{
+    NSURLResponse* response = _probeResponse;
+
+    long long length = [CURLResponseHeaderValue(response, @"Content-Length") longLongValue];
+    NSString* ranges = CURLResponseHeaderValue(response, @"Accept-Ranges");
+    if (length > 0 && [ranges rangeOfString:@"bytes" options:NSCaseInsensitiveSearch].location != NSNotFound)
+    {
+        _length = length;
+        _isSegmented = YES;
+    }
+
+    // If-Range needs a strong validator
+    NSString* entityTag = CURLResponseHeaderValue(response, @"ETag");
+    _validator = [((entityTag && ![entityTag hasPrefix:@"W/"]) ? entityTag : CURLResponseHeaderValue(response, @"Last-Modified")) copy];
+}
+
+- (void)startSegments
+{
+    _fileDescriptor = open([[_destinationURL path] fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (_fileDescriptor < 0)
+    {
+        NSError* underlying = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        _error = [[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCannotCreateFile userInfo:@{ NSUnderlyingErrorKey : underlying, NSURLErrorFailingURLErrorKey : [_request URL] }] retain];
+        return;
+    }
+
+    if (!_isSegmented)
+    {
+        CURLHandleLog(@"fetching %@ in one go", [_request URL]);
+        [self startSegmentFrom:0 to:ULLONG_MAX];
+        return;
+    }
+
+    // size the file up front, so that each segment can write its part wherever it is
+    (void)ftruncate(_fileDescriptor, (off_t)_length);
+
+    NSArray* offsets = [[self class] segmentOffsetsForLength:_length count:_maximumSegmentCount minimumLength:kMinimumSegmentLength];
+    CURLHandleLog(@"fetching %@ in %lu segments", [_request URL], (unsigned long)[offsets count]);
+    for (NSUInteger index = 0; index < [offsets count]; ++index)
+    {
+        unsigned long long end = (index + 1 < [offsets count]) ? [[offsets objectAtIndex:index + 1] unsignedLongLongValue] : _length;
+        [self startSegmentFrom:[[offsets objectAtIndex:index] unsignedLongLongValue] to:end];
+    }
+}
+
+- (void)startSegmentFrom:(unsigned long long)offset to:(unsigned long long)end
+{
+    NSURLRequest* request = _request;
+    if (_isSegmented)
+    {
+        // CURLTransfer makes this a byte range for HTTP, and a resume offset for FTP and SFTP
+        NSMutableURLRequest* ranged = [[_request mutableCopy] autorelease];
+        [ranged setValue:[NSString stringWithFormat:@"bytes=%llu-%llu", offset, end - 1] forHTTPHeaderField:@"Range"];
+        if (_validator) [ranged setValue:_validator forHTTPHeaderField:@"If-Range"];
+        request = ranged;
+    }
+
+    CURLDownloadSegment* segment = [[CURLDownloadSegment alloc] init];
+    segment->_offset = offset;
+    segment->_end = end;
+    segment->_started = CFAbsoluteTimeGetCurrent();
+    [_segments addObject:segment];
+    ++_segmentCount;
+
+    segment->_transfer = [[CURLTransfer alloc] initWithRequest:request credential:_credential delegate:self delegateQueue:_delegateQueue multi:_multi];
+    [segment release];
+}
+
+- (CURLDownloadSegment*)segmentForTransfer:(CURLTransfer*)transfer
+{
+    for (CURLDownloadSegment* segment in _segments)
+    {
+        if (segment->_transfer == transfer) return segment;
+    }
+
+    return nil;
+}
+
+/**
+ Hand half of what's left of the segment expected to finish last to a new segment, if it's worth it.
+ */
+
+- (void)stealWork
+{
+    CURLDownloadSegment* victim = nil;
+    NSTimeInterval longest = -1;
+    for (CURLDownloadSegment* segment in _segments)
+    {
+        if (segment->_isCancelled || segment->_end - segment->_offset < 2 * kMinimumSegmentLength) continue;
+
+        NSTimeInterval remaining = [segment estimatedTimeRemaining];
+        if (remaining > longest)
+        {
+            victim = segment;
+            longest = remaining;
+        }
+    }
+
+    if (!victim) return;
+
+    unsigned long long middle = victim->_offset + (victim->_end - victim->_offset) / 2;
+    unsigned long long end = victim->_end;
+    CURLHandleLog(@"taking %llu-%llu from %@", middle, end, victim->_transfer);
+
+    victim->_end = middle;
+    victim->_isCut = YES;
+    ++_stealCount;
+
+    [self startSegmentFrom:middle to:end];
+}
+
+#pragma mark - Completion
+
+- (void)stopWithError:(NSError*)error
+{
+    NSMutableArray* transfers = [NSMutableArray array];
+    @synchronized(self)
+    {
+        if (_finished || _error) return;
+
+        CURLHandleLog(@"stopping %@ with error %@", [_request URL], error);
+        _error = [error retain];
+
+        if (_probe) [transfers addObject:_probe];
+        for (CURLDownloadSegment* segment in _segments)
+        {
+            segment->_isCancelled = YES;
+            [transfers addObject:segment->_transfer];
+        }
+    }
+
+    [transfers makeObjectsPerformSelector:@selector(cancel)];
+
+    // if nothing was running, there's nothing to wait for
+    [_delegateQueue addOperationWithBlock:^{
+        [self finishIfIdle];
+    }];
+}
+
+- (void)finishIfIdle
+{
+    id <CURLSegmentedDownloadDelegate> delegate;
+    NSError* error;
+    @synchronized(self)
+    {
+        if (_finished || _probe || [_segments count]) return;
+        _finished = YES;
+
+        if (_fileDescriptor >= 0)
+        {
+            close(_fileDescriptor);
+            _fileDescriptor = -1;
+        }
+
+        // like CURLTransfer, we only hold on to the delegate until the download is done
+        delegate = _delegate;
+        _delegate = nil;
+        error = [[_error retain] autorelease];
+    }
+
+    CURLHandleLog(@"finished %@ with error %@", [_request URL], error);
+    [delegate segmentedDownload:self didCompleteWithError:error];
+    [delegate release];
+}
+
+#pragma mark - CURLTransferDelegate
+
+- (void)transfer:(CURLTransfer *)transfer didReceiveResponse:(NSURLResponse *)response
+{
+    BOOL isWrong = NO;
+    @synchronized(self)
+    {
+        if (transfer == _probe)
+        {
+            [_probeResponse release];
+            _probeResponse = [response retain];
+            return;
+        }
+
+        // a server which ignores the range, or whose file has changed since the HEAD, sends the whole thing
+        isWrong = (_isSegmented && [response isKindOfClass:[NSHTTPURLResponse class]] && [(NSHTTPURLResponse*)response statusCode] != 206);
+    }
+
+    if (isWrong)
+    {
+        [self stopWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorBadServerResponse userInfo:@{ NSURLErrorFailingURLErrorKey : [_request URL] }]];
+    }
+}
+
+- (void)transfer:(CURLTransfer *)transfer didReceiveData:(NSData *)data
+{
+    id <CURLSegmentedDownloadDelegate> delegate = nil;
+    NSUInteger written = 0;
+    unsigned long long total = 0;
+    BOOL isDone = NO;
+    NSError* error = nil;
+
+    @synchronized(self)
+    {
+        CURLDownloadSegment* segment = [self segmentForTransfer:transfer];
+        if (!segment || segment->_isCancelled) return;
+
+        // anything past the end belongs to the segment that took it over
+        written = (NSUInteger)MIN((unsigned long long)[data length], segment->_end - segment->_offset);
+        if (written && pwrite(_fileDescriptor, [data bytes], written, (off_t)segment->_offset) != (ssize_t)written)
+        {
+            NSError* underlying = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+            error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCannotWriteToFile userInfo:@{ NSUnderlyingErrorKey : underlying, NSURLErrorFailingURLErrorKey : [_request URL] }];
+            written = 0;
+        }
+
+        segment->_offset += written;
+        segment->_received += written;
+        _bytesWritten += written;
+        total = _bytesWritten;
+
+        if (segment->_isCut && segment->_offset >= segment->_end)
+        {
+            segment->_isCancelled = YES;
+            isDone = YES;
+        }
+
+        delegate = [[_delegate retain] autorelease];
+    }
+
+    if (error)
+    {
+        [self stopWithError:error];
+        return;
+    }
+
+    // the rest of what it asked for is someone else's job now
+    if (isDone) [transfer cancel];
+
+    if (written && [delegate respondsToSelector:@selector(segmentedDownload:didWriteDataOfLength:totalBytesWritten:)])
+    {
+        [delegate segmentedDownload:self didWriteDataOfLength:written totalBytesWritten:total];
+    }
+}
+
+- (void)transfer:(CURLTransfer *)transfer didCompleteWithError:(NSError *)error
+{
+    NSError* failure = nil;
+    @synchronized(self)
+    {
+        if (transfer == _probe)
+        {
+            // a server that won't say is simply downloaded in one go
+            [self takeProbeResponse];
+            [_probe autorelease];
+            _probe = nil;
+
+            if (!_error) [self startSegments];
+        }
+        else
+        {
+            CURLDownloadSegment* segment = [[[self segmentForTransfer:transfer] retain] autorelease];
+            if (segment)
+            {
+                [_segments removeObjectIdenticalTo:segment];
+
+                BOOL isComplete = _isSegmented ? (segment->_offset >= segment->_end) : (error == nil);
+                if (!isComplete)
+                {
+                    failure = (error ? error : [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorNetworkConnectionLost userInfo:@{ NSURLErrorFailingURLErrorKey : [_request URL] }]);
+                }
+                else if (!_error && _isSegmented)
+                {
+                    [self stealWork];
+                }
+            }
+        }
+    }
+
+    if (failure) [self stopWithError:failure];
+    [self finishIfIdle];
+}
+
+- (NSString*)description
+{
+    @synchronized(self)
+    {
+        return [NSString stringWithFormat:@"<SEGMENTED %p %@: %llu of %llu bytes, %lu segments running>", self, [_request URL], _bytesWritten, _length, (unsigned long)[_segments count]];
+    }
+}
+
+@end
@@ -11,18 +11,18 @@
 @class CURLMultiHandle;
 
 /**
- * Internal wrapper for dispatch sources that monitor each of the curl sockets.
+ * Internal record of what each of the curl sockets is being watched for.
  * CURLMulti uses this internally - not intended for public consumption.
  */
 
 @interface CURLSocketRegistration : NSObject
 {
-    dispatch_source_t _reader;
-    dispatch_source_t _writer;
+    BOOL _reading;
+    BOOL _writing;
 }
 
 /**
- * Create/destroy the dispatch sources, based on the values in the mode parameter.
+ * Start/stop watching the socket, based on the values in the mode parameter.
  * CURLMulti uses this internally - not intended for public consumption.
  *
  * @param socket The socket .
@@ -32,13 +32,4 @@
 
 - (void)updateSourcesForSocket:(int)socket mode:(int)mode multi:(CURLMultiHandle*)multi;
 
-/**
- Indicates whether a given source is owned by this socket.
-
- @param source The source to check.
- @return Returns YES if the source is owned by this socket.
- */
-
-- (BOOL)ownsSource:(dispatch_source_t)source;
-
 @end
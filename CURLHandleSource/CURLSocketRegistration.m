@@ -15,8 +15,8 @@
 
 #pragma mark - Private Properties
 
-@property (assign, nonatomic) dispatch_source_t reader;
-@property (assign, nonatomic) dispatch_source_t writer;
+@property (assign, nonatomic) BOOL reading;
+@property (assign, nonatomic) BOOL writing;
 
 @end
 
@@ -24,67 +24,43 @@
 
 #pragma mark - Synthesized Properties
 
-@synthesize reader = _reader;
-@synthesize writer = _writer;
+@synthesize reading = _reading;
+@synthesize writing = _writing;
 
 #pragma mark - Implementation
 
-- (void)dealloc
-{
-    if (self.reader)
-    {
-        dispatch_source_cancel(self.reader); // the cancel handler will release the source
-    }
-
-    if (self.writer)
-    {
-        dispatch_source_cancel(self.writer); // the cancel handler will release the source
-    }
-
-    [super dealloc];
-}
-
 - (void)updateSourcesForSocket:(int)socket mode:(int)mode multi:(CURLMultiHandle*)multi
 {
-    // We call back to the multi to do the actual work - this class really just exists as
-    // a place to group together the reader and writer sources corresponding to a socket.
+    // We call back to the multi to do the actual work (which it hands on to its event backend) - this
+    // class really just exists to remember what a socket is being watched for, so the backend only hears about changes.
 
     BOOL readerRequired = (mode == CURL_POLL_IN) || (mode == CURL_POLL_INOUT);
-    self.reader = [multi updateSource:self.reader type:DISPATCH_SOURCE_TYPE_READ socket:socket registration:self required:readerRequired];
-
     BOOL writerRequired = (mode == CURL_POLL_OUT) || (mode == CURL_POLL_INOUT);
-    self.writer = [multi updateSource:self.writer type:DISPATCH_SOURCE_TYPE_WRITE socket:socket registration:self required:writerRequired];
+    if ((readerRequired != self.reading) || (writerRequired != self.writing))
+    {
+        self.reading = readerRequired;
+        self.writing = writerRequired;
+        [multi watchSocket:socket reading:readerRequired writing:writerRequired];
+    }
 }
 
 - (NSString*)description
 {
     NSString* mode;
-    if (self.reader)
+    if (self.reading)
     {
-        if (self.writer)
-        {
-            mode = [NSString stringWithFormat:@"read, write sources for %lu", dispatch_source_get_handle(self.reader)];
-        }
-        else
-        {
-            mode = [NSString stringWithFormat:@"read source for %lu", dispatch_source_get_handle(self.reader)];
-        }
+        mode = self.writing ? @"reading, writing" : @"reading";
     }
-    else if (self.writer)
+    else if (self.writing)
     {
-        mode = [NSString stringWithFormat:@"write source for %lu", dispatch_source_get_handle(self.writer)];
+        mode = @"writing";
     }
     else
     {
-        mode = @"no sources";
+        mode = @"not watched";
     }
 
     return [NSString stringWithFormat:@"<socket %p %@>", self, mode];
 }
 
-- (BOOL)ownsSource:(dispatch_source_t)source
-{
-    return (self.reader == source) || (self.writer == source);
-}
-
 @end
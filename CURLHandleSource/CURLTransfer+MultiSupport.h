@@ -39,6 +39,20 @@
 
 - (void)completeWithCode:(CURLcode)code;
 
+/**
+ Called by <CURLMulti> to complete the transfer without running it, when the result is already known.
+
+ The error is the one the transfer would have produced had it run and finished the same way.
+
+ @param code The completion code.
+ @param responseCode The response status it would have got.
+
+ @warning Not intended for general use.
+
+ */
+
+- (void)completeWithCode:(CURLcode)code responseCode:(long)responseCode;
+
 /**
  Called by <CURLMulti> to tell the transfer that it has completed.
  
@@ -50,6 +64,65 @@
 
 - (void)completeWithError:(NSError *)error;
 
+/**
+ Called by <CURLMulti> when the transfer has failed, to ask whether it should be tried again.
+
+ If so, the transfer is made ready to run again (rewinding any upload); the multi should wait for
+ the delay, then add the transfer's handle again.
+
+ @param code The failure code.
+ @return How long to wait before trying again, or a negative value if the failure should be reported.
+
+ @warning Not intended for general use.
+
+ */
+
+- (NSTimeInterval)retryDelayAfterCode:(CURLcode)code;
+
+/**
+ Was the transfer given a credential? If so, it can't share a request with anything else.
+
+ @return YES if it was.
+
+ @warning Not intended for general use.
+
+ */
+
+- (BOOL)usesCredential;
+
+/**
+ Who the transfer's credential is for.
+
+ @return The credential's user, or nil if the transfer wasn't given a credential.
+
+ @warning Not intended for general use.
+
+ */
+
+- (NSString*)credentialUser;
+
+/**
+ Called by <CURLTransferFlight> to pass on a response received by the identical request that the transfer is attached to.
+
+ @param response The response.
+
+ @warning Not intended for general use.
+
+ */
+
+- (void)deliverResponse:(NSURLResponse *)response;
+
+/**
+ Called by <CURLTransferFlight> to pass on data received by the identical request that the transfer is attached to.
+
+ @param data The data.
+
+ @warning Not intended for general use.
+
+ */
+
+- (void)deliverData:(NSData *)data;
+
 /**
  Has the transfer completed?
  
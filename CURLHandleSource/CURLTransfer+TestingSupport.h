@@ -18,15 +18,6 @@
 
 /** @name Testing Methods */
 
-/**
- Creates a CURLTransfer instance tied to a specific multi handle
- 
- @warning Not intended for general use.
- 
- @return A new CURLTransfer object.
- */
-- (id)initWithRequest:(NSURLRequest *)request credential:(NSURLCredential *)credential delegate:(id <CURLTransferDelegate>)delegate delegateQueue:(NSOperationQueue *)queue multi:(CURLMultiHandle*)multi __attribute((nonnull(1,5)));
-
 /**
  Returns a new CURLMulti, for use in testing.
 
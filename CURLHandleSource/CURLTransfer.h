@@ -19,6 +19,16 @@
 
 
 @class CURLMultiHandle;
+@class CURLTransferRecord;
+@class CURLTransferRecorder;
+@class CURLHTTPCache;
+@class CURLCachedHTTPResponse;
+@class CURLDigest;
+@class CURLContentDecoder;
+@class CURLContentEncoder;
+@class CURLRecordBatch;
+@class CURLRecordSplitter;
+@class CURLResponseReader;
 
 @protocol CURLTransferDelegate;
 
@@ -52,6 +62,34 @@ typedef NS_ENUM(NSInteger, CURLTransferState) {
     NSMutableArray          *_lists;                        // Lists we need to hold on to until the handle goes away.
 	NSDictionary            *_proxies;                      /*" Dictionary of proxy information; it's released when the transfer is deallocated since it's needed for the transfer."*/
     NSInputStream           *_uploadStream;
+    BOOL                    _uploadStreamSeeks;             // can be rewound in place, as found when it was opened
+    CURLTransferRecord      *_record;
+    NSUInteger              _attempts;                      // how many times the request has been tried
+    BOOL                    _hasNotifiedDelegate;           // once the delegate has seen a response or data, failures are final
+    CURLHTTPCache           *_cache;                        // set if the request can use the HTTP cache
+    CURLCachedHTTPResponse  *_cachedResponse;               // what the cache had for the request
+    BOOL                    _revalidatesCachedResponse;
+    CURLCachedHTTPResponse  *_storingResponse;              // the response being written to the cache
+    BOOL                    _usesCredential;
+    NSString                *_credentialUser;               // who the credential is for, so results cached per user stay apart
+    BOOL                    _resumes;                       // an interrupted attempt should be retried from where it got to
+    BOOL                    _isResuming;                    // this attempt carries on from an earlier one, so the delegate already has the response
+    BOOL                    _resumeMismatch;                // the file changed between attempts
+    unsigned long long      _committedLength;               // how much of the body the delegate has been given
+    unsigned long long      _sentLength;                    // how much of the upload this attempt has read
+    NSString                *_resumeValidator;              // strong ETag or Last-Modified date, sent as If-Range when resuming over HTTP
+    long                    _remoteFileTime;                // FTP/SFTP modification time, or -1 if unknown
+    double                  _remoteLength;                  // FTP/SFTP file size, or -1 if unknown
+    CURLDigest              *_receivedDigest;               // set if the request asks for digests
+    CURLDigest              *_sentDigest;
+    NSData                  *_downloadDigest;               // the final digests, once completed
+    NSData                  *_uploadDigest;
+    NSError                 *_digestError;                  // a body didn't match its expected digest
+    BOOL                    _decodesInBackground;           // compressed bodies are left for a CURLContentDecoder, rather than libcurl
+    CURLContentDecoder      *_decoder;                      // set once the body turns out to be compressed
+    CURLContentEncoder      *_uploadEncoder;                // set if the upload is compressed on the way out
+    CURLRecordSplitter      *_recordSplitter;               // set if the delegate wants the body as records
+    CURLResponseReader      *_responseReader;               // the delegate, if it's a reader, whose buffer the body goes straight into
 }
 
 //  Loading respects as many of NSURLRequest's built-in features as possible, including:
@@ -60,11 +98,19 @@ typedef NS_ENUM(NSInteger, CURLTransferState) {
 //    * Similarly, @"PUT" turns on the CURLOPT_UPLOAD option (again handy for FTP uploads)
 //  
 //    * Supply -HTTPBody or -HTTPBodyStream to switch Curl into uploading mode, regardless of protocol
+//      (a -HTTPBodyStream is sent chunked, unless there's a Content-Length header to say how long it is)
 //  
 //    * Custom Range: HTTP headers are specially handled to set the CURLOPT_RANGE option, regardless of protocol in use
 //      (you should still construct the header as though it were HTTP, e.g. bytes=500-999)
 //  
 //    * Custom Accept-Encoding: HTTP headers are specially handled to set the CURLOPT_ENCODING option
+//      (or, with curl_decodesContentInBackground, to decode the body away from the multi's queue)
+//
+//    * With curl_uploadContentEncoding, an HTTP upload is compressed on the way out, and sent chunked
+//
+//    * With curl_recordDelimiter, the body can go to the delegate as batches of records, rather than pieces as they arrive
+//
+//    * A CURLResponseReader delegate has the body put straight into its buffer, and the transfer paused while that's full
 //
 //  Delegate messages are delivered on the specified queue
 //
@@ -74,6 +120,18 @@ typedef NS_ENUM(NSInteger, CURLTransferState) {
              delegate:(id <CURLTransferDelegate>)delegate
         delegateQueue:(NSOperationQueue *)queue __attribute((nonnull(1)));
 
+/**
+ Creates a transfer run by a specific multi, rather than the shared one.
+
+ Generally that's an implementation detail, but it's needed to run transfers on a multi driven by an
+ external event loop (see -[CURLMultiHandle initForExternalEventLoop:]). For such a multi, a nil queue
+ means the delegate is called directly on the loop's thread.
+
+ @return A new CURLTransfer object.
+ */
+
+- (id)initWithRequest:(NSURLRequest *)request credential:(NSURLCredential *)credential delegate:(id <CURLTransferDelegate>)delegate delegateQueue:(NSOperationQueue *)queue multi:(CURLMultiHandle*)multi __attribute((nonnull(1,5)));
+
 @property (readonly, copy) NSURLRequest *originalRequest;  // auth might cause a slightly different request to be sent out
 
 @property (readonly, strong) id <CURLTransferDelegate> delegate; // As an asynchronous API, CURLTransfer retains its delegate until the request is finished, failed, or cancelled. Much like NSURLConnection
@@ -103,9 +161,49 @@ typedef NS_ENUM(NSInteger, CURLTransferState) {
 
 - (NSString *)initialFTPPath;
 - (NSString *)primaryIPAddress;
+
+/**
+ CURLINFO_NUM_CONNECTS. Only suitable once transfer has finished.
+
+ @return The number of new connections libcurl had to make for the transfer. Zero means an existing connection was re-used.
+ */
+
+- (NSUInteger)connectCount;
+
+/**
+ The digest of the response body, using the request's curl_digestAlgorithm. Only set once the transfer has finished.
+ */
+
+@property (readonly, copy) NSData *downloadDigest;
+
+/**
+ The digest of the request body that was sent, using the request's curl_digestAlgorithm. Only set once the transfer has finished.
+ */
+
+@property (readonly, copy) NSData *uploadDigest;
+
 + (NSString *)curlVersion;
 + (NSString*)nameForType:(curl_infotype)type;
 
+/**
+ Record the shape of every transfer started from now on, so that the traffic can be replayed offline.
+
+ @param recorder The recorder to use, or nil to stop recording. It's retained until it's replaced.
+ */
+
++ (void)setRecorder:(CURLTransferRecorder*)recorder;
++ (CURLTransferRecorder*)recorder;
+
+/**
+ Answer HTTP requests started from now on from an on-disk cache where their cachePolicy allows, and store
+ what comes back. See CURLHTTPCache for the details.
+
+ @param cache The cache to use, or nil to stop caching. It's retained until it's replaced.
+ */
+
++ (void)setHTTPCache:(CURLHTTPCache*)cache;
++ (CURLHTTPCache*)HTTPCache;
+
 @end
 
 #pragma mark - Old API
@@ -160,6 +258,15 @@ typedef NS_ENUM(NSInteger, CURLTransferState) {
 
 - (void)transfer:(CURLTransfer *)transfer didReceiveResponse:(NSURLResponse *)response;
 
+/**
+ Optional method, called instead of transfer:didReceiveData: when the request has a curl_recordDelimiter.
+
+ @param transfer The transfer receiving the data.
+ @param records The whole records received since the last batch, in order.
+ */
+
+- (void)transfer:(CURLTransfer *)transfer didReceiveRecords:(CURLRecordBatch *)records;
+
 /**
  Sent as the last message related to the transfer. Error may be nil, which implies
  that no error occurred and this task is complete.
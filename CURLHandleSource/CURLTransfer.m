@@ -10,14 +10,24 @@
 #import "CURLTransfer+MultiSupport.h"
 #import "CURLTransfer+TestingSupport.h"
 
+#import "CURLContentDecoder.h"
+#import "CURLContentEncoder.h"
+#import "CURLDigest.h"
+#import "CURLHTTPCache.h"
+#import "CURLHTTPParsing.h"
 #import "CURLList.h"
 #import "CURLMultiHandle.h"
+#import "CURLRecordSplitter.h"
 #import "CURLRequest.h"
+#import "CURLResponseReader+TransferSupport.h"
 #import "CURLResponse.h"
+#import "CURLRetryPolicy.h"
+#import "CURLTransferRecorder.h"
 
 #import "CK2SSHCredential.h"
 
 #include <SystemConfiguration/SystemConfiguration.h>
+#include <arpa/inet.h>
 
 #pragma mark - Constants
 
@@ -45,18 +55,25 @@ NSString *const kInfoNames[] =
 #define __IPHONE_5_0 (__IPHONE_OS_VERSION_MAX_ALLOWED + 1)
 #endif
 
+// How far a compressed upload is allowed to get ahead of libcurl
+static const NSUInteger kUploadEncoderBufferLimit = 256 * 1024;
+
 #pragma mark - Globals
 
 BOOL				sAllowsProxy = YES;		// by default, allow proxy to be used./
 SCDynamicStoreRef	sSCDSRef = NULL;
 NSString			*sProxyUserIDAndPassword = nil;
+CURLTransferRecorder *sRecorder = nil;
+CURLHTTPCache       *sHTTPCache = nil;
 
 #pragma mark - Callback Prototypes
 
 int curlSocketOptFunction(CURLTransfer *self, curl_socket_t curlfd, curlsocktype purpose);
+static curl_socket_t curlOpenSocketFunction(CURLTransfer *self, curlsocktype purpose, struct curl_sockaddr *address);
 static size_t curlBodyFunction(void *ptr, size_t size, size_t nmemb, CURLTransfer *self);
 static size_t curlHeaderFunction(void *ptr, size_t size, size_t nmemb, CURLTransfer *self);
 static size_t curlReadFunction(void *ptr, size_t size, size_t nmemb, CURLTransfer *transfer);
+static int curlSeekFunction(CURLTransfer *self, curl_off_t offset, int origin);
 static int curlDebugFunction(CURL *mCURL, curl_infotype infoType, char *info, size_t infoLength, CURLTransfer *transfer);
 
 static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
@@ -71,6 +88,24 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
 
 - (size_t) curlReceiveDataFrom:(void *)inPtr size:(size_t)inSize number:(size_t)inNumber isHeader:(BOOL)header;
 - (size_t) curlSendDataTo:(void *)inPtr size:(size_t)inSize number:(size_t)inNumber;
+- (BOOL)rewindUploadStream;
+- (BOOL)moveUploadStreamToOffset:(unsigned long long)offset;
+- (BOOL)completeFromHTTPCacheIfPossible;
+- (BOOL)isHTTP;
+- (BOOL)canResumeAfterCode:(CURLcode)code;
+- (CURLcode)prepareToResume;
+- (void)noteResumeValidators;
+- (BOOL)isResumingSameFile;
+- (BOOL)hasReceivedWholeBody;
+- (NSError *)digestErrorForDownload:(BOOL)download;
+- (void)startDecodingIfNeeded;
+- (void)deliverDecodedData:(NSData *)data;
+- (NSString *)uploadContentEncodingForRequest:(NSURLRequest *)request;
+- (BOOL)startEncodingUploadForRequest:(NSURLRequest *)request;
+- (BOOL)isUploadAtEnd;
+- (void)passBodyDataToDelegate:(NSData *)data;
+- (void)passLastRecordToDelegate;
+- (BOOL)reserveSpaceInResponseReaderForLength:(NSUInteger)length;
 
 @property (strong, nonatomic) NSMutableArray* lists;
 @property (strong, nonatomic, readonly) CURLMultiHandle* multi;
@@ -85,6 +120,8 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
 @synthesize error = _error;
 @synthesize lists = _lists;
 @synthesize multi = _multi;
+@synthesize downloadDigest = _downloadDigest;
+@synthesize uploadDigest = _uploadDigest;
 
 
 /*"	CURLTransfer is a wrapper around a CURL.
@@ -164,6 +201,42 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
 	return [NSString stringWithCString: curl_version() encoding:NSASCIIStringEncoding];
 }
 
++ (void)setRecorder:(CURLTransferRecorder *)recorder
+{
+    @synchronized(self)
+    {
+        [recorder retain];
+        [sRecorder release];
+        sRecorder = recorder;
+    }
+}
+
++ (CURLTransferRecorder*)recorder
+{
+    @synchronized(self)
+    {
+        return [[sRecorder retain] autorelease];
+    }
+}
+
++ (void)setHTTPCache:(CURLHTTPCache *)cache
+{
+    @synchronized(self)
+    {
+        [cache retain];
+        [sHTTPCache release];
+        sHTTPCache = cache;
+    }
+}
+
++ (CURLHTTPCache*)HTTPCache
+{
+    @synchronized(self)
+    {
+        return [[sHTTPCache retain] autorelease];
+    }
+}
+
 
 // -----------------------------------------------------------------------------
 #pragma mark Lifecycle
@@ -189,6 +262,10 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
         {
             _delegateQueue = [queue retain];
         }
+        else if (multi.usesExternalEventLoop)
+        {
+            // the delegate is called directly, on the loop's thread
+        }
         else
         {
             // Make our own queue for the delegate to use
@@ -202,13 +279,18 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
         CURLcode code = [self setupRequest:request credential:credential];
         if (code == CURLE_OK)
         {
-            _multi = [multi retain];
-            [multi beginTransfer:self];
+            code = [self setupTimeoutsForRequest:request multi:multi];
         }
-        else
+
+        if (code != CURLE_OK)
         {
             [self completeWithCode:code];
         }
+        else if (![self completeFromHTTPCacheIfPossible])
+        {
+            _multi = [multi retain];
+            [multi beginTransfer:self];
+        }
     }
     
     return self;
@@ -228,6 +310,21 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
 	[_headerBuffer release];
 	[_proxies release];
     [_uploadStream release];
+    [_record release];
+    if (_storingResponse) [_cache abandonStoringResponse:_storingResponse];
+    [_storingResponse release];
+    [_cachedResponse release];
+    [_cache release];
+    [_resumeValidator release];
+    [_credentialUser release];
+    [_receivedDigest release];
+    [_sentDigest release];
+    [_downloadDigest release];
+    [_uploadDigest release];
+    [_digestError release];
+    [_decoder release];
+    [_uploadEncoder release];
+    [_recordSplitter release];
 
     CURLHandleLogDetail(@"dealloced");
     
@@ -413,6 +510,9 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
 {
     CURLcode code = CURLE_OK;
 
+    // a compressed body's length isn't known until it's been sent
+    NSString *uploadEncoding = [self uploadContentEncodingForRequest:request];
+
     NSDictionary* allFields = [request allHTTPHeaderFields];
     NSMutableArray* headers = [NSMutableArray arrayWithCapacity:[allFields count]];
     for (NSString *field in allFields)
@@ -432,7 +532,22 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
         // Accept-Encoding requests are also special
         else if ([field caseInsensitiveCompare:@"Accept-Encoding"] == NSOrderedSame)
         {
-            RETURN_IF_FAILED([self setOption:CURLOPT_ENCODING string:value]);
+            if (_decodesInBackground)
+            {
+                // libcurl hands over the body as it was sent, for a CURLContentDecoder to take care of
+                [headers addObject:[NSString stringWithFormat:@"Accept-Encoding: %@", ([value length] ? value : [CURLContentDecoder acceptedContentEncodings])]];
+                RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_HTTP_CONTENT_DECODING, 0L));
+            }
+            else
+            {
+                RETURN_IF_FAILED([self setOption:CURLOPT_ENCODING string:value]);
+            }
+        }
+
+        else if (uploadEncoding &&
+                 ([field caseInsensitiveCompare:@"Content-Length"] == NSOrderedSame || [field caseInsensitiveCompare:@"Transfer-Encoding"] == NSOrderedSame))
+        {
+            // replaced below
         }
 
         else
@@ -442,6 +557,25 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
         }
     }
 
+    if (uploadEncoding)
+    {
+        [headers addObject:[NSString stringWithFormat:@"Content-Encoding: %@", uploadEncoding]];
+        [headers addObject:@"Transfer-Encoding: chunked"];
+    }
+
+    // carrying on from an interrupted attempt, as long as it's still the same entity
+    if (_isResuming && _resumeValidator)
+    {
+        [headers addObject:[NSString stringWithFormat:@"If-Range: %@", _resumeValidator]];
+    }
+
+    // revalidating what the HTTP cache has
+    if (_cachedResponse && _revalidatesCachedResponse)
+    {
+        if (_cachedResponse.entityTag) [headers addObject:[NSString stringWithFormat:@"If-None-Match: %@", _cachedResponse.entityTag]];
+        if (_cachedResponse.lastModified) [headers addObject:[NSString stringWithFormat:@"If-Modified-Since: %@", _cachedResponse.lastModified]];
+    }
+
     RETURN_IF_FAILED([self setOption:CURLOPT_HTTPHEADER withContentsOfArray:headers]);
 
     return code;
@@ -451,22 +585,38 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
 {
     CURLcode code = CURLE_OK;
     
+    // any earlier encoder is reading a stream of its own, so can be left to finish by itself
+    [_uploadEncoder cancel];
+    [_uploadEncoder release]; _uploadEncoder = nil;
+
     // Set the upload data
+    BOOL encodes = ([self uploadContentEncodingForRequest:request] != nil);
     NSData *uploadData = [request HTTPBody];
     if (uploadData)
     {
         _uploadStream = [[NSInputStream alloc] initWithData:uploadData];
-        RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_INFILESIZE, [uploadData length]));
+        if (!encodes) RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_INFILESIZE, [uploadData length]));
     }
     else
     {
         _uploadStream = [[request HTTPBodyStream] retain];
+
+        // a stream of known length, such as a CURLMultipartFormData body, is sent whole rather than chunked
+        NSString *length = [request valueForHTTPHeaderField:@"Content-Length"];
+        if (_uploadStream && length && !encodes) RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_INFILESIZE_LARGE, (curl_off_t)[length longLongValue]));
     }
 
     if (_uploadStream)
     {
         [_uploadStream open];
+        _uploadStreamSeeks = ([_uploadStream propertyForKey:NSStreamFileCurrentOffsetKey] != nil);    // before anything reads it
         RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_UPLOAD, 1L));
+
+        if (encodes)
+        {
+            if (![self startEncodingUploadForRequest:request]) return CURLE_OUT_OF_MEMORY;
+            RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_INFILESIZE_LARGE, (curl_off_t)-1));
+        }
     }
     else
     {
@@ -505,6 +655,40 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
     return code;
 }
 
+// The first timeout that's been set, of the request's own, the multi's and the fallback. Negative means none.
+static NSTimeInterval CURLChooseTimeout(NSTimeInterval requested, NSTimeInterval multiDefault, NSTimeInterval fallback)
+{
+    if (requested != 0) return requested;
+    if (multiDefault != 0) return multiDefault;
+    return fallback;
+}
+
+- (CURLcode)setupTimeoutsForRequest:(NSURLRequest *)request multi:(CURLMultiHandle *)multi
+{
+    CURLcode code = CURLE_OK;
+
+    // like NSURLConnection, treat timeoutInterval as the longest to wait for the connection, or for any data once connected
+    NSTimeInterval interval = [request timeoutInterval];
+    if (interval <= 0) interval = -1;
+
+    NSTimeInterval connect = CURLChooseTimeout([request curl_connectTimeout], multi.defaultConnectTimeout, interval);
+    NSTimeInterval total = CURLChooseTimeout([request curl_totalTimeout], multi.defaultTotalTimeout, -1);
+    NSTimeInterval stall = CURLChooseTimeout([request curl_stallTimeout], multi.defaultStallTimeout, interval);
+    NSUInteger minimumRate = [request curl_minimumBytesPerSecond];
+    if (minimumRate == 0) minimumRate = multi.defaultMinimumBytesPerSecond;
+    if (minimumRate == 0) minimumRate = 1;
+
+    // libcurl's default name resolver uses signals to time out, which isn't safe with other threads around
+    RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_NOSIGNAL, 1L));
+
+    RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_CONNECTTIMEOUT_MS, (long)(connect > 0 ? ceil(connect * 1000.0) : 0)));
+    RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_TIMEOUT_MS, (long)(total > 0 ? ceil(total * 1000.0) : 0)));
+    RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_LOW_SPEED_TIME, (long)(stall > 0 ? ceil(stall) : 0)));
+    RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_LOW_SPEED_LIMIT, (long)(stall > 0 ? minimumRate : 0)));
+
+    return code;
+}
+
 - (CURLcode)setupRequest:(NSURLRequest *)request credential:(NSURLCredential *)credential
 {
     NSAssert(_executing == NO, @"CURLTransfer instances may not be accessed on multiple threads at once, or re-entrantly");
@@ -514,6 +698,61 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
 
     _request = [request copy];    // assumes caller will have ensured _originalRequest is suitable for overwriting
     [_headerBuffer setLength:0];
+    _attempts = 1;
+    _hasNotifiedDelegate = NO;
+    _usesCredential = (credential != nil);
+    [_credentialUser release]; _credentialUser = [[credential user] copy];
+    [[request curl_retryPolicy] noteRequestToHost:[[request URL] host]];
+
+    _resumes = [request curl_resumesInterruptedTransfers] && [request curl_retryPolicy];
+    _isResuming = NO;
+    _resumeMismatch = NO;
+    _committedLength = 0;
+    _sentLength = 0;
+    [_resumeValidator release]; _resumeValidator = nil;
+    _remoteFileTime = -1;
+    _remoteLength = -1;
+
+    CURLDigestAlgorithm algorithm = [request curl_digestAlgorithm];
+    [_receivedDigest release]; _receivedDigest = (algorithm ? [[CURLDigest alloc] initWithAlgorithm:algorithm] : nil);
+    [_sentDigest release]; _sentDigest = (algorithm ? [[CURLDigest alloc] initWithAlgorithm:algorithm] : nil);
+    [_downloadDigest release]; _downloadDigest = nil;
+    [_uploadDigest release]; _uploadDigest = nil;
+    [_digestError release]; _digestError = nil;
+
+    // a reader's buffer is filled as the body arrives, pausing when it's full, which decoding in the background would get in the way of
+    _responseReader = ([_delegate isKindOfClass:[CURLResponseReader class]] ? (CURLResponseReader *)_delegate : nil);
+
+    // decoding in the background needs somewhere to send the decoded body other than the multi's own thread
+    _decodesInBackground = [request curl_decodesContentInBackground] && _delegateQueue && !_responseReader;
+    [_decoder cancel];
+    [_decoder release]; _decoder = nil;
+
+    // splitting the body up is only worth it for a delegate that can take the records
+    NSInteger delimiter = [request curl_recordDelimiter];
+    [_recordSplitter release];
+    _recordSplitter = ((delimiter >= 0 && [_delegate respondsToSelector:@selector(transfer:didReceiveRecords:)]) ? [[CURLRecordSplitter alloc] initWithDelimiter:(uint8_t)delimiter] : nil);
+
+    // only pay for recording when it's been asked for
+    [_record release];
+    _record = (sRecorder ? [[[CURLTransfer recorder] recordForRequest:request] retain] : nil);
+
+    // likewise the HTTP cache, which gets to look at the request before it's sent
+    [_cache release]; _cache = nil;
+    [_cachedResponse release]; _cachedResponse = nil;
+    _revalidatesCachedResponse = NO;
+    if (sHTTPCache)
+    {
+        CURLHTTPCache *cache = [CURLTransfer HTTPCache];
+        [cache invalidateResponseForRequest:request];
+
+        // a credential is as personal as an Authorization header, even though it's not in the request
+        if (!_usesCredential && [CURLHTTPCache canCacheRequest:request])
+        {
+            _cache = [cache retain];
+            _cachedResponse = [[cache cachedResponseForRequest:request mustRevalidate:&_revalidatesCachedResponse] retain];
+        }
+    }
 
     CURLcode code = CURLE_OK;
 
@@ -535,15 +774,22 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
     RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_SSL_VERIFYPEER, (long)[request curl_shouldVerifySSLCertificate]));
     RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_SSL_VERIFYHOST, (long)(request.curl_shouldVerifySSLHost ? 2 : 0)));
     RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_FTP_USE_EPSV, 0));     // Disable EPSV for FTP transfers. I've found that some servers claim to support EPSV but take a very long time to respond to it, if at all, often causing the overall connection to fail. Note IPv6 connections will ignore this and use EPSV anyway
+    RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_FRESH_CONNECT, (long)[request curl_forcesFreshConnection]));     // hedges need a connection of their own, not the one that's being slow
 
     // functions
     RETURN_IF_FAILED([self setOption:CURLOPT_SOCKOPTFUNCTION data:CURLOPT_SOCKOPTDATA function:curlSocketOptFunction]);
     RETURN_IF_FAILED([self setOption:CURLOPT_WRITEFUNCTION data:CURLOPT_WRITEDATA function:curlBodyFunction]);
     RETURN_IF_FAILED([self setOption:CURLOPT_HEADERFUNCTION data:CURLOPT_HEADERDATA function:curlHeaderFunction]);
     RETURN_IF_FAILED([self setOption:CURLOPT_READFUNCTION data:CURLOPT_READDATA function:curlReadFunction]);
+    RETURN_IF_FAILED([self setOption:CURLOPT_SEEKFUNCTION data:CURLOPT_SEEKDATA function:curlSeekFunction]);
     RETURN_IF_FAILED([self setOption:CURLOPT_DEBUGFUNCTION data:CURLOPT_DEBUGDATA function:curlDebugFunction]);
     RETURN_IF_FAILED([self setOption:CURLOPT_SSH_KEYFUNCTION data:CURLOPT_SSH_KEYDATA function:curlKnownHostsFunction]);
 
+    if ([request curl_connectAddress])
+    {
+        RETURN_IF_FAILED([self setOption:CURLOPT_OPENSOCKETFUNCTION data:CURLOPT_OPENSOCKETDATA function:curlOpenSocketFunction]);
+    }
+
     if (credential)
     {
         RETURN_IF_FAILED([self setupOptionsForCredential:credential]);
@@ -560,6 +806,12 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
     RETURN_IF_FAILED([self setOption:CURLOPT_PREQUOTE withContentsOfArray:[request curl_preTransferCommands]]);
     RETURN_IF_FAILED([self setOption:CURLOPT_POSTQUOTE withContentsOfArray:[request curl_postTransferCommands]]);
 
+    // resuming FTP and SFTP checks the file's modification time hasn't changed, which costs an MDTM
+    if (_resumes && ![self isHTTP])
+    {
+        RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_FILETIME, 1L));
+    }
+
     return CURLE_OK;
 }
 
@@ -573,6 +825,7 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
     // (the curl_easy_reset below should fix this anyway by unregistering the callbacks, but let's be paranoid...)
     [_delegate release]; _delegate = nil;
     [_delegateQueue release]; _delegateQueue = nil;
+    _responseReader = nil;  // not retained; it was the delegate
 
     if (_handle)
     {
@@ -590,7 +843,12 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
         }
     }
     
-    if (_uploadStream)
+    // the encoder has to be done with the stream before it's closed, so it does that itself
+    if (_uploadEncoder)
+    {
+        [_uploadEncoder cancelAndCloseStream];
+    }
+    else if (_uploadStream)
     {
         [_uploadStream close];
     }
@@ -620,6 +878,22 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
         // returning from this method. Deadlock *shouldn't* be possible since client
         // code should always run on _delegateQueue rather than CURLMulti's.
         dispatch_queue_t queue = multi.queue;
+        if (!queue)
+        {
+            // Driven by an external event loop, so we must already be on its thread. The multi
+            // runs the suspension once it's safe to, in case we're being called from a delegate method.
+            if (_state < CURLTransferStateCanceling)
+            {
+                _state = CURLTransferStateCanceling;
+                [multi performBlock:^{
+                    if (_state == CURLTransferStateCompleted) return;   // finished before we got the chance
+                    [multi suspendTransfer:self];
+                    [self completeWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]];
+                }];
+            }
+            return;
+        }
+
         dispatch_sync(queue, ^{
             
             if (_state < CURLTransferStateCanceling)
@@ -649,9 +923,22 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
 - (void)completeWithCode:(CURLcode)code;
 {
     CURLHandleLog(@"completed with %@ code %d", isMultiCode ? @"multi" : @"easy", code);
-    
+
+    // the body was refused because the file isn't the one an earlier attempt started on
+    if (_resumeMismatch && code == CURLE_WRITE_ERROR)
+    {
+        code = CURLE_BAD_DOWNLOAD_RESUME;
+        strlcpy(_errorBuffer, "The file changed while the transfer was being resumed", sizeof(_errorBuffer));
+    }
+
+    [_record recordResultCode:code];
+
     NSError *error = nil;
-    if (code != CURLE_OK)
+    if (_digestError)
+    {
+        error = _digestError;   // a body was stopped for not matching its digest, which is why libcurl gave up
+    }
+    else if (code != CURLE_OK)
     {
         error = [self errorForURL:self.originalRequest.URL code:(CURLcode)code];
         NSAssert(error, @"Failed to created error");
@@ -660,12 +947,81 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
     [self completeWithError:error];
 }
 
+- (void)completeWithCode:(CURLcode)code responseCode:(long)responseCode;
+{
+    CURLHandleLog(@"completed without running, with code %d response %ld", code, responseCode);
+
+    // say what libcurl would have said, had the request been made
+    if (code == CURLE_HTTP_RETURNED_ERROR)
+    {
+        snprintf(_errorBuffer, sizeof(_errorBuffer), "The requested URL returned error: %ld", responseCode);
+    }
+    else
+    {
+        strlcpy(_errorBuffer, curl_easy_strerror(code), sizeof(_errorBuffer));
+    }
+
+    [_record recordResultCode:code];
+    [self completeWithError:[self errorForURL:self.originalRequest.URL code:code responseCode:responseCode]];
+}
+
 - (void)completeWithError:(NSError *)error;
 {
+    // A compressed body may still be being decoded, and all of it has to reach the delegate before the news that the transfer's done
+    if (_decoder)
+    {
+        CURLContentDecoder *decoder = _decoder;
+        _decoder = nil;
+        if (_state == CURLTransferStateCanceling) [decoder cancel];
+
+        [decoder finishWithCompletionHandler:^(NSString *failureReason) {
+
+            // the body being refused part way through is down to the decoder, as is a body that's cut short without libcurl noticing
+            NSError *result = error;
+            BOOL refused = ([[error domain] isEqualToString:CURLcodeErrorDomain] && [error code] == CURLE_WRITE_ERROR);
+            if (failureReason && (!error || refused))
+            {
+                strlcpy(_errorBuffer, [failureReason UTF8String], sizeof(_errorBuffer));
+                result = [self errorForURL:self.originalRequest.URL code:CURLE_BAD_CONTENT_ENCODING];
+            }
+
+            [self completeWithError:result];
+        }];
+
+        [decoder release];
+        return;
+    }
+
+    [self notifyDelegateOfResponseIfNeeded];
+
+    // however well the transfer went, bodies that aren't what was expected are a failure
+    if (!error) error = [self digestErrorForDownload:YES];
+    if (!error) error = [self digestErrorForDownload:NO];
+    _downloadDigest = [[_receivedDigest digest] copy];
+    _uploadDigest = (_uploadStream ? [[_sentDigest digest] copy] : nil);
+
+    if (!error) [self passLastRecordToDelegate];
+
     _error = [error copy];
     _state = CURLTransferStateCompleted;
-    
-    [self notifyDelegateOfResponseIfNeeded];
+
+    // only a complete body is worth caching
+    if (_storingResponse)
+    {
+        if (error)
+        {
+            [_cache abandonStoringResponse:_storingResponse];
+        }
+        else
+        {
+            [_cache finishStoringResponse:_storingResponse];
+        }
+
+        [_storingResponse release]; _storingResponse = nil;
+    }
+
+    [_record finishWithError:error];
+    [_record release]; _record = nil;
     
     if (!error)
     {
@@ -687,6 +1043,459 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
     }
 }
 
+/*" Answers the request from the HTTP cache, if it has a fresh response (or the request's cachePolicy says any response will do).
+    Nothing is sent, so the transfer never goes near a multi.
+"*/
+
+- (BOOL)completeFromHTTPCacheIfPossible;
+{
+    if (!_cache) return NO;
+
+    if (!_cachedResponse || _revalidatesCachedResponse)
+    {
+        if ([_request cachePolicy] != NSURLRequestReturnCacheDataDontLoad) return NO;
+
+        // told not to load, but there was nothing to give
+        [_record release]; _record = nil;
+        [self completeWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorResourceUnavailable userInfo:@{ NSURLErrorFailingURLErrorKey : [_request URL] }]];
+        return YES;
+    }
+
+    CURLHandleLog(@"answered from the HTTP cache");
+
+    // nothing went over the wire, so there's nothing to record
+    [_record release]; _record = nil;
+
+    NSURLResponse *response = [CURLResponse responseWithURL:_cachedResponse.URL statusCode:_cachedResponse.statusCode headerString:_cachedResponse.headerString];
+    NSData *data = _cachedResponse.data;
+    _hasNotifiedDelegate = YES;
+
+    [self tryToPerformSelectorOnDelegate:@selector(transfer:didReceiveResponse:) usingBlock:^{
+        [self.delegate transfer:self didReceiveResponse:response];
+    }];
+
+    if ([data length])
+    {
+        [_receivedDigest updateWithData:data];
+        [self passBodyDataToDelegate:data];
+    }
+
+    [self completeWithError:nil];
+    return YES;
+}
+
+#pragma mark Coalescing
+
+- (BOOL)usesCredential;
+{
+    return _usesCredential;
+}
+
+- (NSString *)credentialUser;
+{
+    return _credentialUser;
+}
+
+- (void)deliverResponse:(NSURLResponse *)response;
+{
+    _hasNotifiedDelegate = YES;
+    [self tryToPerformSelectorOnDelegate:@selector(transfer:didReceiveResponse:) usingBlock:^{
+        [self.delegate transfer:self didReceiveResponse:response];
+    }];
+}
+
+- (void)deliverData:(NSData *)data;
+{
+    [_receivedDigest updateWithData:data];
+    _hasNotifiedDelegate = YES;
+    [self passBodyDataToDelegate:data];
+}
+
+#pragma mark Retrying
+
+- (NSTimeInterval)retryDelayAfterCode:(CURLcode)code;
+{
+    CURLRetryPolicy *policy = [_request curl_retryPolicy];
+    if (!policy || _state >= CURLTransferStateCanceling || _digestError) return -1;
+
+    // once the delegate has seen a response or data, the only way to go again is to carry on from where it got to
+    if (_hasNotifiedDelegate && ![self canResumeAfterCode:code]) return -1;
+
+    long statusCode = 0;
+    curl_easy_getinfo(_handle, CURLINFO_RESPONSE_CODE, &statusCode);
+
+    // can't go again if the upload can't be sent again
+    if (![policy shouldRetryCode:code statusCode:statusCode] || ![self rewindUploadStream]) return -1;
+
+    NSTimeInterval delay = [policy retryDelayAfterAttempt:_attempts code:code statusCode:statusCode host:[[_request URL] host]];
+    if (delay >= 0)
+    {
+        CURLHandleLog(@"retrying after code %d (status %ld) in %.3fs", code, statusCode, delay);
+        ++_attempts;
+        [_headerBuffer setLength:0];    // the failed attempt's headers were never reported
+
+        if ([self prepareToResume] != CURLE_OK) return -1;
+    }
+
+    return delay;
+}
+
+#pragma mark Resuming
+
+- (BOOL)isHTTP;
+{
+    NSString *scheme = [[[_request URL] scheme] lowercaseString];
+    return [scheme isEqualToString:@"http"] || [scheme isEqualToString:@"https"];
+}
+
+/*" Whether a download the delegate has already seen some of can carry on from where it got to.
+"*/
+
+- (BOOL)canResumeAfterCode:(CURLcode)code;
+{
+    if (!_resumes || _resumeMismatch || _uploadStream) return NO;
+
+    // the server can't do it, or the file has changed
+    if (code == CURLE_RANGE_ERROR || code == CURLE_BAD_DOWNLOAD_RESUME) return NO;
+
+    // a range of its own would fight with the resume offset
+    if ([_request valueForHTTPHeaderField:@"Range"]) return NO;
+
+    // HTTP can only be sure it's getting the rest of the same entity with If-Range
+    if ([self isHTTP] && !_resumeValidator) return NO;
+
+    return YES;
+}
+
+/*" Sets up the next attempt to carry on from where the failed one got to, if it should.
+    Downloads start from however much the delegate has been given; FTP and SFTP uploads which got as far as
+    sending something start from the size of the remote file, which libcurl asks the server for (and moves the
+    upload stream on to, through curlSeekFunction).
+"*/
+
+- (CURLcode)prepareToResume;
+{
+    CURLcode code = CURLE_OK;
+    if (!_resumes) return code;
+
+    if (_hasNotifiedDelegate)
+    {
+        CURLHandleLog(@"resuming from %llu", _committedLength);
+        _isResuming = YES;
+        RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_RESUME_FROM_LARGE, (curl_off_t)_committedLength));
+        if ([self isHTTP]) RETURN_IF_FAILED([self setupHeadersForRequest:_request]);
+    }
+    else if (_uploadStream && _sentLength && ![self isHTTP])
+    {
+        // the first attempt replaced whatever was there, so what the server has now came from us
+        CURLHandleLog(@"resuming upload from the remote size");
+        RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_RESUME_FROM_LARGE, (curl_off_t)-1));
+    }
+
+    _sentLength = 0;
+    return code;
+}
+
+/*" Remembers what to check the file against, should the transfer need resuming. Called as the body starts arriving.
+"*/
+
+- (void)noteResumeValidators;
+{
+    if ([self isHTTP])
+    {
+        NSString *headerString = [[NSString alloc] initWithData:_headerBuffer encoding:NSASCIIStringEncoding];
+        NSDictionary *fields = [headerString allHTTPHeaderFields];
+        [headerString release];
+
+        NSString *entityTag = nil;
+        NSString *lastModified = nil;
+        for (NSString *key in fields)
+        {
+            if ([key caseInsensitiveCompare:@"Content-Encoding"] == NSOrderedSame) return;  // the offset would be into the decoded body
+            if ([key caseInsensitiveCompare:@"ETag"] == NSOrderedSame) entityTag = [fields objectForKey:key];
+            if ([key caseInsensitiveCompare:@"Last-Modified"] == NSOrderedSame) lastModified = [fields objectForKey:key];
+        }
+
+        // If-Range needs a strong validator
+        _resumeValidator = [((entityTag && ![entityTag hasPrefix:@"W/"]) ? entityTag : lastModified) copy];
+    }
+    else
+    {
+        curl_easy_getinfo(_handle, CURLINFO_FILETIME, &_remoteFileTime);
+        curl_easy_getinfo(_handle, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &_remoteLength);
+    }
+}
+
+/*" Checks the body a resumed attempt is getting is from the same file as before. HTTP leaves that to If-Range,
+    which libcurl enforces by failing with CURLE_RANGE_ERROR if the whole entity comes back instead.
+"*/
+
+- (BOOL)isResumingSameFile;
+{
+    if ([self isHTTP]) return YES;
+
+    long fileTime = -1;
+    curl_easy_getinfo(_handle, CURLINFO_FILETIME, &fileTime);
+    if (fileTime >= 0 && _remoteFileTime >= 0 && fileTime != _remoteFileTime) return NO;
+
+    // libcurl reports either the whole size or just what's left, depending on how the server answered
+    double length = -1;
+    curl_easy_getinfo(_handle, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &length);
+    if (length >= 0 && _remoteLength >= 0 && length != _remoteLength && length + _committedLength != _remoteLength) return NO;
+
+    return YES;
+}
+
+/*" Put the upload back to the start, either for a retry or because libcurl needs to send it again (after an auth challenge, say).
+    Streams are rewound in place if they support it; a body supplied as data just gets a fresh stream over the same bytes.
+"*/
+
+- (BOOL)rewindUploadStream;
+{
+    return [self moveUploadStreamToOffset:0];
+}
+
+/*" Moves the upload on to somewhere else, for resuming an upload part way through.
+"*/
+
+- (BOOL)moveUploadStreamToOffset:(unsigned long long)offset;
+{
+    if (!_uploadStream) return (offset == 0);
+
+    // a digest has to see everything, so libcurl is left to read through to the offset instead
+    if (_sentDigest)
+    {
+        if (offset) return NO;
+        [_sentDigest reset];
+    }
+
+    // offsets into a compressed body don't correspond to anywhere in the stream, so it can only start over. The encoder
+    // may be in the middle of reading the stream, and this is on the multi's queue, so rather than waiting for it the
+    // next encoder rewinds the stream once it's free
+    if (_uploadEncoder)
+    {
+        if (offset) return NO;
+        if (![_request HTTPBody]) return (_uploadStreamSeeks && [self startEncodingUploadForRequest:_request]);
+    }
+
+    BOOL moved = NO;
+    if (!_uploadEncoder && [_uploadStream setProperty:@(offset) forKey:NSStreamFileCurrentOffsetKey])
+    {
+        moved = YES;
+    }
+    else
+    {
+        NSData *uploadData = [_request HTTPBody];
+        if (uploadData && offset <= [uploadData length])
+        {
+            if (_uploadEncoder) [_uploadEncoder cancelAndCloseStream];
+            else [_uploadStream close];
+            [_uploadStream release];
+            _uploadStream = [[NSInputStream alloc] initWithData:(offset ? [uploadData subdataWithRange:NSMakeRange((NSUInteger)offset, [uploadData length] - (NSUInteger)offset)] : uploadData)];
+            [_uploadStream open];
+            moved = YES;
+        }
+    }
+
+    if (moved && _uploadEncoder)
+    {
+        moved = [self startEncodingUploadForRequest:_request];
+    }
+
+    return moved;
+}
+
+#pragma mark Compressing Uploads
+
+/*" The Content-Encoding to compress the request's body with, or nil to send it as it is.
+"*/
+
+- (NSString *)uploadContentEncodingForRequest:(NSURLRequest *)request;
+{
+    NSString *encoding = [request curl_uploadContentEncoding];
+    if (![CURLContentEncoder canEncodeContentEncoding:encoding]) return nil;
+
+    NSString *scheme = [[[request URL] scheme] lowercaseString];
+    if (!([scheme isEqualToString:@"http"] || [scheme isEqualToString:@"https"])) return nil;
+
+    // the caller may have already encoded it themselves
+    if ([request valueForHTTPHeaderField:@"Content-Encoding"]) return nil;
+
+    unsigned long long minimum = [request curl_minimumCompressedUploadLength];
+    NSData *body = [request HTTPBody];
+    if (body)
+    {
+        if ([body length] < minimum) return nil;
+    }
+    else if ([request HTTPBodyStream])
+    {
+        NSString *length = [request valueForHTTPHeaderField:@"Content-Length"];
+        if (length && (unsigned long long)[length longLongValue] < minimum) return nil;
+    }
+    else
+    {
+        return nil;
+    }
+
+    return [encoding stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+}
+
+/*" Starts compressing _uploadStream from where it is, in place of any earlier encoder.
+"*/
+
+- (BOOL)startEncodingUploadForRequest:(NSURLRequest *)request;
+{
+    CURLContentEncoder *previous = _uploadEncoder;
+    _uploadEncoder = [[CURLContentEncoder alloc] initWithContentEncoding:[self uploadContentEncodingForRequest:request]
+                                                                   level:[request curl_uploadCompressionLevel]
+                                                             inputStream:_uploadStream
+                                                             bufferLimit:kUploadEncoderBufferLimit
+                                                        replacingEncoder:previous];
+    [previous cancel];
+    [previous release];
+
+    return (_uploadEncoder != nil);
+}
+
+/*" Whether the upload has been read all the way through, without waiting for a read to return 0.
+    A compressed upload only knows it's done once the encoder says so, whatever state its stream is in.
+"*/
+
+- (BOOL)isUploadAtEnd;
+{
+    return (!_uploadEncoder && _uploadStream.streamStatus == NSStreamStatusAtEnd);
+}
+
+#pragma mark Digests
+
+/*" Whether the body has all arrived, as far as can be told from its length.
+"*/
+
+- (BOOL)hasReceivedWholeBody;
+{
+    double length = -1;
+    double received = 0;
+    curl_easy_getinfo(_handle, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &length);
+    curl_easy_getinfo(_handle, CURLINFO_SIZE_DOWNLOAD, &received);
+
+    return (length > 0 && received >= length);
+}
+
+/*" The error for a body not matching the digest the request expects of it, or nil if it matches (or nothing's expected).
+"*/
+
+- (NSError *)digestErrorForDownload:(BOOL)download;
+{
+    NSData *expected = (download ? [_request curl_expectedDownloadDigest] : [_request curl_expectedUploadDigest]);
+    CURLDigest *digest = (download ? _receivedDigest : _sentDigest);
+    if (!expected || !digest) return nil;
+
+    NSData *actual = [digest digest];
+    if ([actual isEqualToData:expected]) return nil;
+
+    NSURL *url = [_request URL];
+    NSString *description = (download ? @"The response body doesn't match its expected digest" : @"The request body doesn't match its expected digest");
+    CURLHandleLog(@"%@: expected %@, got %@", description, expected, actual);
+
+    NSDictionary *userInfo = @{ NSURLErrorFailingURLErrorKey : url,
+                                NSURLErrorFailingURLStringErrorKey : [url absoluteString],
+                                NSLocalizedDescriptionKey : description,
+                                CURLDigestExpectedDigestKey : expected,
+                                CURLDigestActualDigestKey : actual };
+
+    return [NSError errorWithDomain:CURLDigestErrorDomain code:CURLDigestErrorMismatch userInfo:userInfo];
+}
+
+#pragma mark Decoding
+
+/*" Sets up a decoder for the body, if the response says it's compressed. Called as the body starts arriving.
+"*/
+
+- (void)startDecodingIfNeeded;
+{
+    NSString *headerString = [[NSString alloc] initWithData:_headerBuffer encoding:NSASCIIStringEncoding];
+    NSDictionary *fields = [headerString allHTTPHeaderFields];
+    [headerString release];
+
+    for (NSString *key in fields)
+    {
+        if ([key caseInsensitiveCompare:@"Content-Encoding"] != NSOrderedSame) continue;
+
+        NSString *encoding = [fields objectForKey:key];
+        if ([CURLContentDecoder canDecodeContentEncoding:encoding])
+        {
+            _decoder = [[CURLContentDecoder alloc] initWithContentEncoding:encoding outputHandler:^(NSData *decoded) {
+                [self deliverDecodedData:decoded];
+            }];
+        }
+        break;
+    }
+}
+
+/*" Passes on a piece of the decoded body. Called on the decoder's queue, which keeps the pieces in order.
+"*/
+
+- (void)deliverDecodedData:(NSData *)data;
+{
+    [_receivedDigest updateWithData:data];
+    if (_storingResponse) [_cache appendData:data toResponse:_storingResponse];
+
+    [self passBodyDataToDelegate:data];
+}
+
+#pragma mark Records
+
+/*" Passes on a piece of the body, as records if the delegate wants them that way, or as it is.
+"*/
+
+- (void)passBodyDataToDelegate:(NSData *)data;
+{
+    if (_recordSplitter)
+    {
+        CURLRecordBatch *records = [_recordSplitter batchBySplittingData:data];
+        if (records) [self tryToPerformSelectorOnDelegate:@selector(transfer:didReceiveRecords:) usingBlock:^{
+            [self.delegate transfer:self didReceiveRecords:records];
+        }];
+        return;
+    }
+
+    [self tryToPerformSelectorOnDelegate:@selector(transfer:didReceiveData:) usingBlock:^{
+        [self.delegate transfer:self didReceiveData:data];
+    }];
+}
+
+/*" A body that didn't end with a delimiter still has a record to pass on. Only called once the whole body has arrived.
+"*/
+
+- (void)passLastRecordToDelegate;
+{
+    CURLRecordBatch *records = [_recordSplitter finish];
+    if (records) [self tryToPerformSelectorOnDelegate:@selector(transfer:didReceiveRecords:) usingBlock:^{
+        [self.delegate transfer:self didReceiveRecords:records];
+    }];
+}
+
+#pragma mark Response Readers
+
+/*" Whether the reader has room for the next piece of the body. If not, the transfer pauses until the reader has been
+    drained, which happens on the reading thread; the multi picks the transfer up again on its own queue.
+"*/
+
+- (BOOL)reserveSpaceInResponseReaderForLength:(NSUInteger)length;
+{
+    if (!_responseReader.resumeHandler)
+    {
+        CURLMultiHandle *multi = self.multi;
+        _responseReader.resumeHandler = ^{
+            [multi performBlock:^{
+                if (_executing) curl_easy_pause(_handle, CURLPAUSE_CONT);
+            }];
+        };
+    }
+
+    return [_responseReader reserveSpaceForLength:length];
+}
+
 #pragma mark Synchronous Loading
 
 - (void)sendSynchronousRequest:(NSURLRequest *)request credential:(NSURLCredential *)credential delegate:(id <CURLTransferDelegate>)delegate;
@@ -698,9 +1507,15 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
     
     [_request release]; // -setupRequest: will fill it back in
     CURLcode result = [self setupRequest:request credential:credential];
-    
+
     if (result == CURLE_OK)
     {
+        result = [self setupTimeoutsForRequest:request multi:nil];
+    }
+
+    if (result == CURLE_OK)
+    {
+        if ([self completeFromHTTPCacheIfPossible]) return;
         result = curl_easy_perform(self.curlHandle);
     }
     
@@ -726,9 +1541,25 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
                               encoding:NSUTF8StringEncoding];  // guessing here!
 }
 
+- (NSUInteger)connectCount;
+{
+    long count;
+    if (curl_easy_getinfo(_handle, CURLINFO_NUM_CONNECTS, &count) != CURLE_OK) return 0;
+
+    return count;
+}
+
 #pragma mark Error Construction
 
 - (NSError*)errorForURL:(NSURL*)url code:(CURLcode)code
+{
+    long responseCode = 0;
+    curl_easy_getinfo(_handle, CURLINFO_RESPONSE_CODE, &responseCode);
+
+    return [self errorForURL:url code:code responseCode:responseCode];
+}
+
+- (NSError*)errorForURL:(NSURL*)url code:(CURLcode)code responseCode:(long)responseCode
 {
     NSMutableDictionary *userInfo = [[NSMutableDictionary alloc] initWithObjectsAndKeys:
                                      url, NSURLErrorFailingURLErrorKey,
@@ -737,8 +1568,7 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
                                      [NSString stringWithUTF8String:curl_easy_strerror(code)], NSLocalizedFailureReasonErrorKey,
                                      nil];
     
-    long responseCode;
-    if (curl_easy_getinfo(_handle, CURLINFO_RESPONSE_CODE, &responseCode) == CURLE_OK && responseCode)
+    if (responseCode)
     {
         [userInfo setObject:[NSNumber numberWithLong:responseCode] forKey:@(CURLINFO_RESPONSE_CODE)];
     }
@@ -919,6 +1749,13 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
 
 - (void)notifyDelegateOfResponseIfNeeded;
 {
+    // A resumed attempt's response isn't news to the delegate
+    if (_isResuming)
+    {
+        [_headerBuffer setLength:0];
+        return;
+    }
+
     // If a response has been buffered, send that off
     if ([_headerBuffer length])
     {
@@ -928,6 +1765,8 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
         long code;
         if (curl_easy_getinfo(_handle, CURLINFO_RESPONSE_CODE, &code) == CURLE_OK)
         {
+            [_record recordResponseWithStatusCode:code headers:headerString];
+
             char *urlBuffer;
             if (curl_easy_getinfo(_handle, CURLINFO_EFFECTIVE_URL, &urlBuffer) == CURLE_OK)
             {
@@ -937,12 +1776,34 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
                     NSURL *url = [[NSURL alloc] initWithString:urlString];
                     if (url)
                     {
+                        NSData *cachedData = nil;
+                        if (_cachedResponse && code == 304)
+                        {
+                            // what the HTTP cache has is still good, so carry on as if it had been sent again
+                            [_cache updateResponse:_cachedResponse withNotModifiedHeaderString:headerString];
+                            code = _cachedResponse.statusCode;
+                            [headerString release];
+                            headerString = [_cachedResponse.headerString copy];
+                            cachedData = _cachedResponse.data;
+                        }
+                        else if (_cache)
+                        {
+                            _storingResponse = [[_cache storeResponseToRequest:_request URL:url statusCode:code headerString:headerString] retain];
+                        }
+
                         NSURLResponse *response = [CURLResponse responseWithURL:url statusCode:code headerString:headerString];
+                        _hasNotifiedDelegate = YES;
                         
                         [self tryToPerformSelectorOnDelegate:@selector(transfer:didReceiveResponse:) usingBlock:^{
                             [self.delegate transfer:self didReceiveResponse:response];
                         }];
 
+                        if ([cachedData length])
+                        {
+                            [_receivedDigest updateWithData:cachedData];
+                            [self passBodyDataToDelegate:cachedData];
+                        }
+
                         [url release];
                     }
 
@@ -967,25 +1828,73 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
 
 	if (self.state < CURLTransferStateCanceling || self.multi)
 	{
+        // A reader with no room pauses the transfer before anything else sees the data, since libcurl will hand it over again
+        BOOL fillsReader = (!header && _responseReader && self.multi.queue);
+        if (fillsReader && ![self reserveSpaceInResponseReaderForLength:written]) return CURL_WRITEFUNC_PAUSE;
+
         NSData *data = [NSData dataWithBytes:inPtr length:written];
+        [_record recordReceivedBytes:inPtr length:written isHeader:header];
 
 		if (header)
 		{
-            // Delegate might not care about the response
-            if ([self.delegate respondsToSelector:@selector(transfer:didReceiveResponse:)])
+            // Delegate might not care about the response (but a recorder, the HTTP cache, resuming or decoding always does)
+            if (_record || _cache || _resumes || _decodesInBackground || [self.delegate respondsToSelector:@selector(transfer:didReceiveResponse:)])
             {
                 [_headerBuffer appendData:data];
             }
 		}
 		else
 		{
-            // Once the body starts arriving, we know we have the full header, so can report that
-            [self notifyDelegateOfResponseIfNeeded];
+            if (_isResuming)
+            {
+                // The delegate already has the response, so this just needs to be more of the same file
+                if (![self isResumingSameFile])
+                {
+                    _resumeMismatch = YES;
+                    return 0;
+                }
+
+                _isResuming = NO;
+                [_headerBuffer setLength:0];
+            }
+            else
+            {
+                // Once the body starts arriving, we know we have the full header, so can report that
+                if (_resumes && !_hasNotifiedDelegate) [self noteResumeValidators];
+                if (_decodesInBackground && !_hasNotifiedDelegate) [self startDecodingIfNeeded];
+                [self notifyDelegateOfResponseIfNeeded];
+            }
+
+            // A compressed body goes off to be decoded, and on to the delegate from there
+            if (_decoder)
+            {
+                if (_decoder.failed) return 0;
+
+                _hasNotifiedDelegate = YES;
+                [_decoder decodeData:data];
+                return written;
+            }
+
+            // A body that turns out not to be the one expected is stopped before its last piece is passed on
+            [_receivedDigest updateWithData:data];
+            if (_receivedDigest && [self hasReceivedWholeBody] && (_digestError = [[self digestErrorForDownload:YES] retain]))
+            {
+                return 0;
+            }
+
+            if (_storingResponse) [_cache appendData:data toResponse:_storingResponse];
 
             // Report regular body data
-            [self tryToPerformSelectorOnDelegate:@selector(transfer:didReceiveData:) usingBlock:^{
-                [self.delegate transfer:self didReceiveData:data];
-            }];
+            _hasNotifiedDelegate = YES;
+            _committedLength += written;
+            if (fillsReader)
+            {
+                [_responseReader writeBytes:inPtr length:written];
+            }
+            else
+            {
+                [self passBodyDataToDelegate:data];
+            }
 		}
 	}
     else
@@ -1003,7 +1912,28 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
 
     if (self.state < CURLTransferStateCanceling || self.multi)
     {
-        result = [_uploadStream read:inPtr maxLength:inSize * inNumber];
+        if (_uploadEncoder)
+        {
+            // a multi on a queue of its own mustn't wait for the compression to catch up, so the transfer pauses instead
+            CURLMultiHandle *multi = self.multi;
+            BOOL wait = (multi.queue == NULL);
+            if (!wait && !_uploadEncoder.readyHandler)
+            {
+                _uploadEncoder.readyHandler = ^{
+                    [multi performBlock:^{
+                        if (_executing) curl_easy_pause(_handle, CURLPAUSE_CONT);
+                    }];
+                };
+            }
+
+            result = [_uploadEncoder read:inPtr maxLength:inSize * inNumber waitUntilReady:wait];
+            if (result == CURLContentEncoderNotReady) return CURL_READFUNC_PAUSE;
+        }
+        else
+        {
+            result = [_uploadStream read:inPtr maxLength:inSize * inNumber];
+        }
+
         if (result < 0)
         {
             [self tryToPerformSelectorOnDelegate:@selector(transfer:didReceiveDebugInformation:ofType:) usingBlock:^{
@@ -1018,11 +1948,24 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
             return CURL_READFUNC_ABORT;
         }
 
+        if (result > 0)
+        {
+            [_record recordSentLength:result];
+            [_sentDigest updateWithBytes:inPtr length:result];
+            _sentLength += result;
+        }
+
+        // Likewise an upload is stopped before its last piece goes out
+        if ((result == 0 || [self isUploadAtEnd]) && (_digestError = [[self digestErrorForDownload:NO] retain]))
+        {
+            return CURL_READFUNC_ABORT;
+        }
+
         if (result >= 0) [self tryToPerformSelectorOnDelegate:@selector(transfer:willSendBodyDataOfLength:) usingBlock:^{
             
             CURLHandleLog(@"sending %ld bytes (max %ld) from %p", (size_t)result, inSize*inNumber, inPtr);
             [self.delegate transfer:self willSendBodyDataOfLength:result];
-            if (_uploadStream.streamStatus == NSStreamStatusAtEnd)
+            if ([self isUploadAtEnd])
             {
                 [self.delegate transfer:self willSendBodyDataOfLength:0];
             }
@@ -1142,6 +2085,36 @@ int curlSocketOptFunction(CURLTransfer *self, curl_socket_t curlfd, curlsocktype
     return 0;
 }
 
+/*"	Callback to open a socket, used to point the connection at the request's curl_connectAddress.
+ "*/
+
+curl_socket_t curlOpenSocketFunction(CURLTransfer *self, curlsocktype purpose, struct curl_sockaddr *address)
+{
+    NSString *connectAddress = [self.originalRequest curl_connectAddress];
+    if (purpose == CURLSOCKTYPE_IPCXN && connectAddress)
+    {
+        // keep the port libcurl chose, just swap the host's address for ours
+        // (libcurl backs address->addr with enough storage for the family it was resolved as)
+        const char *string = [connectAddress UTF8String];
+        int converted = 0;
+        if (address->family == AF_INET)
+        {
+            converted = inet_pton(AF_INET, string, &((struct sockaddr_in *)&address->addr)->sin_addr);
+        }
+        else if (address->family == AF_INET6)
+        {
+            converted = inet_pton(AF_INET6, string, &((struct sockaddr_in6 *)&address->addr)->sin6_addr);
+        }
+
+        if (converted != 1)
+        {
+            CURLHandleLog(@"Unable to connect to %@ instead of the resolved address", connectAddress);
+        }
+    }
+
+    return socket(address->family, address->socktype, address->protocol);
+}
+
 /*"	Callback from reading a chunk of data.  Since we pass "self" in as the "data pointer",
  we can use that to get back into Objective C and do the work with the class.
  "*/
@@ -1169,6 +2142,19 @@ size_t curlReadFunction( void *ptr, size_t size, size_t nmemb, CURLTransfer *sel
     return [self curlSendDataTo:ptr size:size number:nmemb];
 }
 
+/*"	Callback asking us to move the upload to a new position: back to the start, or on to where a resumed upload carries on from.
+ "*/
+
+int curlSeekFunction(CURLTransfer *self, curl_off_t offset, int origin)
+{
+    if (offset >= 0 && origin == SEEK_SET && [self moveUploadStreamToOffset:offset])
+    {
+        return CURL_SEEKFUNC_OK;
+    }
+
+    return CURL_SEEKFUNC_CANTSEEK;
+}
+
 int curlKnownHostsFunction(CURL *easy,     /* easy handle */
                            const struct curl_khkey *knownkey, /* known */
                            const struct curl_khkey *foundkey, /* found */
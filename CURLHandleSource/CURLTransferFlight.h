@@ -0,0 +1,100 @@
+//
+//  CURLTransferFlight.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "CURLTransfer.h"
+#import "CURLMultiHandle.h"
+
+/**
+ * Internal record of a request that's out on the network on behalf of several identical transfers.
+ * CURLMultiHandle uses this internally, when coalescesRequests is on - not intended for public consumption.
+ *
+ * The flight makes one transfer of its own, and passes the response and data it gets on to each of the
+ * transfers attached to it. Once the response has arrived, anyone turning up later would miss the start
+ * of the body, so the flight takes no more transfers.
+ */
+
+@interface CURLTransferFlight : NSObject <CURLTransferDelegate>
+{
+    NSString        *_key;
+    NSURLRequest    *_request;
+    CURLMultiHandle *_multi;
+    CURLTransfer    *_transfer;
+    NSMutableArray  *_transfers;
+    BOOL            _isClosed;
+}
+
+/**
+ * The key that identical requests share.
+ *
+ * @param request The request.
+ * @return The normalised URL, the request's headers, its timeout and cache policy, and every curl_ option,
+ * or nil for requests that can't be coalesced: anything other than an HTTP GET without a body, and URLs with a login.
+ * Retry policies match only if they're the same object.
+ */
+
++ (NSString*)keyForRequest:(NSURLRequest*)request;
+
+- (id)initWithRequest:(NSURLRequest*)request key:(NSString*)key multi:(CURLMultiHandle*)multi;
+
+@property (readonly, copy, nonatomic) NSString* key;
+
+/** The flight's own transfer, once it has been started. */
+@property (readonly, strong, nonatomic) CURLTransfer* transfer;
+
+/**
+ * Attach a transfer, to be given the response, data and result of the flight's own.
+ *
+ * @param transfer The transfer.
+ * @return NO if the flight has already got its response, and so can't take any more.
+ */
+
+- (BOOL)addTransfer:(CURLTransfer*)transfer;
+
+/**
+ * Detach a transfer, which hears nothing more from the flight.
+ *
+ * @param transfer The transfer.
+ * @return YES if it was the last one attached.
+ */
+
+- (BOOL)removeTransfer:(CURLTransfer*)transfer;
+
+/**
+ * Detach everything, once the flight has finished.
+ *
+ * @return The transfers that were attached.
+ */
+
+- (NSArray*)removeAllTransfers;
+
+/**
+ * Send the flight's own transfer out, on the multi it was made with.
+ */
+
+- (void)start;
+
+@end
+
+
+@interface CURLMultiHandle(CURLTransferFlight)
+
+/**
+ * Called by <CURLTransferFlight> on the multi's queue (via -performBlock:), once its own transfer has finished
+ * and passed on everything it received, to complete the transfers attached to it.
+ *
+ * @warning Not intended for general use.
+ *
+ * @param flight The flight.
+ * @param error The failure error if there was one.
+ */
+
+- (void)finishFlight:(CURLTransferFlight*)flight error:(NSError*)error;
+
+@end
@@ -0,0 +1,182 @@
+//
+//  CURLTransferFlight.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLTransferFlight.h"
+
+#import "CURLNegativeCache.h"
+#import "CURLRequest.h"
+#import "CURLTransfer+MultiSupport.h"
+
+@implementation CURLTransferFlight
+
+@synthesize key = _key;
+@synthesize transfer = _transfer;
+
++ (NSString*)keyForRequest:(NSURLRequest *)request
+{
+    NSURL* url = [request URL];
+    NSString* scheme = [[url scheme] lowercaseString];
+    if (!([scheme isEqualToString:@"http"] || [scheme isEqualToString:@"https"])) return nil;
+    if ([url user]) return nil;     // the normalised URL leaves the password out
+
+    NSString* method = [request HTTPMethod];
+    if (method && ![method isEqualToString:@"GET"]) return nil;
+    if ([request HTTPBody] || [request HTTPBodyStream]) return nil;
+
+    // any of the headers might turn out to be one the response varies by, so they all have to match
+    NSMutableString* result = [NSMutableString stringWithString:[CURLNegativeCache normalizedStringForURL:url]];
+    NSDictionary* headers = [request allHTTPHeaderFields];
+    for (NSString* name in [[headers allKeys] sortedArrayUsingSelector:@selector(caseInsensitiveCompare:)])
+    {
+        [result appendFormat:@"\n%@: %@", [name lowercaseString], [headers objectForKey:name]];
+    }
+
+    // likewise somewhere else to connect to
+    NSString* address = [request curl_connectAddress];
+    if (address) [result appendFormat:@"\n@%@", address];
+
+    // and every option that changes how the transfer behaves, since attached transfers get whatever the sent one did
+    [result appendFormat:@"\ntimeout %g cache %lu ssl %d/%d/%d fresh %d known-hosts %@",
+     [request timeoutInterval], (unsigned long)[request cachePolicy],
+     (int)[request curl_desiredSSLLevel], [request curl_shouldVerifySSLCertificate], [request curl_shouldVerifySSLHost],
+     [request curl_forcesFreshConnection], [[request curl_SSHKnownHostsFileURL] absoluteString]];
+    [result appendFormat:@"\nretry %p resume %d connect %g total %g stall %g/%lu",
+     [request curl_retryPolicy], [request curl_resumesInterruptedTransfers],
+     [request curl_connectTimeout], [request curl_totalTimeout], [request curl_stallTimeout], (unsigned long)[request curl_minimumBytesPerSecond]];
+    [result appendFormat:@"\ndigest %d %@/%@ background %d records %ld",
+     (int)[request curl_digestAlgorithm], [request curl_expectedDownloadDigest], [request curl_expectedUploadDigest],
+     [request curl_decodesContentInBackground], (long)[request curl_recordDelimiter]];
+    [result appendFormat:@"\nupload %@/%ld/%llu directories %lu permissions %@/%@ commands %@/%@",
+     [request curl_uploadContentEncoding], (long)[request curl_uploadCompressionLevel], [request curl_minimumCompressedUploadLength],
+     (unsigned long)[request curl_createIntermediateDirectories], [request curl_newFilePermissions], [request curl_newDirectoryPermissions],
+     [request curl_preTransferCommands], [request curl_postTransferCommands]];
+
+    return result;
+}
+
+- (id)initWithRequest:(NSURLRequest *)request key:(NSString *)key multi:(CURLMultiHandle *)multi
+{
+    if (self = [super init])
+    {
+        _key = [key copy];
+        _request = [request copy];
+        _multi = [multi retain];
+        _transfers = [[NSMutableArray alloc] init];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_key release];
+    [_request release];
+    [_multi release];
+    [_transfer release];
+    [_transfers release];
+
+    [super dealloc];
+}
+
+#pragma mark Attached Transfers
+
+- (BOOL)addTransfer:(CURLTransfer *)transfer
+{
+    @synchronized(self)
+    {
+        if (_isClosed) return NO;
+
+        [_transfers addObject:transfer];
+        return YES;
+    }
+}
+
+- (BOOL)removeTransfer:(CURLTransfer *)transfer
+{
+    @synchronized(self)
+    {
+        NSUInteger index = [_transfers indexOfObjectIdenticalTo:transfer];
+        if (index == NSNotFound) return NO;
+
+        [_transfers removeObjectAtIndex:index];
+        return ([_transfers count] == 0);
+    }
+}
+
+- (NSArray*)removeAllTransfers
+{
+    @synchronized(self)
+    {
+        _isClosed = YES;
+
+        NSArray* result = [[_transfers copy] autorelease];
+        [_transfers removeAllObjects];
+        return result;
+    }
+}
+
+- (void)start
+{
+    NSAssert(!_transfer, @"flight started twice");
+
+    // the transfer may finish before the init returns (and tell us so directly, on an external event loop), so everything's set up first
+    _transfer = [[CURLTransfer alloc] initWithRequest:_request credential:nil delegate:self delegateQueue:nil multi:_multi];
+}
+
+#pragma mark CURLTransferDelegate
+
+// Passing things on is done inside the lock, so that a transfer that's detached hears nothing after it's gone
+
+- (void)transfer:(CURLTransfer *)transfer didReceiveResponse:(NSURLResponse *)response
+{
+    @synchronized(self)
+    {
+        // anyone turning up from now on would miss the start of the body
+        _isClosed = YES;
+
+        for (CURLTransfer* aTransfer in _transfers)
+        {
+            [aTransfer deliverResponse:response];
+        }
+    }
+}
+
+- (void)transfer:(CURLTransfer *)transfer didReceiveData:(NSData *)data
+{
+    @synchronized(self)
+    {
+        for (CURLTransfer* aTransfer in _transfers)
+        {
+            [aTransfer deliverData:data];
+        }
+    }
+}
+
+- (void)transfer:(CURLTransfer *)transfer didCompleteWithError:(NSError *)error
+{
+    @synchronized(self)
+    {
+        _isClosed = YES;
+    }
+
+    // the attached transfers are completed on the multi's queue, where they're cancelled too
+    CURLMultiHandle* multi = _multi;
+    [multi performBlock:^{
+        [multi finishFlight:self error:error];
+    }];
+}
+
+- (NSString*)description
+{
+    @synchronized(self)
+    {
+        return [NSString stringWithFormat:@"<%@ %p: %@ for %lu transfers>", [self class], self, [_request URL], (unsigned long)[_transfers count]];
+    }
+}
+
+@end
@@ -0,0 +1,175 @@
+//
+//  CURLTransferRecorder.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <curl/curl.h>
+
+@class CURLTransferRecorder;
+
+/** What a recorder writes in place of a credential. */
+extern NSString* const CURLTransferRecorderRedactedValue;
+
+/**
+ What was captured about a single transfer.
+
+ Times are in seconds. The start time is relative to when the recorder was created, so the
+ gaps between records give the original inter-arrival times; the other times are relative to the start.
+ */
+
+@interface CURLTransferRecord : NSObject
+{
+    CURLTransferRecorder    *_recorder;
+    NSTimeInterval          _startTime;
+    NSTimeInterval          _firstByteTime;
+    NSTimeInterval          _duration;
+    NSString                *_method;
+    NSURL                   *_URL;
+    NSDictionary            *_requestHeaders;
+    uint64_t                _bytesSent;
+    NSInteger               _statusCode;
+    NSString                *_responseHeaders;
+    uint64_t                _bytesReceived;
+    NSInteger               _resultCode;
+    NSMutableData           *_body;
+    BOOL                    _redactsResponseHeaders;
+}
+
+@property (readonly, nonatomic) NSTimeInterval startTime;
+
+/** When the first byte of the response arrived, or zero if nothing did. */
+@property (readonly, nonatomic) NSTimeInterval firstByteTime;
+@property (readonly, nonatomic) NSTimeInterval duration;
+
+@property (readonly, copy, nonatomic) NSString* method;
+/** The request's URL, with any password replaced unless the recorder keeps credentials. */
+@property (readonly, copy, nonatomic) NSURL* URL;
+
+/** The request's headers, with the values of Authorization, Proxy-Authorization and Cookie replaced unless the recorder keeps credentials. */
+@property (readonly, copy, nonatomic) NSDictionary* requestHeaders;
+@property (readonly, nonatomic) uint64_t bytesSent;
+
+@property (readonly, nonatomic) NSInteger statusCode;
+
+/** The raw response headers, including the status line, as received (less any cookies, unless the recorder keeps credentials). */
+@property (readonly, copy, nonatomic) NSString* responseHeaders;
+@property (readonly, nonatomic) uint64_t bytesReceived;
+
+/** The CURLcode the transfer finished with. */
+@property (readonly, nonatomic) NSInteger resultCode;
+
+/** The response body, if the recorder was capturing bodies. Otherwise nil. */
+@property (readonly, strong, nonatomic) NSData* body;
+
+@end
+
+
+/**
+ Captures the shape of real traffic, so that it can be replayed offline later.
+
+ Install a recorder with +[CURLTransfer setRecorder:], and every transfer started from then on
+ records its request metadata, response headers, body sizes and timings. Bodies themselves are only
+ kept if asked for, since they can be large and private.
+
+ Credentials are private too, so by default they never reach the log: the values of the Authorization,
+ Proxy-Authorization and Cookie request headers and Set-Cookie response headers, and any password in the URL,
+ are all written as CURLTransferRecorderRedactedValue. Set recordsCredentials to keep them, for a log which
+ will stay on the machine that made it.
+
+ Records are appended to a compact binary log as each transfer finishes:
+
+    file    := "CURLREC" version:uint8 record*
+    record  := length:varint payload            (length lets readers skip fields they don't know about)
+    payload := start_us first_byte_us duration_us method url header_count (name value)* bytes_sent
+               status response_headers bytes_received result body_length body_bytes
+
+ where every number is an unsigned LEB128 varint, and every string is a varint length followed by UTF-8.
+
+ It's safe for transfers on any thread or queue to record at once.
+ */
+
+@interface CURLTransferRecorder : NSObject
+{
+    NSURL               *_URL;
+    BOOL                _recordsBodies;
+    BOOL                _recordsCredentials;
+    FILE                *_file;
+    dispatch_queue_t    _queue;
+    uint64_t            _origin;
+    NSUInteger          _recordCount;
+}
+
+/**
+ Make a recorder which writes to a new log file, replacing anything already there.
+
+ @param url The file to write.
+ @param recordsBodies YES to capture response bodies as well as their sizes.
+ @param error Set if the file couldn't be created.
+ @return A new recorder, or nil.
+ */
+
++ (CURLTransferRecorder*)recorderWithURL:(NSURL*)url recordsBodies:(BOOL)recordsBodies error:(NSError**)error;
+
+/**
+ Read back every record in a log.
+
+ @param url The file to read.
+ @param error Set if the file couldn't be read, or isn't a transfer log.
+ @return An array of CURLTransferRecord objects, in the order the transfers finished, or nil.
+ */
+
++ (NSArray*)recordsWithContentsOfURL:(NSURL*)url error:(NSError**)error;
+
+/**
+ Flush and close the log. Transfers which finish after this aren't recorded.
+ */
+
+- (void)close;
+
+@property (readonly, copy, nonatomic) NSURL* URL;
+@property (readonly, nonatomic) BOOL recordsBodies;
+
+/**
+ YES to write credentials to the log as they were sent and received, rather than redacting them.
+ Default is NO. Set it before installing the recorder; it applies to transfers started afterwards.
+ */
+
+@property (assign, atomic) BOOL recordsCredentials;
+
+/** Number of records written so far. */
+@property (readonly, atomic) NSUInteger recordCount;
+
+/**
+ Used by CURLTransfer to start a record for a request. The record collects data as the transfer
+ runs, and writes itself to the log when the transfer finishes.
+
+ @warning Not intended to be called from your code.
+
+ @param request The request about to be performed.
+ @return A new record.
+ */
+
+- (CURLTransferRecord*)recordForRequest:(NSURLRequest*)request;
+
+@end
+
+
+/**
+ The calls CURLTransfer makes on a record as the transfer progresses.
+
+ @warning Not intended to be called from your code.
+ */
+
+@interface CURLTransferRecord(TransferSupport)
+
+- (void)recordSentLength:(size_t)length;
+- (void)recordReceivedBytes:(const void*)bytes length:(size_t)length isHeader:(BOOL)header;
+- (void)recordResponseWithStatusCode:(NSInteger)code headers:(NSString*)headers;
+- (void)recordResultCode:(CURLcode)code;
+- (void)finishWithError:(NSError*)error;
+
+@end
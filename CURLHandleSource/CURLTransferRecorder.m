@@ -0,0 +1,504 @@
+//
+//  CURLTransferRecorder.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLTransferRecorder.h"
+
+#import "CURLTransfer.h"
+
+#include <mach/mach_time.h>
+
+static const char kMagic[7] = { 'C', 'U', 'R', 'L', 'R', 'E', 'C' };
+static const uint8_t kVersion = 1;
+
+NSString* const CURLTransferRecorderRedactedValue = @"redacted";
+
+#pragma mark - Encoding
+
+static void CURLRecorderAppendNumber(NSMutableData* data, uint64_t value)
+{
+    uint8_t bytes[10];
+    NSUInteger count = 0;
+    do
+    {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        bytes[count++] = value ? (byte | 0x80) : byte;
+    }
+    while (value);
+
+    [data appendBytes:bytes length:count];
+}
+
+static void CURLRecorderAppendString(NSMutableData* data, NSString* string)
+{
+    NSData* utf8 = [string dataUsingEncoding:NSUTF8StringEncoding];
+    CURLRecorderAppendNumber(data, [utf8 length]);
+    [data appendData:utf8];
+}
+
+static uint64_t CURLRecorderMicroseconds(NSTimeInterval seconds)
+{
+    return (seconds > 0) ? (uint64_t)(seconds * USEC_PER_SEC) : 0;
+}
+
+#pragma mark - Redaction
+
+static BOOL CURLRecorderIsCredentialHeader(NSString* name, NSArray* credentialHeaders)
+{
+    for (NSString* credentialHeader in credentialHeaders)
+    {
+        if ([name caseInsensitiveCompare:credentialHeader] == NSOrderedSame)
+        {
+            return YES;
+        }
+    }
+
+    return NO;
+}
+
+static NSDictionary* CURLRecorderRedactedRequestHeaders(NSDictionary* headers)
+{
+    NSArray* credentialHeaders = @[ @"Authorization", @"Proxy-Authorization", @"Cookie" ];
+    NSMutableDictionary* result = [NSMutableDictionary dictionaryWithCapacity:[headers count]];
+    for (NSString* name in headers)
+    {
+        [result setObject:CURLRecorderIsCredentialHeader(name, credentialHeaders) ? CURLTransferRecorderRedactedValue : [headers objectForKey:name] forKey:name];
+    }
+
+    return result;
+}
+
+static NSString* CURLRecorderRedactedResponseHeaders(NSString* headers)
+{
+    NSArray* credentialHeaders = @[ @"Set-Cookie", @"Set-Cookie2" ];
+    NSMutableArray* lines = [[[headers componentsSeparatedByString:@"\n"] mutableCopy] autorelease];
+    for (NSUInteger index = 0; index < [lines count]; ++index)
+    {
+        NSString* line = [lines objectAtIndex:index];
+        NSRange colon = [line rangeOfString:@":"];
+        if ((colon.location != NSNotFound) && CURLRecorderIsCredentialHeader([[line substringToIndex:colon.location] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]], credentialHeaders))
+        {
+            NSString* ending = [line hasSuffix:@"\r"] ? @"\r" : @"";
+            [lines replaceObjectAtIndex:index withObject:[NSString stringWithFormat:@"%@: %@%@", [line substringToIndex:colon.location], CURLTransferRecorderRedactedValue, ending]];
+        }
+    }
+
+    return [lines componentsJoinedByString:@"\n"];
+}
+
+static NSURL* CURLRecorderRedactedURL(NSURL* url)
+{
+    NSURL* absolute = [url absoluteURL];
+    CFRange range = CFURLGetByteRangeForComponent((CFURLRef)absolute, kCFURLComponentPassword, NULL);
+    if (range.location == kCFNotFound) return url;
+
+    NSData* bytes = [[absolute absoluteString] dataUsingEncoding:NSUTF8StringEncoding];
+    NSMutableData* redacted = [[bytes mutableCopy] autorelease];
+    NSData* replacement = [CURLTransferRecorderRedactedValue dataUsingEncoding:NSUTF8StringEncoding];
+    [redacted replaceBytesInRange:NSMakeRange(range.location, range.length) withBytes:[replacement bytes] length:[replacement length]];
+
+    NSString* string = [[[NSString alloc] initWithData:redacted encoding:NSUTF8StringEncoding] autorelease];
+    return [NSURL URLWithString:string] ?: url;
+}
+
+#pragma mark - Decoding
+
+typedef struct
+{
+    const uint8_t   *bytes;
+    NSUInteger      length;
+    NSUInteger      offset;
+    BOOL            failed;
+} CURLRecorderCursor;
+
+static uint64_t CURLRecorderReadNumber(CURLRecorderCursor* cursor)
+{
+    uint64_t result = 0;
+    NSUInteger shift = 0;
+    while (!cursor->failed)
+    {
+        if ((cursor->offset >= cursor->length) || (shift > 63))
+        {
+            cursor->failed = YES;
+            break;
+        }
+
+        uint8_t byte = cursor->bytes[cursor->offset++];
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        shift += 7;
+        if (!(byte & 0x80))
+        {
+            break;
+        }
+    }
+
+    return result;
+}
+
+static NSData* CURLRecorderReadData(CURLRecorderCursor* cursor)
+{
+    uint64_t length = CURLRecorderReadNumber(cursor);
+    if (cursor->failed || (length > cursor->length - cursor->offset))
+    {
+        cursor->failed = YES;
+        return nil;
+    }
+
+    NSData* result = [NSData dataWithBytes:cursor->bytes + cursor->offset length:(NSUInteger)length];
+    cursor->offset += (NSUInteger)length;
+    return result;
+}
+
+static NSString* CURLRecorderReadString(CURLRecorderCursor* cursor)
+{
+    NSData* data = CURLRecorderReadData(cursor);
+    return data ? [[[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding] autorelease] : nil;
+}
+
+static NSTimeInterval CURLRecorderReadTime(CURLRecorderCursor* cursor)
+{
+    return (NSTimeInterval)CURLRecorderReadNumber(cursor) / USEC_PER_SEC;
+}
+
+#pragma mark - Record
+
+@interface CURLTransferRecorder()
+
+@property (readwrite, atomic) NSUInteger recordCount;
+
+- (NSTimeInterval)now;
+- (void)writeRecord:(CURLTransferRecord*)record;
+
+@end
+
+@interface CURLTransferRecord()
+
+- (id)initWithRecorder:(CURLTransferRecorder*)recorder request:(NSURLRequest*)request;
+- (NSData*)encodedData;
+- (BOOL)decodeFromCursor:(CURLRecorderCursor*)cursor;
+
+@end
+
+@implementation CURLTransferRecord
+
+@synthesize startTime = _startTime;
+@synthesize firstByteTime = _firstByteTime;
+@synthesize duration = _duration;
+@synthesize method = _method;
+@synthesize URL = _URL;
+@synthesize requestHeaders = _requestHeaders;
+@synthesize bytesSent = _bytesSent;
+@synthesize statusCode = _statusCode;
+@synthesize responseHeaders = _responseHeaders;
+@synthesize bytesReceived = _bytesReceived;
+@synthesize resultCode = _resultCode;
+@synthesize body = _body;
+
+- (id)initWithRecorder:(CURLTransferRecorder *)recorder request:(NSURLRequest *)request
+{
+    if ((self = [super init]) != nil)
+    {
+        _recorder = [recorder retain];
+        _startTime = [recorder now];
+        _method = [[request HTTPMethod] copy];
+        _resultCode = -1;
+
+        if (recorder.recordsCredentials)
+        {
+            _URL = [[request URL] copy];
+            _requestHeaders = [[request allHTTPHeaderFields] copy];
+        }
+        else
+        {
+            _URL = [CURLRecorderRedactedURL([request URL]) copy];
+            _requestHeaders = [CURLRecorderRedactedRequestHeaders([request allHTTPHeaderFields]) copy];
+            _redactsResponseHeaders = YES;
+        }
+
+        if (recorder.recordsBodies)
+        {
+            _body = [[NSMutableData alloc] init];
+        }
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_recorder release];
+    [_method release];
+    [_URL release];
+    [_requestHeaders release];
+    [_responseHeaders release];
+    [_body release];
+
+    [super dealloc];
+}
+
+#pragma mark Recording
+
+- (void)recordSentLength:(size_t)length
+{
+    _bytesSent += length;
+}
+
+- (void)recordReceivedBytes:(const void *)bytes length:(size_t)length isHeader:(BOOL)header
+{
+    if (_firstByteTime == 0)
+    {
+        _firstByteTime = [_recorder now] - _startTime;
+    }
+
+    if (!header)
+    {
+        _bytesReceived += length;
+        [_body appendBytes:bytes length:length];
+    }
+}
+
+- (void)recordResponseWithStatusCode:(NSInteger)code headers:(NSString *)headers
+{
+    _statusCode = code;
+
+    [_responseHeaders release];
+    _responseHeaders = [(_redactsResponseHeaders ? CURLRecorderRedactedResponseHeaders(headers) : headers) copy];
+}
+
+- (void)recordResultCode:(CURLcode)code
+{
+    _resultCode = code;
+}
+
+- (void)finishWithError:(NSError *)error
+{
+    if (!_recorder) return;
+
+    _duration = [_recorder now] - _startTime;
+    if (_resultCode < 0)
+    {
+        // finished without libcurl reporting a result, which means it was cancelled
+        _resultCode = error ? CURLE_ABORTED_BY_CALLBACK : CURLE_OK;
+    }
+
+    [_recorder writeRecord:self];
+    [_recorder release]; _recorder = nil;
+}
+
+#pragma mark Coding
+
+- (NSData*)encodedData
+{
+    NSMutableData* result = [NSMutableData dataWithCapacity:512 + [_body length]];
+    CURLRecorderAppendNumber(result, CURLRecorderMicroseconds(_startTime));
+    CURLRecorderAppendNumber(result, CURLRecorderMicroseconds(_firstByteTime));
+    CURLRecorderAppendNumber(result, CURLRecorderMicroseconds(_duration));
+    CURLRecorderAppendString(result, _method);
+    CURLRecorderAppendString(result, [_URL absoluteString]);
+
+    CURLRecorderAppendNumber(result, [_requestHeaders count]);
+    for (NSString* name in _requestHeaders)
+    {
+        CURLRecorderAppendString(result, name);
+        CURLRecorderAppendString(result, [_requestHeaders objectForKey:name]);
+    }
+
+    CURLRecorderAppendNumber(result, _bytesSent);
+    CURLRecorderAppendNumber(result, _statusCode);
+    CURLRecorderAppendString(result, _responseHeaders);
+    CURLRecorderAppendNumber(result, _bytesReceived);
+    CURLRecorderAppendNumber(result, _resultCode);
+    CURLRecorderAppendNumber(result, [_body length]);
+    [result appendData:_body];
+
+    return result;
+}
+
+- (BOOL)decodeFromCursor:(CURLRecorderCursor *)cursor
+{
+    _startTime = CURLRecorderReadTime(cursor);
+    _firstByteTime = CURLRecorderReadTime(cursor);
+    _duration = CURLRecorderReadTime(cursor);
+    _method = [CURLRecorderReadString(cursor) copy];
+    NSString* url = CURLRecorderReadString(cursor);
+    _URL = url ? [[NSURL alloc] initWithString:url] : nil;
+
+    uint64_t count = CURLRecorderReadNumber(cursor);
+    NSMutableDictionary* headers = [NSMutableDictionary dictionary];
+    for (uint64_t n = 0; (n < count) && !cursor->failed; ++n)
+    {
+        NSString* name = CURLRecorderReadString(cursor);
+        NSString* value = CURLRecorderReadString(cursor);
+        if (name && value)
+        {
+            [headers setObject:value forKey:name];
+        }
+    }
+    _requestHeaders = [headers copy];
+
+    _bytesSent = CURLRecorderReadNumber(cursor);
+    _statusCode = (NSInteger)CURLRecorderReadNumber(cursor);
+    _responseHeaders = [CURLRecorderReadString(cursor) copy];
+    _bytesReceived = CURLRecorderReadNumber(cursor);
+    _resultCode = (NSInteger)CURLRecorderReadNumber(cursor);
+
+    NSData* body = CURLRecorderReadData(cursor);
+    if ([body length])
+    {
+        _body = [body mutableCopy];
+    }
+
+    return !cursor->failed && _URL;
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"<RECORD %@ %@ at %.3fs: %ld, %llu bytes in %.3fs>", _method, _URL, _startTime, (long)_statusCode, _bytesReceived, _duration];
+}
+
+@end
+
+#pragma mark - Recorder
+
+@implementation CURLTransferRecorder
+
+@synthesize URL = _URL;
+@synthesize recordsBodies = _recordsBodies;
+@synthesize recordsCredentials = _recordsCredentials;
+@synthesize recordCount = _recordCount;
+
++ (CURLTransferRecorder*)recorderWithURL:(NSURL *)url recordsBodies:(BOOL)recordsBodies error:(NSError **)error
+{
+    FILE* file = fopen([[url path] fileSystemRepresentation], "wb");
+    if (!file)
+    {
+        if (error)
+        {
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{ NSURLErrorKey : url }];
+        }
+        return nil;
+    }
+
+    fwrite(kMagic, sizeof(kMagic), 1, file);
+    fwrite(&kVersion, sizeof(kVersion), 1, file);
+
+    CURLTransferRecorder* result = [[self alloc] init];
+    result->_URL = [url copy];
+    result->_recordsBodies = recordsBodies;
+    result->_file = file;
+    result->_queue = dispatch_queue_create("com.karelia.CURLTransferRecorder", DISPATCH_QUEUE_SERIAL);
+    result->_origin = mach_absolute_time();
+
+    return [result autorelease];
+}
+
+- (void)dealloc
+{
+    [self close];
+
+    [_URL release];
+    if (_queue)
+    {
+        dispatch_release(_queue);
+    }
+
+    [super dealloc];
+}
+
+- (NSTimeInterval)now
+{
+    static mach_timebase_info_data_t sTimebase;
+    if (sTimebase.denom == 0)
+    {
+        mach_timebase_info(&sTimebase);
+    }
+
+    return ((double)(mach_absolute_time() - _origin) * sTimebase.numer / sTimebase.denom) / NSEC_PER_SEC;
+}
+
+- (CURLTransferRecord*)recordForRequest:(NSURLRequest *)request
+{
+    return [[[CURLTransferRecord alloc] initWithRecorder:self request:request] autorelease];
+}
+
+- (void)writeRecord:(CURLTransferRecord *)record
+{
+    // encode on the caller's thread, so the queue just does the I/O
+    NSMutableData* data = [NSMutableData data];
+    NSData* payload = [record encodedData];
+    CURLRecorderAppendNumber(data, [payload length]);
+    [data appendData:payload];
+
+    dispatch_async(_queue, ^{
+        if (_file)
+        {
+            fwrite([data bytes], [data length], 1, _file);
+            self.recordCount = _recordCount + 1;
+        }
+    });
+}
+
+- (void)close
+{
+    if (!_queue) return;
+
+    dispatch_sync(_queue, ^{
+        if (_file)
+        {
+            fclose(_file);
+            _file = NULL;
+        }
+    });
+}
+
++ (NSArray*)recordsWithContentsOfURL:(NSURL *)url error:(NSError **)error
+{
+    NSData* data = [NSData dataWithContentsOfURL:url options:NSDataReadingMappedIfSafe error:error];
+    if (!data) return nil;
+
+    const uint8_t* bytes = [data bytes];
+    if (([data length] < sizeof(kMagic) + 1) || (memcmp(bytes, kMagic, sizeof(kMagic)) != 0) || (bytes[sizeof(kMagic)] > kVersion))
+    {
+        if (error)
+        {
+            *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadCorruptFileError userInfo:@{ NSURLErrorKey : url }];
+        }
+        return nil;
+    }
+
+    CURLRecorderCursor cursor = { bytes, [data length], sizeof(kMagic) + 1, NO };
+    NSMutableArray* result = [NSMutableArray array];
+    while (cursor.offset < cursor.length)
+    {
+        uint64_t length = CURLRecorderReadNumber(&cursor);
+        if (cursor.failed || (length > cursor.length - cursor.offset))
+        {
+            // a truncated record at the end just means the log wasn't closed cleanly; keep what we have
+            break;
+        }
+
+        CURLRecorderCursor recordCursor = { bytes + cursor.offset, (NSUInteger)length, 0, NO };
+        cursor.offset += (NSUInteger)length;
+
+        CURLTransferRecord* record = [[CURLTransferRecord alloc] init];
+        if ([record decodeFromCursor:&recordCursor])
+        {
+            [result addObject:record];
+        }
+        [record release];
+    }
+
+    return result;
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"<RECORDER %p %@, %lu records>", self, [self.URL path], (unsigned long)self.recordCount];
+}
+
+@end
@@ -0,0 +1,191 @@
+//
+//  CURLLoadGenerator.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ One entry in a load generator's request mix.
+ */
+
+@interface CURLLoadRequest : NSObject
+{
+    NSURL           *_URL;
+    NSString        *_method;
+    NSUInteger      _bodySize;
+    NSUInteger      _weight;
+    NSURLRequest    *_URLRequest;
+}
+
+/**
+ Read a request mix from a JSON file.
+
+ The file should contain an array of objects, each with a `url`, and optionally a `method`
+ (default GET), `body_bytes` (default 0) and `weight` (default 1), eg:
+
+    [ { "url" : "http://origin.example.com/small", "weight" : 9 },
+      { "url" : "http://origin.example.com/upload", "method" : "PUT", "body_bytes" : 65536 } ]
+
+ @param path The file to read.
+ @param error Set if the file couldn't be read or parsed.
+ @return An array of CURLLoadRequest objects, or nil.
+ */
+
++ (NSArray*)requestsWithContentsOfFile:(NSString*)path error:(NSError**)error;
+
++ (CURLLoadRequest*)requestWithURL:(NSURL*)url method:(NSString*)method bodySize:(NSUInteger)bodySize;
+
+@property (copy, nonatomic) NSURL* URL;
+@property (copy, nonatomic) NSString* method;
+@property (assign, nonatomic) NSUInteger bodySize;
+
+/**
+ How often this request is picked, relative to the others in the mix.
+ */
+
+@property (assign, nonatomic) NSUInteger weight;
+
+/**
+ The request to actually send, with a body of bodySize bytes if needed. Built once, and re-used.
+ */
+
+- (NSURLRequest*)URLRequest;
+
+@end
+
+
+/**
+ The measurements taken by a load generator run.
+
+ Each shard keeps its own report while running, and they're merged at the end.
+ */
+
+@interface CURLLoadReport : NSObject
+{
+    NSUInteger          _completed;
+    NSUInteger          _failed;
+    NSUInteger          _reused;
+    uint64_t            _bytes;
+    NSTimeInterval      _elapsed;
+    double              *_latencies;
+    NSUInteger          _latencyCount;
+    NSUInteger          _latencyCapacity;
+    NSCountedSet        *_errorCodes;
+    NSCountedSet        *_statusCodes;
+}
+
+/** Transfers which finished without a libcurl error (whatever their HTTP status). */
+@property (readonly, nonatomic) NSUInteger completed;
+
+/** Transfers which failed with a libcurl error. */
+@property (readonly, nonatomic) NSUInteger failed;
+
+/** Completed transfers which re-used an existing connection rather than making a new one. */
+@property (readonly, nonatomic) NSUInteger reused;
+
+@property (readonly, nonatomic) uint64_t bytes;
+@property (readonly, nonatomic) NSTimeInterval elapsed;
+
+- (double)requestsPerSecond;
+- (double)megabytesPerSecond;
+- (double)connectionReuseRatio;
+
+/**
+ Returns a latency percentile for completed transfers, using the nearest-rank method.
+
+ @param percentile The percentile, from 0 to 100.
+ @return The latency in seconds, or zero if nothing completed.
+ */
+
+- (NSTimeInterval)latencyPercentile:(double)percentile;
+
+/**
+ How many transfers failed with a given CURLcode. Errors which didn't come from libcurl are counted as -1.
+ */
+
+- (NSUInteger)countOfErrorCode:(NSInteger)code;
+
+/**
+ How many completed transfers got a given response code (HTTP status, or FTP reply).
+ */
+
+- (NSUInteger)countOfStatusCode:(NSInteger)code;
+
+/**
+ A JSON-compatible summary of the report.
+ */
+
+- (NSDictionary*)dictionaryRepresentation;
+
+@end
+
+
+/**
+ A wrk-style load generator, which drives CURLMultiHandle with the same client stack that applications use.
+
+ Transfers are spread over `shardCount` multis, each with its own queue, so the load isn't limited
+ by a single queue. Requests are picked from the mix at random, according to their weights.
+
+ There are two ways of generating load:
+
+ - Closed loop (rate is zero): each shard keeps its share of `concurrency` transfers in flight,
+   starting a new one as soon as one finishes.
+
+ - Open loop (rate is non-zero): transfers are started at a fixed rate, with `concurrency` as a cap on how
+   many can be in flight at once. When the cap is reached, transfers queue up; their latency is measured
+   from when they should have started, so a struggling server isn't flattered by the generator backing off.
+
+ The run stops after `requestCount` transfers, or after `duration` seconds, whichever comes first.
+ Transfers in flight at that point are allowed to finish.
+
+ The calling thread's run loop is spun while waiting, so that in-process servers can do their work.
+ */
+
+@interface CURLLoadGenerator : NSObject
+{
+    NSArray         *_requests;
+    NSUInteger      _shardCount;
+    NSUInteger      _concurrency;
+    double          _rate;
+    NSUInteger      _requestCount;
+    NSTimeInterval  _duration;
+}
+
+/**
+ The request mix, as an array of CURLLoadRequest objects.
+ */
+
+@property (copy, nonatomic) NSArray* requests;
+
+@property (assign, nonatomic) NSUInteger shardCount;
+@property (assign, nonatomic) NSUInteger concurrency;
+
+/**
+ Requests per second, across all shards. Zero for closed-loop operation.
+ */
+
+@property (assign, nonatomic) double rate;
+
+/**
+ The most transfers to perform. Zero means no limit, in which case a duration must be set.
+ */
+
+@property (assign, nonatomic) NSUInteger requestCount;
+
+/**
+ The longest to keep starting transfers for, in seconds. Zero means no limit.
+ */
+
+@property (assign, nonatomic) NSTimeInterval duration;
+
+/**
+ Run the load, and return the merged results once every shard has finished.
+ */
+
+- (CURLLoadReport*)run;
+
+@end
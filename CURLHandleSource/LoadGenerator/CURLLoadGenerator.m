@@ -0,0 +1,732 @@
+//
+//  CURLLoadGenerator.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLLoadGenerator.h"
+
+#import "CURLMultiHandle.h"
+#import "CURLTransfer+TestingSupport.h"
+
+#include <mach/mach_time.h>
+
+#pragma mark - Time
+
+static NSTimeInterval CURLLoadSecondsFromMachTime(uint64_t elapsed)
+{
+    static mach_timebase_info_data_t sTimebase;
+    if (sTimebase.denom == 0)
+    {
+        mach_timebase_info(&sTimebase);
+    }
+
+    return ((double)elapsed * sTimebase.numer / sTimebase.denom) / NSEC_PER_SEC;
+}
+
+static uint64_t CURLLoadMachTimeFromSeconds(NSTimeInterval seconds)
+{
+    static mach_timebase_info_data_t sTimebase;
+    if (sTimebase.denom == 0)
+    {
+        mach_timebase_info(&sTimebase);
+    }
+
+    return (uint64_t)(seconds * NSEC_PER_SEC * sTimebase.denom / sTimebase.numer);
+}
+
+static int CURLLoadCompareLatencies(const void* a, const void* b)
+{
+    double lhs = *(const double*)a;
+    double rhs = *(const double*)b;
+    return (lhs < rhs) ? -1 : (lhs > rhs) ? 1 : 0;
+}
+
+/**
+ The CURLcode behind an error, if there is one. CURLTransfer often wraps it in a friendlier NSURLErrorDomain error.
+ */
+
+static NSInteger CURLLoadCodeForError(NSError* error)
+{
+    if ([error.domain isEqualToString:CURLcodeErrorDomain])
+    {
+        return error.code;
+    }
+
+    NSError* underlying = [error.userInfo objectForKey:NSUnderlyingErrorKey];
+    if ([underlying.domain isEqualToString:CURLcodeErrorDomain])
+    {
+        return underlying.code;
+    }
+
+    return -1;
+}
+
+#pragma mark - Request
+
+@implementation CURLLoadRequest
+
+@synthesize URL = _URL;
+@synthesize method = _method;
+@synthesize bodySize = _bodySize;
+@synthesize weight = _weight;
+
++ (CURLLoadRequest*)requestWithURL:(NSURL *)url method:(NSString *)method bodySize:(NSUInteger)bodySize
+{
+    CURLLoadRequest* result = [[CURLLoadRequest alloc] init];
+    result.URL = url;
+    result.method = method ? method : @"GET";
+    result.bodySize = bodySize;
+    result.weight = 1;
+
+    return [result autorelease];
+}
+
++ (NSArray*)requestsWithContentsOfFile:(NSString *)path error:(NSError **)error
+{
+    NSData* data = [NSData dataWithContentsOfFile:path options:0 error:error];
+    if (!data) return nil;
+
+    NSArray* items = [NSJSONSerialization JSONObjectWithData:data options:0 error:error];
+    if (!items) return nil;
+
+    NSMutableArray* result = [NSMutableArray arrayWithCapacity:[items count]];
+    for (NSDictionary* item in items)
+    {
+        NSURL* url = [item isKindOfClass:[NSDictionary class]] ? [NSURL URLWithString:[item objectForKey:@"url"]] : nil;
+        if (!url)
+        {
+            if (error)
+            {
+                NSString* description = [NSString stringWithFormat:@"Request mix entry %@ doesn't have a valid url", item];
+                *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadCorruptFileError userInfo:@{ NSLocalizedDescriptionKey : description, NSFilePathErrorKey : path }];
+            }
+            return nil;
+        }
+
+        CURLLoadRequest* request = [self requestWithURL:url method:[item objectForKey:@"method"] bodySize:[[item objectForKey:@"body_bytes"] unsignedIntegerValue]];
+        NSNumber* weight = [item objectForKey:@"weight"];
+        if (weight)
+        {
+            request.weight = [weight unsignedIntegerValue];
+        }
+        [result addObject:request];
+    }
+
+    return result;
+}
+
+- (void)dealloc
+{
+    [_URL release];
+    [_method release];
+    [_URLRequest release];
+
+    [super dealloc];
+}
+
+- (NSURLRequest*)URLRequest
+{
+    if (!_URLRequest)
+    {
+        NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:self.URL];
+        [request setHTTPMethod:self.method];
+        if (self.bodySize)
+        {
+            NSMutableData* body = [NSMutableData dataWithLength:self.bodySize];
+            memset([body mutableBytes], 'x', self.bodySize);
+            [request setHTTPBody:body];
+        }
+
+        _URLRequest = [request copy];
+    }
+
+    return _URLRequest;
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"<LOAD REQUEST %@ %@ %lub x%lu>", self.method, self.URL, (unsigned long)self.bodySize, (unsigned long)self.weight];
+}
+
+@end
+
+#pragma mark - Report
+
+@interface CURLLoadReport()
+
+- (void)recordLatency:(NSTimeInterval)latency bytes:(uint64_t)bytes statusCode:(NSInteger)status reused:(BOOL)reused;
+- (void)recordErrorCode:(NSInteger)code;
+- (void)addReport:(CURLLoadReport*)report;
+- (void)finishWithElapsedTime:(NSTimeInterval)elapsed;
+
+@end
+
+@implementation CURLLoadReport
+
+@synthesize completed = _completed;
+@synthesize failed = _failed;
+@synthesize reused = _reused;
+@synthesize bytes = _bytes;
+@synthesize elapsed = _elapsed;
+
+- (id)init
+{
+    if ((self = [super init]) != nil)
+    {
+        _errorCodes = [[NSCountedSet alloc] init];
+        _statusCodes = [[NSCountedSet alloc] init];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_latencies);
+    [_errorCodes release];
+    [_statusCodes release];
+
+    [super dealloc];
+}
+
+- (void)appendLatency:(double)latency
+{
+    if (_latencyCount == _latencyCapacity)
+    {
+        _latencyCapacity = MAX(_latencyCapacity * 2, 1024);
+        _latencies = realloc(_latencies, sizeof(double) * _latencyCapacity);
+    }
+
+    _latencies[_latencyCount++] = latency;
+}
+
+- (void)recordLatency:(NSTimeInterval)latency bytes:(uint64_t)bytes statusCode:(NSInteger)status reused:(BOOL)reused
+{
+    ++_completed;
+    _bytes += bytes;
+    if (reused)
+    {
+        ++_reused;
+    }
+
+    [_statusCodes addObject:@(status)];
+    [self appendLatency:latency];
+}
+
+- (void)recordErrorCode:(NSInteger)code
+{
+    ++_failed;
+    [_errorCodes addObject:@(code)];
+}
+
+- (void)addReport:(CURLLoadReport *)report
+{
+    _completed += report.completed;
+    _failed += report.failed;
+    _reused += report.reused;
+    _bytes += report.bytes;
+
+    for (NSUInteger n = 0; n < report->_latencyCount; ++n)
+    {
+        [self appendLatency:report->_latencies[n]];
+    }
+
+    for (NSNumber* code in report->_errorCodes)
+    {
+        for (NSUInteger n = [report->_errorCodes countForObject:code]; n > 0; --n)
+        {
+            [_errorCodes addObject:code];
+        }
+    }
+
+    for (NSNumber* code in report->_statusCodes)
+    {
+        for (NSUInteger n = [report->_statusCodes countForObject:code]; n > 0; --n)
+        {
+            [_statusCodes addObject:code];
+        }
+    }
+}
+
+- (void)finishWithElapsedTime:(NSTimeInterval)elapsed
+{
+    _elapsed = elapsed;
+
+    qsort(_latencies, _latencyCount, sizeof(double), CURLLoadCompareLatencies);
+}
+
+- (double)requestsPerSecond
+{
+    return (self.elapsed > 0) ? self.completed / self.elapsed : 0;
+}
+
+- (double)megabytesPerSecond
+{
+    return (self.elapsed > 0) ? (self.bytes / (1024.0 * 1024.0)) / self.elapsed : 0;
+}
+
+- (double)connectionReuseRatio
+{
+    return self.completed ? (double)self.reused / self.completed : 0;
+}
+
+- (NSTimeInterval)latencyPercentile:(double)percentile
+{
+    if (_latencyCount == 0) return 0;
+
+    NSUInteger rank = (NSUInteger)ceil((percentile / 100.0) * _latencyCount);
+    rank = MIN(MAX(rank, 1), _latencyCount);
+    return _latencies[rank - 1];
+}
+
+- (NSUInteger)countOfErrorCode:(NSInteger)code
+{
+    return [_errorCodes countForObject:@(code)];
+}
+
+- (NSUInteger)countOfStatusCode:(NSInteger)code
+{
+    return [_statusCodes countForObject:@(code)];
+}
+
+- (NSString*)nameForErrorCode:(NSInteger)code
+{
+    return (code < 0) ? @"non-libcurl error" : [NSString stringWithUTF8String:curl_easy_strerror((CURLcode)code)];
+}
+
+- (NSDictionary*)dictionaryRepresentation
+{
+    NSMutableArray* errors = [NSMutableArray arrayWithCapacity:[_errorCodes count]];
+    for (NSNumber* code in [[_errorCodes allObjects] sortedArrayUsingSelector:@selector(compare:)])
+    {
+        [errors addObject:@{
+                            @"code" : code,
+                            @"name" : [self nameForErrorCode:[code integerValue]],
+                            @"count" : @([_errorCodes countForObject:code]),
+                            }];
+    }
+
+    NSMutableDictionary* statuses = [NSMutableDictionary dictionaryWithCapacity:[_statusCodes count]];
+    for (NSNumber* code in _statusCodes)
+    {
+        [statuses setObject:@([_statusCodes countForObject:code]) forKey:[code stringValue]];
+    }
+
+    return @{
+             @"completed" : @(self.completed),
+             @"failed" : @(self.failed),
+             @"bytes" : @(self.bytes),
+             @"elapsed_s" : @(self.elapsed),
+             @"requests_per_s" : @([self requestsPerSecond]),
+             @"mb_per_s" : @([self megabytesPerSecond]),
+             @"connection_reuse_ratio" : @([self connectionReuseRatio]),
+             @"latency_p50_ms" : @([self latencyPercentile:50] * 1000.0),
+             @"latency_p90_ms" : @([self latencyPercentile:90] * 1000.0),
+             @"latency_p99_ms" : @([self latencyPercentile:99] * 1000.0),
+             @"latency_p999_ms" : @([self latencyPercentile:99.9] * 1000.0),
+             @"latency_max_ms" : @([self latencyPercentile:100] * 1000.0),
+             @"errors" : errors,
+             @"status_codes" : statuses,
+             };
+}
+
+- (NSString*)description
+{
+    NSMutableString* result = [NSMutableString stringWithFormat:@"%lu ok, %lu failed in %.2fs: %.1f req/s, %.2f MB/s, %.1f%% connections re-used\n",
+                               (unsigned long)self.completed, (unsigned long)self.failed, self.elapsed,
+                               [self requestsPerSecond], [self megabytesPerSecond], [self connectionReuseRatio] * 100.0];
+
+    [result appendFormat:@"latency p50 %.2fms, p90 %.2fms, p99 %.2fms, p99.9 %.2fms, max %.2fms",
+     [self latencyPercentile:50] * 1000.0, [self latencyPercentile:90] * 1000.0, [self latencyPercentile:99] * 1000.0,
+     [self latencyPercentile:99.9] * 1000.0, [self latencyPercentile:100] * 1000.0];
+
+    for (NSNumber* code in [[_errorCodes allObjects] sortedArrayUsingSelector:@selector(compare:)])
+    {
+        [result appendFormat:@"\n  error %@ (%@): %lu", code, [self nameForErrorCode:[code integerValue]], (unsigned long)[_errorCodes countForObject:code]];
+    }
+
+    return result;
+}
+
+@end
+
+#pragma mark - Sample
+
+/**
+ What we know about a transfer while it's in flight.
+ */
+
+@interface CURLLoadSample : NSObject
+{
+    uint64_t    _start;
+    uint64_t    _bytes;
+    NSInteger   _statusCode;
+}
+
+@property (assign, nonatomic) uint64_t start;
+@property (assign, nonatomic) uint64_t bytes;
+@property (assign, nonatomic) NSInteger statusCode;
+
+@end
+
+@implementation CURLLoadSample
+
+@synthesize start = _start;
+@synthesize bytes = _bytes;
+@synthesize statusCode = _statusCode;
+
+@end
+
+#pragma mark - Shard
+
+/**
+ One multi, and the transfers running on it.
+ Everything apart from the finished flag is only touched on the shard's (serial) delegate queue.
+ */
+
+@interface CURLLoadShard : NSObject <CURLTransferDelegate>
+{
+    CURLMultiHandle     *_multi;
+    NSOperationQueue    *_queue;
+    NSArray             *_requests;
+    NSUInteger          *_cumulativeWeights;
+    NSUInteger          _totalWeight;
+    NSUInteger          _concurrency;
+    double              _rate;
+    NSUInteger          _limit;
+    NSTimeInterval      _duration;
+
+    uint64_t            _startTime;
+    uint64_t            _deadline;
+    NSUInteger          _issued;
+    NSUInteger          _due;
+    NSUInteger          _inFlight;
+    NSMapTable          *_samples;
+    dispatch_source_t   _ticker;
+    CURLLoadReport      *_report;
+    BOOL                _finished;
+}
+
+@property (readonly, strong, nonatomic) CURLLoadReport* report;
+@property (assign, atomic) BOOL finished;
+
+- (id)initWithIndex:(NSUInteger)index requests:(NSArray*)requests concurrency:(NSUInteger)concurrency rate:(double)rate limit:(NSUInteger)limit duration:(NSTimeInterval)duration;
+- (void)start;
+- (void)shutdown;
+
+@end
+
+@implementation CURLLoadShard
+
+@synthesize report = _report;
+@synthesize finished = _finished;
+
+- (id)initWithIndex:(NSUInteger)index requests:(NSArray *)requests concurrency:(NSUInteger)concurrency rate:(double)rate limit:(NSUInteger)limit duration:(NSTimeInterval)duration
+{
+    if ((self = [super init]) != nil)
+    {
+        _multi = [[CURLMultiHandle alloc] initWithQueueNamed:[NSString stringWithFormat:@"com.karelia.CURLLoadGenerator.shard%lu", (unsigned long)index]];
+        _queue = [[NSOperationQueue alloc] init];
+        _queue.maxConcurrentOperationCount = 1;
+
+        _requests = [requests copy];
+        _cumulativeWeights = malloc(sizeof(NSUInteger) * [requests count]);
+        NSUInteger n = 0;
+        for (CURLLoadRequest* request in requests)
+        {
+            _totalWeight += request.weight;
+            _cumulativeWeights[n++] = _totalWeight;
+        }
+        NSAssert(_totalWeight > 0, @"at least one request in the mix needs a non-zero weight");
+
+        _concurrency = MAX(concurrency, 1);
+        _rate = rate;
+        _limit = limit ? limit : NSUIntegerMax;
+        _duration = duration;
+        _samples = [[NSMapTable mapTableWithKeyOptions:NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality valueOptions:NSPointerFunctionsStrongMemory] retain];
+        _report = [[CURLLoadReport alloc] init];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    NSAssert(_ticker == NULL, @"should have stopped ticking by now");
+
+    [_multi release];
+    [_queue release];
+    [_requests release];
+    free(_cumulativeWeights);
+    [_samples release];
+    [_report release];
+
+    [super dealloc];
+}
+
+- (void)start
+{
+    [_queue addOperationWithBlock:^{
+        _startTime = mach_absolute_time();
+        _deadline = (_duration > 0) ? _startTime + CURLLoadMachTimeFromSeconds(_duration) : 0;
+
+        if (_rate > 0)
+        {
+            // tick often enough to start transfers on time, but not absurdly often at high rates
+            uint64_t interval = MAX((uint64_t)(NSEC_PER_SEC / _rate), NSEC_PER_MSEC);
+            _ticker = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0));
+            dispatch_source_set_timer(_ticker, dispatch_time(DISPATCH_TIME_NOW, 0), interval, interval / 10);
+            dispatch_source_set_event_handler(_ticker, ^{
+                [_queue addOperationWithBlock:^{
+                    [self tick];
+                }];
+            });
+            dispatch_resume(_ticker);
+        }
+        else
+        {
+            [self startTransfers];
+        }
+    }];
+}
+
+- (void)shutdown
+{
+    [_multi shutdown];
+}
+
+- (BOOL)pastDeadline
+{
+    return _deadline && (mach_absolute_time() >= _deadline);
+}
+
+- (void)tick
+{
+    if (self.finished) return;
+
+    if ([self pastDeadline])
+    {
+        // anything still waiting for a slot never gets sent
+        _due = 0;
+    }
+    else
+    {
+        // the first transfer is due straight away, and then one every 1/rate seconds
+        NSUInteger scheduled = (NSUInteger)(CURLLoadSecondsFromMachTime(mach_absolute_time() - _startTime) * _rate) + 1;
+        scheduled = MIN(scheduled, _limit);
+        if (scheduled > _issued + _due)
+        {
+            _due = scheduled - _issued;
+        }
+    }
+
+    [self startTransfers];
+}
+
+- (BOOL)wantsMoreTransfers
+{
+    if (_rate > 0)
+    {
+        return _due > 0;
+    }
+    else
+    {
+        return (_issued < _limit) && ![self pastDeadline];
+    }
+}
+
+- (void)startTransfers
+{
+    while ((_inFlight < _concurrency) && [self wantsMoreTransfers])
+    {
+        [self startTransfer];
+    }
+
+    [self checkFinished];
+}
+
+- (CURLLoadRequest*)pickRequest
+{
+    NSUInteger pick = arc4random_uniform((u_int32_t)_totalWeight);
+    NSUInteger n = 0;
+    while (_cumulativeWeights[n] <= pick)
+    {
+        ++n;
+    }
+
+    return [_requests objectAtIndex:n];
+}
+
+- (void)startTransfer
+{
+    CURLLoadSample* sample = [[CURLLoadSample alloc] init];
+    if (_rate > 0)
+    {
+        // measure from when the transfer should have started, rather than when there was a slot for it
+        sample.start = _startTime + CURLLoadMachTimeFromSeconds(_issued / _rate);
+        --_due;
+    }
+    else
+    {
+        sample.start = mach_absolute_time();
+    }
+
+    ++_issued;
+    ++_inFlight;
+
+    CURLTransfer* transfer = [[CURLTransfer alloc] initWithRequest:[[self pickRequest] URLRequest] credential:nil delegate:self delegateQueue:_queue multi:_multi];
+    [_samples setObject:sample forKey:transfer];
+    [transfer release]; // the multi keeps hold of it until it's done
+    [sample release];
+}
+
+- (void)checkFinished
+{
+    BOOL done = (_rate > 0) ? ((_issued >= _limit) || [self pastDeadline]) : ![self wantsMoreTransfers];
+    if (done && (_due == 0) && (_inFlight == 0) && !self.finished)
+    {
+        if (_ticker)
+        {
+            dispatch_source_cancel(_ticker);
+            dispatch_release(_ticker);
+            _ticker = NULL;
+        }
+
+        [self.report finishWithElapsedTime:CURLLoadSecondsFromMachTime(mach_absolute_time() - _startTime)];
+        self.finished = YES;
+    }
+}
+
+- (void)transfer:(CURLTransfer *)transfer didReceiveResponse:(NSURLResponse *)response
+{
+    if ([response respondsToSelector:@selector(statusCode)])
+    {
+        [[_samples objectForKey:transfer] setStatusCode:[(NSHTTPURLResponse*)response statusCode]];
+    }
+}
+
+- (void)transfer:(CURLTransfer *)transfer didReceiveData:(NSData *)data
+{
+    CURLLoadSample* sample = [_samples objectForKey:transfer];
+    sample.bytes += [data length];
+}
+
+- (void)transfer:(CURLTransfer *)transfer didCompleteWithError:(NSError *)error
+{
+    uint64_t end = mach_absolute_time();
+    CURLLoadSample* sample = [_samples objectForKey:transfer];
+
+    if (error)
+    {
+        [self.report recordErrorCode:CURLLoadCodeForError(error)];
+    }
+    else
+    {
+        // the easy handle is still around at this point, so we can ask it whether it made a new connection
+        [self.report recordLatency:CURLLoadSecondsFromMachTime(end - sample.start) bytes:sample.bytes statusCode:sample.statusCode reused:([transfer connectCount] == 0)];
+    }
+
+    [_samples removeObjectForKey:transfer];
+    --_inFlight;
+
+    [self startTransfers];
+}
+
+@end
+
+#pragma mark - Generator
+
+@implementation CURLLoadGenerator
+
+@synthesize requests = _requests;
+@synthesize shardCount = _shardCount;
+@synthesize concurrency = _concurrency;
+@synthesize rate = _rate;
+@synthesize requestCount = _requestCount;
+@synthesize duration = _duration;
+
+- (id)init
+{
+    if ((self = [super init]) != nil)
+    {
+        _shardCount = 1;
+        _concurrency = 1;
+        _requestCount = 1000;
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_requests release];
+
+    [super dealloc];
+}
+
+// Split a total between the shards, as evenly as possible.
+
+- (NSUInteger)shareOf:(NSUInteger)total forShard:(NSUInteger)index
+{
+    NSUInteger share = total / self.shardCount;
+    return share + ((index < total % self.shardCount) ? 1 : 0);
+}
+
+- (CURLLoadReport*)run
+{
+    NSAssert([self.requests count] > 0, @"need at least one request in the mix");
+    NSAssert(self.requestCount || (self.duration > 0), @"need a request count or duration, or we'll never stop");
+
+    NSUInteger shardCount = MAX(MIN(self.shardCount, MAX(self.concurrency, 1)), 1);
+    self.shardCount = shardCount;
+
+    NSMutableArray* shards = [NSMutableArray arrayWithCapacity:shardCount];
+    for (NSUInteger n = 0; n < shardCount; ++n)
+    {
+        NSUInteger limit = self.requestCount ? [self shareOf:self.requestCount forShard:n] : 0;
+        if (self.requestCount && !limit) continue;
+
+        CURLLoadShard* shard = [[CURLLoadShard alloc] initWithIndex:n
+                                                           requests:self.requests
+                                                        concurrency:[self shareOf:self.concurrency forShard:n]
+                                                               rate:self.rate / shardCount
+                                                              limit:limit
+                                                           duration:self.duration];
+        [shards addObject:shard];
+        [shard release];
+    }
+
+    uint64_t start = mach_absolute_time();
+    for (CURLLoadShard* shard in shards)
+    {
+        [shard start];
+    }
+
+    // in-process servers need the run loop to be serviced
+    BOOL finished = NO;
+    while (!finished)
+    {
+        [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+
+        finished = YES;
+        for (CURLLoadShard* shard in shards)
+        {
+            finished = finished && shard.finished;
+        }
+    }
+
+    CURLLoadReport* result = [[[CURLLoadReport alloc] init] autorelease];
+    for (CURLLoadShard* shard in shards)
+    {
+        [result addReport:shard.report];
+        [shard shutdown];
+    }
+
+    [result finishWithElapsedTime:CURLLoadSecondsFromMachTime(mach_absolute_time() - start)];
+    return result;
+}
+
+@end
@@ -0,0 +1,143 @@
+//
+//  main.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+//  Generates load against an origin, using CURLMultiHandle exactly as applications do.
+//
+//  Usage:
+//      LoadGenerator [-url http://host/path [-method GET] [-body 0] | -mix requests.json]
+//                    [-shards 4] [-concurrency 64] [-rate 0] [-requests 10000] [-duration 0] [-output results.json]
+//
+//  Without -url or -mix, load is generated against an in-process stand-in server serving -size bytes,
+//  which makes the tool usable as a regression benchmark for the library itself.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "CURLLoadGenerator.h"
+#import "CURLStandInServer.h"
+#import "CURLTransfer.h"
+
+int main(int argc, const char * argv[])
+{
+    int result = EXIT_SUCCESS;
+
+    @autoreleasepool
+    {
+        // NSUserDefaults picks up "-key value" pairs from the command line
+        NSUserDefaults* defaults = [NSUserDefaults standardUserDefaults];
+        [defaults registerDefaults:@{
+                                     @"shards" : @([[NSProcessInfo processInfo] activeProcessorCount]),
+                                     @"concurrency" : @64,
+                                     @"requests" : @10000,
+                                     @"size" : @65536,
+                                     }];
+
+        CURLStandInServer* server = nil;
+        NSArray* requests = nil;
+        NSString* mixPath = [defaults stringForKey:@"mix"];
+        NSString* urlString = [defaults stringForKey:@"url"];
+        if (mixPath)
+        {
+            NSError* error = nil;
+            requests = [CURLLoadRequest requestsWithContentsOfFile:[mixPath stringByExpandingTildeInPath] error:&error];
+            if (!requests)
+            {
+                NSLog(@"loadgen: couldn't read request mix %@: %@", mixPath, error);
+                return EXIT_FAILURE;
+            }
+        }
+        else
+        {
+            NSURL* url = urlString ? [NSURL URLWithString:urlString] : nil;
+            if (!url)
+            {
+                if (urlString)
+                {
+                    NSLog(@"loadgen: invalid url '%@'", urlString);
+                    return EXIT_FAILURE;
+                }
+
+                NSUInteger size = [defaults integerForKey:@"size"];
+                NSMutableData* payload = [NSMutableData dataWithLength:size];
+                memset([payload mutableBytes], 'x', size);
+
+                server = [CURLStandInServer HTTPServerWithPayload:payload];
+                [server start];
+                url = [server URLForPath:@"/loadgen/payload.bin"];
+            }
+
+            NSString* method = [defaults stringForKey:@"method"];
+            requests = @[[CURLLoadRequest requestWithURL:url method:[method uppercaseString] bodySize:[defaults integerForKey:@"body"]]];
+        }
+
+        CURLLoadGenerator* generator = [[CURLLoadGenerator alloc] init];
+        generator.requests = requests;
+        generator.shardCount = MAX([defaults integerForKey:@"shards"], 1);
+        generator.concurrency = MAX([defaults integerForKey:@"concurrency"], 1);
+        generator.rate = MAX([defaults doubleForKey:@"rate"], 0);
+        generator.duration = MAX([defaults doubleForKey:@"duration"], 0);
+        // with just a -duration, keep going until it's up rather than stopping at the default request count
+        BOOL requestsGiven = [[defaults volatileDomainForName:NSArgumentDomain] objectForKey:@"requests"] != nil;
+        generator.requestCount = ((generator.duration > 0) && !requestsGiven) ? 0 : MAX([defaults integerForKey:@"requests"], 0);
+
+        NSLog(@"loadgen: %lu shards, concurrency %lu, rate %@, %@ requests, duration %@, mix %@",
+              (unsigned long)generator.shardCount, (unsigned long)generator.concurrency,
+              generator.rate > 0 ? [NSString stringWithFormat:@"%.1f/s", generator.rate] : @"closed loop",
+              generator.requestCount ? @(generator.requestCount) : @"unlimited",
+              generator.duration > 0 ? [NSString stringWithFormat:@"%.1fs", generator.duration] : @"unlimited",
+              requests);
+
+        CURLLoadReport* report = [generator run];
+        NSLog(@"loadgen: %@", report);
+
+        if (report.completed == 0)
+        {
+            result = EXIT_FAILURE;
+        }
+
+        NSMutableDictionary* configuration = [NSMutableDictionary dictionary];
+        [configuration setObject:@(generator.shardCount) forKey:@"shards"];
+        [configuration setObject:@(generator.concurrency) forKey:@"concurrency"];
+        [configuration setObject:@(generator.rate) forKey:@"rate"];
+        [configuration setObject:@(generator.requestCount) forKey:@"requests"];
+        [configuration setObject:@(generator.duration) forKey:@"duration_s"];
+        [configuration setObject:[requests valueForKey:@"description"] forKey:@"mix"];
+
+        [generator release];
+        [server stop];
+
+        NSDictionary* output = @{
+                                 @"schema" : @1,
+                                 @"curl_version" : [CURLTransfer curlVersion],
+                                 @"configuration" : configuration,
+                                 @"results" : [report dictionaryRepresentation],
+                                 };
+
+        NSError* error = nil;
+        NSData* json = [NSJSONSerialization dataWithJSONObject:output options:NSJSONWritingPrettyPrinted error:&error];
+        NSString* path = [defaults stringForKey:@"output"];
+        if (!json)
+        {
+            NSLog(@"loadgen: couldn't encode results: %@", error);
+            result = EXIT_FAILURE;
+        }
+        else if (path)
+        {
+            if (![json writeToFile:[path stringByExpandingTildeInPath] options:NSDataWritingAtomic error:&error])
+            {
+                NSLog(@"loadgen: couldn't write results to %@: %@", path, error);
+                result = EXIT_FAILURE;
+            }
+        }
+        else
+        {
+            [[NSFileHandle fileHandleWithStandardOutput] writeData:json];
+        }
+    }
+
+    return result;
+}
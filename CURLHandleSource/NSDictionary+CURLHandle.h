@@ -13,6 +13,14 @@
 - (NSString *) formatForHTTPUsingEncoding:(NSStringEncoding)inEncoding;
 - (NSString *) formatForHTTPUsingEncoding:(NSStringEncoding)inEncoding ordering:(NSArray *)inOrdering;
 
+// The same as formatForHTTPUsingEncoding:ordering:, as bytes ready to send, without building a string along the way
+- (NSData *) formDataForHTTPUsingEncoding:(NSStringEncoding)inEncoding ordering:(NSArray *)inOrdering;
+
 @end
 
+@interface NSMutableURLRequest(CURLHandleForms)
+
+// Sets the body to the form data for the values, and the Content-Type to match; CURLTransfer sends the bytes as they are
+- (void) setHTTPBodyWithFormValues:(NSDictionary *)inValues encoding:(NSStringEncoding)inEncoding ordering:(NSArray *)inOrdering;
 
+@end
@@ -7,6 +7,195 @@
 
 #import "NSDictionary+CURLHandle.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <tmmintrin.h>
+#include <sys/sysctl.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#pragma mark - Form Encoding
+
+// Bytes which go out as they are; everything else is escaped with %. This is what CFURLCreateStringByAddingPercentEscapes
+// leaves alone when it's also asked to escape ;:@&=/+ - conforming with rfc 1738 3.3, and escaping URL-like characters
+// that might be in the parameters.
+static BOOL sFormSafeBytes[256];
+
+// The same, split up by nibble for the vector classifier. Each possible high nibble of a safe byte has a bit of its own,
+// and a byte is safe if the entries for its low and high nibbles have a bit in common.
+static uint8_t sFormSafeLowNibbles[16];
+static uint8_t sFormSafeHighNibbles[16];
+
+typedef size_t (*CURLFormSafeSpanFunction)(const uint8_t *bytes, size_t length);
+static CURLFormSafeSpanFunction sFormSafeSpanFunction;
+
+// How many bytes from the start need no escaping
+static size_t CURLFormSafeSpanScalar(const uint8_t *bytes, size_t length)
+{
+	size_t index = 0;
+	while (index < length && sFormSafeBytes[bytes[index]]) ++index;
+	return index;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("ssse3")))
+static size_t CURLFormSafeSpanSSSE3(const uint8_t *bytes, size_t length)
+{
+	const __m128i lowTable = _mm_loadu_si128((const __m128i *)sFormSafeLowNibbles);
+	const __m128i highTable = _mm_loadu_si128((const __m128i *)sFormSafeHighNibbles);
+	const __m128i nibbleMask = _mm_set1_epi8(0x0f);
+
+	size_t index = 0;
+	while (index + 16 <= length)
+	{
+		__m128i chunk = _mm_loadu_si128((const __m128i *)(bytes + index));
+		__m128i low = _mm_shuffle_epi8(lowTable, _mm_and_si128(chunk, nibbleMask));
+		__m128i high = _mm_shuffle_epi8(highTable, _mm_and_si128(_mm_srli_epi16(chunk, 4), nibbleMask));
+		int unsafe = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(low, high), _mm_setzero_si128()));
+		if (unsafe) return index + __builtin_ctz(unsafe);
+
+		index += 16;
+	}
+
+	return index + CURLFormSafeSpanScalar(bytes + index, length - index);
+}
+
+static BOOL CURLHasSSSE3Instructions(void)
+{
+	int available = 0;
+	size_t size = sizeof(available);
+	return (sysctlbyname("hw.optional.supplementalsse3", &available, &size, NULL, 0) == 0) && available;
+}
+
+#elif defined(__aarch64__)
+
+static size_t CURLFormSafeSpanNEON(const uint8_t *bytes, size_t length)
+{
+	const uint8x16_t lowTable = vld1q_u8(sFormSafeLowNibbles);
+	const uint8x16_t highTable = vld1q_u8(sFormSafeHighNibbles);
+	const uint8x16_t nibbleMask = vdupq_n_u8(0x0f);
+
+	size_t index = 0;
+	while (index + 16 <= length)
+	{
+		uint8x16_t chunk = vld1q_u8(bytes + index);
+		uint8x16_t safe = vandq_u8(vqtbl1q_u8(lowTable, vandq_u8(chunk, nibbleMask)), vqtbl1q_u8(highTable, vshrq_n_u8(chunk, 4)));
+		if (vminvq_u8(safe) == 0) break;	// one of these needs escaping, which the scalar loop pins down
+
+		index += 16;
+	}
+
+	return index + CURLFormSafeSpanScalar(bytes + index, length - index);
+}
+
+#endif
+
+static void CURLFormEncodingSetup(void)
+{
+	static dispatch_once_t once;
+	dispatch_once(&once, ^{
+
+		const char *safe = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789!$'()*,-._~?";
+		for (const char *c = safe; *c; ++c)
+		{
+			uint8_t byte = (uint8_t)*c;
+			sFormSafeBytes[byte] = YES;
+
+			// safe bytes are all printable ASCII, so their high nibbles are 2 to 7
+			sFormSafeHighNibbles[byte >> 4] = (uint8_t)(1 << ((byte >> 4) - 2));
+			sFormSafeLowNibbles[byte & 0x0f] |= (uint8_t)(1 << ((byte >> 4) - 2));
+		}
+
+		sFormSafeSpanFunction = CURLFormSafeSpanScalar;
+#if defined(__x86_64__) || defined(__i386__)
+		if (CURLHasSSSE3Instructions()) sFormSafeSpanFunction = CURLFormSafeSpanSSSE3;
+#elif defined(__aarch64__)
+		sFormSafeSpanFunction = CURLFormSafeSpanNEON;
+#endif
+	});
+}
+
+// A growable run of bytes, which ends up owned by an NSData
+typedef struct
+{
+	uint8_t	*bytes;
+	size_t	length;
+	size_t	capacity;
+} CURLFormBuffer;
+
+static void CURLFormBufferReserve(CURLFormBuffer *buffer, size_t extra)
+{
+	if (buffer->length + extra <= buffer->capacity) return;
+
+	buffer->capacity = MAX(buffer->capacity * 2, buffer->length + extra);
+	buffer->bytes = reallocf(buffer->bytes, buffer->capacity);
+	if (!buffer->bytes) [NSException raise:NSMallocException format:@"Couldn't allocate %lu bytes for form data", (unsigned long)buffer->capacity];
+}
+
+static void CURLFormBufferAppendByte(CURLFormBuffer *buffer, uint8_t byte)
+{
+	CURLFormBufferReserve(buffer, 1);
+	buffer->bytes[buffer->length++] = byte;
+}
+
+static void CURLFormBufferAppendEscaped(CURLFormBuffer *buffer, const uint8_t *bytes, size_t length)
+{
+	static const char hex[] = "0123456789ABCDEF";
+
+	// at worst, every byte becomes three
+	CURLFormBufferReserve(buffer, length * 3);
+	uint8_t *output = buffer->bytes + buffer->length;
+
+	while (length)
+	{
+		size_t span = sFormSafeSpanFunction(bytes, length);
+		memcpy(output, bytes, span);
+		output += span;
+		bytes += span;
+		length -= span;
+
+		if (length)
+		{
+			*output++ = '%';
+			*output++ = hex[*bytes >> 4];
+			*output++ = hex[*bytes & 0x0f];
+			++bytes;
+			--length;
+		}
+	}
+
+	buffer->length = output - buffer->bytes;
+}
+
+static void CURLFormBufferAppendString(CURLFormBuffer *buffer, id object, NSStringEncoding encoding)
+{
+	NSString *string = ([object isKindOfClass:[NSString class]] ? object : [object description]);
+
+	// ASCII strings often have their bytes to hand already
+	if (encoding == NSASCIIStringEncoding || encoding == NSUTF8StringEncoding)
+	{
+		const char *cString = CFStringGetCStringPtr((CFStringRef)string, CFStringConvertNSStringEncodingToEncoding(encoding));
+		if (cString)
+		{
+			CURLFormBufferAppendEscaped(buffer, (const uint8_t *)cString, [string length]);
+			return;
+		}
+	}
+
+	// otherwise convert a piece at a time; characters which don't exist in the encoding become ?
+	uint8_t piece[1024];
+	NSRange remaining = NSMakeRange(0, [string length]);
+	while (remaining.length)
+	{
+		NSUInteger used = 0;
+		[string getBytes:piece maxLength:sizeof(piece) usedLength:&used encoding:encoding options:NSStringEncodingConversionAllowLossy range:remaining remainingRange:&remaining];
+		if (!used) break;
+
+		CURLFormBufferAppendEscaped(buffer, piece, used);
+	}
+}
+
 @implementation NSDictionary ( CurlHTTPExtensions )
 
 /*"	This category adds methods for dealing with HTTP input and output to an #NSDictionary.
@@ -23,7 +212,7 @@
 }
 
 /*"	Convert a dictionary to an HTTP-formatted string with the given encoding.
-	Spaces are turned into !{+}; other special characters are escaped with !{%};
+	Spaces are turned into !{%20}; other special characters are escaped with !{%};
 	keys and values are output as %{key}=%{value}; in between arguments is !{&}.
 "*/
 
@@ -37,48 +226,82 @@
 
 - (NSString *) formatForHTTPUsingEncoding:(NSStringEncoding)inEncoding ordering:(NSArray *)inOrdering
 {
-	NSMutableString *s = [NSMutableString stringWithCapacity:256];
-	NSEnumerator *e = (nil == inOrdering) ? [self keyEnumerator] : [inOrdering objectEnumerator];
-	id key;
-	CFStringEncoding cfStrEnc = CFStringConvertNSStringEncodingToEncoding(inEncoding);
+	// anything outside ASCII has been escaped by now
+	NSData *data = [self formDataForHTTPUsingEncoding:inEncoding ordering:inOrdering];
+	return [[[NSString alloc] initWithData:data encoding:NSASCIIStringEncoding] autorelease];
+}
 
-	while ((key = [e nextObject]))
+/*"	Convert a dictionary to HTTP form data, exactly as #formatForHTTPUsingEncoding:ordering: would, but escaping straight
+	into a buffer of bytes rather than going through strings.  Values which respond to !{objectEnumerator} (arrays and sets)
+	give one %{key}=%{value} for each of their objects.  The bytes are handed over to the data without being copied.
+"*/
+
+- (NSData *) formDataForHTTPUsingEncoding:(NSStringEncoding)inEncoding ordering:(NSArray *)inOrdering
+{
+	CURLFormEncodingSetup();
+
+	CURLFormBuffer buffer = { NULL, 0, 0 };
+	CURLFormBufferReserve(&buffer, 32 * [self count] + 256);
+
+	for (id key in (inOrdering ? (id)inOrdering : (id)self))
 	{
-        id keyObject = [self objectForKey: key];
-		// conform with rfc 1738 3.3, also escape URL-like characters that might be in the parameters
-		NSString *escapedKey
-		= (NSString *) CFURLCreateStringByAddingPercentEscapes(
-														 NULL, (CFStringRef) key, NULL, (CFStringRef) @";:@&=/+", cfStrEnc);
-        if ([keyObject respondsToSelector: @selector(objectEnumerator)])
-        {
-            NSEnumerator	*multipleValueEnum = [keyObject objectEnumerator];
-            id				aValue;
-
-            while ((aValue = [multipleValueEnum nextObject]))
-            {
-                NSString *escapedObject
-                = (NSString *) CFURLCreateStringByAddingPercentEscapes(
-                                                                       NULL, (CFStringRef) [aValue description], NULL, (CFStringRef) @";:@&=/+", cfStrEnc);
-                [s appendFormat:@"%@=%@&", escapedKey, escapedObject];
-				[escapedObject release];
-            }
-        }
-        else
-        {
-            NSString *escapedObject
-            = (NSString *) CFURLCreateStringByAddingPercentEscapes(
-                                                                   NULL, (CFStringRef) [keyObject description], NULL, (CFStringRef) @";:@&=/+", cfStrEnc);
-            [s appendFormat:@"%@=%@&", escapedKey, escapedObject];
-			[escapedObject release];
-        }
-		[escapedKey release];
+		id keyObject = [self objectForKey:key];
+		if (!keyObject) continue;
+
+		NSEnumerator *multipleValueEnum = ([keyObject respondsToSelector:@selector(objectEnumerator)] ? [keyObject objectEnumerator] : nil);
+		id aValue = (multipleValueEnum ? [multipleValueEnum nextObject] : keyObject);
+
+		// the key is escaped once, and copied for any more of its values
+		size_t keyStart = 0;
+		size_t keyLength = 0;
+		while (aValue)
+		{
+			if (buffer.length) CURLFormBufferAppendByte(&buffer, '&');
+
+			if (keyLength)
+			{
+				CURLFormBufferReserve(&buffer, keyLength);
+				memcpy(buffer.bytes + buffer.length, buffer.bytes + keyStart, keyLength);
+				buffer.length += keyLength;
+			}
+			else
+			{
+				keyStart = buffer.length;
+				CURLFormBufferAppendString(&buffer, key, inEncoding);
+				keyLength = buffer.length - keyStart;
+			}
+
+			CURLFormBufferAppendByte(&buffer, '=');
+			CURLFormBufferAppendString(&buffer, aValue, inEncoding);
+
+			aValue = [multipleValueEnum nextObject];
+		}
 	}
-	// Delete final & from the string
-	if (![s isEqualToString:@""])
+
+	if (!buffer.length)
 	{
-		[s deleteCharactersInRange:NSMakeRange([s length]-1, 1)];
+		free(buffer.bytes);
+		return [NSData data];
 	}
-	return s;	
+
+	return [NSData dataWithBytesNoCopy:buffer.bytes length:buffer.length freeWhenDone:YES];
+}
+
+@end
+
+@implementation NSMutableURLRequest ( CurlHTTPFormExtensions )
+
+/*"	Use a dictionary, encoded as by #formDataForHTTPUsingEncoding:ordering:, as the body of the request.
+	The Content-Type is set to !{application/x-www-form-urlencoded}, with the encoding's charset.
+"*/
+
+- (void) setHTTPBodyWithFormValues:(NSDictionary *)inValues encoding:(NSStringEncoding)inEncoding ordering:(NSArray *)inOrdering
+{
+	[self setHTTPBody:[inValues formDataForHTTPUsingEncoding:inEncoding ordering:inOrdering]];
+
+	NSString *charset = (NSString *)CFStringConvertEncodingToIANACharSetName(CFStringConvertNSStringEncodingToEncoding(inEncoding));
+	NSString *contentType = (charset ? [NSString stringWithFormat:@"application/x-www-form-urlencoded; charset=%@", charset] : @"application/x-www-form-urlencoded");
+	[self setValue:contentType forHTTPHeaderField:@"Content-Type"];
 }
 
 @end
@@ -0,0 +1,106 @@
+//
+//  CURLReplayServer.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ A loopback HTTP/1.1 server which plays back responses captured by CURLTransferRecorder.
+
+ Each incoming request is matched to a record by its Host header, method and path (query included).
+ Records for the same request are served in the order they were recorded, starting over once they've
+ all been used. Anything that doesn't match gets a 404.
+
+ Responses are paced like the originals: the headers go out after the recorded time to first byte,
+ and the body is spread evenly over the rest of the recorded duration. The recorded body is sent
+ if there is one; otherwise a filler body of the recorded size is used. Since the body is replayed
+ decoded, the original Content-Encoding and Transfer-Encoding headers are dropped, and Content-Length
+ is set to match.
+
+ Every connection gets its own thread, using blocking I/O, so that slow responses don't hold each other up.
+ Like CURLConditioningProxy, the server doesn't need a run loop.
+ */
+
+@interface CURLReplayServer : NSObject
+{
+    NSMutableDictionary     *_records;
+    NSMutableDictionary     *_nextIndexes;
+    NSUInteger              _port;
+    int                     _listener;
+    dispatch_queue_t        _queue;
+    dispatch_source_t       _acceptSource;
+    NSMutableSet            *_clients;
+    BOOL                    _stopped;
+    NSUInteger              _servedCount;
+    NSUInteger              _unmatchedCount;
+    double                  _speed;
+}
+
+/**
+ Make a server for some records.
+
+ @param records CURLTransferRecord objects, as returned by +[CURLTransferRecorder recordsWithContentsOfURL:error:].
+ Records which aren't for HTTP are ignored.
+ @return A new server, which hasn't been started yet.
+ */
+
+- (id)initWithRecords:(NSArray*)records;
+
+/**
+ Start listening on an ephemeral loopback port.
+
+ @return YES if the server is now listening.
+ */
+
+- (BOOL)start;
+
+/**
+ Stop listening, and drop any connections that are still open.
+ */
+
+- (void)stop;
+
+/**
+ Returns the given URL, re-pointed at the server.
+
+ The original host should be sent in the Host header, so that the request still matches its record.
+
+ @param url A URL from a record.
+ @return The same URL, with the scheme, host and port replaced by the server's.
+ */
+
+- (NSURL*)URLByRoutingURL:(NSURL*)url;
+
+/**
+ The Host header to send with a routed request.
+
+ @param url A URL from a record.
+ @return The host and port from the URL, as HTTP clients normally send them.
+ */
+
++ (NSString*)hostHeaderForURL:(NSURL*)url;
+
+/**
+ How much faster than the original to replay. 1 (the default) keeps the original pacing,
+ 2 halves every delay, and zero sends everything as fast as possible.
+ */
+
+@property (assign, atomic) double speed;
+
+/**
+ The port the server is listening on, or zero if it hasn't been started.
+ */
+
+@property (readonly, nonatomic) NSUInteger port;
+
+/** How many requests have been answered from a record. */
+@property (readonly, atomic) NSUInteger servedCount;
+
+/** How many requests have been answered with a 404, because nothing matched them. */
+@property (readonly, atomic) NSUInteger unmatchedCount;
+
+@end
@@ -0,0 +1,623 @@
+//
+//  CURLReplayServer.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLReplayServer.h"
+#import "CURLTransferRecorder.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+static const size_t kReadChunkSize = 16 * 1024;
+static const NSUInteger kMaxHeaderBytes = 64 * 1024;
+static const NSUInteger kPacingChunkSize = 16 * 1024;
+
+@interface CURLReplayServer()
+
+@property (readwrite, atomic) NSUInteger servedCount;
+@property (readwrite, atomic) NSUInteger unmatchedCount;
+
+@end
+
+#pragma mark - Socket I/O
+
+static BOOL CURLReplayFill(int fd, NSMutableData* buffer)
+{
+    uint8_t bytes[kReadChunkSize];
+    ssize_t count;
+    do
+    {
+        count = read(fd, bytes, sizeof(bytes));
+    } while ((count < 0) && (errno == EINTR));
+
+    if (count <= 0)
+    {
+        return NO;
+    }
+
+    [buffer appendBytes:bytes length:count];
+    return YES;
+}
+
+static void CURLReplayConsume(NSMutableData* buffer, NSUInteger length)
+{
+    [buffer replaceBytesInRange:NSMakeRange(0, length) withBytes:NULL length:0];
+}
+
+/**
+ Returns everything up to and including the delimiter, reading more from the socket as needed.
+ */
+
+static NSData* CURLReplayReadUntil(int fd, NSMutableData* buffer, const char* delimiter)
+{
+    size_t delimiterLength = strlen(delimiter);
+    while (YES)
+    {
+        const uint8_t* bytes = [buffer bytes];
+        const uint8_t* found = memmem(bytes, [buffer length], delimiter, delimiterLength);
+        if (found)
+        {
+            NSUInteger length = (found - bytes) + delimiterLength;
+            NSData* result = [buffer subdataWithRange:NSMakeRange(0, length)];
+            CURLReplayConsume(buffer, length);
+            return result;
+        }
+
+        if (([buffer length] > kMaxHeaderBytes) || !CURLReplayFill(fd, buffer))
+        {
+            return nil;
+        }
+    }
+}
+
+static BOOL CURLReplaySkip(int fd, NSMutableData* buffer, uint64_t length)
+{
+    while (length)
+    {
+        if (![buffer length] && !CURLReplayFill(fd, buffer))
+        {
+            return NO;
+        }
+
+        NSUInteger count = (NSUInteger)MIN([buffer length], length);
+        CURLReplayConsume(buffer, count);
+        length -= count;
+    }
+
+    return YES;
+}
+
+static BOOL CURLReplaySkipChunkedBody(int fd, NSMutableData* buffer)
+{
+    while (YES)
+    {
+        NSData* line = CURLReplayReadUntil(fd, buffer, "\r\n");
+        if (!line)
+        {
+            return NO;
+        }
+
+        NSString* size = [[[NSString alloc] initWithData:line encoding:NSASCIIStringEncoding] autorelease];
+        uint64_t length = strtoull([size UTF8String], NULL, 16);
+        if (length == 0)
+        {
+            // skip any trailers, up to the blank line which ends the body
+            while ((line = CURLReplayReadUntil(fd, buffer, "\r\n")) && ([line length] > 2))
+            {
+            }
+
+            return (line != nil);
+        }
+
+        if (!CURLReplaySkip(fd, buffer, length + 2))
+        {
+            return NO;
+        }
+    }
+}
+
+static BOOL CURLReplayWrite(int fd, const void* bytes, size_t length)
+{
+    while (length)
+    {
+        ssize_t written = write(fd, bytes, length);
+        if (written < 0)
+        {
+            if (errno == EINTR) continue;
+            return NO;
+        }
+
+        bytes = (const uint8_t*)bytes + written;
+        length -= written;
+    }
+
+    return YES;
+}
+
+static BOOL CURLReplayWriteString(int fd, NSString* string)
+{
+    NSData* data = [string dataUsingEncoding:NSUTF8StringEncoding];
+    return CURLReplayWrite(fd, [data bytes], [data length]);
+}
+
+static NSString* CURLReplayNormalisedHost(NSString* host)
+{
+    host = [host lowercaseString];
+    if ([host hasSuffix:@":80"])
+    {
+        host = [host substringToIndex:[host length] - 3];
+    }
+
+    return host;
+}
+
+static NSString* CURLReplayPathOfURL(NSURL* url)
+{
+    // the path as it went over the wire, without any percent escapes decoded
+    NSString* path = [(NSString*)CFURLCopyPath((CFURLRef)url) autorelease];
+    if (![path length])
+    {
+        path = @"/";
+    }
+
+    NSString* query = [url query];
+    return query ? [NSString stringWithFormat:@"%@?%@", path, query] : path;
+}
+
+static NSString* CURLReplayKey(NSString* host, NSString* method, NSString* path)
+{
+    return [NSString stringWithFormat:@"%@ %@ %@", CURLReplayNormalisedHost(host), [method uppercaseString], path];
+}
+
+#pragma mark - Server
+
+@implementation CURLReplayServer
+
+@synthesize speed = _speed;
+@synthesize port = _port;
+@synthesize servedCount = _servedCount;
+@synthesize unmatchedCount = _unmatchedCount;
+
+#pragma mark - Object Lifecycle
+
+- (id)initWithRecords:(NSArray *)records
+{
+    if ((self = [super init]) != nil)
+    {
+        _records = [[NSMutableDictionary alloc] init];
+        _nextIndexes = [[NSMutableDictionary alloc] init];
+        _clients = [[NSMutableSet alloc] init];
+        _listener = -1;
+        _speed = 1.0;
+        _queue = dispatch_queue_create("com.karelia.CURLReplayServer", DISPATCH_QUEUE_SERIAL);
+
+        for (CURLTransferRecord* record in records)
+        {
+            NSString* scheme = [[record.URL scheme] lowercaseString];
+            if (![scheme isEqualToString:@"http"] && ![scheme isEqualToString:@"https"])
+            {
+                continue;
+            }
+
+            NSString* key = CURLReplayKey([[self class] hostHeaderForURL:record.URL], record.method, CURLReplayPathOfURL(record.URL));
+            NSMutableArray* matching = [_records objectForKey:key];
+            if (!matching)
+            {
+                matching = [NSMutableArray array];
+                [_records setObject:matching forKey:key];
+            }
+
+            [matching addObject:record];
+        }
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [self stop];
+
+    [_records release];
+    [_nextIndexes release];
+    [_clients release];
+    dispatch_release(_queue);
+
+    [super dealloc];
+}
+
+#pragma mark - Control
+
+- (BOOL)start
+{
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0)
+    {
+        return NO;
+    }
+
+    int on = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_len = sizeof(address);
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+
+    socklen_t length = sizeof(address);
+    if ((bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0) || (listen(listener, 128) != 0) || (getsockname(listener, (struct sockaddr*)&address, &length) != 0))
+    {
+        close(listener);
+        return NO;
+    }
+
+    _listener = listener;
+    _port = ntohs(address.sin_port);
+
+    _acceptSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, listener, 0, _queue);
+    dispatch_source_set_event_handler(_acceptSource, ^{
+        [self acceptConnection];
+    });
+
+    dispatch_source_t source = _acceptSource;
+    dispatch_source_set_cancel_handler(source, ^{
+        close(listener);
+        dispatch_release(source);
+    });
+
+    dispatch_resume(_acceptSource);
+    return YES;
+}
+
+- (void)stop
+{
+    dispatch_sync(_queue, ^{
+        if (_acceptSource)
+        {
+            dispatch_source_cancel(_acceptSource); // the cancel handler will close the socket and release the source
+            _acceptSource = NULL;
+            _listener = -1;
+        }
+    });
+
+    @synchronized(_clients)
+    {
+        _stopped = YES;
+
+        // shutting down rather than closing wakes up the connection threads, which close the sockets themselves
+        for (NSNumber* client in _clients)
+        {
+            shutdown([client intValue], SHUT_RDWR);
+        }
+    }
+}
+
+- (BOOL)isStopped
+{
+    @synchronized(_clients)
+    {
+        return _stopped;
+    }
+}
+
+#pragma mark - Connections
+
+- (void)acceptConnection
+{
+    if (_listener < 0)
+    {
+        return;
+    }
+
+    int client = accept(_listener, NULL, NULL);
+    if (client < 0)
+    {
+        return;
+    }
+
+    int on = 1;
+    setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    NSNumber* number = [NSNumber numberWithInt:client];
+    @synchronized(_clients)
+    {
+        [_clients addObject:number];
+    }
+
+    [NSThread detachNewThreadSelector:@selector(serveClient:) toTarget:self withObject:number];
+}
+
+- (void)serveClient:(NSNumber*)number
+{
+    int client = [number intValue];
+    NSMutableData* buffer = [[NSMutableData alloc] init];
+
+    BOOL keepAlive = YES;
+    while (keepAlive && ![self isStopped])
+    {
+        @autoreleasepool
+        {
+            keepAlive = [self serveRequestFromClient:client buffer:buffer];
+        }
+    }
+
+    [buffer release];
+
+    @synchronized(_clients)
+    {
+        [_clients removeObject:number];
+    }
+
+    close(client);
+}
+
+/**
+ Reads one request and sends its response.
+
+ @return YES if the connection can be used for another request.
+ */
+
+- (BOOL)serveRequestFromClient:(int)client buffer:(NSMutableData*)buffer
+{
+    NSData* head = CURLReplayReadUntil(client, buffer, "\r\n\r\n");
+    NSString* headString = head ? [[[NSString alloc] initWithData:head encoding:NSISOLatin1StringEncoding] autorelease] : nil;
+    NSArray* lines = [headString componentsSeparatedByString:@"\r\n"];
+    NSArray* requestLine = [lines count] ? [[lines objectAtIndex:0] componentsSeparatedByString:@" "] : nil;
+    if ([requestLine count] != 3)
+    {
+        return NO;
+    }
+
+    NSString* method = [requestLine objectAtIndex:0];
+    NSString* target = [requestLine objectAtIndex:1];
+    BOOL keepAlive = [[requestLine objectAtIndex:2] isEqualToString:@"HTTP/1.1"];
+
+    NSString* host = @"";
+    uint64_t contentLength = 0;
+    BOOL chunked = NO;
+    BOOL expectsContinue = NO;
+    for (NSString* line in lines)
+    {
+        NSRange colon = [line rangeOfString:@":"];
+        if (colon.location == NSNotFound) continue;
+
+        NSString* name = [[line substringToIndex:colon.location] lowercaseString];
+        NSString* value = [[line substringFromIndex:colon.location + 1] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        if ([name isEqualToString:@"host"])
+        {
+            host = value;
+        }
+        else if ([name isEqualToString:@"content-length"])
+        {
+            contentLength = strtoull([value UTF8String], NULL, 10);
+        }
+        else if ([name isEqualToString:@"transfer-encoding"])
+        {
+            chunked = ([value rangeOfString:@"chunked" options:NSCaseInsensitiveSearch].location != NSNotFound);
+        }
+        else if ([name isEqualToString:@"expect"])
+        {
+            expectsContinue = ([value caseInsensitiveCompare:@"100-continue"] == NSOrderedSame);
+        }
+        else if ([name isEqualToString:@"connection"])
+        {
+            keepAlive = ([value caseInsensitiveCompare:@"close"] != NSOrderedSame) && (keepAlive || ([value caseInsensitiveCompare:@"keep-alive"] == NSOrderedSame));
+        }
+    }
+
+    // uploads aren't replayed, just swallowed
+    if (expectsContinue && !CURLReplayWriteString(client, @"HTTP/1.1 100 Continue\r\n\r\n"))
+    {
+        return NO;
+    }
+
+    BOOL bodyRead = chunked ? CURLReplaySkipChunkedBody(client, buffer) : CURLReplaySkip(client, buffer, contentLength);
+    if (!bodyRead)
+    {
+        return NO;
+    }
+
+    // requests from a proxy client come with the full URL
+    NSURL* targetURL = [target hasPrefix:@"/"] ? nil : [NSURL URLWithString:target];
+    if (targetURL)
+    {
+        target = CURLReplayPathOfURL(targetURL);
+        if (![host length])
+        {
+            host = [[self class] hostHeaderForURL:targetURL];
+        }
+    }
+
+    CURLTransferRecord* record = [self nextRecordForKey:CURLReplayKey(host, method, target)];
+    if (!record)
+    {
+        self.unmatchedCount = self.unmatchedCount + 1;
+        NSString* response = [NSString stringWithFormat:@"HTTP/1.1 404 Not Recorded\r\nContent-Length: 0\r\n%@\r\n", keepAlive ? @"" : @"Connection: close\r\n"];
+        return CURLReplayWriteString(client, response) && keepAlive;
+    }
+
+    self.servedCount = self.servedCount + 1;
+    return [self sendRecord:record toClient:client isHEAD:[method isEqualToString:@"HEAD"] keepAlive:keepAlive] && keepAlive;
+}
+
+- (CURLTransferRecord*)nextRecordForKey:(NSString*)key
+{
+    @synchronized(_records)
+    {
+        NSArray* matching = [_records objectForKey:key];
+        if (![matching count])
+        {
+            return nil;
+        }
+
+        NSUInteger index = [[_nextIndexes objectForKey:key] unsignedIntegerValue];
+        [_nextIndexes setObject:@((index + 1) % [matching count]) forKey:key];
+
+        return [[[matching objectAtIndex:index] retain] autorelease];
+    }
+}
+
+#pragma mark - Responses
+
+- (NSString*)responseHeadForRecord:(CURLTransferRecord*)record isHEAD:(BOOL)isHEAD keepAlive:(BOOL)keepAlive
+{
+    // with redirects or 100 Continue, the recorded headers hold more than one response; the last one is the one that counted
+    NSString* reason = nil;
+    NSMutableArray* headers = [NSMutableArray array];
+    NSString* originalLength = nil;
+    for (NSString* line in [record.responseHeaders componentsSeparatedByCharactersInSet:[NSCharacterSet newlineCharacterSet]])
+    {
+        if ([line hasPrefix:@"HTTP/"])
+        {
+            [headers removeAllObjects];
+            originalLength = nil;
+
+            NSArray* parts = [line componentsSeparatedByString:@" "];
+            reason = ([parts count] > 2) ? [[parts subarrayWithRange:NSMakeRange(2, [parts count] - 2)] componentsJoinedByString:@" "] : @"";
+            continue;
+        }
+
+        NSRange colon = [line rangeOfString:@":"];
+        if (colon.location == NSNotFound) continue;
+
+        NSString* name = [[line substringToIndex:colon.location] lowercaseString];
+        if ([name isEqualToString:@"content-length"])
+        {
+            originalLength = [[line substringFromIndex:colon.location + 1] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        }
+        else if (![name isEqualToString:@"transfer-encoding"] && ![name isEqualToString:@"content-encoding"] &&
+                 ![name isEqualToString:@"connection"] && ![name isEqualToString:@"keep-alive"])
+        {
+            [headers addObject:line];
+        }
+    }
+
+    NSInteger status = record.statusCode ? record.statusCode : 200;
+    NSMutableString* result = [NSMutableString stringWithFormat:@"HTTP/1.1 %ld %@\r\n", (long)status, reason ? reason : @"Replayed"];
+    for (NSString* header in headers)
+    {
+        [result appendFormat:@"%@\r\n", header];
+    }
+
+    if ((status >= 200) && (status != 204) && (status != 304))
+    {
+        // a HEAD response describes the body it would have had
+        if (isHEAD && originalLength)
+        {
+            [result appendFormat:@"Content-Length: %@\r\n", originalLength];
+        }
+        else
+        {
+            [result appendFormat:@"Content-Length: %llu\r\n", (unsigned long long)record.bytesReceived];
+        }
+    }
+
+    if (!keepAlive)
+    {
+        [result appendString:@"Connection: close\r\n"];
+    }
+
+    [result appendString:@"\r\n"];
+    return result;
+}
+
+- (BOOL)waitUntil:(NSTimeInterval)time
+{
+    NSTimeInterval delay;
+    while (((delay = time - [NSDate timeIntervalSinceReferenceDate]) > 0) && ![self isStopped])
+    {
+        // wake up now and then, so that stopping the server isn't held up by a long response
+        [NSThread sleepForTimeInterval:MIN(delay, 0.1)];
+    }
+
+    return ![self isStopped];
+}
+
+- (BOOL)sendRecord:(CURLTransferRecord*)record toClient:(int)client isHEAD:(BOOL)isHEAD keepAlive:(BOOL)keepAlive
+{
+    double speed = self.speed;
+    double scale = (speed > 0) ? 1.0 / speed : 0;
+    NSTimeInterval start = [NSDate timeIntervalSinceReferenceDate];
+
+    if (![self waitUntil:start + record.firstByteTime * scale])
+    {
+        return NO;
+    }
+
+    NSString* head = [self responseHeadForRecord:record isHEAD:isHEAD keepAlive:keepAlive];
+    if (!CURLReplayWriteString(client, head))
+    {
+        return NO;
+    }
+
+    NSInteger status = record.statusCode;
+    if (isHEAD || (status == 204) || (status == 304) || ((status > 0) && (status < 200)))
+    {
+        return YES;
+    }
+
+    uint64_t length = record.bytesReceived;
+    NSData* body = record.body;
+    if ([body length] != length)
+    {
+        body = nil;
+    }
+
+    uint8_t filler[kPacingChunkSize];
+    memset(filler, 'x', sizeof(filler));
+
+    NSTimeInterval bodyStart = [NSDate timeIntervalSinceReferenceDate];
+    NSTimeInterval bodyDuration = MAX(record.duration - record.firstByteTime, 0) * scale;
+    uint64_t sent = 0;
+    while (sent < length)
+    {
+        NSUInteger count = (NSUInteger)MIN(length - sent, kPacingChunkSize);
+        const void* bytes = body ? (const uint8_t*)[body bytes] + sent : filler;
+        if (!CURLReplayWrite(client, bytes, count))
+        {
+            return NO;
+        }
+
+        sent += count;
+
+        // spread the body evenly over the time the original took
+        if ((sent < length) && ![self waitUntil:bodyStart + bodyDuration * ((double)sent / length)])
+        {
+            return NO;
+        }
+    }
+
+    return YES;
+}
+
+#pragma mark - URLs
+
++ (NSString*)hostHeaderForURL:(NSURL *)url
+{
+    NSNumber* port = [url port];
+    return port ? [NSString stringWithFormat:@"%@:%@", [url host], port] : [url host];
+}
+
+- (NSURL*)URLByRoutingURL:(NSURL *)url
+{
+    NSMutableString* string = [NSMutableString stringWithFormat:@"http://127.0.0.1:%lu", (unsigned long)self.port];
+    [string appendString:CURLReplayPathOfURL(url)];
+
+    return [NSURL URLWithString:string];
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"<REPLAY %p port %lu, %lu requests recorded, %lu served, %lu unmatched>", self, (unsigned long)self.port, (unsigned long)[_records count], (unsigned long)self.servedCount, (unsigned long)self.unmatchedCount];
+}
+
+@end
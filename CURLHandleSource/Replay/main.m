@@ -0,0 +1,350 @@
+//
+//  main.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+//  Replays a log captured with CURLTransferRecorder against a local CURLReplayServer, so that
+//  real-world traffic shapes can be re-run offline, and compared before and after a change.
+//
+//  Usage:
+//      Replay -log capture.curlrec [-speed 1] [-output results.json]
+//
+//  Each HTTP transfer in the log is started at its original offset (divided by -speed), and the
+//  server answers it with the recorded response at the recorded pacing. Non-HTTP transfers are skipped.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "CURLMultiHandle.h"
+#import "CURLReplayServer.h"
+#import "CURLTransfer.h"
+#import "CURLTransferRecorder.h"
+
+static NSTimeInterval CURLReplayPercentile(NSArray* sorted, double percentile)
+{
+    NSUInteger count = [sorted count];
+    if (!count)
+    {
+        return 0;
+    }
+
+    // nearest-rank, as CURLLoadReport does
+    NSUInteger rank = (NSUInteger)ceil(percentile / 100.0 * count);
+    return [[sorted objectAtIndex:MIN(MAX(rank, 1), count) - 1] doubleValue];
+}
+
+static NSDictionary* CURLReplaySummary(NSArray* latencies)
+{
+    NSArray* sorted = [latencies sortedArrayUsingSelector:@selector(compare:)];
+    return @{
+             @"count" : @([sorted count]),
+             @"latency_p50_ms" : @(CURLReplayPercentile(sorted, 50) * 1000.0),
+             @"latency_p90_ms" : @(CURLReplayPercentile(sorted, 90) * 1000.0),
+             @"latency_p99_ms" : @(CURLReplayPercentile(sorted, 99) * 1000.0),
+             @"latency_max_ms" : @(CURLReplayPercentile(sorted, 100) * 1000.0),
+             };
+}
+
+/**
+ The CURLcode behind an error, if there is one. CURLTransfer often wraps it in a friendlier NSURLErrorDomain error.
+ */
+
+static NSInteger CURLReplayCodeForError(NSError* error)
+{
+    if ([error.domain isEqualToString:CURLcodeErrorDomain])
+    {
+        return error.code;
+    }
+
+    NSError* underlying = [error.userInfo objectForKey:NSUnderlyingErrorKey];
+    if ([underlying.domain isEqualToString:CURLcodeErrorDomain])
+    {
+        return underlying.code;
+    }
+
+    return -1;
+}
+
+#pragma mark - Client
+
+/**
+ Starts a transfer for each record at the right moment, and collects how long they took.
+ */
+
+@interface CURLReplayClient : NSObject <CURLTransferDelegate>
+{
+    CURLReplayServer    *_server;
+    CURLMultiHandle     *_multi;
+    NSOperationQueue    *_queue;
+    NSMutableDictionary *_starts;
+    NSMutableArray      *_replayed;
+    NSMutableArray      *_recorded;
+    NSCountedSet        *_errorCodes;
+    NSUInteger          _statusMismatches;
+    NSUInteger          _remaining;
+}
+
+- (id)initWithServer:(CURLReplayServer*)server;
+- (void)replayRecords:(NSArray*)records speed:(double)speed;
+- (NSDictionary*)results;
+
+@end
+
+@implementation CURLReplayClient
+
+- (id)initWithServer:(CURLReplayServer *)server
+{
+    if ((self = [super init]) != nil)
+    {
+        _server = [server retain];
+        _multi = [[CURLMultiHandle alloc] initWithQueueNamed:@"com.karelia.Replay"];
+        _queue = [[NSOperationQueue alloc] init];
+        [_queue setMaxConcurrentOperationCount:1];
+        _starts = [[NSMutableDictionary alloc] init];
+        _replayed = [[NSMutableArray alloc] init];
+        _recorded = [[NSMutableArray alloc] init];
+        _errorCodes = [[NSCountedSet alloc] init];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_multi shutdown];
+
+    [_server release];
+    [_multi release];
+    [_queue release];
+    [_starts release];
+    [_replayed release];
+    [_recorded release];
+    [_errorCodes release];
+
+    [super dealloc];
+}
+
+- (NSURLRequest*)requestForRecord:(CURLTransferRecord*)record
+{
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[_server URLByRoutingURL:record.URL]];
+    [request setHTTPMethod:record.method];
+
+    [record.requestHeaders enumerateKeysAndObjectsUsingBlock:^(NSString* name, NSString* value, BOOL *stop) {
+        if (([name caseInsensitiveCompare:@"Host"] != NSOrderedSame) && ([name caseInsensitiveCompare:@"Content-Length"] != NSOrderedSame))
+        {
+            [request setValue:value forHTTPHeaderField:name];
+        }
+    }];
+
+    [request setValue:[CURLReplayServer hostHeaderForURL:record.URL] forHTTPHeaderField:@"Host"];
+
+    if (record.bytesSent)
+    {
+        // upload bodies aren't recorded, but their size is
+        NSMutableData* body = [NSMutableData dataWithLength:(NSUInteger)record.bytesSent];
+        memset([body mutableBytes], 'x', [body length]);
+        [request setHTTPBody:body];
+    }
+
+    return request;
+}
+
+- (void)replayRecords:(NSArray *)records speed:(double)speed
+{
+    // records were written as transfers finished, so put them back in the order they started
+    NSArray* sorted = [records sortedArrayUsingComparator:^NSComparisonResult(CURLTransferRecord* record1, CURLTransferRecord* record2) {
+        return [@(record1.startTime) compare:@(record2.startTime)];
+    }];
+
+    NSTimeInterval origin = [sorted count] ? [[sorted objectAtIndex:0] startTime] : 0;
+    double scale = (speed > 0) ? 1.0 / speed : 0;
+
+    _remaining = [sorted count];
+    for (CURLTransferRecord* record in sorted)
+    {
+        NSTimeInterval delay = (record.startTime - origin) * scale;
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+            NSURLRequest* request = [self requestForRecord:record];
+            NSNumber* start = @([NSDate timeIntervalSinceReferenceDate]);
+
+            [_queue addOperationWithBlock:^{
+                CURLTransfer* transfer = [[CURLTransfer alloc] initWithRequest:request credential:nil delegate:self delegateQueue:_queue multi:_multi];
+                [_starts setObject:@[start, record] forKey:[NSValue valueWithNonretainedObject:transfer]];
+                [transfer release]; // the multi keeps hold of it until it's done
+            }];
+        });
+    }
+
+    while (self.remaining)
+    {
+        [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+}
+
+- (NSUInteger)remaining
+{
+    @synchronized(self)
+    {
+        return _remaining;
+    }
+}
+
+- (void)transfer:(CURLTransfer *)transfer didReceiveResponse:(NSURLResponse *)response
+{
+    NSArray* entry = [_starts objectForKey:[NSValue valueWithNonretainedObject:transfer]];
+    CURLTransferRecord* record = [entry objectAtIndex:1];
+    if ([response respondsToSelector:@selector(statusCode)] && ([(NSHTTPURLResponse*)response statusCode] != record.statusCode))
+    {
+        ++_statusMismatches;
+    }
+}
+
+- (void)transfer:(CURLTransfer *)transfer didReceiveData:(NSData *)data
+{
+}
+
+- (void)transfer:(CURLTransfer *)transfer didCompleteWithError:(NSError *)error
+{
+    NSTimeInterval end = [NSDate timeIntervalSinceReferenceDate];
+    NSValue* key = [NSValue valueWithNonretainedObject:transfer];
+    NSArray* entry = [_starts objectForKey:key];
+    CURLTransferRecord* record = [entry objectAtIndex:1];
+
+    if (error)
+    {
+        [_errorCodes addObject:@(CURLReplayCodeForError(error))];
+    }
+    else
+    {
+        [_replayed addObject:@(end - [[entry objectAtIndex:0] doubleValue])];
+        [_recorded addObject:@(record.duration)];
+    }
+
+    [_starts removeObjectForKey:key];
+
+    @synchronized(self)
+    {
+        --_remaining;
+    }
+}
+
+- (NSDictionary*)results
+{
+    __block NSDictionary* result = nil;
+    [_queue addOperations:@[[NSBlockOperation blockOperationWithBlock:^{
+        NSMutableDictionary* errors = [NSMutableDictionary dictionary];
+        for (NSNumber* code in _errorCodes)
+        {
+            [errors setObject:@([_errorCodes countForObject:code]) forKey:[code stringValue]];
+        }
+
+        result = [@{
+                    @"replayed" : CURLReplaySummary(_replayed),
+                    @"recorded" : CURLReplaySummary(_recorded),
+                    @"errors" : errors,
+                    @"status_mismatches" : @(_statusMismatches),
+                    } retain];
+    }]] waitUntilFinished:YES];
+
+    return [result autorelease];
+}
+
+@end
+
+#pragma mark - Main
+
+int main(int argc, const char * argv[])
+{
+    int result = EXIT_SUCCESS;
+
+    @autoreleasepool
+    {
+        // NSUserDefaults picks up "-key value" pairs from the command line
+        NSUserDefaults* defaults = [NSUserDefaults standardUserDefaults];
+        [defaults registerDefaults:@{ @"speed" : @1 }];
+
+        NSString* logPath = [defaults stringForKey:@"log"];
+        if (!logPath)
+        {
+            NSLog(@"replay: usage: Replay -log capture.curlrec [-speed 1] [-output results.json]");
+            return EXIT_FAILURE;
+        }
+
+        NSError* error = nil;
+        NSArray* records = [CURLTransferRecorder recordsWithContentsOfURL:[NSURL fileURLWithPath:[logPath stringByExpandingTildeInPath]] error:&error];
+        if (!records)
+        {
+            NSLog(@"replay: couldn't read %@: %@", logPath, error);
+            return EXIT_FAILURE;
+        }
+
+        NSMutableArray* httpRecords = [NSMutableArray arrayWithCapacity:[records count]];
+        for (CURLTransferRecord* record in records)
+        {
+            NSString* scheme = [[record.URL scheme] lowercaseString];
+            if ([scheme isEqualToString:@"http"] || [scheme isEqualToString:@"https"])
+            {
+                [httpRecords addObject:record];
+            }
+        }
+
+        double speed = MAX([defaults doubleForKey:@"speed"], 0);
+        NSLog(@"replay: %lu of %lu records are HTTP, replaying at %@", (unsigned long)[httpRecords count], (unsigned long)[records count],
+              speed > 0 ? [NSString stringWithFormat:@"%.2fx", speed] : @"full speed");
+
+        CURLReplayServer* server = [[CURLReplayServer alloc] initWithRecords:httpRecords];
+        server.speed = speed;
+        if (![server start])
+        {
+            NSLog(@"replay: couldn't start server");
+            [server release];
+            return EXIT_FAILURE;
+        }
+
+        CURLReplayClient* client = [[CURLReplayClient alloc] initWithServer:server];
+        [client replayRecords:httpRecords speed:speed];
+        NSDictionary* results = [client results];
+        [client release];
+
+        [server stop];
+        NSLog(@"replay: %@", server);
+
+        if ([server unmatchedCount] || [[results objectForKey:@"errors"] count])
+        {
+            result = EXIT_FAILURE;
+        }
+
+        NSDictionary* output = @{
+                                 @"schema" : @1,
+                                 @"curl_version" : [CURLTransfer curlVersion],
+                                 @"configuration" : @{ @"log" : logPath, @"speed" : @(speed), @"records" : @([records count]), @"replayed" : @([httpRecords count]) },
+                                 @"results" : results,
+                                 @"unmatched" : @(server.unmatchedCount),
+                                 };
+        [server release];
+
+        NSData* json = [NSJSONSerialization dataWithJSONObject:output options:NSJSONWritingPrettyPrinted error:&error];
+        NSString* path = [defaults stringForKey:@"output"];
+        if (!json)
+        {
+            NSLog(@"replay: couldn't encode results: %@", error);
+            result = EXIT_FAILURE;
+        }
+        else if (path)
+        {
+            if (![json writeToFile:[path stringByExpandingTildeInPath] options:NSDataWritingAtomic error:&error])
+            {
+                NSLog(@"replay: couldn't write results to %@: %@", path, error);
+                result = EXIT_FAILURE;
+            }
+        }
+        else
+        {
+            [[NSFileHandle fileHandleWithStandardOutput] writeData:json];
+        }
+    }
+
+    return result;
+}
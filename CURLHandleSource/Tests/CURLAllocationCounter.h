@@ -0,0 +1,55 @@
+//
+//  CURLAllocationCounter.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ Counts heap allocations and Objective-C object allocations made by CURLHandle's hot paths.
+
+ While counting, every malloc zone is wrapped and +[NSObject allocWithZone:] is swizzled. Only
+ allocations made on a watched queue (normally the multi's queue, where all of the socket
+ and callback work happens) or inside countAllocationsInBlock: are recorded. Allocations made by
+ the stand-in server, or by the test's own delegate code, don't pollute the numbers.
+
+ Only one counter can be counting at a time.
+ */
+
+@interface CURLAllocationCounter : NSObject
+{
+    dispatch_queue_t    _queue;
+    uint64_t            _mallocs;
+    uint64_t            _bytes;
+    uint64_t            _objects;
+    BOOL                _counting;
+}
+
+/**
+ Make a counter which records allocations made on the given queue.
+
+ @param queue The queue to watch. Usually the multi's queue.
+ @return A new counter, which isn't counting yet.
+ */
+
+- (id)initWatchingQueue:(dispatch_queue_t)queue;
+
+- (void)start;
+- (void)stop;
+
+/**
+ Also record any allocations made by the block, which is run synchronously on the current thread.
+
+ Use this for work which happens on the caller's thread, such as setting up a transfer.
+ */
+
+- (void)countAllocationsInBlock:(void (^)(void))block;
+
+@property (readonly, nonatomic) uint64_t mallocs;
+@property (readonly, nonatomic) uint64_t bytes;
+@property (readonly, nonatomic) uint64_t objects;
+
+@end
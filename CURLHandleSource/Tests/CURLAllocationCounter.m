@@ -0,0 +1,251 @@
+//
+//  CURLAllocationCounter.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLAllocationCounter.h"
+
+#include <libkern/OSAtomic.h>
+#include <malloc/malloc.h>
+#include <mach/mach.h>
+#include <mach/mach_vm.h>
+#include <objc/runtime.h>
+
+#define MAX_HOOKED_ZONES 16
+
+typedef struct
+{
+    malloc_zone_t   *zone;
+    void            *(*malloc)(malloc_zone_t* zone, size_t size);
+    void            *(*calloc)(malloc_zone_t* zone, size_t count, size_t size);
+    void            *(*realloc)(malloc_zone_t* zone, void* pointer, size_t size);
+} CURLZoneHooks;
+
+static CURLZoneHooks gHooks[MAX_HOOKED_ZONES];
+static unsigned gHookCount = 0;
+static IMP gOriginalAllocWithZone = NULL;
+
+static volatile BOOL gCounting = NO;
+static volatile int64_t gMallocs = 0;
+static volatile int64_t gBytes = 0;
+static volatile int64_t gObjects = 0;
+static char kWatchedQueueKey;
+static __thread int tCountingThisThread = 0;
+
+#pragma mark - Recording
+
+// Nothing in here can allocate, or send Objective-C messages (which might allocate when filling a method cache).
+
+static inline BOOL CURLShouldCount()
+{
+    return gCounting && (tCountingThisThread || dispatch_get_specific(&kWatchedQueueKey));
+}
+
+static inline void CURLRecordMalloc(size_t size)
+{
+    OSAtomicIncrement64(&gMallocs);
+    OSAtomicAdd64((int64_t)size, &gBytes);
+}
+
+static inline CURLZoneHooks* CURLHooksForZone(malloc_zone_t* zone)
+{
+    for (unsigned n = 0; n < gHookCount; ++n)
+    {
+        if (gHooks[n].zone == zone)
+        {
+            return &gHooks[n];
+        }
+    }
+
+    return NULL;
+}
+
+static void* CURLCountingMalloc(malloc_zone_t* zone, size_t size)
+{
+    if (CURLShouldCount())
+    {
+        CURLRecordMalloc(size);
+    }
+
+    return CURLHooksForZone(zone)->malloc(zone, size);
+}
+
+static void* CURLCountingCalloc(malloc_zone_t* zone, size_t count, size_t size)
+{
+    if (CURLShouldCount())
+    {
+        CURLRecordMalloc(count * size);
+    }
+
+    return CURLHooksForZone(zone)->calloc(zone, count, size);
+}
+
+static void* CURLCountingRealloc(malloc_zone_t* zone, void* pointer, size_t size)
+{
+    if (CURLShouldCount())
+    {
+        CURLRecordMalloc(size);
+    }
+
+    return CURLHooksForZone(zone)->realloc(zone, pointer, size);
+}
+
+static id CURLCountingAllocWithZone(id self, SEL _cmd, NSZone* zone)
+{
+    if (CURLShouldCount())
+    {
+        OSAtomicIncrement64(&gObjects);
+    }
+
+    return ((id (*)(id, SEL, NSZone*))gOriginalAllocWithZone)(self, _cmd, zone);
+}
+
+#pragma mark - Hook Installation
+
+static void CURLHookZone(malloc_zone_t* zone)
+{
+    if ((gHookCount == MAX_HOOKED_ZONES) || CURLHooksForZone(zone))
+    {
+        return;
+    }
+
+    // zones are usually write-protected these days, so find out how the page is protected, to put it back exactly as it was
+    mach_vm_address_t page = trunc_page((mach_vm_address_t)(uintptr_t)zone);
+    mach_vm_size_t length = round_page((mach_vm_address_t)(uintptr_t)zone + sizeof(malloc_zone_t)) - page;
+
+    mach_vm_address_t region = page;
+    mach_vm_size_t regionLength = 0;
+    vm_region_basic_info_data_64_t info;
+    mach_msg_type_number_t infoCount = VM_REGION_BASIC_INFO_COUNT_64;
+    mach_port_t object = MACH_PORT_NULL;
+    if ((mach_vm_region(mach_task_self(), &region, &regionLength, VM_REGION_BASIC_INFO_64, (vm_region_info_t)&info, &infoCount, &object) != KERN_SUCCESS) ||
+        (region > page) || (region + regionLength < page + length))
+    {
+        return; // a zone we can't make sense of goes uncounted, rather than risk it
+    }
+
+    BOOL writable = ((info.protection & VM_PROT_WRITE) != 0);
+    if (!writable && (mach_vm_protect(mach_task_self(), page, length, FALSE, info.protection | VM_PROT_WRITE) != KERN_SUCCESS))
+    {
+        return;
+    }
+
+    CURLZoneHooks* hooks = &gHooks[gHookCount];
+    hooks->zone = zone;
+    hooks->malloc = zone->malloc;
+    hooks->calloc = zone->calloc;
+    hooks->realloc = zone->realloc;
+
+    // publish the hooks before the zone can call them
+    ++gHookCount;
+    OSMemoryBarrier();
+
+    zone->malloc = CURLCountingMalloc;
+    zone->calloc = CURLCountingCalloc;
+    zone->realloc = CURLCountingRealloc;
+
+    if (!writable)
+    {
+        mach_vm_protect(mach_task_self(), page, length, FALSE, info.protection);
+    }
+}
+
+static void CURLInstallHooks()
+{
+    // The hooks stay installed once they're in, and just stop counting when no counter is active.
+    // Taking them out again while other threads might be half way through a call isn't safe.
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        vm_address_t* zones = NULL;
+        unsigned count = 0;
+        if (malloc_get_all_zones(mach_task_self(), NULL, &zones, &count) == KERN_SUCCESS)
+        {
+            for (unsigned n = 0; n < count; ++n)
+            {
+                CURLHookZone((malloc_zone_t*)zones[n]);
+            }
+        }
+
+        Method method = class_getClassMethod([NSObject class], @selector(allocWithZone:));
+        gOriginalAllocWithZone = method_setImplementation(method, (IMP)CURLCountingAllocWithZone);
+    });
+}
+
+#pragma mark - Counter
+
+@implementation CURLAllocationCounter
+
+@synthesize mallocs = _mallocs;
+@synthesize bytes = _bytes;
+@synthesize objects = _objects;
+
+- (id)initWatchingQueue:(dispatch_queue_t)queue
+{
+    if ((self = [super init]) != nil)
+    {
+        _queue = queue;
+        dispatch_retain(_queue);
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_counting)
+    {
+        [self stop];
+    }
+
+    dispatch_release(_queue);
+
+    [super dealloc];
+}
+
+- (void)start
+{
+    NSAssert(!gCounting, @"only one counter can be active at once");
+
+    CURLInstallHooks();
+
+    _mallocs = _bytes = _objects = 0;
+    gMallocs = gBytes = gObjects = 0;
+    _counting = YES;
+    dispatch_queue_set_specific(_queue, &kWatchedQueueKey, &kWatchedQueueKey, NULL);
+
+    OSMemoryBarrier();
+    gCounting = YES;
+}
+
+- (void)stop
+{
+    // wait for anything already on the queue to finish
+    dispatch_sync(_queue, ^{ });
+
+    gCounting = NO;
+    OSMemoryBarrier();
+
+    dispatch_queue_set_specific(_queue, &kWatchedQueueKey, NULL, NULL);
+    _counting = NO;
+
+    _mallocs = gMallocs;
+    _bytes = gBytes;
+    _objects = gObjects;
+}
+
+- (void)countAllocationsInBlock:(void (^)(void))block
+{
+    ++tCountingThisThread;
+    block();
+    --tCountingThisThread;
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"<ALLOCATIONS %llu mallocs, %llu bytes, %llu objects>", _mallocs, _bytes, _objects];
+}
+
+@end
@@ -0,0 +1,160 @@
+//
+//  CURLAllocationTests.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLHandleBasedTest.h"
+#import "CURLAllocationCounter.h"
+#import "CURLMultiHandle.h"
+#import "CURLStandInServer.h"
+#import "CURLTransfer+TestingSupport.h"
+
+// Budgets for a single transfer, covering request setup on the caller's thread, and everything done on the multi's queue.
+// Each is set just above what the tests log, so that a change which makes the hot paths noticeably more expensive
+// fails. When a change makes them cheaper, ratchet the budgets down to just above the new numbers so that the
+// improvement sticks; when one has to cost more, raise them deliberately, in the same change.
+
+static const uint64_t kMaxObjectsPerRequest = 160;
+static const uint64_t kMaxMallocsPerRequest = 700;
+static const uint64_t kMaxBytesPerRequest = 128 * 1024;
+
+// Budgets for the work which scales with the size of the transfer - the read and write callbacks.
+
+static const uint64_t kMaxObjectsPerMB = 140;
+static const uint64_t kMaxMallocsPerMB = 260;
+
+static const NSUInteger kPayloadLength = 256 * 1024;
+static const NSUInteger kRequestCount = 20;
+
+@interface CURLAllocationTests : CURLHandleBasedTest
+
+@end
+
+@implementation CURLAllocationTests
+
+- (void)transfer:(CURLTransfer *)transfer didReceiveData:(NSData *)data
+{
+    // just keep a count; the buffer would only get in the way of large runs
+    self.expected += [data length];
+}
+
+- (void)transfer:(CURLTransfer *)transfer didReceiveResponse:(NSURLResponse *)response
+{
+    self.response = response;
+}
+
+- (void)transfer:(CURLTransfer*)transfer didCompleteWithError:(NSError *)error
+{
+    if (error)
+    {
+        self.error = error;
+    }
+    else
+    {
+        self.finishedCount++;
+    }
+
+    [self pause];
+}
+
+/**
+ Run the workload one transfer at a time, counting what the transfers allocate.
+ Delegate callbacks happen on the main queue, so the test's own work isn't counted.
+ */
+
+- (CURLAllocationCounter*)countAllocationsForRequests:(NSArray*)requests
+{
+    CURLMultiHandle* multi = [CURLMultiHandle sharedInstance];
+    CURLAllocationCounter* counter = [[[CURLAllocationCounter alloc] initWatchingQueue:multi.queue] autorelease];
+
+    // one untimed transfer first, so that one-off costs (loading libcurl's tables, filling caches, opening the
+    // connection that gets re-used) aren't charged to the workload
+    CURLTransfer* warmup = [[CURLTransfer alloc] initWithRequest:[requests objectAtIndex:0] credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue] multi:multi];
+    [self runUntilPaused];
+    [warmup release];
+
+    self.finishedCount = 0;
+    self.expected = 0;
+
+    [counter start];
+    for (NSURLRequest* request in requests)
+    {
+        __block CURLTransfer* transfer = nil;
+        [counter countAllocationsInBlock:^{
+            transfer = [[CURLTransfer alloc] initWithRequest:request credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue] multi:multi];
+        }];
+
+        [self runUntilPaused];
+        [transfer release];
+    }
+    [counter stop];
+
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEquals(self.finishedCount, [requests count], @"all transfers should have finished");
+
+    return counter;
+}
+
+- (void)checkCounter:(CURLAllocationCounter*)counter requests:(NSUInteger)requests bytesTransferred:(NSUInteger)transferred
+{
+    double megabytes = (double)transferred / (1024.0 * 1024.0);
+    NSLog(@"allocations for %lu requests, %.2fMB: %@", (unsigned long)requests, megabytes, counter);
+    NSLog(@"per request: %.1f objects, %.1f mallocs, %.0f bytes", (double)counter.objects / requests, (double)counter.mallocs / requests, (double)counter.bytes / requests);
+    NSLog(@"per MB: %.1f objects, %.1f mallocs, %.0f bytes", counter.objects / megabytes, counter.mallocs / megabytes, counter.bytes / megabytes);
+
+    // charge everything to the per-request budget, less whatever the size-dependent budget allows for
+    uint64_t objectAllowance = kMaxObjectsPerRequest * requests + (uint64_t)(kMaxObjectsPerMB * megabytes);
+    uint64_t mallocAllowance = kMaxMallocsPerRequest * requests + (uint64_t)(kMaxMallocsPerMB * megabytes);
+    uint64_t byteAllowance = kMaxBytesPerRequest * requests + transferred;
+
+    STAssertTrue(counter.objects <= objectAllowance, @"allocated %llu objects, budget is %llu", counter.objects, objectAllowance);
+    STAssertTrue(counter.mallocs <= mallocAllowance, @"made %llu mallocs, budget is %llu", counter.mallocs, mallocAllowance);
+    STAssertTrue(counter.bytes <= byteAllowance, @"allocated %llu bytes, budget is %llu", counter.bytes, byteAllowance);
+}
+
+#pragma mark - Tests
+
+- (void)testHTTPDownloadAllocations
+{
+    [self URLForPayloadOfLength:kPayloadLength connectionConditions:nil];
+
+    NSMutableArray* requests = [NSMutableArray array];
+    for (NSUInteger n = 0; n < kRequestCount; ++n)
+    {
+        NSURL* url = [self.standInServer URLForPath:[NSString stringWithFormat:@"/payload-%lu.bin", (unsigned long)n]];
+        [requests addObject:[NSURLRequest requestWithURL:url]];
+    }
+
+    CURLAllocationCounter* counter = [self countAllocationsForRequests:requests];
+    STAssertEquals(self.expected, kPayloadLength * kRequestCount, @"wrong amount of data");
+
+    // received data is handed to the delegate as an NSData, so the bytes transferred are allowed for
+    [self checkCounter:counter requests:kRequestCount bytesTransferred:kPayloadLength * kRequestCount];
+}
+
+- (void)testFTPUploadAllocations
+{
+    NSMutableData* payload = [NSMutableData dataWithLength:kPayloadLength];
+    memset([payload mutableBytes], 'x', kPayloadLength);
+    self.standInPayload = payload;
+
+    self.standInServer = [CURLStandInServer FTPServerWithPayload:payload];
+    [self.standInServer start];
+
+    NSMutableArray* requests = [NSMutableArray array];
+    for (NSUInteger n = 0; n < kRequestCount; ++n)
+    {
+        NSURL* url = [self.standInServer URLForPath:[NSString stringWithFormat:@"/upload-%lu.bin", (unsigned long)n]];
+        NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:url];
+        [request setHTTPBody:self.standInPayload];
+        [requests addObject:request];
+    }
+
+    CURLAllocationCounter* counter = [self countAllocationsForRequests:requests];
+    [self checkCounter:counter requests:kRequestCount bytesTransferred:kPayloadLength * kRequestCount];
+}
+
+@end
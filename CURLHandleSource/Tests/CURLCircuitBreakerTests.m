@@ -0,0 +1,153 @@
+//
+//  CURLCircuitBreakerTests.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLHandleBasedTest.h"
+#import "CURLCircuitBreaker.h"
+#import "CURLMultiHandle.h"
+
+@interface CURLCircuitBreakerTests : CURLHandleBasedTest<CURLCircuitBreakerObserver>
+
+@property (strong, nonatomic) NSMutableArray* changes;
+
+@end
+
+@implementation CURLCircuitBreakerTests
+
+- (void)dealloc
+{
+    [_changes release];
+
+    [super dealloc];
+}
+
+- (void)circuitBreaker:(CURLCircuitBreaker *)breaker circuit:(NSString *)key didChangeToState:(CURLCircuitState)state
+{
+    @synchronized(self)
+    {
+        [self.changes addObject:[NSString stringWithFormat:@"%@ %ld", key, (long)state]];
+    }
+}
+
+- (CURLCircuitBreaker*)breakerWithThreshold:(NSUInteger)threshold
+{
+    self.changes = [NSMutableArray array];
+
+    CURLCircuitBreaker* breaker = [CURLCircuitBreaker breaker];
+    breaker.failureThreshold = threshold;
+    breaker.observer = self;
+
+    return breaker;
+}
+
+#pragma mark - Tests
+
+- (void)testKeys
+{
+    STAssertEqualObjects([CURLCircuitBreaker keyForURL:[NSURL URLWithString:@"http://Example.com/path"]], @"example.com:80", @"wrong key");
+    STAssertEqualObjects([CURLCircuitBreaker keyForURL:[NSURL URLWithString:@"https://example.com:8443/"]], @"example.com:8443", @"wrong key");
+    STAssertEqualObjects([CURLCircuitBreaker keyForURL:[NSURL URLWithString:@"ftp://example.com/file"]], @"example.com:21", @"wrong key");
+    STAssertNil([CURLCircuitBreaker keyForURL:[NSURL fileURLWithPath:@"/tmp"]], @"file URLs have no circuit");
+}
+
+- (void)testOpensAfterConsecutiveFailures
+{
+    CURLCircuitBreaker* breaker = [self breakerWithThreshold:3];
+    NSURL* url = [NSURL URLWithString:@"http://example.com/"];
+    BOOL isProbe;
+
+    [breaker recordCode:CURLE_COULDNT_CONNECT connected:NO forURL:url isProbe:NO];
+    [breaker recordCode:CURLE_COULDNT_RESOLVE_HOST connected:NO forURL:url isProbe:NO];
+    [breaker recordCode:CURLE_HTTP_RETURNED_ERROR connected:YES forURL:url isProbe:NO];
+    STAssertEquals([breaker stateForURL:url], CURLCircuitStateClosed, @"a response should reset the count");
+
+    [breaker recordCode:CURLE_COULDNT_CONNECT connected:NO forURL:url isProbe:NO];
+    [breaker recordCode:CURLE_OPERATION_TIMEDOUT connected:YES forURL:url isProbe:NO];
+    STAssertEquals([breaker stateForURL:url], CURLCircuitStateClosed, @"a timeout once connected doesn't count");
+
+    [breaker recordCode:CURLE_OPERATION_TIMEDOUT connected:NO forURL:url isProbe:NO];
+    [breaker recordCode:CURLE_COULDNT_CONNECT connected:NO forURL:url isProbe:NO];
+    STAssertEquals([breaker stateForURL:url], CURLCircuitStateClosed, @"circuit shouldn't open before the threshold");
+    [breaker recordCode:CURLE_COULDNT_RESOLVE_HOST connected:NO forURL:url isProbe:NO];
+    STAssertEquals([breaker stateForURL:url], CURLCircuitStateOpen, @"circuit should have opened");
+    STAssertEqualObjects(self.changes, @[@"example.com:80 1"], @"observer should have been told");
+
+    STAssertFalse([breaker shouldAllowTransferToURL:url isProbe:&isProbe], @"open circuit should refuse transfers");
+    STAssertTrue([breaker shouldAllowTransferToURL:[NSURL URLWithString:@"http://example.com:8080/"] isProbe:&isProbe], @"other ports have their own circuit");
+    STAssertEquals(breaker.rejectedCount, (NSUInteger)1, @"wrong rejected count");
+
+    NSError* error = [breaker errorForURL:url];
+    STAssertEqualObjects([error domain], CURLCircuitBreakerErrorDomain, @"wrong domain");
+    STAssertEquals([error code], (NSInteger)CURLCircuitBreakerErrorOpen, @"wrong code");
+    STAssertNotNil([[error userInfo] objectForKey:CURLCircuitBreakerRetryDateKey], @"should say when to try again");
+}
+
+- (void)testHalfOpenProbes
+{
+    CURLCircuitBreaker* breaker = [self breakerWithThreshold:1];
+    breaker.openDuration = 0.1;
+    NSURL* url = [NSURL URLWithString:@"http://example.com/"];
+    BOOL isProbe;
+
+    [breaker recordCode:CURLE_COULDNT_CONNECT connected:NO forURL:url isProbe:NO];
+    STAssertEquals([breaker stateForURL:url], CURLCircuitStateOpen, @"circuit should have opened");
+
+    [NSThread sleepForTimeInterval:0.2];
+    STAssertEquals([breaker stateForURL:url], CURLCircuitStateHalfOpen, @"circuit should be ready to probe");
+    STAssertTrue([breaker shouldAllowTransferToURL:url isProbe:&isProbe], @"probe should be let through");
+    STAssertTrue(isProbe, @"should be a probe");
+    STAssertFalse([breaker shouldAllowTransferToURL:url isProbe:&isProbe], @"only one probe at a time");
+
+    // a failed probe opens it again
+    [breaker recordCode:CURLE_COULDNT_CONNECT connected:NO forURL:url isProbe:YES];
+    STAssertEquals([breaker stateForURL:url], CURLCircuitStateOpen, @"failed probe should reopen the circuit");
+
+    [NSThread sleepForTimeInterval:0.2];
+    STAssertTrue([breaker shouldAllowTransferToURL:url isProbe:&isProbe], @"probe should be let through");
+    [breaker abandonProbeForURL:url];
+    STAssertTrue([breaker shouldAllowTransferToURL:url isProbe:&isProbe], @"abandoned probe should free its place");
+
+    [breaker recordCode:CURLE_OK connected:YES forURL:url isProbe:YES];
+    STAssertEquals([breaker stateForURL:url], CURLCircuitStateClosed, @"successful probe should close the circuit");
+
+    NSArray* expected = @[@"example.com:80 1", @"example.com:80 2", @"example.com:80 1", @"example.com:80 2", @"example.com:80 0"];
+    STAssertEqualObjects(self.changes, expected, @"observer should have seen every change");
+    STAssertEquals(breaker.openCount, (NSUInteger)2, @"wrong open count");
+}
+
+- (void)testMultiFailsFast
+{
+    // nothing listens on the discard port, so connections are refused
+    NSURL* url = [NSURL URLWithString:@"http://127.0.0.1:9/"];
+    CURLCircuitBreaker* breaker = [self breakerWithThreshold:2];
+
+    CURLMultiHandle* multi = [[CURLMultiHandle alloc] initWithQueueNamed:@"com.karelia.curlhandle.tests.breaker"];
+    multi.circuitBreaker = breaker;
+
+    for (NSUInteger index = 0; index < 2; ++index)
+    {
+        self.error = nil;
+        CURLTransfer* transfer = [[CURLTransfer alloc] initWithRequest:[NSURLRequest requestWithURL:url] credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue] multi:multi];
+        [self runUntilPaused];
+        [transfer release];
+
+        STAssertEquals([self.error code], (NSInteger)NSURLErrorCannotConnectToHost, @"should have failed to connect, got %@", self.error);
+    }
+
+    self.error = nil;
+    CURLTransfer* transfer = [[CURLTransfer alloc] initWithRequest:[NSURLRequest requestWithURL:url] credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue] multi:multi];
+    [self runUntilPaused];
+    [transfer release];
+
+    STAssertEqualObjects([self.error domain], CURLCircuitBreakerErrorDomain, @"should have failed fast, got %@", self.error);
+    STAssertEquals(breaker.rejectedCount, (NSUInteger)1, @"wrong rejected count");
+
+    [multi shutdown];
+    [multi release];
+}
+
+@end
@@ -0,0 +1,178 @@
+//
+//  CURLConcurrencyLimiterTests.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLHandleBasedTest.h"
+#import "CURLConcurrencyLimiter.h"
+#import "CURLMultiHandle.h"
+
+@interface CURLConcurrencyLimiterTests : CURLHandleBasedTest
+
+@end
+
+@implementation CURLConcurrencyLimiterTests
+
+// fill the host's window, then finish every transfer in it the same way
+- (void)finishWindowForHost:(NSString*)host limiter:(CURLConcurrencyLimiter*)limiter code:(CURLcode)code statusCode:(NSInteger)statusCode firstByteTime:(NSTimeInterval)firstByteTime
+{
+    NSUInteger count = 0;
+    while ([limiter acquireSlotForHost:host])
+    {
+        ++count;
+    }
+
+    NSTimeInterval started = [NSDate timeIntervalSinceReferenceDate];
+    for (NSUInteger index = 0; index < count; ++index)
+    {
+        [limiter releaseSlotForHost:host code:code statusCode:statusCode firstByteTime:firstByteTime startTime:started];
+    }
+}
+
+#pragma mark - Tests
+
+- (void)testSlots
+{
+    CURLConcurrencyLimiter* limiter = [CURLConcurrencyLimiter limiter];
+    limiter.initialLimit = 2;
+
+    STAssertTrue([limiter acquireSlotForHost:@"example.com"], @"first slot should be free");
+    STAssertTrue([limiter acquireSlotForHost:@"EXAMPLE.com"], @"second slot should be free");
+    STAssertFalse([limiter acquireSlotForHost:@"example.com"], @"window should be full");
+    STAssertTrue([limiter acquireSlotForHost:@"other.com"], @"other hosts have their own window");
+    STAssertEquals([limiter activeCountForHost:@"example.com"], (NSUInteger)2, @"wrong active count");
+
+    [limiter releaseSlotForHost:@"example.com"];
+    STAssertTrue([limiter acquireSlotForHost:@"example.com"], @"released slot should be free again");
+    STAssertEquals([limiter limitForHost:@"example.com"], (NSUInteger)2, @"cancelling shouldn't change the limit");
+}
+
+- (void)testAdditiveIncrease
+{
+    CURLConcurrencyLimiter* limiter = [CURLConcurrencyLimiter limiter];
+    limiter.initialLimit = 2;
+    limiter.maximumLimit = 4;
+
+    [self finishWindowForHost:@"example.com" limiter:limiter code:CURLE_OK statusCode:200 firstByteTime:0.01];
+    STAssertEquals([limiter limitForHost:@"example.com"], (NSUInteger)3, @"a full window of successes should add one");
+
+    for (NSUInteger index = 0; index < 10; ++index)
+    {
+        [self finishWindowForHost:@"example.com" limiter:limiter code:CURLE_OK statusCode:200 firstByteTime:0.01];
+    }
+    STAssertEquals([limiter limitForHost:@"example.com"], (NSUInteger)4, @"limit should be capped");
+    STAssertEquals([[limiter.limits objectForKey:@"example.com"] unsignedIntegerValue], (NSUInteger)4, @"limits should report the same");
+
+    // successes that don't use the window say nothing about whether it could be bigger
+    CURLConcurrencyLimiter* idle = [CURLConcurrencyLimiter limiter];
+    idle.initialLimit = 2;
+    for (NSUInteger index = 0; index < 10; ++index)
+    {
+        [idle acquireSlotForHost:@"example.com"];
+        [idle releaseSlotForHost:@"example.com" code:CURLE_OK statusCode:200 firstByteTime:0.01 startTime:[NSDate timeIntervalSinceReferenceDate]];
+    }
+    STAssertEquals([idle limitForHost:@"example.com"], (NSUInteger)2, @"limit shouldn't grow without being used");
+}
+
+- (void)testMultiplicativeDecrease
+{
+    CURLConcurrencyLimiter* limiter = [CURLConcurrencyLimiter limiter];
+    limiter.initialLimit = 8;
+
+    // a whole window failing together only counts once
+    [self finishWindowForHost:@"example.com" limiter:limiter code:CURLE_COULDNT_CONNECT statusCode:0 firstByteTime:0];
+    STAssertEquals([limiter limitForHost:@"example.com"], (NSUInteger)4, @"limit should halve once");
+    STAssertEquals(limiter.decreaseCount, (NSUInteger)1, @"wrong decrease count");
+
+    [self finishWindowForHost:@"example.com" limiter:limiter code:CURLE_FTP_WEIRD_SERVER_REPLY statusCode:421 firstByteTime:0];
+    STAssertEquals([limiter limitForHost:@"example.com"], (NSUInteger)2, @"421 should cut the limit");
+
+    [self finishWindowForHost:@"example.com" limiter:limiter code:CURLE_HTTP_RETURNED_ERROR statusCode:404 firstByteTime:0.01];
+    STAssertEquals([limiter limitForHost:@"example.com"], (NSUInteger)2, @"404 says nothing about load");
+
+    for (NSUInteger index = 0; index < 5; ++index)
+    {
+        [self finishWindowForHost:@"example.com" limiter:limiter code:CURLE_HTTP_RETURNED_ERROR statusCode:503 firstByteTime:0.01];
+    }
+    STAssertEquals([limiter limitForHost:@"example.com"], (NSUInteger)1, @"limit shouldn't go below the minimum");
+}
+
+- (void)testZeroLimits
+{
+    CURLConcurrencyLimiter* limiter = [CURLConcurrencyLimiter limiter];
+    limiter.minimumLimit = 0;
+    limiter.initialLimit = 0;
+    STAssertEquals(limiter.minimumLimit, (NSUInteger)1, @"the minimum can't go below one slot");
+    STAssertEquals(limiter.initialLimit, (NSUInteger)1, @"the initial limit can't go below one slot");
+    STAssertTrue([limiter acquireSlotForHost:@"example.com"], @"there should always be a slot to start with");
+    [limiter releaseSlotForHost:@"example.com"];
+
+    // overload pushes the limit down to the minimum, but never so far that nothing could run again
+    for (NSUInteger index = 0; index < 5; ++index)
+    {
+        [self finishWindowForHost:@"example.com" limiter:limiter code:CURLE_COULDNT_CONNECT statusCode:0 firstByteTime:0];
+    }
+    STAssertEquals([limiter limitForHost:@"example.com"], (NSUInteger)1, @"limit shouldn't go below one slot");
+
+    // and a full window of successes can still grow it again
+    limiter.maximumLimit = 4;
+    [self finishWindowForHost:@"example.com" limiter:limiter code:CURLE_OK statusCode:200 firstByteTime:0.01];
+    STAssertEquals([limiter limitForHost:@"example.com"], (NSUInteger)2, @"the limit should recover");
+}
+
+- (void)testLatencySpike
+{
+    CURLConcurrencyLimiter* limiter = [CURLConcurrencyLimiter limiter];
+    limiter.initialLimit = 1;
+    limiter.maximumLimit = 1;
+
+    for (NSUInteger index = 0; index < 10; ++index)
+    {
+        [self finishWindowForHost:@"example.com" limiter:limiter code:CURLE_OK statusCode:200 firstByteTime:0.1];
+    }
+    STAssertEquals(limiter.decreaseCount, (NSUInteger)0, @"steady latency isn't a spike");
+
+    [self finishWindowForHost:@"example.com" limiter:limiter code:CURLE_OK statusCode:200 firstByteTime:1.0];
+    STAssertEquals(limiter.decreaseCount, (NSUInteger)1, @"ten times the usual latency should count as overload");
+}
+
+- (void)testMultiQueuesOverLimit
+{
+    NSURL* url = [self URLForPayloadOfLength:10000 connectionConditions:nil];
+
+    CURLConcurrencyLimiter* limiter = [CURLConcurrencyLimiter limiter];
+    limiter.initialLimit = 1;
+    limiter.maximumLimit = 1;
+
+    CURLMultiHandle* multi = [[CURLMultiHandle alloc] initWithQueueNamed:@"com.karelia.curlhandle.tests.limiter"];
+    multi.concurrencyLimiter = limiter;
+
+    NSMutableArray* transfers = [NSMutableArray array];
+    for (NSUInteger index = 0; index < 4; ++index)
+    {
+        CURLTransfer* transfer = [[CURLTransfer alloc] initWithRequest:[NSURLRequest requestWithURL:url] credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue] multi:multi];
+        [transfers addObject:transfer];
+        [transfer release];
+    }
+
+    // the last one is cancelled while it waits
+    [[transfers lastObject] cancel];
+
+    while (self.finishedCount < 3)
+    {
+        [self runUntilPaused];
+        STAssertTrue([limiter activeCountForHost:[url host]] <= 1, @"limit should be respected");
+    }
+
+    STAssertEquals(self.finishedCount, (NSUInteger)3, @"the rest should have run in turn");
+    STAssertEquals([self.error code], (NSInteger)NSURLErrorCancelled, @"the waiting transfer should have been cancelled");
+    STAssertEquals([limiter activeCountForHost:[url host]], (NSUInteger)0, @"all slots should be free");
+
+    [multi shutdown];
+    [multi release];
+}
+
+@end
@@ -0,0 +1,105 @@
+//
+//  CURLConditioningProxy.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class CURLNetworkConditions;
+
+typedef CURLNetworkConditions* (^CURLConditionsScript)(NSUInteger connectionIndex);
+
+/**
+ A loopback TCP proxy which sits in front of a MockServer or CURLStandInServer and makes
+ the connections through it behave like a slow or unreliable network.
+
+ Each accepted connection gets its own CURLNetworkConditions. By default every connection gets
+ defaultConditions, but setting a script lets a test give each connection something different
+ (for example, drop the first connection half way through the body, then let the retry through).
+
+ Everything happens on background queues, so unlike MockServer the proxy doesn't need a run loop.
+
+ Note that the proxy only sees the connection it was pointed at. For FTP that's the control
+ connection; passive mode data connections go straight to the server, so bandwidth caps and
+ disconnects won't affect the file data itself.
+ */
+
+@interface CURLConditioningProxy : NSObject
+{
+    NSString                *_host;
+    NSUInteger              _targetPort;
+    NSUInteger              _port;
+    NSUInteger              _connectionCount;
+    int                     _listener;
+    dispatch_queue_t        _queue;
+    dispatch_source_t       _acceptSource;
+    NSMutableSet            *_connections;
+    CURLNetworkConditions   *_defaultConditions;
+    CURLConditionsScript    _script;
+}
+
+/**
+ Make a proxy which forwards connections to the host and port of a URL.
+
+ @param url The URL of the real server.
+ @return A new proxy, which hasn't been started yet.
+ */
+
++ (CURLConditioningProxy*)proxyForURL:(NSURL*)url;
+
+- (id)initWithHost:(NSString*)host port:(NSUInteger)port;
+
+/**
+ Start listening on an ephemeral loopback port.
+
+ @return YES if the proxy is now listening.
+ */
+
+- (BOOL)start;
+
+/**
+ Stop listening, and drop any connections that are still open.
+ */
+
+- (void)stop;
+
+/**
+ Returns the given URL, re-pointed at the proxy.
+
+ @param url A URL on the real server.
+ @return The same URL, with the host and port replaced by the proxy's.
+ */
+
+- (NSURL*)URLByRoutingURL:(NSURL*)url;
+
+/**
+ The conditions used for a connection when there's no script, or the script returns nil.
+ */
+
+@property (copy, atomic) CURLNetworkConditions* defaultConditions;
+
+/**
+ Optional block called for each connection as it's accepted, with the zero-based index of
+ the connection, to choose its conditions.
+
+ The block is called on a private queue.
+ */
+
+@property (copy, atomic) CURLConditionsScript script;
+
+/**
+ The port the proxy is listening on, or zero if it hasn't been started.
+ */
+
+@property (readonly, nonatomic) NSUInteger port;
+
+/**
+ How many connections have been accepted so far.
+ */
+
+@property (readonly, atomic) NSUInteger connectionCount;
+
+@end
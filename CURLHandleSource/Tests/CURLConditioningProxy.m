@@ -0,0 +1,759 @@
+//
+//  CURLConditioningProxy.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLConditioningProxy.h"
+#import "CURLNetworkConditions.h"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+static const size_t kReadChunkSize = 16 * 1024;
+static const NSUInteger kMaxBufferedBytes = 256 * 1024;
+
+@class CURLConditionedConnection;
+
+#pragma mark - Pipe
+
+/**
+ Moves data in one direction between two sockets, delaying and throttling it on the way.
+
+ Chunks are read as soon as they arrive, given a delivery time, and written out in order
+ by a timer. All state is only touched on the pipe's own serial queue.
+ */
+
+@interface CURLConditionedPipe : NSObject
+{
+    CURLConditionedConnection   *_connection;
+    CURLNetworkConditions       *_conditions;
+    int                         _from;
+    int                         _to;
+    BOOL                        _downstream;
+    dispatch_queue_t            _queue;
+    dispatch_source_t           _reader;
+    dispatch_source_t           _timer;
+    NSMutableArray              *_chunks;
+    NSUInteger                  _bufferedBytes;
+    NSUInteger                  _totalBytes;
+    NSTimeInterval              _lastDue;
+    BOOL                        _readerSuspended;
+    BOOL                        _timerSuspended;
+    BOOL                        _aborted;
+}
+
+- (id)initWithConnection:(CURLConditionedConnection*)connection from:(int)from to:(int)to conditions:(CURLNetworkConditions*)conditions downstream:(BOOL)downstream;
+- (void)start;
+- (void)abort;
+- (void)detach;
+
+@end
+
+@interface CURLConditionedChunk : NSObject
+{
+@public
+    NSData          *_data;
+    NSTimeInterval  _due;
+    BOOL            _endOfStream;
+    BOOL            _disconnect;
+}
+@end
+
+@implementation CURLConditionedChunk
+
+- (void)dealloc
+{
+    [_data release];
+
+    [super dealloc];
+}
+
+@end
+
+#pragma mark - Connection
+
+@interface CURLConditionedConnection : NSObject
+{
+    CURLConditioningProxy   *_proxy;
+    int                     _client;
+    int                     _upstream;
+    CURLConditionedPipe     *_up;
+    CURLConditionedPipe     *_down;
+    NSUInteger              _finishedPipes;
+    NSUInteger              _closedReaders;
+    BOOL                    _aborted;
+}
+
+- (id)initWithProxy:(CURLConditioningProxy*)proxy client:(int)client upstream:(int)upstream conditions:(CURLNetworkConditions*)conditions;
+- (void)start;
+- (void)abort;
+- (void)pipeFinished:(CURLConditionedPipe*)pipe;
+- (void)readerClosed:(CURLConditionedPipe*)pipe;
+
+@end
+
+@interface CURLConditioningProxy()
+
+@property (readwrite, atomic) NSUInteger connectionCount;
+
+- (void)connectionClosed:(CURLConditionedConnection*)connection;
+
+@end
+
+static NSTimeInterval CURLConditioningNow()
+{
+    return [NSDate timeIntervalSinceReferenceDate];
+}
+
+static void CURLConditioningConfigureSocket(int socket)
+{
+    int on = 1;
+    setsockopt(socket, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+@implementation CURLConditionedPipe
+
+- (id)initWithConnection:(CURLConditionedConnection *)connection from:(int)from to:(int)to conditions:(CURLNetworkConditions *)conditions downstream:(BOOL)downstream
+{
+    if ((self = [super init]) != nil)
+    {
+        _connection = [connection retain]; // released by detach, which breaks the cycle
+        _conditions = [conditions copy];
+        _from = from;
+        _to = to;
+        _downstream = downstream;
+        _chunks = [[NSMutableArray alloc] init];
+        _queue = dispatch_queue_create(downstream ? "com.karelia.CURLConditioningProxy.down" : "com.karelia.CURLConditioningProxy.up", DISPATCH_QUEUE_SERIAL);
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_connection release];
+    [_conditions release];
+    [_chunks release];
+    dispatch_release(_queue);
+
+    [super dealloc];
+}
+
+- (void)start
+{
+    dispatch_source_t reader = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, _from, 0, _queue);
+    dispatch_source_set_event_handler(reader, ^{
+        [self readAvailableBytes:dispatch_source_get_data(reader)];
+    });
+
+    _reader = reader;
+    dispatch_source_set_cancel_handler(reader, ^{
+        dispatch_release(reader);
+        [_connection readerClosed:self];
+    });
+
+    _timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, _queue);
+    dispatch_source_set_event_handler(_timer, ^{
+        [self writeDueChunks];
+    });
+
+    dispatch_source_t timer = _timer;
+    dispatch_source_set_cancel_handler(timer, ^{
+        dispatch_release(timer);
+    });
+
+    // the timer stays suspended until there's something to send
+    _timerSuspended = YES;
+    dispatch_resume(_reader);
+}
+
+- (void)stopReading
+{
+    if (_reader)
+    {
+        if (_readerSuspended)
+        {
+            dispatch_resume(_reader);
+            _readerSuspended = NO;
+        }
+
+        dispatch_source_cancel(_reader); // the cancel handler will release the source
+        _reader = NULL;
+    }
+}
+
+- (void)stopWriting
+{
+    if (_timer)
+    {
+        dispatch_source_cancel(_timer);
+        if (_timerSuspended)
+        {
+            dispatch_resume(_timer); // a suspended source never runs its cancel handler
+            _timerSuspended = NO;
+        }
+        _timer = NULL;
+    }
+
+    [_chunks removeAllObjects];
+}
+
+- (void)abort
+{
+    dispatch_async(_queue, ^{
+        if (!_aborted)
+        {
+            _aborted = YES;
+            [self stopReading];
+            [self stopWriting];
+        }
+    });
+}
+
+- (void)detach
+{
+    dispatch_async(_queue, ^{
+        [self stopReading];
+        [self stopWriting];
+        [_connection release];
+        _connection = nil;
+    });
+}
+
+#pragma mark - Reading
+
+- (void)readAvailableBytes:(unsigned long)available
+{
+    size_t length = MIN(MAX(available, 1), kReadChunkSize);
+    NSMutableData* data = [NSMutableData dataWithLength:length];
+    ssize_t count = read(_from, [data mutableBytes], length);
+    if (count > 0)
+    {
+        [data setLength:count];
+        [self enqueueData:data];
+
+        if (_reader && (_bufferedBytes > kMaxBufferedBytes) && !_readerSuspended)
+        {
+            // stop reading until the writer catches up, so that a bandwidth cap pushes back on the sender
+            dispatch_suspend(_reader);
+            _readerSuspended = YES;
+        }
+    }
+    else if ((count == 0) || (errno != EAGAIN && errno != EINTR))
+    {
+        [self enqueueData:nil];
+        [self stopReading];
+    }
+}
+
+- (void)enqueueData:(NSData*)data
+{
+    CURLConditionedChunk* chunk = [[CURLConditionedChunk alloc] init];
+    NSUInteger length = [data length];
+
+    if (data && _downstream)
+    {
+        NSUInteger disconnectAfter = _conditions.disconnectAfterBytes;
+        if (disconnectAfter && (_totalBytes + length >= disconnectAfter))
+        {
+            length = disconnectAfter - _totalBytes;
+            data = [data subdataWithRange:NSMakeRange(0, length)];
+            chunk->_disconnect = YES;
+            [self stopReading];
+        }
+    }
+
+    chunk->_data = [data retain];
+    chunk->_endOfStream = (data == nil);
+
+    // each chunk goes out no earlier than the latency allows, and no earlier than the
+    // previous chunk finished going out at the capped rate
+    NSTimeInterval due = MAX(CURLConditioningNow() + _conditions.latency, _lastDue);
+    if (_conditions.bytesPerSecond)
+    {
+        due += (double)length / _conditions.bytesPerSecond;
+    }
+
+    if (_downstream)
+    {
+        NSUInteger stallAfter = _conditions.stallAfterBytes;
+        if (stallAfter && (_totalBytes < stallAfter) && (_totalBytes + length >= stallAfter))
+        {
+            due += _conditions.stallDuration;
+        }
+    }
+
+    chunk->_due = due;
+    _lastDue = due;
+    _totalBytes += length;
+    _bufferedBytes += length;
+
+    BOOL wasEmpty = ([_chunks count] == 0);
+    [_chunks addObject:chunk];
+    [chunk release];
+
+    if (wasEmpty && _timer)
+    {
+        [self scheduleTimer];
+        dispatch_resume(_timer);
+        _timerSuspended = NO;
+    }
+}
+
+#pragma mark - Writing
+
+- (void)scheduleTimer
+{
+    CURLConditionedChunk* next = [_chunks objectAtIndex:0];
+    NSTimeInterval delay = MAX(next->_due - CURLConditioningNow(), 0);
+    dispatch_source_set_timer(_timer, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), DISPATCH_TIME_FOREVER, NSEC_PER_MSEC);
+}
+
+- (BOOL)writeData:(NSData*)data
+{
+    const uint8_t* bytes = [data bytes];
+    NSUInteger remaining = [data length];
+    while (remaining)
+    {
+        ssize_t written = write(_to, bytes, remaining);
+        if (written < 0)
+        {
+            if (errno == EINTR) continue;
+            return NO;
+        }
+
+        bytes += written;
+        remaining -= written;
+    }
+
+    return YES;
+}
+
+- (void)writeDueChunks
+{
+    NSTimeInterval now = CURLConditioningNow();
+    while (_timer && [_chunks count])
+    {
+        CURLConditionedChunk* chunk = [_chunks objectAtIndex:0];
+        if (chunk->_due > now)
+        {
+            [self scheduleTimer];
+            return;
+        }
+
+        [[chunk retain] autorelease];
+        [_chunks removeObjectAtIndex:0];
+        _bufferedBytes -= [chunk->_data length];
+
+        if (chunk->_data && ![self writeData:chunk->_data])
+        {
+            [_connection abort];
+            return;
+        }
+
+        if (chunk->_disconnect)
+        {
+            [_connection abort];
+            return;
+        }
+
+        if (chunk->_endOfStream)
+        {
+            shutdown(_to, SHUT_WR);
+            [self stopWriting];
+            [_connection pipeFinished:self];
+            return;
+        }
+    }
+
+    if (_timer)
+    {
+        dispatch_suspend(_timer);
+        _timerSuspended = YES;
+    }
+
+    if (_readerSuspended && (_bufferedBytes < kMaxBufferedBytes / 2))
+    {
+        _readerSuspended = NO;
+        dispatch_resume(_reader);
+    }
+}
+
+@end
+
+@implementation CURLConditionedConnection
+
+- (id)initWithProxy:(CURLConditioningProxy *)proxy client:(int)client upstream:(int)upstream conditions:(CURLNetworkConditions *)conditions
+{
+    if ((self = [super init]) != nil)
+    {
+        _proxy = [proxy retain]; // released once the connection closes
+        _client = client;
+        _upstream = upstream;
+        _up = [[CURLConditionedPipe alloc] initWithConnection:self from:client to:upstream conditions:conditions downstream:NO];
+        _down = [[CURLConditionedPipe alloc] initWithConnection:self from:upstream to:client conditions:conditions downstream:YES];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_proxy release];
+    [_up release];
+    [_down release];
+
+    [super dealloc];
+}
+
+- (void)start
+{
+    [_up start];
+    [_down start];
+}
+
+- (void)abort
+{
+    @synchronized(self)
+    {
+        if (_aborted) return;
+        _aborted = YES;
+
+        // shutting down rather than closing wakes up any blocked writes, without
+        // pulling the sockets out from under the dispatch sources
+        shutdown(_client, SHUT_RDWR);
+        shutdown(_upstream, SHUT_RDWR);
+    }
+
+    [_up abort];
+    [_down abort];
+}
+
+- (void)pipeFinished:(CURLConditionedPipe *)pipe
+{
+    @synchronized(self)
+    {
+        ++_finishedPipes;
+    }
+
+    [self closeIfDone];
+}
+
+- (void)readerClosed:(CURLConditionedPipe *)pipe
+{
+    @synchronized(self)
+    {
+        ++_closedReaders;
+    }
+
+    [self closeIfDone];
+}
+
+- (void)closeIfDone
+{
+    BOOL done;
+    @synchronized(self)
+    {
+        done = (_closedReaders == 2) && (_aborted || _finishedPipes == 2);
+        if (done)
+        {
+            // make sure we only close once
+            _closedReaders = 0;
+        }
+    }
+
+    if (done)
+    {
+        close(_client);
+        close(_upstream);
+        [_proxy connectionClosed:self];
+
+        // the pipes hold on to us until they've processed anything already queued
+        [_up detach];
+        [_down detach];
+    }
+}
+
+@end
+
+#pragma mark - Proxy
+
+@implementation CURLConditioningProxy
+
+@synthesize defaultConditions = _defaultConditions;
+@synthesize script = _script;
+@synthesize port = _port;
+@synthesize connectionCount = _connectionCount;
+
+#pragma mark - Object Lifecycle
+
++ (CURLConditioningProxy*)proxyForURL:(NSURL *)url
+{
+    NSNumber* port = [url port];
+    if (!port)
+    {
+        port = [[url scheme] isEqualToString:@"ftp"] ? @21 : @80;
+    }
+
+    return [[[self alloc] initWithHost:[url host] port:[port unsignedIntegerValue]] autorelease];
+}
+
+- (id)initWithHost:(NSString *)host port:(NSUInteger)port
+{
+    if ((self = [super init]) != nil)
+    {
+        _host = [host copy];
+        _targetPort = port;
+        _listener = -1;
+        _connections = [[NSMutableSet alloc] init];
+        _defaultConditions = [[CURLNetworkConditions conditions] retain];
+        _queue = dispatch_queue_create("com.karelia.CURLConditioningProxy", DISPATCH_QUEUE_SERIAL);
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [self stop];
+
+    [_host release];
+    [_connections release];
+    [_defaultConditions release];
+    [_script release];
+    dispatch_release(_queue);
+
+    [super dealloc];
+}
+
+#pragma mark - Control
+
+- (BOOL)start
+{
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0)
+    {
+        return NO;
+    }
+
+    int on = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_len = sizeof(address);
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+
+    socklen_t length = sizeof(address);
+    if ((bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0) || (listen(listener, 128) != 0) || (getsockname(listener, (struct sockaddr*)&address, &length) != 0))
+    {
+        close(listener);
+        return NO;
+    }
+
+    _listener = listener;
+    _port = ntohs(address.sin_port);
+
+    _acceptSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, listener, 0, _queue);
+    dispatch_source_set_event_handler(_acceptSource, ^{
+        [self acceptConnection];
+    });
+
+    dispatch_source_t source = _acceptSource;
+    dispatch_source_set_cancel_handler(source, ^{
+        close(listener);
+        dispatch_release(source);
+    });
+
+    dispatch_resume(_acceptSource);
+    return YES;
+}
+
+- (void)stop
+{
+    dispatch_sync(_queue, ^{
+        if (_acceptSource)
+        {
+            dispatch_source_cancel(_acceptSource); // the cancel handler will close the socket and release the source
+            _acceptSource = NULL;
+            _listener = -1;
+        }
+    });
+
+    NSArray* connections;
+    @synchronized(_connections)
+    {
+        connections = [_connections allObjects];
+    }
+
+    for (CURLConditionedConnection* connection in connections)
+    {
+        [connection abort];
+    }
+}
+
+#pragma mark - Connections
+
+- (CURLNetworkConditions*)conditionsForConnection:(NSUInteger)index
+{
+    CURLNetworkConditions* result = nil;
+    CURLConditionsScript script = self.script;
+    if (script)
+    {
+        result = script(index);
+    }
+
+    return result ? result : self.defaultConditions;
+}
+
+- (void)acceptConnection
+{
+    NSUInteger index = self.connectionCount;
+    CURLNetworkConditions* conditions = [self conditionsForConnection:index];
+
+    if (conditions.acceptDelay > 0)
+    {
+        // leave the connection sitting in the backlog for a while
+        dispatch_suspend(_acceptSource);
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(conditions.acceptDelay * NSEC_PER_SEC)), _queue, ^{
+            [self acceptConnectionWithConditions:conditions];
+            if (_acceptSource)
+            {
+                dispatch_resume(_acceptSource);
+            }
+        });
+    }
+    else
+    {
+        [self acceptConnectionWithConditions:conditions];
+    }
+}
+
+- (void)acceptConnectionWithConditions:(CURLNetworkConditions*)conditions
+{
+    if (_listener < 0)
+    {
+        return;
+    }
+
+    int client = accept(_listener, NULL, NULL);
+    if (client < 0)
+    {
+        return;
+    }
+
+    self.connectionCount = self.connectionCount + 1;
+
+    int upstream = [self connectUpstream];
+    if (upstream < 0)
+    {
+        NSLog(@"proxy: couldn't connect to %@:%lu", _host, (unsigned long)_targetPort);
+        close(client);
+        return;
+    }
+
+    CURLConditioningConfigureSocket(client);
+    CURLConditioningConfigureSocket(upstream);
+
+    CURLConditionedConnection* connection = [[CURLConditionedConnection alloc] initWithProxy:self client:client upstream:upstream conditions:conditions];
+    @synchronized(_connections)
+    {
+        [_connections addObject:connection];
+    }
+
+    [connection start];
+    [connection release];
+}
+
+- (int)connectUpstream
+{
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo* addresses = NULL;
+    NSString* port = [NSString stringWithFormat:@"%lu", (unsigned long)_targetPort];
+    if (getaddrinfo([_host UTF8String], [port UTF8String], &hints, &addresses) != 0)
+    {
+        return -1;
+    }
+
+    int result = -1;
+    for (struct addrinfo* address = addresses; address && (result < 0); address = address->ai_next)
+    {
+        result = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if ((result >= 0) && (connect(result, address->ai_addr, address->ai_addrlen) != 0))
+        {
+            close(result);
+            result = -1;
+        }
+    }
+
+    freeaddrinfo(addresses);
+    return result;
+}
+
+- (void)connectionClosed:(CURLConditionedConnection *)connection
+{
+    @synchronized(_connections)
+    {
+        [_connections removeObject:connection];
+    }
+}
+
+#pragma mark - URLs
+
+- (NSURL*)URLByRoutingURL:(NSURL *)url
+{
+    NSMutableString* string = [NSMutableString stringWithFormat:@"%@://", [url scheme]];
+    NSString* user = [url user];
+    if (user)
+    {
+        NSString* password = [url password];
+        [string appendString:user];
+        if (password)
+        {
+            [string appendFormat:@":%@", password];
+        }
+        [string appendString:@"@"];
+    }
+
+    [string appendFormat:@"127.0.0.1:%lu", (unsigned long)self.port];
+
+    NSString* path = [url path];
+    if ([path length])
+    {
+        path = (NSString*)CFURLCopyPath((CFURLRef)url);
+        [string appendString:path];
+        [path release];
+    }
+    else
+    {
+        [string appendString:@"/"];
+    }
+
+    NSString* query = [url query];
+    if (query)
+    {
+        [string appendFormat:@"?%@", query];
+    }
+
+    return [NSURL URLWithString:string];
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"<PROXY %p port %lu -> %@:%lu, %@>", self, (unsigned long)self.port, _host, (unsigned long)_targetPort, self.defaultConditions];
+}
+
+@end
@@ -0,0 +1,188 @@
+//
+//  CURLContentDecodingTests.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLHandleBasedTest.h"
+#import "CURLContentDecoder.h"
+#import "CURLDigest.h"
+#import "CURLRequest.h"
+#import "CURLStandInServer.h"
+
+@interface CURLContentDecodingTests : CURLHandleBasedTest
+
+@end
+
+@implementation CURLContentDecodingTests
+
+- (NSData*)payload
+{
+    // compressible, but not so much that the body comes in one piece
+    NSMutableData* payload = [NSMutableData dataWithLength:500000];
+    uint8_t* bytes = [payload mutableBytes];
+    uint32_t seed = 1;
+    for (NSUInteger index = 0; index < [payload length]; ++index)
+    {
+        seed = seed * 1103515245 + 12345;
+        bytes[index] = (uint8_t)('a' + (seed >> 16) % 16);
+    }
+
+    return payload;
+}
+
+- (CURLTransfer*)downloadPayload:(NSData*)payload contentEncoding:(NSString*)encoding inBackground:(BOOL)background
+{
+    self.standInServer = [CURLStandInServer HTTPServerWithPayload:payload contentEncoding:encoding];
+    [self.standInServer start];
+
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[self.standInServer URLForPath:@"/payload.txt"]];
+    [request setValue:@"" forHTTPHeaderField:@"Accept-Encoding"];
+    [request curl_setDecodesContentInBackground:background];
+    [request curl_setDigestAlgorithm:CURLDigestAlgorithmCRC32C];
+
+    self.buffer = nil;
+    self.error = nil;
+
+    CURLTransfer* transfer = [[CURLTransfer alloc] initWithRequest:request credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue]];
+    [self runUntilPaused];
+    return [transfer autorelease];
+}
+
+// Feeds the data to a decoder in pieces, and waits for the result
+- (NSData*)decodeData:(NSData*)data contentEncoding:(NSString*)encoding pieceSize:(NSUInteger)size failureReason:(NSString**)reason
+{
+    NSMutableData* output = [NSMutableData data];
+    CURLContentDecoder* decoder = [[CURLContentDecoder alloc] initWithContentEncoding:encoding outputHandler:^(NSData *decoded) {
+        [output appendData:decoded];
+    }];
+
+    for (NSUInteger offset = 0; offset < [data length]; offset += size)
+    {
+        [decoder decodeData:[data subdataWithRange:NSMakeRange(offset, MIN(size, [data length] - offset))]];
+    }
+
+    dispatch_semaphore_t finished = dispatch_semaphore_create(0);
+    __block NSString* failure = nil;
+    [decoder finishWithCompletionHandler:^(NSString *failureReason) {
+        failure = [failureReason copy];
+        dispatch_semaphore_signal(finished);
+    }];
+    dispatch_semaphore_wait(finished, DISPATCH_TIME_FOREVER);
+    dispatch_release(finished);
+    [decoder release];
+
+    if (reason) *reason = [failure autorelease];
+    return output;
+}
+
+#pragma mark - Tests
+
+- (void)testOption
+{
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:@"http://example.com/"]];
+    STAssertFalse([request curl_decodesContentInBackground], @"decoding should be left to libcurl by default");
+
+    [request curl_setDecodesContentInBackground:YES];
+    STAssertTrue([request curl_decodesContentInBackground], @"decoding should be in the background");
+}
+
+- (void)testEncodings
+{
+    STAssertTrue([CURLContentDecoder canDecodeContentEncoding:@"gzip"], @"gzip should be supported");
+    STAssertTrue([CURLContentDecoder canDecodeContentEncoding:@" Deflate "], @"deflate should be supported");
+    STAssertFalse([CURLContentDecoder canDecodeContentEncoding:@"br"], @"brotli isn't supported");
+    STAssertFalse([CURLContentDecoder canDecodeContentEncoding:@"gzip, br"], @"only single encodings are supported");
+}
+
+- (void)testGzipInBackground
+{
+    NSData* payload = [self payload];
+    CURLTransfer* transfer = [self downloadPayload:payload contentEncoding:@"gzip" inBackground:YES];
+
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEqualObjects(self.buffer, payload, @"the body should have been decoded, in order");
+    STAssertEqualObjects([(NSHTTPURLResponse*)self.response allHeaderFields][@"Content-Encoding"], @"gzip", @"the response should say how it was sent");
+    STAssertEqualObjects(transfer.downloadDigest, [CURLDigest digestOfData:payload algorithm:CURLDigestAlgorithmCRC32C], @"the digest should be of the decoded body");
+}
+
+- (void)testDeflateInBackground
+{
+    NSData* payload = [self payload];
+    [self downloadPayload:payload contentEncoding:@"deflate" inBackground:YES];
+
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEqualObjects(self.buffer, payload, @"the body should have been decoded, in order");
+}
+
+- (void)testSameAsInline
+{
+    NSData* payload = [self payload];
+    [self downloadPayload:payload contentEncoding:@"gzip" inBackground:NO];
+    NSData* inlineBody = [[self.buffer copy] autorelease];
+    [self.standInServer stop];
+
+    [self downloadPayload:payload contentEncoding:@"gzip" inBackground:YES];
+
+    STAssertEqualObjects(self.buffer, inlineBody, @"decoding in the background shouldn't change the body");
+}
+
+- (void)testUncompressedIsUntouched
+{
+    NSData* payload = [self payload];
+    [self downloadPayload:payload contentEncoding:nil inBackground:YES];
+
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEqualObjects(self.buffer, payload, @"the body should be passed on as it is");
+}
+
+- (void)testSmallPieces
+{
+    NSData* payload = [self payload];
+    NSData* encoded = [CURLStandInServer data:payload encodedWithContentEncoding:@"gzip"];
+
+    NSString* reason = nil;
+    NSData* decoded = [self decodeData:encoded contentEncoding:@"gzip" pieceSize:7 failureReason:&reason];
+
+    STAssertNil(reason, @"decoding failed: %@", reason);
+    STAssertEqualObjects(decoded, payload, @"the pieces should come out in order");
+}
+
+- (void)testRawDeflate
+{
+    // zlib's header is two bytes, and the checksum four, either side of the raw stream
+    NSData* payload = [self payload];
+    NSData* encoded = [CURLStandInServer data:payload encodedWithContentEncoding:@"deflate"];
+    NSData* raw = [encoded subdataWithRange:NSMakeRange(2, [encoded length] - 6)];
+
+    NSString* reason = nil;
+    NSData* decoded = [self decodeData:raw contentEncoding:@"deflate" pieceSize:4096 failureReason:&reason];
+
+    STAssertNil(reason, @"decoding failed: %@", reason);
+    STAssertEqualObjects(decoded, payload, @"deflate without its zlib wrapper should still be decoded");
+}
+
+- (void)testTruncatedBodyFails
+{
+    NSData* encoded = [CURLStandInServer data:[self payload] encodedWithContentEncoding:@"gzip"];
+
+    NSString* reason = nil;
+    [self decodeData:[encoded subdataWithRange:NSMakeRange(0, [encoded length] / 2)] contentEncoding:@"gzip" pieceSize:4096 failureReason:&reason];
+
+    STAssertNotNil(reason, @"half a body should fail");
+}
+
+- (void)testCorruptBodyFails
+{
+    NSMutableData* encoded = [[[CURLStandInServer data:[self payload] encodedWithContentEncoding:@"gzip"] mutableCopy] autorelease];
+    memset((uint8_t*)[encoded mutableBytes] + 100, 0xff, 200);
+
+    NSString* reason = nil;
+    [self decodeData:encoded contentEncoding:@"gzip" pieceSize:4096 failureReason:&reason];
+
+    STAssertNotNil(reason, @"a corrupt body should fail");
+}
+
+@end
@@ -0,0 +1,149 @@
+//
+//  CURLDigestTests.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLHandleBasedTest.h"
+#import "CURLDigest.h"
+#import "CURLRequest.h"
+#import "CURLStandInServer.h"
+
+@interface CURLDigestTests : CURLHandleBasedTest
+
+@end
+
+@implementation CURLDigestTests
+
+- (NSData*)dataFromHex:(NSString*)hex
+{
+    NSMutableData* result = [NSMutableData data];
+    for (NSUInteger index = 0; index + 1 < [hex length]; index += 2)
+    {
+        uint8_t byte = (uint8_t)strtoul([[hex substringWithRange:NSMakeRange(index, 2)] UTF8String], NULL, 16);
+        [result appendBytes:&byte length:1];
+    }
+
+    return result;
+}
+
+- (NSURL*)payloadURL
+{
+    NSMutableData* payload = [NSMutableData dataWithLength:100000];
+    uint8_t* bytes = [payload mutableBytes];
+    for (NSUInteger index = 0; index < [payload length]; ++index)
+    {
+        bytes[index] = (uint8_t)(index * 7);
+    }
+    self.standInPayload = payload;
+
+    self.standInServer = [CURLStandInServer HTTPServerWithPayload:payload];
+    [self.standInServer start];
+
+    return [self.standInServer URLForPath:@"/payload.bin"];
+}
+
+- (CURLTransfer*)downloadRequest:(NSURLRequest*)request
+{
+    self.buffer = nil;
+    self.error = nil;
+
+    CURLTransfer* transfer = [[CURLTransfer alloc] initWithRequest:request credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue]];
+    [self runUntilPaused];
+    return [transfer autorelease];
+}
+
+#pragma mark - Tests
+
+- (void)testKnownDigests
+{
+    NSData* data = [@"123456789" dataUsingEncoding:NSUTF8StringEncoding];
+    STAssertEqualObjects([CURLDigest digestOfData:data algorithm:CURLDigestAlgorithmCRC32C], [self dataFromHex:@"e3069283"], @"wrong CRC32C");
+
+    data = [@"abc" dataUsingEncoding:NSUTF8StringEncoding];
+    STAssertEqualObjects([CURLDigest digestOfData:data algorithm:CURLDigestAlgorithmSHA256],
+                         [self dataFromHex:@"ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"], @"wrong SHA-256");
+
+    STAssertNil([CURLDigest digestOfData:data algorithm:CURLDigestAlgorithmNone], @"no algorithm, no digest");
+}
+
+- (void)testPiecesMatchTheWhole
+{
+    NSMutableData* data = [NSMutableData dataWithLength:10007];
+    uint8_t* bytes = [data mutableBytes];
+    for (NSUInteger index = 0; index < [data length]; ++index)
+    {
+        bytes[index] = (uint8_t)(index * 7 + 3);
+    }
+
+    for (CURLDigestAlgorithm algorithm = CURLDigestAlgorithmSHA256; algorithm <= CURLDigestAlgorithmCRC32C; ++algorithm)
+    {
+        // odd sizes and offsets, so that the unaligned ends get used
+        CURLDigest* digest = [[CURLDigest alloc] initWithAlgorithm:algorithm];
+        NSUInteger offset = 0;
+        NSUInteger size = 1;
+        while (offset < [data length])
+        {
+            NSUInteger length = MIN(size, [data length] - offset);
+            [digest updateWithBytes:bytes + offset length:length];
+            offset += length;
+            size = size * 3 + 1;
+        }
+
+        STAssertEquals(digest.length, (unsigned long long)[data length], @"wrong length");
+        STAssertEqualObjects([digest digest], [CURLDigest digestOfData:data algorithm:algorithm], @"pieces should give the same digest as the whole");
+
+        [digest reset];
+        STAssertEqualObjects([digest digest], [CURLDigest digestOfData:[NSData data] algorithm:algorithm], @"reset should start again");
+        [digest release];
+    }
+}
+
+- (void)testDownloadDigest
+{
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[self payloadURL]];
+    [request curl_setDigestAlgorithm:CURLDigestAlgorithmSHA256];
+    [request curl_setExpectedDownloadDigest:[CURLDigest digestOfData:self.standInPayload algorithm:CURLDigestAlgorithmSHA256]];
+
+    CURLTransfer* transfer = [self downloadRequest:request];
+
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEqualObjects(self.buffer, self.standInPayload, @"wrong body");
+    STAssertEqualObjects(transfer.downloadDigest, [CURLDigest digestOfData:self.standInPayload algorithm:CURLDigestAlgorithmSHA256], @"wrong digest");
+    STAssertNil(transfer.uploadDigest, @"nothing was sent");
+}
+
+- (void)testMismatchFailsBeforeTheEnd
+{
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[self payloadURL]];
+    [request curl_setDigestAlgorithm:CURLDigestAlgorithmCRC32C];
+    [request curl_setExpectedDownloadDigest:[self dataFromHex:@"00000000"]];
+
+    CURLTransfer* transfer = [self downloadRequest:request];
+
+    STAssertEqualObjects([self.error domain], CURLDigestErrorDomain, @"wrong error %@", self.error);
+    STAssertEquals([self.error code], (NSInteger)CURLDigestErrorMismatch, @"wrong error %@", self.error);
+    STAssertEqualObjects([[self.error userInfo] objectForKey:CURLDigestActualDigestKey], [CURLDigest digestOfData:self.standInPayload algorithm:CURLDigestAlgorithmCRC32C], @"the actual digest should be given");
+    STAssertTrue([self.buffer length] < [self.standInPayload length], @"the last piece shouldn't have been passed on");
+    STAssertEqualObjects(transfer.downloadDigest, [CURLDigest digestOfData:self.standInPayload algorithm:CURLDigestAlgorithmCRC32C], @"the digest should still be available");
+}
+
+- (void)testUploadDigest
+{
+    NSData* body = [@"an upload worth checking" dataUsingEncoding:NSUTF8StringEncoding];
+    self.standInServer = [CURLStandInServer FTPServerWithPayload:body];
+    [self.standInServer start];
+
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[self.standInServer URLForPath:@"/upload.txt"]];
+    [request setHTTPBody:body];
+    [request curl_setDigestAlgorithm:CURLDigestAlgorithmCRC32C];
+
+    CURLTransfer* transfer = [self downloadRequest:request];
+
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEqualObjects(transfer.uploadDigest, [CURLDigest digestOfData:body algorithm:CURLDigestAlgorithmCRC32C], @"wrong digest");
+}
+
+@end
@@ -0,0 +1,244 @@
+//
+//  CURLEventBackendTests.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLHandleBasedTest.h"
+#import "CURLDispatchEventBackend.h"
+#import "CURLMultiHandle.h"
+#import "CURLPollEventBackend.h"
+#import "CURLTransfer+TestingSupport.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+
+// A listener for a multi on an external event loop, which just remembers what it was told
+@interface CURLEventBackendTestListener : NSObject <CURLEventBackend>
+
+@property (assign, nonatomic) BOOL started;
+@property (assign, nonatomic) BOOL startedWithQueue;
+@property (assign, nonatomic) NSUInteger timeoutChanges;
+
+@end
+
+@implementation CURLEventBackendTestListener
+
+- (BOOL)startWithQueue:(dispatch_queue_t)queue handler:(CURLEventHandler)handler
+{
+    self.started = YES;
+    self.startedWithQueue = (queue != NULL);
+    return YES;
+}
+
+- (void)watchSocket:(curl_socket_t)socket reading:(BOOL)reading writing:(BOOL)writing
+{
+}
+
+- (void)setTimeout:(long)timeout_ms
+{
+    self.timeoutChanges += 1;
+}
+
+- (void)stop
+{
+}
+
+@end
+
+@interface CURLEventBackendTests : CURLHandleBasedTest
+
+@end
+
+@implementation CURLEventBackendTests
+
+#pragma mark - Helpers
+
+- (NSArray*)backends
+{
+    return @[[[[CURLDispatchEventBackend alloc] init] autorelease], [[[CURLPollEventBackend alloc] init] autorelease]];
+}
+
+- (void)checkEventsFromBackend:(id<CURLEventBackend>)backend
+{
+    int pair[2];
+    STAssertEquals(socketpair(AF_UNIX, SOCK_STREAM, 0, pair), 0, @"couldn't make sockets");
+
+    dispatch_queue_t queue = dispatch_queue_create("com.karelia.CURLEventBackendTests", NULL);
+    dispatch_semaphore_t fired = dispatch_semaphore_create(0);
+    NSMutableArray* events = [NSMutableArray array];
+
+    BOOL started = [backend startWithQueue:queue handler:^(curl_socket_t socket, int action) {
+        char buffer[16];
+        read(socket, buffer, sizeof(buffer));
+        [events addObject:@[@(socket), @(action)]];
+        dispatch_semaphore_signal(fired);
+    }];
+    STAssertTrue(started, @"%@ didn't start", backend);
+
+    // readable
+    dispatch_sync(queue, ^{ [backend watchSocket:pair[0] reading:YES writing:NO]; });
+    write(pair[1], "x", 1);
+    STAssertEquals(dispatch_semaphore_wait(fired, dispatch_time(DISPATCH_TIME_NOW, NSEC_PER_SEC)), 0L, @"%@ didn't report a readable socket", backend);
+    dispatch_sync(queue, ^{
+        STAssertEqualObjects([events lastObject], (@[@(pair[0]), @(CURL_CSELECT_IN)]), @"%@ reported the wrong event", backend);
+    });
+
+    // no longer watched
+    dispatch_sync(queue, ^{ [backend watchSocket:pair[0] reading:NO writing:NO]; });
+    write(pair[1], "x", 1);
+    STAssertTrue(dispatch_semaphore_wait(fired, dispatch_time(DISPATCH_TIME_NOW, NSEC_PER_SEC / 10)) != 0, @"%@ reported a socket that isn't watched", backend);
+
+    // writable
+    dispatch_sync(queue, ^{ [backend watchSocket:pair[1] reading:NO writing:YES]; });
+    STAssertEquals(dispatch_semaphore_wait(fired, dispatch_time(DISPATCH_TIME_NOW, NSEC_PER_SEC)), 0L, @"%@ didn't report a writable socket", backend);
+    dispatch_sync(queue, ^{
+        [backend watchSocket:pair[1] reading:NO writing:NO];
+        STAssertEqualObjects([events lastObject], (@[@(pair[1]), @(CURL_CSELECT_OUT)]), @"%@ reported the wrong event", backend);
+    });
+
+    // drain anything that was queued up before we stopped watching
+    while (dispatch_semaphore_wait(fired, dispatch_time(DISPATCH_TIME_NOW, NSEC_PER_SEC / 10)) == 0)
+    {
+    }
+
+    // the timer is one-shot, and can be cancelled
+    dispatch_sync(queue, ^{ [backend setTimeout:10]; });
+    STAssertEquals(dispatch_semaphore_wait(fired, dispatch_time(DISPATCH_TIME_NOW, NSEC_PER_SEC)), 0L, @"%@ timer didn't fire", backend);
+    dispatch_sync(queue, ^{
+        STAssertEqualObjects([events lastObject], (@[@(CURL_SOCKET_TIMEOUT), @0]), @"%@ reported the wrong event", backend);
+    });
+    STAssertTrue(dispatch_semaphore_wait(fired, dispatch_time(DISPATCH_TIME_NOW, NSEC_PER_SEC / 10)) != 0, @"%@ timer fired twice", backend);
+
+    dispatch_sync(queue, ^{
+        [backend setTimeout:50];
+        [backend setTimeout:-1];
+    });
+    STAssertTrue(dispatch_semaphore_wait(fired, dispatch_time(DISPATCH_TIME_NOW, NSEC_PER_SEC / 5)) != 0, @"%@ cancelled timer fired", backend);
+
+    dispatch_sync(queue, ^{ [backend stop]; });
+
+    close(pair[0]);
+    close(pair[1]);
+    dispatch_release(fired);
+    dispatch_release(queue);
+}
+
+#pragma mark - Tests
+
+- (void)testBackendEvents
+{
+    for (id<CURLEventBackend> backend in [self backends])
+    {
+        [self checkEventsFromBackend:backend];
+    }
+}
+
+- (void)testDownloadWithEachBackend
+{
+    NSURL* url = [self URLForPayloadOfLength:256 * 1024 connectionConditions:nil];
+
+    for (id<CURLEventBackend> backend in [self backends])
+    {
+        CURLMultiHandle* multi = [[CURLMultiHandle alloc] initWithEventBackend:backend];
+        STAssertEquals(multi.eventBackend, backend, @"multi should be using the backend it was given");
+
+        self.buffer = nil;
+        self.error = nil;
+
+        NSURLRequest* request = [NSURLRequest requestWithURL:url];
+        CURLTransfer* transfer = [[CURLTransfer alloc] initWithRequest:request credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue] multi:multi];
+        [self runUntilPaused];
+
+        STAssertNil(self.error, @"got error %@ using %@", self.error, backend);
+        STAssertEqualObjects(self.buffer, self.standInPayload, @"wrong data using %@", backend);
+
+        [transfer release];
+        [multi shutdown];
+        STAssertNil(multi.eventBackend, @"backend should be released by shutdown");
+        [multi release];
+    }
+}
+
+- (void)testExternalEventLoop
+{
+    NSURL* url = [self URLForPayloadOfLength:256 * 1024 connectionConditions:nil];
+
+    CURLMultiHandle* multi = [[CURLMultiHandle alloc] initForExternalEventLoop:nil];
+    STAssertTrue(multi.usesExternalEventLoop, @"multi should be driven externally");
+    STAssertTrue(multi.queue == NULL, @"multi shouldn't have a queue");
+
+    // with no delegate queue, the delegate is called right here
+    NSURLRequest* request = [NSURLRequest requestWithURL:url];
+    CURLTransfer* transfer = [[CURLTransfer alloc] initWithRequest:request credential:nil delegate:self delegateQueue:nil multi:multi];
+
+    self.exitRunLoop = NO;
+    NSDate* giveUp = [NSDate dateWithTimeIntervalSinceNow:10.0];
+    while (!self.exitRunLoop && [giveUp timeIntervalSinceNow] > 0)
+    {
+        curl_socket_t sockets[16];
+        int events[16];
+        NSUInteger count = MIN([multi getWatchedSockets:sockets events:events count:16], (NSUInteger)16);
+
+        struct pollfd fds[16];
+        for (NSUInteger index = 0; index < count; ++index)
+        {
+            fds[index].fd = sockets[index];
+            fds[index].events = ((events[index] & CURL_POLL_IN) ? POLLIN : 0) | ((events[index] & CURL_POLL_OUT) ? POLLOUT : 0);
+            fds[index].revents = 0;
+        }
+
+        long timeout = [multi timeout];
+        int ready = poll(fds, (nfds_t)count, (timeout < 0 || timeout > 100) ? 100 : (int)timeout);
+        STAssertTrue(ready >= 0, @"poll failed");
+
+        for (NSUInteger index = 0; ready > 0 && index < count; ++index)
+        {
+            int what = ((fds[index].revents & POLLIN) ? CURL_CSELECT_IN : 0) | ((fds[index].revents & POLLOUT) ? CURL_CSELECT_OUT : 0) | ((fds[index].revents & (POLLERR | POLLHUP)) ? CURL_CSELECT_ERR : 0);
+            if (what) [multi processSocket:fds[index].fd events:what];
+        }
+
+        if ([multi timeout] == 0)
+        {
+            [multi processTimeout];
+        }
+    }
+
+    STAssertTrue(self.exitRunLoop, @"transfer didn't finish");
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEqualObjects(self.buffer, self.standInPayload, @"wrong data");
+
+    [transfer release];
+    [multi shutdown];
+    [multi release];
+}
+
+- (void)testListenerForExternalEventLoop
+{
+    // the built-in backends can only deliver through a queue, so they refuse to listen rather than crash
+    for (id<CURLEventBackend> backend in [self backends])
+    {
+        CURLMultiHandle* multi = [[CURLMultiHandle alloc] initForExternalEventLoop:backend];
+        STAssertNil(multi, @"%@ shouldn't have started without a queue", backend);
+        [multi release];
+    }
+
+    CURLEventBackendTestListener* listener = [[[CURLEventBackendTestListener alloc] init] autorelease];
+    CURLMultiHandle* multi = [[CURLMultiHandle alloc] initForExternalEventLoop:listener];
+    STAssertNotNil(multi, @"the multi should have been made");
+    STAssertTrue(listener.started, @"the listener should have been started");
+    STAssertFalse(listener.startedWithQueue, @"the listener shouldn't have been given a queue");
+
+    NSURL* url = [self URLForPayloadOfLength:1024 connectionConditions:nil];
+    CURLTransfer* transfer = [[CURLTransfer alloc] initWithRequest:[NSURLRequest requestWithURL:url] credential:nil delegate:self delegateQueue:nil multi:multi];
+    STAssertTrue(listener.timeoutChanges > 0, @"the listener should have been told about libcurl's timer");
+
+    [transfer cancel];
+    [transfer release];
+    [multi shutdown];
+    [multi release];
+}
+
+@end
@@ -0,0 +1,95 @@
+//
+//  CURLFormEncodingTests.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLHandleBasedTest.h"
+#import "NSDictionary+CURLHandle.h"
+
+@interface CURLFormEncodingTests : CURLHandleBasedTest
+
+@end
+
+@implementation CURLFormEncodingTests
+
+- (NSString*)formStringForValues:(NSDictionary*)values encoding:(NSStringEncoding)encoding ordering:(NSArray*)ordering
+{
+    NSData* data = [values formDataForHTTPUsingEncoding:encoding ordering:ordering];
+    return [[[NSString alloc] initWithData:data encoding:NSASCIIStringEncoding] autorelease];
+}
+
+#pragma mark - Tests
+
+- (void)testEscaping
+{
+    NSString* form = [self formStringForValues:@{ @"a b" : @"c&d=e/f+g;h:i@j#k%l" } encoding:NSASCIIStringEncoding ordering:nil];
+    STAssertEqualObjects(form, @"a%20b=c%26d%3De%2Ff%2Bg%3Bh%3Ai%40j%23k%25l", @"separators and illegal characters should be escaped");
+}
+
+- (void)testSafeCharactersAreLeftAlone
+{
+    NSString* safe = @"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789!$'()*,-._~?";
+    NSString* form = [self formStringForValues:@{ @"key" : safe } encoding:NSASCIIStringEncoding ordering:nil];
+    STAssertEqualObjects(form, [@"key=" stringByAppendingString:safe], @"unreserved characters should go out as they are");
+}
+
+- (void)testLongValues
+{
+    // long enough for the vector classifier, with escapes landing at every position within a block
+    NSMutableString* value = [NSMutableString string];
+    NSMutableString* expected = [NSMutableString stringWithString:@"long="];
+    NSCharacterSet* safe = [NSCharacterSet characterSetWithCharactersInString:@"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789!$'()*,-._~?"];
+    for (NSUInteger index = 0; index < 5000; ++index)
+    {
+        unichar character = (unichar)(0x20 + (index * 7) % 0x5F);
+        [value appendFormat:@"%C", character];
+        if ([safe characterIsMember:character])
+        {
+            [expected appendFormat:@"%C", character];
+        }
+        else
+        {
+            [expected appendFormat:@"%%%02X", character];
+        }
+    }
+
+    NSString* form = [self formStringForValues:@{ @"long" : value } encoding:NSASCIIStringEncoding ordering:nil];
+    STAssertEqualObjects(form, expected, @"a long value should be escaped just like a short one");
+}
+
+- (void)testUTF8
+{
+    NSString* form = [self formStringForValues:@{ @"name" : @"Grüße 日本" } encoding:NSUTF8StringEncoding ordering:nil];
+    STAssertEqualObjects(form, @"name=Gr%C3%BC%C3%9Fe%20%E6%97%A5%E6%9C%AC", @"characters outside ASCII should be escaped as UTF-8");
+}
+
+- (void)testOrderingAndMultipleValues
+{
+    NSDictionary* values = @{ @"k" : @[ @"1", @"two 2" ], @"n" : @3, @"unordered" : @"x" };
+    NSString* form = [self formStringForValues:values encoding:NSASCIIStringEncoding ordering:@[ @"n", @"k", @"missing" ]];
+    STAssertEqualObjects(form, @"n=3&k=1&k=two%202", @"only the ordered keys should be included, in order, with each of their values");
+
+    STAssertEqualObjects([self formStringForValues:@{} encoding:NSASCIIStringEncoding ordering:nil], @"", @"nothing should give an empty body");
+}
+
+- (void)testStringMatchesData
+{
+    NSDictionary* values = @{ @"a" : @"b c", @"d" : @[ @"e", @"f&g" ] };
+    NSArray* ordering = @[ @"a", @"d" ];
+    STAssertEqualObjects([values formatForHTTPUsingEncoding:NSUTF8StringEncoding ordering:ordering], @"a=b%20c&d=e&d=f%26g", @"the string should match the data");
+    STAssertEqualObjects([values formatForHTTPUsingEncoding:NSUTF8StringEncoding ordering:ordering], [self formStringForValues:values encoding:NSUTF8StringEncoding ordering:ordering], @"the string should match the data");
+}
+
+- (void)testRequestBody
+{
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:@"http://example.com/form"]];
+    [request setHTTPBodyWithFormValues:@{ @"q" : @"a b" } encoding:NSUTF8StringEncoding ordering:nil];
+
+    STAssertEqualObjects([request HTTPBody], [@"q=a%20b" dataUsingEncoding:NSASCIIStringEncoding], @"wrong body");
+    STAssertEqualObjects([request valueForHTTPHeaderField:@"Content-Type"], @"application/x-www-form-urlencoded; charset=utf-8", @"wrong content type");
+}
+
+@end
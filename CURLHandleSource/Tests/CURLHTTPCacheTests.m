@@ -0,0 +1,328 @@
+//
+//  CURLHTTPCacheTests.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLHandleBasedTest.h"
+#import "CURLHTTPCache.h"
+#import "CURLMultiHandle.h"
+#import "CURLReplayServer.h"
+#import "CURLTransferRecorder.h"
+
+@interface CURLHTTPCacheTests : CURLHandleBasedTest
+
+@property (strong, nonatomic) NSURL* directoryURL;
+
+@end
+
+@implementation CURLHTTPCacheTests
+
+- (void)dealloc
+{
+    [_directoryURL release];
+
+    [super dealloc];
+}
+
+- (void)setUp
+{
+    [super setUp];
+
+    NSString* name = [NSString stringWithFormat:@"CURLHTTPCacheTests-%@", [[NSProcessInfo processInfo] globallyUniqueString]];
+    self.directoryURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:name]];
+}
+
+- (void)cleanup
+{
+    [CURLTransfer setHTTPCache:nil];
+
+    if (self.directoryURL)
+    {
+        [[NSFileManager defaultManager] removeItemAtURL:self.directoryURL error:nil];
+        self.directoryURL = nil;
+    }
+
+    [super cleanup];
+}
+
+- (CURLHTTPCache*)cacheWithCapacity:(unsigned long long)capacity
+{
+    CURLHTTPCache* cache = [[[CURLHTTPCache alloc] initWithDirectoryURL:self.directoryURL capacity:capacity] autorelease];
+    STAssertNotNil(cache, @"couldn't make cache");
+    return cache;
+}
+
+- (BOOL)storeBody:(NSData*)body headers:(NSString*)headers forRequest:(NSURLRequest*)request inCache:(CURLHTTPCache*)cache
+{
+    CURLCachedHTTPResponse* response = [cache storeResponseToRequest:request URL:[request URL] statusCode:200 headerString:headers];
+    if (!response) return NO;
+
+    [cache appendData:body toResponse:response];
+    [cache finishStoringResponse:response];
+    return YES;
+}
+
+- (NSArray*)recordsForURL:(NSURL*)url responses:(NSArray*)responses
+{
+    // the replay server plays back records for the same request in order, so make up the ones we want
+    NSURL* logURL = [self.directoryURL URLByAppendingPathExtension:@"curlrec"];
+    CURLTransferRecorder* recorder = [CURLTransferRecorder recorderWithURL:logURL recordsBodies:YES error:NULL];
+    for (NSArray* response in responses)
+    {
+        NSString* headers = [response objectAtIndex:1];
+        NSData* body = [response objectAtIndex:2];
+
+        CURLTransferRecord* record = [recorder recordForRequest:[NSURLRequest requestWithURL:url]];
+        [record recordReceivedBytes:[headers UTF8String] length:strlen([headers UTF8String]) isHeader:YES];
+        [record recordResponseWithStatusCode:[[response objectAtIndex:0] integerValue] headers:headers];
+        [record recordReceivedBytes:[body bytes] length:[body length] isHeader:NO];
+        [record recordResultCode:CURLE_OK];
+        [record finishWithError:nil];
+    }
+    [recorder close];
+
+    NSArray* records = [CURLTransferRecorder recordsWithContentsOfURL:logURL error:NULL];
+    [[NSFileManager defaultManager] removeItemAtURL:logURL error:NULL];
+    return records;
+}
+
+- (void)performRequest:(NSURLRequest*)request
+{
+    [self performRequest:request credential:nil];
+}
+
+- (void)performRequest:(NSURLRequest*)request credential:(NSURLCredential*)credential
+{
+    self.buffer = nil;
+    self.error = nil;
+    self.response = nil;
+
+    CURLTransfer* transfer = [[CURLTransfer alloc] initWithRequest:request credential:credential delegate:self delegateQueue:[NSOperationQueue mainQueue] multi:[CURLMultiHandle sharedInstance]];
+    [self runUntilPaused];
+    [transfer release];
+}
+
+#pragma mark - Tests
+
+- (void)testFreshResponse
+{
+    CURLHTTPCache* cache = [self cacheWithCapacity:100000];
+    NSURLRequest* request = [NSURLRequest requestWithURL:[NSURL URLWithString:@"http://example.com/fresh"]];
+    NSData* body = [@"fresh body" dataUsingEncoding:NSUTF8StringEncoding];
+    BOOL revalidate;
+
+    STAssertNil([cache cachedResponseForRequest:request mustRevalidate:&revalidate], @"cache should start empty");
+    STAssertTrue([self storeBody:body headers:@"HTTP/1.1 200 OK\r\nCache-Control: max-age=60\r\n\r\n" forRequest:request inCache:cache], @"response should be stored");
+    STAssertEquals(cache.currentSize, (unsigned long long)[body length], @"wrong size");
+
+    CURLCachedHTTPResponse* response = [cache cachedResponseForRequest:request mustRevalidate:&revalidate];
+    STAssertNotNil(response, @"response should be cached");
+    STAssertFalse(revalidate, @"fresh response shouldn't need revalidating");
+    STAssertEqualObjects(response.data, body, @"wrong body");
+    STAssertEquals(response.statusCode, (NSInteger)200, @"wrong status");
+
+    NSURLRequest* reload = [NSURLRequest requestWithURL:[request URL] cachePolicy:NSURLRequestReloadIgnoringLocalCacheData timeoutInterval:60.0];
+    STAssertNil([cache cachedResponseForRequest:reload mustRevalidate:&revalidate], @"reloading should skip the cache");
+
+    STAssertEquals(cache.hitCount, (NSUInteger)1, @"wrong hit count");
+    STAssertEquals(cache.missCount, (NSUInteger)1, @"wrong miss count");
+}
+
+- (void)testRevalidation
+{
+    CURLHTTPCache* cache = [self cacheWithCapacity:100000];
+    NSURLRequest* request = [NSURLRequest requestWithURL:[NSURL URLWithString:@"http://example.com/stale"]];
+    BOOL revalidate;
+
+    STAssertTrue([self storeBody:[NSData dataWithBytes:"x" length:1] headers:@"HTTP/1.1 200 OK\r\nETag: \"v1\"\r\nCache-Control: no-cache\r\n\r\n" forRequest:request inCache:cache], @"response should be stored");
+
+    CURLCachedHTTPResponse* response = [cache cachedResponseForRequest:request mustRevalidate:&revalidate];
+    STAssertTrue(revalidate, @"no-cache response should be revalidated");
+    STAssertEqualObjects(response.entityTag, @"\"v1\"", @"wrong validator");
+
+    NSURLRequest* anyAge = [NSURLRequest requestWithURL:[request URL] cachePolicy:NSURLRequestReturnCacheDataElseLoad timeoutInterval:60.0];
+    STAssertNotNil([cache cachedResponseForRequest:anyAge mustRevalidate:&revalidate], @"any response should do");
+    STAssertFalse(revalidate, @"shouldn't revalidate when any response will do");
+
+    // the 304 says it's good for a while now
+    [cache updateResponse:response withNotModifiedHeaderString:@"HTTP/1.1 304 Not Modified\r\nCache-Control: max-age=60\r\n\r\n"];
+    STAssertNotNil([cache cachedResponseForRequest:request mustRevalidate:&revalidate], @"response should still be cached");
+    STAssertFalse(revalidate, @"response should be fresh again");
+
+    STAssertEquals(cache.revalidationCount, (NSUInteger)1, @"wrong revalidation count");
+    STAssertEquals(cache.notModifiedCount, (NSUInteger)1, @"wrong not modified count");
+    STAssertEquals(cache.hitCount, (NSUInteger)2, @"wrong hit count");
+}
+
+- (void)testNotModifiedUpdatesHeaders
+{
+    CURLHTTPCache* cache = [self cacheWithCapacity:100000];
+    NSURLRequest* request = [NSURLRequest requestWithURL:[NSURL URLWithString:@"http://example.com/changing"]];
+    BOOL revalidate;
+
+    STAssertTrue([self storeBody:[NSData dataWithBytes:"x" length:1] headers:@"HTTP/1.1 200 OK\r\nETag: \"v1\"\r\nCache-Control: no-cache\r\nContent-Length: 1\r\n\r\n" forRequest:request inCache:cache], @"response should be stored");
+
+    CURLCachedHTTPResponse* response = [cache cachedResponseForRequest:request mustRevalidate:&revalidate];
+    [cache updateResponse:response withNotModifiedHeaderString:@"HTTP/1.1 304 Not Modified\r\nETag: \"v2\"\r\nLast-Modified: Sun, 06 Nov 1994 08:49:37 GMT\r\nContent-Length: 0\r\n\r\n"];
+    STAssertEqualObjects(response.entityTag, @"\"v2\"", @"304's validator should replace the stored one");
+    STAssertEqualObjects(response.lastModified, @"Sun, 06 Nov 1994 08:49:37 GMT", @"304's validator should be added");
+    STAssertTrue([response.headerString rangeOfString:@"\"v1\""].location == NSNotFound, @"old validator should be gone");
+    STAssertTrue([response.headerString rangeOfString:@"Content-Length: 1"].location != NSNotFound, @"304's length shouldn't replace the body's");
+
+    // the next revalidation, even after a relaunch, sends the new validator
+    CURLHTTPCache* reopened = [self cacheWithCapacity:100000];
+    response = [reopened cachedResponseForRequest:request mustRevalidate:&revalidate];
+    STAssertTrue(revalidate, @"no-cache response should still be revalidated");
+    STAssertEqualObjects(response.entityTag, @"\"v2\"", @"updated validator should have been stored");
+    STAssertEqualObjects(response.lastModified, @"Sun, 06 Nov 1994 08:49:37 GMT", @"updated validator should have been stored");
+}
+
+- (void)testWhatIsStored
+{
+    CURLHTTPCache* cache = [self cacheWithCapacity:100000];
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:@"http://example.com/page"]];
+    NSData* body = [NSData dataWithBytes:"x" length:1];
+    BOOL revalidate;
+
+    STAssertFalse([self storeBody:body headers:@"HTTP/1.1 200 OK\r\nCache-Control: no-store, max-age=60\r\n\r\n" forRequest:request inCache:cache], @"no-store shouldn't be stored");
+    STAssertFalse([self storeBody:body headers:@"HTTP/1.1 200 OK\r\nCache-Control: private, max-age=60\r\n\r\n" forRequest:request inCache:cache], @"private shouldn't be stored");
+    STAssertFalse([self storeBody:body headers:@"HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n\r\n" forRequest:request inCache:cache], @"a response that's never fresh and has no validator is no use");
+    STAssertTrue([self storeBody:body headers:@"HTTP/1.1 200 OK\r\nLast-Modified: Sun, 06 Nov 1994 08:49:37 GMT\r\n\r\n" forRequest:request inCache:cache], @"heuristic freshness should be enough");
+
+    [request setValue:@"en" forHTTPHeaderField:@"Accept-Language"];
+    STAssertTrue([self storeBody:body headers:@"HTTP/1.1 200 OK\r\nCache-Control: max-age=60\r\nVary: Accept-Language\r\n\r\n" forRequest:request inCache:cache], @"varying response should be stored");
+    STAssertNotNil([cache cachedResponseForRequest:request mustRevalidate:&revalidate], @"same variant should hit");
+    [request setValue:@"fr" forHTTPHeaderField:@"Accept-Language"];
+    STAssertNil([cache cachedResponseForRequest:request mustRevalidate:&revalidate], @"different variant shouldn't hit");
+
+    [request setValue:@"Basic YWxpY2U6b25l" forHTTPHeaderField:@"Authorization"];
+    STAssertFalse([CURLHTTPCache canCacheRequest:request], @"authorised request shouldn't be cached");
+    [request setValue:nil forHTTPHeaderField:@"Authorization"];
+    [request setValue:@"session=1" forHTTPHeaderField:@"Cookie"];
+    STAssertFalse([CURLHTTPCache canCacheRequest:request], @"request with cookies shouldn't be cached");
+    [request setValue:nil forHTTPHeaderField:@"Cookie"];
+    STAssertFalse([CURLHTTPCache canCacheRequest:[NSURLRequest requestWithURL:[NSURL URLWithString:@"http://alice@example.com/page"]]], @"request with a login shouldn't be cached");
+
+    [request setHTTPMethod:@"PUT"];
+    STAssertFalse([CURLHTTPCache canCacheRequest:request], @"PUT shouldn't be cached");
+    [cache invalidateResponseForRequest:request];
+    [request setHTTPMethod:@"GET"];
+    [request setValue:@"en" forHTTPHeaderField:@"Accept-Language"];
+    STAssertNil([cache cachedResponseForRequest:request mustRevalidate:&revalidate], @"PUT should have dropped the response");
+}
+
+- (void)testEvictionAndReopening
+{
+    CURLHTTPCache* cache = [self cacheWithCapacity:1000];
+    NSMutableData* body = [NSMutableData dataWithLength:400];
+    NSString* headers = @"HTTP/1.1 200 OK\r\nCache-Control: max-age=60\r\n\r\n";
+    NSURLRequest* first = [NSURLRequest requestWithURL:[NSURL URLWithString:@"http://example.com/1"]];
+    NSURLRequest* second = [NSURLRequest requestWithURL:[NSURL URLWithString:@"http://example.com/2"]];
+    NSURLRequest* third = [NSURLRequest requestWithURL:[NSURL URLWithString:@"http://example.com/3"]];
+    BOOL revalidate;
+
+    [self storeBody:body headers:headers forRequest:first inCache:cache];
+    [self storeBody:body headers:headers forRequest:second inCache:cache];
+    [cache cachedResponseForRequest:first mustRevalidate:&revalidate];     // so the second is least recently used
+    [self storeBody:body headers:headers forRequest:third inCache:cache];
+
+    STAssertEquals(cache.currentSize, (unsigned long long)800, @"wrong size");
+    STAssertNil([cache cachedResponseForRequest:second mustRevalidate:&revalidate], @"least recently used should have been evicted");
+    STAssertFalse([self storeBody:[NSMutableData dataWithLength:2000] headers:headers forRequest:second inCache:cache] && [cache cachedResponseForRequest:second mustRevalidate:&revalidate], @"too big to keep");
+
+    // the index lives on disk
+    CURLHTTPCache* reopened = [self cacheWithCapacity:1000];
+    STAssertEquals(reopened.currentSize, (unsigned long long)800, @"wrong size after reopening");
+    STAssertEqualObjects([reopened cachedResponseForRequest:third mustRevalidate:&revalidate].data, body, @"response should survive reopening");
+}
+
+- (void)testTransfersUseCache
+{
+    NSURL* freshURL = [NSURL URLWithString:@"http://example.com/fresh.txt"];
+    NSURL* staleURL = [NSURL URLWithString:@"http://example.com/stale.txt"];
+    NSData* body = [@"cached body" dataUsingEncoding:NSUTF8StringEncoding];
+    NSMutableArray* records = [NSMutableArray array];
+    [records addObjectsFromArray:[self recordsForURL:freshURL responses:@[@[@200, @"HTTP/1.1 200 OK\r\nCache-Control: max-age=60\r\n\r\n", body]]]];
+    [records addObjectsFromArray:[self recordsForURL:staleURL responses:@[@[@200, @"HTTP/1.1 200 OK\r\nETag: \"v1\"\r\nCache-Control: no-cache\r\n\r\n", body],
+                                                                           @[@304, @"HTTP/1.1 304 Not Modified\r\nETag: \"v1\"\r\n\r\n", [NSData data]]]]];
+
+    CURLReplayServer* server = [[CURLReplayServer alloc] initWithRecords:records];
+    server.speed = 0;
+    STAssertTrue([server start], @"server didn't start");
+
+    CURLHTTPCache* cache = [self cacheWithCapacity:100000];
+    [CURLTransfer setHTTPCache:cache];
+
+    // a fresh response is only fetched once
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[server URLByRoutingURL:freshURL]];
+    [request setValue:[CURLReplayServer hostHeaderForURL:freshURL] forHTTPHeaderField:@"Host"];
+    for (NSUInteger n = 0; n < 2; ++n)
+    {
+        [self performRequest:request];
+        STAssertNil(self.error, @"got error %@", self.error);
+        STAssertEquals([(NSHTTPURLResponse*)self.response statusCode], (NSInteger)200, @"wrong status");
+        STAssertEqualObjects(self.buffer, body, @"wrong body");
+    }
+    STAssertEquals(server.servedCount, (NSUInteger)1, @"second request should have been answered from the cache");
+
+    // a stale one is revalidated, and the 304 delivers the cached copy
+    request = [NSMutableURLRequest requestWithURL:[server URLByRoutingURL:staleURL]];
+    [request setValue:[CURLReplayServer hostHeaderForURL:staleURL] forHTTPHeaderField:@"Host"];
+    for (NSUInteger n = 0; n < 2; ++n)
+    {
+        [self performRequest:request];
+        STAssertNil(self.error, @"got error %@", self.error);
+        STAssertEquals([(NSHTTPURLResponse*)self.response statusCode], (NSInteger)200, @"304 should look like the cached 200");
+        STAssertEqualObjects(self.buffer, body, @"wrong body");
+    }
+    STAssertEquals(server.servedCount, (NSUInteger)3, @"revalidation should have gone to the server");
+    STAssertEquals(cache.notModifiedCount, (NSUInteger)1, @"wrong not modified count");
+
+    // nothing cached, and told not to load
+    request = [NSMutableURLRequest requestWithURL:[server URLByRoutingURL:[NSURL URLWithString:@"http://example.com/none.txt"]] cachePolicy:NSURLRequestReturnCacheDataDontLoad timeoutInterval:60.0];
+    [self performRequest:request];
+    STAssertEquals([self.error code], (NSInteger)NSURLErrorResourceUnavailable, @"should have failed without loading");
+    STAssertEquals(server.unmatchedCount, (NSUInteger)0, @"nothing should have been sent");
+
+    [server stop];
+    [server release];
+}
+
+- (void)testCredentialsDontShareResponses
+{
+    NSURL* url = [NSURL URLWithString:@"http://example.com/inbox.txt"];
+    NSData* aliceBody = [@"alice's inbox" dataUsingEncoding:NSUTF8StringEncoding];
+    NSData* bobBody = [@"bob's inbox" dataUsingEncoding:NSUTF8StringEncoding];
+    NSString* headers = @"HTTP/1.1 200 OK\r\nCache-Control: max-age=60\r\n\r\n";
+    NSArray* records = [self recordsForURL:url responses:@[@[@200, headers, aliceBody], @[@200, headers, bobBody]]];
+
+    CURLReplayServer* server = [[CURLReplayServer alloc] initWithRecords:records];
+    server.speed = 0;
+    STAssertTrue([server start], @"server didn't start");
+
+    CURLHTTPCache* cache = [self cacheWithCapacity:100000];
+    [CURLTransfer setHTTPCache:cache];
+
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[server URLByRoutingURL:url]];
+    [request setValue:[CURLReplayServer hostHeaderForURL:url] forHTTPHeaderField:@"Host"];
+
+    [self performRequest:request credential:[NSURLCredential credentialWithUser:@"alice" password:@"one" persistence:NSURLCredentialPersistenceNone]];
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEqualObjects(self.buffer, aliceBody, @"wrong body");
+
+    [self performRequest:request credential:[NSURLCredential credentialWithUser:@"bob" password:@"two" persistence:NSURLCredentialPersistenceNone]];
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEqualObjects(self.buffer, bobBody, @"second user got the first user's response");
+
+    STAssertEquals(server.servedCount, (NSUInteger)2, @"both requests should have gone to the server");
+    STAssertEquals(cache.currentSize, (unsigned long long)0, @"nothing should have been stored");
+    STAssertEquals(cache.hitCount, (NSUInteger)0, @"nothing should have come from the cache");
+
+    [server stop];
+    [server release];
+}
+
+@end
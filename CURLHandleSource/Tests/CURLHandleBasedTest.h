@@ -10,6 +10,10 @@
 
 #import "CURLTransfer.h"
 
+@class CURLConditioningProxy;
+@class CURLNetworkConditions;
+@class CURLStandInServer;
+
 @interface CURLHandleBasedTest : KMSTestCase<CURLTransferDelegate>
 
 @property (strong, nonatomic) NSMutableData* buffer;
@@ -20,6 +24,9 @@
 @property (strong, nonatomic) NSURLResponse* response;
 @property (assign, nonatomic) BOOL sending;
 @property (strong, nonatomic) NSMutableString* transcript;
+@property (strong, nonatomic) CURLConditioningProxy* proxy;
+@property (strong, nonatomic) CURLStandInServer* standInServer;
+@property (strong, nonatomic) NSData* standInPayload;
 
 - (BOOL)checkDownloadedBufferWasCorrect;
 - (void)runUntilPaused;
@@ -31,5 +38,27 @@
 - (NSURL*)testFileURL;
 - (NSURL*)testFileRemoteURL;
 
+/**
+ Start a conditioning proxy in front of the server for a URL, and return the URL re-pointed at it.
+ The proxy is available as self.proxy (so that a test can script it further), and is stopped by cleanup.
+
+ @param url A URL on the real (usually mock) server.
+ @param conditions How the connections through the proxy should behave.
+ @return The URL to use instead.
+ */
+
+- (NSURL*)URLByConditioningURL:(NSURL*)url withConditions:(CURLNetworkConditions*)conditions;
+
+/**
+ Start a stand-in HTTP server serving a payload of 'x's, and return a URL for it.
+ The payload and server are available as self.standInPayload and self.standInServer, and the server is stopped by cleanup.
+
+ @param length The length of the payload.
+ @param script How each connection should behave, going through a conditioning proxy; nil to talk to the server directly.
+ @return The URL to fetch the payload from.
+ */
+
+- (NSURL*)URLForPayloadOfLength:(NSUInteger)length connectionConditions:(CURLNetworkConditions* (^)(NSUInteger connectionIndex))script;
+
 @end
 
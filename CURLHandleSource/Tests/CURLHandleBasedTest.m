@@ -7,6 +7,9 @@
 //
 
 #import "CURLHandleBasedTest.h"
+#import "CURLConditioningProxy.h"
+#import "CURLNetworkConditions.h"
+#import "CURLStandInServer.h"
 #import "KMSServer.h"
 
 @implementation CURLHandleBasedTest
@@ -175,6 +178,39 @@
     return result;
 }
 
+- (NSURL*)URLByConditioningURL:(NSURL *)url withConditions:(CURLNetworkConditions *)conditions
+{
+    [self.proxy stop];
+
+    CURLConditioningProxy* proxy = [CURLConditioningProxy proxyForURL:url];
+    proxy.defaultConditions = conditions;
+    BOOL started = [proxy start];
+    STAssertTrue(started, @"failed to start proxy for %@", url);
+    self.proxy = proxy;
+
+    return [proxy URLByRoutingURL:url];
+}
+
+- (NSURL*)URLForPayloadOfLength:(NSUInteger)length connectionConditions:(CURLNetworkConditions* (^)(NSUInteger connectionIndex))script
+{
+    NSMutableData* payload = [NSMutableData dataWithLength:length];
+    memset([payload mutableBytes], 'x', [payload length]);
+    self.standInPayload = payload;
+
+    [self.standInServer stop];
+    self.standInServer = [CURLStandInServer HTTPServerWithPayload:payload];
+    [self.standInServer start];
+
+    NSURL* url = [self.standInServer URLForPath:@"/payload.bin"];
+    if (script)
+    {
+        url = [self URLByConditioningURL:url withConditions:[CURLNetworkConditions conditions]];
+        self.proxy.script = script;
+    }
+
+    return url;
+}
+
 - (void)cleanup
 {
     if (self.transcript)
@@ -186,6 +222,13 @@
         NSLog(@"No transcript.");
     }
 
+    [self.proxy stop];
+    self.proxy = nil;
+
+    [self.standInServer stop];
+    self.standInServer = nil;
+    self.standInPayload = nil;
+
     self.buffer = nil;
     self.transcript = nil;
     self.response = nil;
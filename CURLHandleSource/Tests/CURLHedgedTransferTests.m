@@ -0,0 +1,114 @@
+//
+//  CURLHedgedTransferTests.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLHandleBasedTest.h"
+#import "CURLConditioningProxy.h"
+#import "CURLHedgedTransfer.h"
+#import "CURLMultiHandle.h"
+#import "CURLNetworkConditions.h"
+
+@interface CURLHedgedTransferTests : CURLHandleBasedTest
+
+@end
+
+@implementation CURLHedgedTransferTests
+
+- (NSURL*)URLWithSlowFirstConnection:(NSTimeInterval)latency
+{
+    return [self URLForPayloadOfLength:10000 connectionConditions:^CURLNetworkConditions*(NSUInteger connectionIndex) {
+        CURLNetworkConditions* conditions = [CURLNetworkConditions conditions];
+        if (connectionIndex == 0)
+        {
+            conditions.latency = latency;
+        }
+        return conditions;
+    }];
+}
+
+- (CURLHedgedTransfer*)runRequestForURL:(NSURL*)url policy:(CURLHedgingPolicy*)policy
+{
+    self.buffer = nil;
+    self.error = nil;
+
+    NSURLRequest* request = [NSURLRequest requestWithURL:url];
+    CURLHedgedTransfer* transfer = [[CURLHedgedTransfer alloc] initWithRequest:request credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue] multi:[CURLMultiHandle sharedInstance] policy:policy];
+    [self runUntilPaused];
+
+    return [transfer autorelease];
+}
+
+#pragma mark - Tests
+
+- (void)testHedgeWinsAgainstSlowConnection
+{
+    NSURL* url = [self URLWithSlowFirstConnection:2.0];
+    CURLHedgingPolicy* policy = [CURLHedgingPolicy policyWithDelay:0.1];
+
+    NSDate* started = [NSDate date];
+    CURLHedgedTransfer* transfer = [self runRequestForURL:url policy:policy];
+    NSTimeInterval elapsed = -[started timeIntervalSinceNow];
+
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEqualObjects(self.buffer, self.standInPayload, @"wrong data");
+    STAssertTrue(transfer.didHedge, @"request should have been hedged");
+    STAssertNotNil(transfer.winningTransfer, @"there should be a winner");
+    STAssertTrue(elapsed < 2.0, @"hedge should have beaten the slow connection, took %.3fs", elapsed);
+
+    STAssertEquals(policy.requestCount, (NSUInteger)1, @"wrong request count");
+    STAssertEquals(policy.hedgeCount, (NSUInteger)1, @"wrong hedge count");
+    STAssertEquals(policy.hedgeWinCount, (NSUInteger)1, @"wrong win count");
+    STAssertEquals(self.proxy.connectionCount, (NSUInteger)2, @"hedge should have used a new connection");
+}
+
+- (void)testNoHedgeForFastResponse
+{
+    NSURL* url = [self URLWithSlowFirstConnection:0.0];
+    CURLHedgingPolicy* policy = [CURLHedgingPolicy policyWithDelay:1.0];
+
+    CURLHedgedTransfer* transfer = [self runRequestForURL:url policy:policy];
+
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEqualObjects(self.buffer, self.standInPayload, @"wrong data");
+    STAssertFalse(transfer.didHedge, @"request shouldn't have been hedged");
+    STAssertEquals(policy.hedgeCount, (NSUInteger)0, @"wrong hedge count");
+}
+
+- (void)testObservedLatency
+{
+    CURLHedgingPolicy* policy = [CURLHedgingPolicy policyWithDelay:1.0];
+    policy.minimumSamples = 20;
+
+    for (NSUInteger index = 0; index < 19; ++index)
+    {
+        [policy recordFirstByteTime:0.01 * (index + 1) forHost:@"example.com"];
+    }
+    STAssertEquals([policy observedFirstByteTimeForHost:@"example.com"], 0.0, @"too few samples to trust");
+    STAssertEquals([policy hedgeDelayForURL:[NSURL URLWithString:@"http://example.com/"]], 1.0, @"should use the fixed delay");
+
+    [policy recordFirstByteTime:0.2 forHost:@"EXAMPLE.com"];
+    STAssertEqualsWithAccuracy([policy observedFirstByteTimeForHost:@"example.com"], 0.19, 0.0001, @"wrong percentile");
+    STAssertEqualsWithAccuracy([policy hedgeDelayForURL:[NSURL URLWithString:@"http://example.com/"]], 0.19, 0.0001, @"should hedge at the percentile");
+    STAssertEquals([policy hedgeDelayForURL:[NSURL URLWithString:@"http://other.com/"]], 1.0, @"other hosts shouldn't be affected");
+}
+
+- (void)testOnlyIdempotentRequestsHedge
+{
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:@"http://example.com/"]];
+    STAssertTrue([CURLHedgedTransfer canHedgeRequest:request], @"GET should be hedged");
+
+    [request setHTTPMethod:@"POST"];
+    STAssertFalse([CURLHedgedTransfer canHedgeRequest:request], @"POST shouldn't be hedged");
+
+    [request setHTTPMethod:@"GET"];
+    [request setHTTPBody:[@"body" dataUsingEncoding:NSUTF8StringEncoding]];
+    STAssertFalse([CURLHedgedTransfer canHedgeRequest:request], @"requests with a body shouldn't be hedged");
+
+    STAssertFalse([CURLHedgedTransfer canHedgeRequest:[NSURLRequest requestWithURL:[NSURL URLWithString:@"ftp://example.com/file"]]], @"FTP shouldn't be hedged");
+}
+
+@end
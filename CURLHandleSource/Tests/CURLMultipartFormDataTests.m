@@ -0,0 +1,215 @@
+//
+//  CURLMultipartFormDataTests.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLHandleBasedTest.h"
+#import "CURLDigest.h"
+#import "CURLMultipartFormData.h"
+#import "CURLReplayServer.h"
+#import "CURLRequest.h"
+#import "CURLTransferRecorder.h"
+
+@interface CURLMultipartFormDataTests : CURLHandleBasedTest
+
+@end
+
+@implementation CURLMultipartFormDataTests
+
+- (NSURL*)temporaryFileWithData:(NSData*)data
+{
+    NSString* name = [NSString stringWithFormat:@"CURLMultipartFormDataTests-%@.bin", [[NSProcessInfo processInfo] globallyUniqueString]];
+    NSURL* url = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:name]];
+    STAssertTrue([data writeToURL:url atomically:NO], @"couldn't write the file");
+    return url;
+}
+
+- (NSData*)fileContents
+{
+    NSMutableData* contents = [NSMutableData dataWithLength:300000];
+    uint8_t* bytes = [contents mutableBytes];
+    for (NSUInteger index = 0; index < [contents length]; ++index)
+    {
+        bytes[index] = (uint8_t)(index * 31 + (index >> 8));
+    }
+
+    return contents;
+}
+
+// Reads a whole stream, a little at a time
+- (NSData*)readStream:(NSInputStream*)stream
+{
+    NSMutableData* output = [NSMutableData data];
+    uint8_t buffer[1000];
+    NSInteger length;
+    while ((length = [stream read:buffer maxLength:sizeof(buffer)]) > 0)
+    {
+        [output appendBytes:buffer length:length];
+    }
+
+    STAssertTrue(length == 0, @"reading failed with %@", [stream streamError]);
+    return output;
+}
+
+- (NSData*)expectedBodyForForm:(CURLMultipartFormData*)form fileContents:(NSData*)contents
+{
+    NSString* boundary = form.boundary;
+    NSMutableData* body = [NSMutableData data];
+    [body appendData:[[NSString stringWithFormat:@"--%@\r\nContent-Disposition: form-data; name=\"title\"\r\n\r\nGrüße\r\n", boundary] dataUsingEncoding:NSUTF8StringEncoding]];
+    [body appendData:[[NSString stringWithFormat:@"--%@\r\nContent-Disposition: form-data; name=\"note\"; filename=\"note.txt\"\r\nContent-Type: text/plain\r\n\r\nhello\r\n", boundary] dataUsingEncoding:NSUTF8StringEncoding]];
+    [body appendData:[[NSString stringWithFormat:@"--%@\r\nContent-Disposition: form-data; name=\"file\"; filename=\"upload.bin\"\r\nContent-Type: application/octet-stream\r\n\r\n", boundary] dataUsingEncoding:NSUTF8StringEncoding]];
+    [body appendData:contents];
+    [body appendData:[[NSString stringWithFormat:@"\r\n--%@--\r\n", boundary] dataUsingEncoding:NSUTF8StringEncoding]];
+    return body;
+}
+
+- (CURLMultipartFormData*)formWithFileURL:(NSURL*)url
+{
+    CURLMultipartFormData* form = [[[CURLMultipartFormData alloc] init] autorelease];
+    [form appendPartWithName:@"title" string:@"Grüße"];
+    [form appendPartWithName:@"note" data:[@"hello" dataUsingEncoding:NSUTF8StringEncoding] fileName:@"note.txt" mimeType:@"text/plain"];
+
+    NSError* error = nil;
+    STAssertTrue([form appendPartWithName:@"file" fileURL:url fileName:@"upload.bin" mimeType:nil error:&error], @"couldn't add the file: %@", error);
+    return form;
+}
+
+#pragma mark - Tests
+
+- (void)testFields
+{
+    CURLMultipartFormData* form = [[CURLMultipartFormData alloc] init];
+    [form appendPartWithName:@"a \"quoted\"\r\nname" string:@"value"];
+
+    NSString* expected = [NSString stringWithFormat:@"--%@\r\nContent-Disposition: form-data; name=\"a %%22quoted%%22%%0D%%0Aname\"\r\n\r\nvalue\r\n--%@--\r\n", form.boundary, form.boundary];
+    NSInputStream* stream = [form inputStream];
+    [stream open];
+    NSData* body = [self readStream:stream];
+    [stream close];
+
+    STAssertEqualObjects([[[NSString alloc] initWithData:body encoding:NSUTF8StringEncoding] autorelease], expected, @"wrong body");
+    STAssertEquals(form.contentLength, (unsigned long long)[body length], @"the length should match the body");
+    STAssertEqualObjects(form.contentType, ([NSString stringWithFormat:@"multipart/form-data; boundary=%@", form.boundary]), @"wrong content type");
+    [form release];
+}
+
+- (void)testFileParts
+{
+    NSData* contents = [self fileContents];
+    NSURL* url = [self temporaryFileWithData:contents];
+    CURLMultipartFormData* form = [self formWithFileURL:url];
+
+    NSData* expected = [self expectedBodyForForm:form fileContents:contents];
+    NSInputStream* stream = [form inputStream];
+    [stream open];
+    STAssertEqualObjects([self readStream:stream], expected, @"wrong body");
+    STAssertEquals([stream streamStatus], NSStreamStatusAtEnd, @"the stream should be at its end");
+    [stream close];
+    STAssertEquals(form.contentLength, (unsigned long long)[expected length], @"the length should match the body");
+
+    NSError* error = nil;
+    STAssertFalse([form appendPartWithName:@"missing" fileURL:[url URLByAppendingPathExtension:@"missing"] fileName:nil mimeType:nil error:&error], @"a missing file shouldn't be added");
+    STAssertNotNil(error, @"there should be an error");
+
+    [[NSFileManager defaultManager] removeItemAtURL:url error:NULL];
+}
+
+- (void)testSeeking
+{
+    NSData* contents = [self fileContents];
+    NSURL* url = [self temporaryFileWithData:contents];
+    CURLMultipartFormData* form = [self formWithFileURL:url];
+    NSData* expected = [self expectedBodyForForm:form fileContents:contents];
+
+    NSInputStream* stream = [form inputStream];
+    [stream open];
+
+    // into the headers, into the file, back to the start and then right to the end
+    NSUInteger length = [expected length];
+    for (NSNumber* offset in @[ @10, @(length / 2), @0, @(length - 3), @(length) ])
+    {
+        STAssertTrue([stream setProperty:offset forKey:NSStreamFileCurrentOffsetKey], @"couldn't move to %@", offset);
+        STAssertEqualObjects([stream propertyForKey:NSStreamFileCurrentOffsetKey], offset, @"wrong offset");
+        NSData* rest = [self readStream:stream];
+        STAssertEqualObjects(rest, [expected subdataWithRange:NSMakeRange([offset unsignedIntegerValue], length - [offset unsignedIntegerValue])], @"wrong body from %@", offset);
+    }
+
+    STAssertFalse([stream setProperty:@(length + 1) forKey:NSStreamFileCurrentOffsetKey], @"moving past the end should fail");
+    [stream close];
+
+    [[NSFileManager defaultManager] removeItemAtURL:url error:NULL];
+}
+
+- (void)testChangedFileFails
+{
+    NSData* contents = [self fileContents];
+    NSURL* url = [self temporaryFileWithData:contents];
+    CURLMultipartFormData* form = [self formWithFileURL:url];
+
+    // a shorter file would leave the body short of its Content-Length
+    [[contents subdataWithRange:NSMakeRange(0, 1000)] writeToURL:url atomically:NO];
+
+    NSInputStream* stream = [form inputStream];
+    [stream open];
+    uint8_t buffer[4096];
+    NSInteger length;
+    while ((length = [stream read:buffer maxLength:sizeof(buffer)]) > 0) { }
+    STAssertEquals(length, (NSInteger)-1, @"reading should have failed");
+    STAssertNotNil([stream streamError], @"there should be an error");
+    STAssertEquals([stream streamStatus], NSStreamStatusError, @"the stream should have failed");
+    [stream close];
+
+    [[NSFileManager defaultManager] removeItemAtURL:url error:NULL];
+}
+
+- (void)testUpload
+{
+    NSData* contents = [self fileContents];
+    NSURL* fileURL = [self temporaryFileWithData:contents];
+    CURLMultipartFormData* form = [self formWithFileURL:fileURL];
+
+    NSURL* url = [NSURL URLWithString:@"http://example.com/form"];
+    NSString* name = [NSString stringWithFormat:@"CURLMultipartFormDataTests-%@.curlrec", [[NSProcessInfo processInfo] globallyUniqueString]];
+    NSURL* logURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:name]];
+    CURLTransferRecorder* recorder = [CURLTransferRecorder recorderWithURL:logURL recordsBodies:YES error:NULL];
+    NSMutableURLRequest* recorded = [NSMutableURLRequest requestWithURL:url];
+    [recorded setHTTPMethod:@"PUT"];
+    NSString* headers = @"HTTP/1.1 201 Created\r\n\r\n";
+    CURLTransferRecord* record = [recorder recordForRequest:recorded];
+    [record recordReceivedBytes:[headers UTF8String] length:strlen([headers UTF8String]) isHeader:YES];
+    [record recordResponseWithStatusCode:201 headers:headers];
+    [record recordResultCode:CURLE_OK];
+    [record finishWithError:nil];
+    [recorder close];
+
+    CURLReplayServer* server = [[CURLReplayServer alloc] initWithRecords:[CURLTransferRecorder recordsWithContentsOfURL:logURL error:NULL]];
+    server.speed = 0;
+    STAssertTrue([server start], @"server didn't start");
+
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[server URLByRoutingURL:url]];
+    [request setValue:[CURLReplayServer hostHeaderForURL:url] forHTTPHeaderField:@"Host"];
+    [request setHTTPMethod:@"PUT"];
+    [request curl_setDigestAlgorithm:CURLDigestAlgorithmCRC32C];
+    [form applyToRequest:request];
+
+    CURLTransfer* transfer = [[CURLTransfer alloc] initWithRequest:request credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue]];
+    [self runUntilPaused];
+
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEquals(server.servedCount, (NSUInteger)1, @"the upload should have reached the server");
+    NSString* length = [NSString stringWithFormat:@"Content-Length: %llu", form.contentLength];
+    STAssertTrue([self.transcript rangeOfString:length].location != NSNotFound, @"the body's length should have been sent");
+    STAssertTrue([self.transcript rangeOfString:@"Transfer-Encoding: chunked"].location == NSNotFound, @"the body shouldn't have been chunked");
+    STAssertEqualObjects(transfer.uploadDigest, [CURLDigest digestOfData:[self expectedBodyForForm:form fileContents:contents] algorithm:CURLDigestAlgorithmCRC32C], @"the whole body should have been sent");
+
+    [transfer release];
+    [server stop];
+    [server release];
+    [[NSFileManager defaultManager] removeItemAtURL:logURL error:NULL];
+    [[NSFileManager defaultManager] removeItemAtURL:fileURL error:NULL];
+}
+
+@end
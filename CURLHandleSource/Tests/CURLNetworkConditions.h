@@ -0,0 +1,98 @@
+//
+//  CURLNetworkConditions.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ Describes how a CURLConditioningProxy should mistreat a single connection.
+
+ Latency and the bandwidth cap apply in both directions. Stalls and disconnects are
+ applied to the downstream (server to client) direction only, since that's where the body
+ of a download is, and where they hurt.
+
+ The default values give a connection which is passed through untouched.
+ */
+
+@interface CURLNetworkConditions : NSObject<NSCopying>
+{
+    NSString        *_name;
+    NSTimeInterval  _latency;
+    NSUInteger      _bytesPerSecond;
+    NSUInteger      _stallAfterBytes;
+    NSTimeInterval  _stallDuration;
+    NSUInteger      _disconnectAfterBytes;
+    NSTimeInterval  _acceptDelay;
+}
+
+/**
+ Conditions which leave the connection alone.
+ */
+
++ (CURLNetworkConditions*)conditions;
+
+/**
+ Roughly a transatlantic DSL link: 40ms each way, 1MB/s.
+ */
+
++ (CURLNetworkConditions*)WANConditions;
+
+/**
+ A poor mobile link: 150ms each way, 64KB/s, and a two second stall after the first 32KB.
+ */
+
++ (CURLNetworkConditions*)lossyConditions;
+
+/**
+ Look up one of the presets by name (`none`, `wan` or `lossy`).
+
+ @param name The name of the preset.
+ @return The preset, or nil if the name is unknown.
+ */
+
++ (CURLNetworkConditions*)conditionsNamed:(NSString*)name;
+
+/**
+ A short name for the conditions, used when reporting results.
+ */
+
+@property (copy, nonatomic) NSString* name;
+
+/**
+ One-way delay added to every chunk of data, in each direction.
+ */
+
+@property (assign, nonatomic) NSTimeInterval latency;
+
+/**
+ Maximum throughput in each direction. Zero means unlimited.
+ */
+
+@property (assign, nonatomic) NSUInteger bytesPerSecond;
+
+/**
+ Once this many bytes have been sent downstream, stop sending for stallDuration.
+ Zero means never stall.
+ */
+
+@property (assign, nonatomic) NSUInteger stallAfterBytes;
+@property (assign, nonatomic) NSTimeInterval stallDuration;
+
+/**
+ Once this many bytes have been sent downstream, drop the connection in both directions.
+ Zero means never disconnect.
+ */
+
+@property (assign, nonatomic) NSUInteger disconnectAfterBytes;
+
+/**
+ How long to leave the connection waiting in the listen backlog before accepting it.
+ */
+
+@property (assign, nonatomic) NSTimeInterval acceptDelay;
+
+@end
@@ -0,0 +1,103 @@
+//
+//  CURLNetworkConditions.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLNetworkConditions.h"
+
+@implementation CURLNetworkConditions
+
+@synthesize name = _name;
+@synthesize latency = _latency;
+@synthesize bytesPerSecond = _bytesPerSecond;
+@synthesize stallAfterBytes = _stallAfterBytes;
+@synthesize stallDuration = _stallDuration;
+@synthesize disconnectAfterBytes = _disconnectAfterBytes;
+@synthesize acceptDelay = _acceptDelay;
+
+#pragma mark - Presets
+
++ (CURLNetworkConditions*)conditions
+{
+    CURLNetworkConditions* result = [[[self alloc] init] autorelease];
+    result.name = @"none";
+
+    return result;
+}
+
++ (CURLNetworkConditions*)WANConditions
+{
+    CURLNetworkConditions* result = [self conditions];
+    result.name = @"wan";
+    result.latency = 0.040;
+    result.bytesPerSecond = 1024 * 1024;
+
+    return result;
+}
+
++ (CURLNetworkConditions*)lossyConditions
+{
+    CURLNetworkConditions* result = [self conditions];
+    result.name = @"lossy";
+    result.latency = 0.150;
+    result.bytesPerSecond = 64 * 1024;
+    result.stallAfterBytes = 32 * 1024;
+    result.stallDuration = 2.0;
+
+    return result;
+}
+
++ (CURLNetworkConditions*)conditionsNamed:(NSString *)name
+{
+    CURLNetworkConditions* result = nil;
+    if ([name isEqualToString:@"none"])
+    {
+        result = [self conditions];
+    }
+    else if ([name isEqualToString:@"wan"])
+    {
+        result = [self WANConditions];
+    }
+    else if ([name isEqualToString:@"lossy"])
+    {
+        result = [self lossyConditions];
+    }
+
+    return result;
+}
+
+#pragma mark - Object Lifecycle
+
+- (void)dealloc
+{
+    [_name release];
+
+    [super dealloc];
+}
+
+- (id)copyWithZone:(NSZone *)zone
+{
+    CURLNetworkConditions* result = [[[self class] allocWithZone:zone] init];
+    result.name = self.name;
+    result.latency = self.latency;
+    result.bytesPerSecond = self.bytesPerSecond;
+    result.stallAfterBytes = self.stallAfterBytes;
+    result.stallDuration = self.stallDuration;
+    result.disconnectAfterBytes = self.disconnectAfterBytes;
+    result.acceptDelay = self.acceptDelay;
+
+    return result;
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"<CONDITIONS %@ latency %.0fms, %lu bytes/s, stall %lu+%.1fs, disconnect %lu, accept %.1fs>",
+            self.name, self.latency * 1000.0, (unsigned long)self.bytesPerSecond,
+            (unsigned long)self.stallAfterBytes, self.stallDuration,
+            (unsigned long)self.disconnectAfterBytes, self.acceptDelay];
+}
+
+@end
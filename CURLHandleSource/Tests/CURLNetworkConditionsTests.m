@@ -0,0 +1,141 @@
+//
+//  CURLNetworkConditionsTests.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLHandleBasedTest.h"
+#import "CURLConditioningProxy.h"
+#import "CURLMultiHandle.h"
+#import "CURLNetworkConditions.h"
+#import "CURLTransfer+TestingSupport.h"
+
+@interface CURLNetworkConditionsTests : CURLHandleBasedTest
+
+@end
+
+@implementation CURLNetworkConditionsTests
+
+- (NSURL*)URLForPayloadOfLength:(NSUInteger)length conditions:(CURLNetworkConditions*)conditions
+{
+    return [self URLForPayloadOfLength:length connectionConditions:^CURLNetworkConditions*(NSUInteger connectionIndex) {
+        return conditions;
+    }];
+}
+
+- (NSTimeInterval)timeDownloadOfURL:(NSURL*)url
+{
+    self.buffer = nil;
+    self.error = nil;
+
+    NSDate* started = [NSDate date];
+    NSURLRequest* request = [NSURLRequest requestWithURL:url];
+    CURLTransfer* transfer = [[CURLTransfer alloc] initWithRequest:request credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue] multi:[CURLMultiHandle sharedInstance]];
+    [self runUntilPaused];
+    [transfer release];
+
+    return -[started timeIntervalSinceNow];
+}
+
+#pragma mark - Tests
+
+- (void)testPassThrough
+{
+    NSURL* url = [self URLForPayloadOfLength:10000 conditions:[CURLNetworkConditions conditions]];
+    [self timeDownloadOfURL:url];
+
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEquals([self.buffer length], (NSUInteger)10000, @"wrong amount of data");
+}
+
+- (void)testLatency
+{
+    CURLNetworkConditions* conditions = [CURLNetworkConditions conditions];
+    conditions.latency = 0.2;
+
+    NSURL* url = [self URLForPayloadOfLength:1000 conditions:conditions];
+    NSTimeInterval elapsed = [self timeDownloadOfURL:url];
+
+    // the request goes up and the response comes down, so there should be at least one round trip
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertTrue(elapsed >= 0.4, @"transfer took %.3fs, expected at least 0.4s", elapsed);
+}
+
+- (void)testBandwidthCap
+{
+    CURLNetworkConditions* conditions = [CURLNetworkConditions conditions];
+    conditions.bytesPerSecond = 128 * 1024;
+
+    NSURL* url = [self URLForPayloadOfLength:64 * 1024 conditions:conditions];
+    NSTimeInterval elapsed = [self timeDownloadOfURL:url];
+
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEquals([self.buffer length], (NSUInteger)64 * 1024, @"wrong amount of data");
+    STAssertTrue(elapsed >= 0.5, @"transfer took %.3fs, expected at least 0.5s", elapsed);
+}
+
+- (void)testStall
+{
+    CURLNetworkConditions* conditions = [CURLNetworkConditions conditions];
+    conditions.stallAfterBytes = 1000;
+    conditions.stallDuration = 0.5;
+
+    NSURL* url = [self URLForPayloadOfLength:10000 conditions:conditions];
+    NSTimeInterval elapsed = [self timeDownloadOfURL:url];
+
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEquals([self.buffer length], (NSUInteger)10000, @"wrong amount of data");
+    STAssertTrue(elapsed >= 0.5, @"transfer took %.3fs, expected at least 0.5s", elapsed);
+}
+
+- (void)testDisconnectMidBody
+{
+    CURLNetworkConditions* conditions = [CURLNetworkConditions conditions];
+    conditions.disconnectAfterBytes = 5000;
+
+    NSURL* url = [self URLForPayloadOfLength:100000 conditions:conditions];
+    [self timeDownloadOfURL:url];
+
+    STAssertNotNil(self.error, @"expected an error");
+    STAssertTrue([self.buffer length] < 100000, @"shouldn't have got all the data");
+}
+
+- (void)testScriptedConnections
+{
+    NSURL* url = [self URLForPayloadOfLength:10000 conditions:[CURLNetworkConditions conditions]];
+
+    // drop the first connection, then let the next one through
+    self.proxy.script = ^CURLNetworkConditions*(NSUInteger index) {
+        CURLNetworkConditions* result = nil;
+        if (index == 0)
+        {
+            result = [CURLNetworkConditions conditions];
+            result.disconnectAfterBytes = 100;
+        }
+        return result;
+    };
+
+    [self timeDownloadOfURL:url];
+    STAssertNotNil(self.error, @"expected the first connection to fail");
+
+    [self timeDownloadOfURL:url];
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEquals([self.buffer length], (NSUInteger)10000, @"wrong amount of data");
+    STAssertEquals(self.proxy.connectionCount, (NSUInteger)2, @"expected two connections");
+}
+
+- (void)testSlowAccept
+{
+    CURLNetworkConditions* conditions = [CURLNetworkConditions conditions];
+    conditions.acceptDelay = 0.5;
+
+    NSURL* url = [self URLForPayloadOfLength:1000 conditions:conditions];
+    NSTimeInterval elapsed = [self timeDownloadOfURL:url];
+
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertTrue(elapsed >= 0.5, @"transfer took %.3fs, expected at least 0.5s", elapsed);
+}
+
+@end
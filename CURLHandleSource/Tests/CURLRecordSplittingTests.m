@@ -0,0 +1,177 @@
+//
+//  CURLRecordSplittingTests.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLHandleBasedTest.h"
+#import "CURLRecordSplitter.h"
+#import "CURLRequest.h"
+#import "CURLStandInServer.h"
+
+@interface CURLRecordSplittingTests : CURLHandleBasedTest
+
+@property (strong, nonatomic) NSMutableArray* records;
+@property (assign, nonatomic) NSUInteger batchCount;
+
+@end
+
+@implementation CURLRecordSplittingTests
+
+@synthesize records = _records;
+@synthesize batchCount = _batchCount;
+
+- (void)dealloc
+{
+    [_records release];
+
+    [super dealloc];
+}
+
+- (NSArray*)lines
+{
+    NSMutableArray* lines = [NSMutableArray array];
+    for (NSUInteger index = 0; index < 20000; ++index)
+    {
+        // lengths vary, so that records land all over the pieces of the body
+        NSString* padding = [@"" stringByPaddingToLength:(index * 13) % 200 withString:@"x" startingAtIndex:0];
+        [lines addObject:[NSString stringWithFormat:@"{\"index\":%lu,\"padding\":\"%@\"}", (unsigned long)index, padding]];
+    }
+
+    return lines;
+}
+
+// Splits the data in pieces of the given size, and collects the records as strings
+- (NSArray*)recordsBySplittingData:(NSData*)data delimiter:(uint8_t)delimiter pieceSize:(NSUInteger)size
+{
+    CURLRecordSplitter* splitter = [[CURLRecordSplitter alloc] initWithDelimiter:delimiter];
+    NSMutableArray* records = [NSMutableArray array];
+    void (^collect)(CURLRecordBatch*) = ^(CURLRecordBatch* batch) {
+        [batch enumerateRecordsUsingBlock:^(const void *bytes, NSUInteger length, BOOL *stop) {
+            [records addObject:[[[NSString alloc] initWithBytes:bytes length:length encoding:NSUTF8StringEncoding] autorelease]];
+        }];
+    };
+
+    for (NSUInteger offset = 0; offset < [data length]; offset += size)
+    {
+        CURLRecordBatch* batch = [splitter batchBySplittingData:[data subdataWithRange:NSMakeRange(offset, MIN(size, [data length] - offset))]];
+        if (batch) collect(batch);
+    }
+
+    CURLRecordBatch* last = [splitter finish];
+    if (last) collect(last);
+
+    [splitter release];
+    return records;
+}
+
+- (CURLTransfer*)downloadLines:(NSArray*)lines contentEncoding:(NSString*)encoding
+{
+    NSData* payload = [[[lines componentsJoinedByString:@"\n"] stringByAppendingString:@"\n"] dataUsingEncoding:NSUTF8StringEncoding];
+    self.standInServer = [CURLStandInServer HTTPServerWithPayload:payload contentEncoding:encoding];
+    [self.standInServer start];
+
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[self.standInServer URLForPath:@"/feed.ndjson"]];
+    [request curl_setRecordDelimiter:'\n'];
+    if (encoding)
+    {
+        [request setValue:@"" forHTTPHeaderField:@"Accept-Encoding"];
+        [request curl_setDecodesContentInBackground:YES];
+    }
+
+    self.buffer = nil;
+    self.error = nil;
+    self.records = [NSMutableArray array];
+    self.batchCount = 0;
+
+    CURLTransfer* transfer = [[CURLTransfer alloc] initWithRequest:request credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue]];
+    [self runUntilPaused];
+    return [transfer autorelease];
+}
+
+#pragma mark - Delegate
+
+- (void)transfer:(CURLTransfer *)transfer didReceiveRecords:(CURLRecordBatch *)records
+{
+    self.batchCount += 1;
+    for (NSUInteger index = 0; index < [records count]; ++index)
+    {
+        NSData* record = [records recordAtIndex:index];
+        [self.records addObject:[[[NSString alloc] initWithData:record encoding:NSUTF8StringEncoding] autorelease]];
+    }
+}
+
+#pragma mark - Tests
+
+- (void)testOption
+{
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:@"http://example.com/"]];
+    STAssertEquals([request curl_recordDelimiter], (NSInteger)-1, @"the body shouldn't be split by default");
+
+    [request curl_setRecordDelimiter:'\n'];
+    STAssertEquals([request curl_recordDelimiter], (NSInteger)'\n', @"wrong delimiter");
+}
+
+- (void)testPieceSizes
+{
+    NSData* data = [@"one\ntwo\r\n\nthree,four\nfive" dataUsingEncoding:NSUTF8StringEncoding];
+    NSArray* expected = @[ @"one", @"two", @"", @"three,four", @"five" ];
+
+    // every way of cutting it up, including records spanning several pieces and delimiters at either end of one
+    for (NSUInteger size = 1; size <= [data length]; ++size)
+    {
+        STAssertEqualObjects([self recordsBySplittingData:data delimiter:'\n' pieceSize:size], expected, @"wrong records in pieces of %lu", (unsigned long)size);
+    }
+}
+
+- (void)testOtherDelimiters
+{
+    NSData* data = [@"a\r,b,,c\n," dataUsingEncoding:NSUTF8StringEncoding];
+    NSArray* expected = @[ @"a\r", @"b", @"", @"c\n" ];
+    STAssertEqualObjects([self recordsBySplittingData:data delimiter:',' pieceSize:3], expected, @"only a newline delimiter should take a carriage return with it");
+}
+
+- (void)testRecordsShareBuffers
+{
+    CURLRecordSplitter* splitter = [[CURLRecordSplitter alloc] initWithDelimiter:'\n'];
+    NSData* data = [@"a\nbb\nccc" dataUsingEncoding:NSUTF8StringEncoding];
+
+    CURLRecordBatch* batch = [splitter batchBySplittingData:data];
+    STAssertEquals([batch count], (NSUInteger)2, @"wrong number of records");
+
+    NSUInteger length;
+    const uint8_t* bytes = [batch bytesOfRecordAtIndex:1 length:&length];
+    STAssertEquals(length, (NSUInteger)2, @"wrong length");
+    STAssertTrue(bytes == (const uint8_t*)[data bytes] + 2, @"a record within a piece shouldn't have been copied");
+
+    STAssertNil([splitter batchBySplittingData:[@"cc" dataUsingEncoding:NSUTF8StringEncoding]], @"a piece that doesn't finish a record shouldn't make a batch");
+    batch = [splitter batchBySplittingData:[@"c\n" dataUsingEncoding:NSUTF8StringEncoding]];
+    STAssertEqualObjects([batch recordAtIndex:0], [@"ccccc" dataUsingEncoding:NSUTF8StringEncoding], @"the spanning record should have been put back together");
+    STAssertNil([splitter finish], @"there should be nothing left");
+
+    [splitter release];
+}
+
+- (void)testDownload
+{
+    NSArray* lines = [self lines];
+    [self downloadLines:lines contentEncoding:nil];
+
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEqualObjects(self.records, lines, @"every line should have arrived as a record, in order");
+    STAssertTrue(self.batchCount > 1, @"the records should have come in batches as the body arrived");
+    STAssertEquals([self.buffer length], (NSUInteger)0, @"the body shouldn't have been passed on in pieces as well");
+}
+
+- (void)testDecodedDownload
+{
+    NSArray* lines = [self lines];
+    [self downloadLines:lines contentEncoding:@"gzip"];
+
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEqualObjects(self.records, lines, @"every line should have arrived as a record, in order");
+}
+
+@end
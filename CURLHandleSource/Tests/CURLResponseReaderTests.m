@@ -0,0 +1,113 @@
+//
+//  CURLResponseReaderTests.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLHandleBasedTest.h"
+#import "CURLResponseReader.h"
+#import "CURLStandInServer.h"
+
+@interface CURLResponseReaderTests : CURLHandleBasedTest
+
+@end
+
+@implementation CURLResponseReaderTests
+
+- (NSData*)payload
+{
+    NSMutableData* payload = [NSMutableData dataWithLength:2000000];
+    uint8_t* bytes = [payload mutableBytes];
+    uint32_t seed = 1;
+    for (NSUInteger index = 0; index < [payload length]; ++index)
+    {
+        seed = seed * 1103515245 + 12345;
+        bytes[index] = (uint8_t)(seed >> 16);
+    }
+
+    return payload;
+}
+
+- (CURLResponseReader*)readerForPayload:(NSData*)payload bufferSize:(NSUInteger)size
+{
+    self.standInServer = [CURLStandInServer HTTPServerWithPayload:payload];
+    [self.standInServer start];
+
+    NSURLRequest* request = [NSURLRequest requestWithURL:[self.standInServer URLForPath:@"/payload.bin"]];
+    return [[[CURLResponseReader alloc] initWithRequest:request credential:nil bufferSize:size] autorelease];
+}
+
+#pragma mark - Tests
+
+- (void)testSlowReader
+{
+    NSData* payload = [self payload];
+    CURLResponseReader* reader = [self readerForPayload:payload bufferSize:64 * 1024];
+
+    NSHTTPURLResponse* response = (NSHTTPURLResponse*)[reader waitForResponse];
+    STAssertEquals([response statusCode], (NSInteger)200, @"wrong status");
+
+    // dawdling at first fills the buffer, so the transfer has to pause and carry on again
+    NSMutableData* body = [NSMutableData data];
+    uint8_t buffer[4096];
+    NSInteger length;
+    NSUInteger reads = 0;
+    while ((length = [reader read:buffer maxLength:sizeof(buffer)]) > 0)
+    {
+        [body appendBytes:buffer length:length];
+        if (++reads < 50) usleep(2000);
+    }
+
+    STAssertEquals(length, (NSInteger)0, @"reading failed with %@", reader.error);
+    STAssertNil(reader.error, @"got error %@", reader.error);
+    STAssertEqualObjects(body, payload, @"the whole body should have been read, in order");
+    STAssertEquals(reader.transfer.state, CURLTransferStateCompleted, @"the transfer should be done once the body has all been read");
+}
+
+- (void)testBufferSize
+{
+    CURLResponseReader* reader = [self readerForPayload:[@"small" dataUsingEncoding:NSUTF8StringEncoding] bufferSize:1];
+    STAssertEquals(reader.bufferSize, (NSUInteger)CURL_MAX_WRITE_SIZE, @"the buffer should hold at least one piece of body");
+
+    uint8_t buffer[16];
+    STAssertEquals([reader read:buffer maxLength:sizeof(buffer)], (NSInteger)5, @"the body should have been read");
+    STAssertEquals([reader read:buffer maxLength:sizeof(buffer)], (NSInteger)0, @"that should be the end of it");
+}
+
+- (void)testClose
+{
+    CURLResponseReader* reader = [self readerForPayload:[self payload] bufferSize:64 * 1024];
+
+    uint8_t buffer[4096];
+    STAssertTrue([reader read:buffer maxLength:sizeof(buffer)] > 0, @"some of the body should have been read");
+    [reader close];
+    STAssertEquals([reader read:buffer maxLength:sizeof(buffer)], (NSInteger)0, @"reading should stop once closed");
+
+    // the paused transfer should have been cancelled, rather than left waiting for room
+    NSDate* limit = [NSDate dateWithTimeIntervalSinceNow:5.0];
+    while (reader.transfer.state != CURLTransferStateCompleted && [limit timeIntervalSinceNow] > 0)
+    {
+        [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.05]];
+    }
+
+    STAssertEquals(reader.transfer.state, CURLTransferStateCompleted, @"the transfer should have finished");
+    STAssertEquals([reader.error code], (NSInteger)NSURLErrorCancelled, @"the transfer should have been cancelled");
+}
+
+- (void)testFailure
+{
+    NSURLRequest* request = [NSURLRequest requestWithURL:[NSURL URLWithString:@"http://127.0.0.1:1/nothing"]];
+    CURLResponseReader* reader = [[CURLResponseReader alloc] initWithRequest:request credential:nil bufferSize:0];
+
+    STAssertNil([reader waitForResponse], @"there shouldn't be a response");
+
+    uint8_t buffer[16];
+    STAssertEquals([reader read:buffer maxLength:sizeof(buffer)], (NSInteger)-1, @"reading should fail");
+    STAssertNotNil(reader.error, @"there should be an error");
+
+    [reader release];
+}
+
+@end
@@ -0,0 +1,190 @@
+//
+//  CURLResumeTests.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLHandleBasedTest.h"
+#import "CURLNetworkConditions.h"
+#import "CURLConditioningProxy.h"
+#import "CURLReplayServer.h"
+#import "CURLRequest.h"
+#import "CURLRetryPolicy.h"
+#import "CURLStandInServer.h"
+#import "CURLTransferRecorder.h"
+
+static NSString* const kResumeURL = @"http://example.com/resume.bin";
+
+@interface CURLResumeTests : CURLHandleBasedTest
+
+@property (strong, nonatomic) CURLReplayServer* server;
+
+@end
+
+@implementation CURLResumeTests
+
+@synthesize server = _server;
+
+- (void)dealloc
+{
+    [_server release];
+
+    [super dealloc];
+}
+
+- (void)cleanup
+{
+    [self.server stop];
+    self.server = nil;
+
+    [super cleanup];
+}
+
+- (NSData*)payload
+{
+    NSMutableData* payload = [NSMutableData dataWithLength:10000];
+    uint8_t* bytes = [payload mutableBytes];
+    for (NSUInteger index = 0; index < [payload length]; ++index)
+    {
+        bytes[index] = (uint8_t)(index % 251);
+    }
+
+    return payload;
+}
+
+// Each response is a status line and headers (without the Content-Length, which the replay server adds), then the body
+- (NSURL*)URLReplayingResponses:(NSArray*)responses
+{
+    NSURL* url = [NSURL URLWithString:kResumeURL];
+    NSString* name = [NSString stringWithFormat:@"CURLResumeTests-%@.curlrec", [[NSProcessInfo processInfo] globallyUniqueString]];
+    NSURL* logURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:name]];
+    CURLTransferRecorder* recorder = [CURLTransferRecorder recorderWithURL:logURL recordsBodies:YES error:NULL];
+
+    for (NSArray* response in responses)
+    {
+        NSString* headers = [response objectAtIndex:0];
+        NSData* body = [response objectAtIndex:1];
+        NSInteger status = [[[headers componentsSeparatedByString:@" "] objectAtIndex:1] integerValue];
+
+        CURLTransferRecord* record = [recorder recordForRequest:[NSURLRequest requestWithURL:url]];
+        [record recordReceivedBytes:[headers UTF8String] length:strlen([headers UTF8String]) isHeader:YES];
+        [record recordResponseWithStatusCode:status headers:headers];
+        [record recordReceivedBytes:[body bytes] length:[body length] isHeader:NO];
+        [record recordResultCode:CURLE_OK];
+        [record finishWithError:nil];
+    }
+    [recorder close];
+
+    NSArray* records = [CURLTransferRecorder recordsWithContentsOfURL:logURL error:NULL];
+    [[NSFileManager defaultManager] removeItemAtURL:logURL error:NULL];
+
+    self.server = [[[CURLReplayServer alloc] initWithRecords:records] autorelease];
+    STAssertTrue([self.server start], @"server didn't start");
+
+    return [self URLByConditioningURL:[self.server URLByRoutingURL:url] withConditions:[CURLNetworkConditions conditions]];
+}
+
+- (void)dropFirstConnectionAfterBytes:(NSUInteger)count
+{
+    self.proxy.script = ^CURLNetworkConditions*(NSUInteger connectionIndex) {
+        CURLNetworkConditions* conditions = [CURLNetworkConditions conditions];
+        if (connectionIndex == 0)
+        {
+            conditions.disconnectAfterBytes = count;
+        }
+        return conditions;
+    };
+}
+
+- (void)downloadURL:(NSURL*)url resuming:(BOOL)resuming
+{
+    self.buffer = nil;
+    self.error = nil;
+
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:url];
+    if (self.server) [request setValue:[CURLReplayServer hostHeaderForURL:[NSURL URLWithString:kResumeURL]] forHTTPHeaderField:@"Host"];
+    CURLRetryPolicy* policy = [CURLRetryPolicy policy];
+    policy.initialDelay = 0.1;
+    [request curl_setRetryPolicy:policy];
+    [request curl_setResumesInterruptedTransfers:resuming];
+
+    CURLTransfer* transfer = [[CURLTransfer alloc] initWithRequest:request credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue]];
+    [self runUntilPaused];
+    [transfer release];
+}
+
+#pragma mark - Tests
+
+- (void)testOption
+{
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:kResumeURL]];
+    STAssertFalse([request curl_resumesInterruptedTransfers], @"resuming should be off by default");
+
+    [request curl_setResumesInterruptedTransfers:YES];
+    STAssertTrue([request curl_resumesInterruptedTransfers], @"resuming should be on");
+    STAssertTrue([[[request copy] autorelease] curl_resumesInterruptedTransfers], @"copies should resume too");
+}
+
+- (void)testResumesFromWhereItWasCutOff
+{
+    NSData* payload = [self payload];
+    NSUInteger cut = 4000;
+    NSString* head = @"HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nETag: \"v1\"\r\n\r\n";
+    NSString* partialHead = [NSString stringWithFormat:@"HTTP/1.1 206 Partial Content\r\nContent-Type: application/octet-stream\r\nETag: \"v1\"\r\nContent-Range: bytes %lu-%lu/%lu\r\n\r\n",
+                             (unsigned long)cut, (unsigned long)[payload length] - 1, (unsigned long)[payload length]];
+    NSURL* url = [self URLReplayingResponses:@[ @[ head, payload ], @[ partialHead, [payload subdataWithRange:NSMakeRange(cut, [payload length] - cut)] ] ]];
+
+    // the replay server adds the length to the headers as it sends them
+    NSString* sentHead = [NSString stringWithFormat:@"HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nETag: \"v1\"\r\nContent-Length: %lu\r\n\r\n", (unsigned long)[payload length]];
+    [self dropFirstConnectionAfterBytes:[sentHead length] + cut];
+
+    [self downloadURL:url resuming:YES];
+
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEqualObjects(self.buffer, payload, @"the pieces should make up the whole body");
+    STAssertEquals([(NSHTTPURLResponse*)self.response statusCode], (NSInteger)200, @"only the first response should be reported");
+    STAssertEquals(self.server.servedCount, (NSUInteger)2, @"the rest should have been asked for");
+}
+
+- (void)testChangedEntityFails
+{
+    NSData* payload = [self payload];
+    NSMutableData* changed = [NSMutableData dataWithLength:[payload length]];
+    memset([changed mutableBytes], 'x', [changed length]);
+
+    // a server ignoring If-Range sends the whole of the new version, which mustn't be tacked on to the old one
+    NSURL* url = [self URLReplayingResponses:@[ @[ @"HTTP/1.1 200 OK\r\nETag: \"v1\"\r\n\r\n", payload ],
+                                               @[ @"HTTP/1.1 200 OK\r\nETag: \"v2\"\r\n\r\n", changed ] ]];
+    [self dropFirstConnectionAfterBytes:3000];
+
+    [self downloadURL:url resuming:YES];
+
+    STAssertNotNil(self.error, @"the download should fail");
+    STAssertEquals([self.error code], (NSInteger)CURLE_RANGE_ERROR, @"wrong error %@", self.error);
+    STAssertTrue([self.buffer length] < [payload length], @"nothing should have been added");
+    STAssertEqualObjects(self.buffer, [payload subdataWithRange:NSMakeRange(0, [self.buffer length])], @"only the first version should have been delivered");
+    STAssertEquals(self.server.servedCount, (NSUInteger)2, @"the resume should have been tried");
+}
+
+- (void)testWithoutValidatorFails
+{
+    // the stand-in server sends no ETag or Last-Modified, so there's no way to be sure of getting the same file
+    NSData* payload = [self payload];
+    CURLStandInServer* standIn = [CURLStandInServer HTTPServerWithPayload:payload];
+    [standIn start];
+
+    NSURL* url = [self URLByConditioningURL:[standIn URLForPath:@"/payload.bin"] withConditions:[CURLNetworkConditions conditions]];
+    [self dropFirstConnectionAfterBytes:3000];
+
+    [self downloadURL:url resuming:YES];
+
+    STAssertNotNil(self.error, @"the download should fail");
+    STAssertTrue([self.buffer length] < [payload length], @"the body shouldn't have been sent again");
+    STAssertEquals(self.proxy.connectionCount, (NSUInteger)1, @"there should have been no retry");
+
+    [standIn stop];
+}
+
+@end
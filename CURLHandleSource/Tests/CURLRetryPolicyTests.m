@@ -0,0 +1,133 @@
+//
+//  CURLRetryPolicyTests.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLHandleBasedTest.h"
+#import "CURLConditioningProxy.h"
+#import "CURLMultiHandle.h"
+#import "CURLNetworkConditions.h"
+#import "CURLRequest.h"
+#import "CURLRetryPolicy.h"
+
+@interface CURLRetryPolicyTests : CURLHandleBasedTest
+
+@end
+
+@implementation CURLRetryPolicyTests
+
+- (NSURL*)URLDroppingConnections:(NSUInteger)dropped
+{
+    // the dropped connections go down part way through the headers, before anything reaches the delegate
+    return [self URLForPayloadOfLength:10000 connectionConditions:^CURLNetworkConditions*(NSUInteger connectionIndex) {
+        CURLNetworkConditions* conditions = [CURLNetworkConditions conditions];
+        if (connectionIndex < dropped)
+        {
+            conditions.disconnectAfterBytes = 10;
+        }
+        return conditions;
+    }];
+}
+
+- (void)downloadURL:(NSURL*)url policy:(CURLRetryPolicy*)policy
+{
+    self.buffer = nil;
+    self.error = nil;
+
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:url];
+    [request curl_setRetryPolicy:policy];
+
+    CURLTransfer* transfer = [[CURLTransfer alloc] initWithRequest:request credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue]];
+    [self runUntilPaused];
+    [transfer release];
+}
+
+#pragma mark - Tests
+
+- (void)testClassification
+{
+    CURLRetryPolicy* policy = [CURLRetryPolicy policy];
+
+    STAssertTrue([policy shouldRetryCode:CURLE_COULDNT_CONNECT statusCode:0], @"connection failures should be retried");
+    STAssertTrue([policy shouldRetryCode:CURLE_OPERATION_TIMEDOUT statusCode:0], @"timeouts should be retried");
+    STAssertFalse([policy shouldRetryCode:CURLE_OK statusCode:200], @"success isn't retried");
+    STAssertFalse([policy shouldRetryCode:CURLE_LOGIN_DENIED statusCode:0], @"bad credentials aren't worth retrying");
+
+    STAssertTrue([policy shouldRetryCode:CURLE_HTTP_RETURNED_ERROR statusCode:503], @"503 should be retried");
+    STAssertTrue([policy shouldRetryCode:CURLE_HTTP_RETURNED_ERROR statusCode:429], @"429 should be retried");
+    STAssertFalse([policy shouldRetryCode:CURLE_HTTP_RETURNED_ERROR statusCode:404], @"404 isn't worth retrying");
+}
+
+- (void)testBackoff
+{
+    CURLRetryPolicy* policy = [CURLRetryPolicy policy];
+    policy.initialDelay = 0.1;
+    policy.maximumDelay = 0.3;
+    policy.jitter = 0.0;
+
+    STAssertEqualsWithAccuracy([policy delayBeforeAttempt:2], 0.1, 0.0001, @"first retry should wait the initial delay");
+    STAssertEqualsWithAccuracy([policy delayBeforeAttempt:3], 0.2, 0.0001, @"wait should double");
+    STAssertEqualsWithAccuracy([policy delayBeforeAttempt:4], 0.3, 0.0001, @"wait should be capped");
+
+    policy.jitter = 1.0;
+    for (NSUInteger index = 0; index < 100; ++index)
+    {
+        NSTimeInterval delay = [policy delayBeforeAttempt:3];
+        STAssertTrue(delay >= 0.0 && delay <= 0.2, @"jittered delay %.3f out of range", delay);
+    }
+}
+
+- (void)testAttemptsAndBudget
+{
+    CURLRetryPolicy* policy = [CURLRetryPolicy policy];
+    policy.maximumAttempts = 3;
+    policy.retryBudgetBurst = 2;
+    policy.retryBudgetRatio = 0.5;
+
+    STAssertTrue([policy retryDelayAfterAttempt:1 code:CURLE_COULDNT_CONNECT statusCode:0 host:@"example.com"] >= 0, @"should retry");
+    STAssertTrue([policy retryDelayAfterAttempt:3 code:CURLE_COULDNT_CONNECT statusCode:0 host:@"example.com"] < 0, @"out of attempts");
+
+    STAssertTrue([policy retryDelayAfterAttempt:1 code:CURLE_COULDNT_CONNECT statusCode:0 host:@"example.com"] >= 0, @"should retry");
+    STAssertTrue([policy retryDelayAfterAttempt:1 code:CURLE_COULDNT_CONNECT statusCode:0 host:@"example.com"] < 0, @"budget should be spent");
+    STAssertEquals(policy.exhaustedBudgetCount, (NSUInteger)1, @"wrong exhausted count");
+    STAssertTrue([policy retryDelayAfterAttempt:1 code:CURLE_COULDNT_CONNECT statusCode:0 host:@"other.com"] >= 0, @"other hosts have their own budget");
+
+    // two more requests earn another retry
+    [policy noteRequestToHost:@"example.com"];
+    [policy noteRequestToHost:@"example.com"];
+    STAssertTrue([policy retryDelayAfterAttempt:1 code:CURLE_COULDNT_CONNECT statusCode:0 host:@"example.com"] >= 0, @"budget should have refilled");
+    STAssertEquals(policy.retryCount, (NSUInteger)4, @"wrong retry count");
+}
+
+- (void)testRetryDroppedConnection
+{
+    NSURL* url = [self URLDroppingConnections:1];
+    CURLRetryPolicy* policy = [CURLRetryPolicy policy];
+    policy.initialDelay = 0.05;
+
+    [self downloadURL:url policy:policy];
+
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEqualObjects(self.buffer, self.standInPayload, @"wrong data");
+    STAssertEquals(policy.retryCount, (NSUInteger)1, @"should have retried once");
+    STAssertEquals(self.proxy.connectionCount, (NSUInteger)2, @"retry should have made a new connection");
+}
+
+- (void)testGiveUpAfterMaximumAttempts
+{
+    NSURL* url = [self URLDroppingConnections:NSUIntegerMax];
+    CURLRetryPolicy* policy = [CURLRetryPolicy policy];
+    policy.initialDelay = 0.05;
+    policy.maximumAttempts = 3;
+
+    [self downloadURL:url policy:policy];
+
+    STAssertNotNil(self.error, @"should have failed");
+    STAssertEquals(policy.retryCount, (NSUInteger)2, @"should have retried twice");
+    STAssertEquals(self.proxy.connectionCount, (NSUInteger)3, @"each attempt should have made a connection");
+}
+
+@end
@@ -0,0 +1,119 @@
+//
+//  CURLSegmentedDownloadTests.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLHandleBasedTest.h"
+#import "CURLMultiHandle.h"
+#import "CURLSegmentedDownload.h"
+#import "CURLStandInServer.h"
+
+@interface CURLSegmentedDownloadTests : CURLHandleBasedTest <CURLSegmentedDownloadDelegate>
+
+@property (strong, nonatomic) NSURL* destinationURL;
+
+@end
+
+@implementation CURLSegmentedDownloadTests
+
+- (void)dealloc
+{
+    [_destinationURL release];
+
+    [super dealloc];
+}
+
+- (void)setUp
+{
+    [super setUp];
+
+    NSString* name = [NSString stringWithFormat:@"CURLSegmentedDownloadTests-%@", [[NSProcessInfo processInfo] globallyUniqueString]];
+    self.destinationURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:name]];
+}
+
+- (void)cleanup
+{
+    if (self.destinationURL)
+    {
+        [[NSFileManager defaultManager] removeItemAtURL:self.destinationURL error:nil];
+        self.destinationURL = nil;
+    }
+
+    [super cleanup];
+}
+
+#pragma mark - CURLSegmentedDownloadDelegate
+
+- (void)segmentedDownload:(CURLSegmentedDownload *)download didWriteDataOfLength:(NSUInteger)length totalBytesWritten:(unsigned long long)totalBytesWritten
+{
+    self.expected = (NSUInteger)totalBytesWritten;
+}
+
+- (void)segmentedDownload:(CURLSegmentedDownload *)download didCompleteWithError:(NSError *)error
+{
+    self.error = error;
+    self.exitRunLoop = YES;
+}
+
+#pragma mark - Tests
+
+- (void)testSegmentOffsets
+{
+    NSArray* offsets = [CURLSegmentedDownload segmentOffsetsForLength:1000 count:4 minimumLength:100];
+    STAssertEqualObjects(offsets, (@[@0, @250, @500, @750]), @"wrong offsets");
+
+    offsets = [CURLSegmentedDownload segmentOffsetsForLength:250 count:4 minimumLength:100];
+    STAssertEqualObjects(offsets, (@[@0, @125]), @"segments shouldn't be smaller than the minimum");
+
+    offsets = [CURLSegmentedDownload segmentOffsetsForLength:50 count:4 minimumLength:100];
+    STAssertEqualObjects(offsets, (@[@0]), @"a small file should be one segment");
+
+    offsets = [CURLSegmentedDownload segmentOffsetsForLength:10 count:4 minimumLength:0];
+    STAssertEqualObjects(offsets, (@[@0, @3, @6, @9]), @"the last segment can be smaller");
+}
+
+- (void)testWithoutRangesDownloadsInOneGo
+{
+    // the stand-in server doesn't say it accepts ranges
+    NSMutableData* payload = [NSMutableData dataWithLength:300000];
+    for (NSUInteger index = 0; index < [payload length]; ++index)
+    {
+        ((uint8_t*)[payload mutableBytes])[index] = (uint8_t)(index * 7);
+    }
+    self.standInServer = [CURLStandInServer HTTPServerWithPayload:payload];
+    [self.standInServer start];
+
+    NSURLRequest* request = [NSURLRequest requestWithURL:[self.standInServer URLForPath:@"/payload.bin"]];
+    CURLSegmentedDownload* download = [[CURLSegmentedDownload alloc] initWithRequest:request credential:nil destinationURL:self.destinationURL length:0 segmentCount:4 delegate:self delegateQueue:[NSOperationQueue mainQueue] multi:[CURLMultiHandle sharedInstance]];
+    [self runUntilPaused];
+
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertFalse(download.isSegmented, @"shouldn't have used segments");
+    STAssertEquals(download.segmentCount, (NSUInteger)1, @"should have used one transfer");
+    STAssertEquals(download.bytesWritten, (unsigned long long)[payload length], @"wrong count");
+    STAssertEquals(self.expected, [payload length], @"progress should have been reported");
+    STAssertEqualObjects([NSData dataWithContentsOfURL:self.destinationURL], payload, @"wrong file contents");
+
+    [download release];
+}
+
+- (void)testCancel
+{
+    NSMutableData* payload = [NSMutableData dataWithLength:1000];
+    self.standInServer = [CURLStandInServer HTTPServerWithPayload:payload];
+    [self.standInServer start];
+
+    NSURLRequest* request = [NSURLRequest requestWithURL:[self.standInServer URLForPath:@"/payload.bin"]];
+    CURLSegmentedDownload* download = [[CURLSegmentedDownload alloc] initWithRequest:request credential:nil destinationURL:self.destinationURL length:[payload length] segmentCount:4 delegate:self delegateQueue:[NSOperationQueue mainQueue] multi:[CURLMultiHandle sharedInstance]];
+    [download cancel];
+    [self runUntilPaused];
+
+    STAssertEquals([self.error code], (NSInteger)NSURLErrorCancelled, @"should have been cancelled");
+
+    [download release];
+}
+
+@end
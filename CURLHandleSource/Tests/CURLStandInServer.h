@@ -0,0 +1,102 @@
+//
+//  CURLStandInServer.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class KMSServer;
+
+/**
+ An in-process loopback HTTP or FTP server, built on top of MockServer.
+
+ The unit tests and the benchmark tool use this so that they don't depend on the network
+ (or on raw.github.com being up). Every GET/RETR is answered with the same payload,
+ which makes it easy to measure transfers of a known size.
+
+ The server runs on MockServer's own queue, so the caller just needs to keep a run loop
+ going (which the tests and benchmarks do anyway while waiting for transfers to finish).
+ */
+
+@interface CURLStandInServer : NSObject
+{
+    KMSServer   *_server;
+    NSString    *_scheme;
+}
+
+/**
+ Make an HTTP/1.1 server which responds to any GET with the given payload.
+ HEAD requests get the same headers, but no body.
+
+ Connections are kept alive, so that connection reuse can be measured too.
+
+ @param payload The body to serve.
+ @return A new server, which hasn't been started yet.
+ */
+
++ (CURLStandInServer*)HTTPServerWithPayload:(NSData*)payload;
+
+/**
+ Make an HTTP/1.1 server which responds to any GET with the given payload, compressed.
+
+ @param payload The body to serve, before it's compressed.
+ @param encoding `gzip` or `deflate`, which is sent as the Content-Encoding; nil to send the payload as it is.
+ @return A new server, which hasn't been started yet.
+ */
+
++ (CURLStandInServer*)HTTPServerWithPayload:(NSData*)payload contentEncoding:(NSString*)encoding;
+
+/**
+ Compress some data the way an HTTP server would for a given Content-Encoding.
+
+ @param data The data to compress.
+ @param encoding `gzip` or `deflate`.
+ @return The compressed data.
+ */
+
++ (NSData*)data:(NSData*)data encodedWithContentEncoding:(NSString*)encoding;
+
+/**
+ Make an FTP server which serves the given payload for any RETR, and accepts any STOR.
+
+ The FTP conversation is driven by MockServer's stock `ftp.json` responses.
+
+ @param payload The file contents to serve.
+ @return A new server, which hasn't been started yet.
+ */
+
++ (CURLStandInServer*)FTPServerWithPayload:(NSData*)payload;
+
+/**
+ The location of one of MockServer's stock response files.
+
+ Looks in the bundle containing this class first (which is where the unit tests find them),
+ and falls back to the MockServer submodule in the source tree (which is how the command line
+ tools find them).
+
+ @param name The name of the response file, without the `.json` extension.
+ @return The URL of the file.
+ */
+
++ (NSURL*)URLForResponsesNamed:(NSString*)name;
+
+- (void)start;
+- (void)stop;
+
+/**
+ Returns a URL on the server for a given path.
+
+ @param path The path, which should start with a `/`.
+ @return A URL using the server's scheme, the loopback address, and its port.
+ */
+
+- (NSURL*)URLForPath:(NSString*)path;
+
+@property (readonly, strong, nonatomic) KMSServer* server;
+@property (readonly, copy, nonatomic) NSString* scheme;
+@property (readonly, nonatomic) NSUInteger port;
+
+@end
@@ -0,0 +1,154 @@
+//
+//  CURLStandInServer.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLStandInServer.h"
+
+#import "KMSRegExResponder.h"
+#import "KMSResponseCollection.h"
+#import "KMSServer.h"
+
+#include <zlib.h>
+
+@interface CURLStandInServer()
+
+- (id)initWithScheme:(NSString*)scheme responder:(KMSResponder*)responder payload:(NSData*)payload;
+
+@end
+
+@implementation CURLStandInServer
+
+@synthesize server = _server;
+@synthesize scheme = _scheme;
+
+#pragma mark - Object Lifecycle
+
++ (CURLStandInServer*)HTTPServerWithPayload:(NSData *)payload
+{
+    return [self HTTPServerWithPayload:payload contentEncoding:nil];
+}
+
++ (CURLStandInServer*)HTTPServerWithPayload:(NSData *)payload contentEncoding:(NSString *)encoding
+{
+    NSString* encodingHeader = @"";
+    if (encoding)
+    {
+        payload = [self data:payload encodedWithContentEncoding:encoding];
+        encodingHeader = [NSString stringWithFormat:@"Content-Encoding: %@\r\n", encoding];
+    }
+
+    NSString* header = [NSString stringWithFormat:@"HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\n%@Content-Length: %lu\r\n\r\n", encodingHeader, (unsigned long)[payload length]];
+
+    // MockServer sends strings as-is, and «data» sends the server's data property
+    NSArray* responses = @[
+                           @[@"^HEAD .* HTTP/1\\.1", header],
+                           @[@"^GET .* HTTP/1\\.1", header, @"«data»"],
+                           ];
+
+    KMSRegExResponder* responder = [KMSRegExResponder responderWithResponses:responses];
+    return [[[self alloc] initWithScheme:@"http" responder:responder payload:payload] autorelease];
+}
+
++ (CURLStandInServer*)FTPServerWithPayload:(NSData *)payload
+{
+    KMSResponseCollection* collection = [KMSResponseCollection collectionWithURL:[self URLForResponsesNamed:@"ftp"]];
+    KMSRegExResponder* responder = [collection responderWithName:@"default"];
+    NSAssert(responder != nil, @"couldn't load the stock FTP responses");
+
+    return [[[self alloc] initWithScheme:@"ftp" responder:responder payload:payload] autorelease];
+}
+
+- (id)initWithScheme:(NSString *)scheme responder:(KMSResponder *)responder payload:(NSData *)payload
+{
+    if ((self = [super init]) != nil)
+    {
+        _scheme = [scheme copy];
+        _server = [[KMSServer serverWithPort:0 responders:@[responder]] retain];
+        _server.data = payload;
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_server release];
+    [_scheme release];
+
+    [super dealloc];
+}
+
+#pragma mark - Responses
+
++ (NSData*)data:(NSData *)data encodedWithContentEncoding:(NSString *)encoding
+{
+    // 16 more than the window size gives a gzip wrapper rather than a zlib one
+    int windowBits = [encoding isEqualToString:@"gzip"] ? MAX_WBITS + 16 : MAX_WBITS;
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK) return nil;
+
+    NSMutableData* result = [NSMutableData dataWithLength:deflateBound(&stream, (uLong)[data length]) + 32];
+    stream.next_in = (Bytef*)[data bytes];
+    stream.avail_in = (uInt)[data length];
+    stream.next_out = [result mutableBytes];
+    stream.avail_out = (uInt)[result length];
+
+    int status = deflate(&stream, Z_FINISH);
+    [result setLength:stream.total_out];
+    deflateEnd(&stream);
+
+    return (status == Z_STREAM_END) ? result : nil;
+}
+
++ (NSURL*)URLForResponsesNamed:(NSString *)name
+{
+    NSURL* result = [[NSBundle bundleForClass:self] URLForResource:name withExtension:@"json"];
+    if (!result)
+    {
+        // command line tools don't have a bundle, so go looking in the source tree
+        NSURL* tests = [[NSURL fileURLWithPath:[NSString stringWithUTF8String:__FILE__]] URLByDeletingLastPathComponent];
+        result = [[[tests URLByAppendingPathComponent:@"MockServer/UnitTests"] URLByAppendingPathComponent:name] URLByAppendingPathExtension:@"json"];
+    }
+
+    return result;
+}
+
+#pragma mark - Control
+
+- (void)start
+{
+    [self.server start];
+}
+
+- (void)stop
+{
+    [self.server stop];
+}
+
+#pragma mark - Properties
+
+- (NSUInteger)port
+{
+    return self.server.port;
+}
+
+- (NSURL*)URLForPath:(NSString *)path
+{
+    // the stock FTP responses want a plain user and password, rather than curl's anonymous login
+    NSString* login = [self.scheme isEqualToString:@"ftp"] ? @"user:pass@" : @"";
+    NSString* string = [NSString stringWithFormat:@"%@://%@127.0.0.1:%lu%@", self.scheme, login, (unsigned long)self.port, path];
+    return [NSURL URLWithString:string];
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"<STAND-IN %p %@ port %lu>", self, self.scheme, (unsigned long)self.port];
+}
+
+@end
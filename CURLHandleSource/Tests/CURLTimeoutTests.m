@@ -0,0 +1,128 @@
+//
+//  CURLTimeoutTests.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLHandleBasedTest.h"
+#import "CURLConditioningProxy.h"
+#import "CURLMultiHandle.h"
+#import "CURLNetworkConditions.h"
+#import "CURLRequest.h"
+
+@interface CURLTimeoutTests : CURLHandleBasedTest
+
+@end
+
+@implementation CURLTimeoutTests
+
+- (NSURL*)URLWithConditions:(CURLNetworkConditions*)conditions
+{
+    return [self URLForPayloadOfLength:100000 connectionConditions:^CURLNetworkConditions*(NSUInteger connectionIndex) {
+        return conditions;
+    }];
+}
+
+- (NSTimeInterval)runRequest:(NSURLRequest*)request multi:(CURLMultiHandle*)multi
+{
+    self.buffer = nil;
+    self.error = nil;
+
+    NSDate* started = [NSDate date];
+    CURLTransfer* transfer = [[CURLTransfer alloc] initWithRequest:request credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue] multi:multi];
+    [self runUntilPaused];
+    [transfer release];
+
+    return -[started timeIntervalSinceNow];
+}
+
+- (void)checkTimedOut
+{
+    STAssertNotNil(self.error, @"should have failed");
+    STAssertEqualObjects([self.error domain], NSURLErrorDomain, @"wrong domain");
+    STAssertEquals([self.error code], (NSInteger)NSURLErrorTimedOut, @"should have timed out, got %@", self.error);
+}
+
+#pragma mark - Tests
+
+- (void)testStallUsesTimeoutInterval
+{
+    CURLNetworkConditions* conditions = [CURLNetworkConditions conditions];
+    conditions.stallAfterBytes = 1000;
+    conditions.stallDuration = 10.0;
+    NSURL* url = [self URLWithConditions:conditions];
+
+    NSURLRequest* request = [NSURLRequest requestWithURL:url cachePolicy:NSURLRequestUseProtocolCachePolicy timeoutInterval:1.0];
+    NSTimeInterval elapsed = [self runRequest:request multi:[CURLMultiHandle sharedInstance]];
+
+    [self checkTimedOut];
+    STAssertTrue(elapsed < 5.0, @"stall should have been noticed after about a second, took %.3fs", elapsed);
+}
+
+- (void)testMinimumThroughput
+{
+    CURLNetworkConditions* conditions = [CURLNetworkConditions conditions];
+    conditions.bytesPerSecond = 2000;
+    NSURL* url = [self URLWithConditions:conditions];
+
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:url];
+    [request curl_setStallTimeout:1.0 minimumBytesPerSecond:10000];
+    NSTimeInterval elapsed = [self runRequest:request multi:[CURLMultiHandle sharedInstance]];
+
+    [self checkTimedOut];
+    STAssertTrue(elapsed < 5.0, @"slow transfer should have been stopped after about a second, took %.3fs", elapsed);
+}
+
+- (void)testTotalTimeout
+{
+    CURLNetworkConditions* conditions = [CURLNetworkConditions conditions];
+    conditions.bytesPerSecond = 50000;
+    NSURL* url = [self URLWithConditions:conditions];
+
+    // data keeps flowing, so only the deadline can stop it
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:url];
+    [request curl_setTotalTimeout:0.5];
+    NSTimeInterval elapsed = [self runRequest:request multi:[CURLMultiHandle sharedInstance]];
+
+    [self checkTimedOut];
+    STAssertTrue(elapsed < 3.0, @"deadline should have stopped the transfer, took %.3fs", elapsed);
+}
+
+- (void)testMultiDefaults
+{
+    CURLNetworkConditions* conditions = [CURLNetworkConditions conditions];
+    conditions.bytesPerSecond = 50000;
+    NSURL* url = [self URLWithConditions:conditions];
+
+    CURLMultiHandle* multi = [[CURLMultiHandle alloc] initWithQueueNamed:@"com.karelia.curlhandle.tests.timeouts"];
+    multi.defaultTotalTimeout = 0.5;
+
+    [self runRequest:[NSURLRequest requestWithURL:url] multi:multi];
+    [self checkTimedOut];
+
+    // the request's own setting wins
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:url];
+    [request curl_setTotalTimeout:-1];
+    [self runRequest:request multi:multi];
+
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEqualObjects(self.buffer, self.standInPayload, @"wrong data");
+
+    [multi shutdown];
+    [multi release];
+}
+
+- (void)testNoTimeoutForHealthyTransfer
+{
+    NSURL* url = [self URLWithConditions:[CURLNetworkConditions conditions]];
+
+    NSURLRequest* request = [NSURLRequest requestWithURL:url cachePolicy:NSURLRequestUseProtocolCachePolicy timeoutInterval:1.0];
+    [self runRequest:request multi:[CURLMultiHandle sharedInstance]];
+
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEqualObjects(self.buffer, self.standInPayload, @"wrong data");
+}
+
+@end
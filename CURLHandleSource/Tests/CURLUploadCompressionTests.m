@@ -0,0 +1,294 @@
+//
+//  CURLUploadCompressionTests.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLHandleBasedTest.h"
+#import "CURLContentDecoder.h"
+#import "CURLContentEncoder.h"
+#import "CURLDigest.h"
+#import "CURLReplayServer.h"
+#import "CURLRequest.h"
+#import "CURLStandInServer.h"
+#import "CURLTransferRecorder.h"
+
+// A file stream whose reads hold on until it's opened up, as a slow source would
+@interface CURLGatedInputStream : NSInputStream
+{
+    NSInputStream           *_stream;
+    dispatch_semaphore_t    _gate;
+}
+
+- (id)initWithFileAtPath:(NSString*)path;
+- (void)openGate;
+
+@end
+
+@implementation CURLGatedInputStream
+
+- (id)initWithFileAtPath:(NSString*)path
+{
+    if (self = [super init])
+    {
+        _stream = [[NSInputStream alloc] initWithFileAtPath:path];
+        _gate = dispatch_semaphore_create(0);
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_stream release];
+    dispatch_release(_gate);
+
+    [super dealloc];
+}
+
+- (void)openGate
+{
+    dispatch_semaphore_signal(_gate);
+}
+
+- (NSInteger)read:(uint8_t *)buffer maxLength:(NSUInteger)length
+{
+    // once open, the gate stays open
+    dispatch_semaphore_wait(_gate, DISPATCH_TIME_FOREVER);
+    dispatch_semaphore_signal(_gate);
+
+    return [_stream read:buffer maxLength:length];
+}
+
+- (BOOL)getBuffer:(uint8_t **)buffer length:(NSUInteger *)length { return NO; }
+- (BOOL)hasBytesAvailable { return [_stream hasBytesAvailable]; }
+- (void)open { [_stream open]; }
+- (void)close { [_stream close]; }
+- (NSStreamStatus)streamStatus { return [_stream streamStatus]; }
+- (NSError *)streamError { return [_stream streamError]; }
+- (id)propertyForKey:(NSString *)key { return [_stream propertyForKey:key]; }
+- (BOOL)setProperty:(id)property forKey:(NSString *)key { return [_stream setProperty:property forKey:key]; }
+
+@end
+
+
+@interface CURLUploadCompressionTests : CURLHandleBasedTest
+
+@end
+
+@implementation CURLUploadCompressionTests
+
+- (NSData*)payload
+{
+    // compressible, but not so much that the body goes in one piece
+    NSMutableData* payload = [NSMutableData dataWithLength:500000];
+    uint8_t* bytes = [payload mutableBytes];
+    uint32_t seed = 1;
+    for (NSUInteger index = 0; index < [payload length]; ++index)
+    {
+        seed = seed * 1103515245 + 12345;
+        bytes[index] = (uint8_t)('a' + (seed >> 16) % 16);
+    }
+
+    return payload;
+}
+
+- (NSArray*)recordsForUploadToURL:(NSURL*)url
+{
+    NSString* name = [NSString stringWithFormat:@"CURLUploadCompressionTests-%@.curlrec", [[NSProcessInfo processInfo] globallyUniqueString]];
+    NSURL* logURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:name]];
+    CURLTransferRecorder* recorder = [CURLTransferRecorder recorderWithURL:logURL recordsBodies:YES error:NULL];
+
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:url];
+    [request setHTTPMethod:@"PUT"];
+
+    NSString* headers = @"HTTP/1.1 201 Created\r\n\r\n";
+    CURLTransferRecord* record = [recorder recordForRequest:request];
+    [record recordReceivedBytes:[headers UTF8String] length:strlen([headers UTF8String]) isHeader:YES];
+    [record recordResponseWithStatusCode:201 headers:headers];
+    [record recordResultCode:CURLE_OK];
+    [record finishWithError:nil];
+    [recorder close];
+
+    NSArray* records = [CURLTransferRecorder recordsWithContentsOfURL:logURL error:NULL];
+    [[NSFileManager defaultManager] removeItemAtURL:logURL error:NULL];
+    return records;
+}
+
+- (CURLTransfer*)uploadRequest:(NSMutableURLRequest*)request
+{
+    NSURL* url = [NSURL URLWithString:@"http://example.com/upload.log"];
+    CURLReplayServer* server = [[CURLReplayServer alloc] initWithRecords:[self recordsForUploadToURL:url]];
+    server.speed = 0;
+    STAssertTrue([server start], @"server didn't start");
+
+    [request setURL:[server URLByRoutingURL:url]];
+    [request setValue:[CURLReplayServer hostHeaderForURL:url] forHTTPHeaderField:@"Host"];
+    [request setHTTPMethod:@"PUT"];
+    [request curl_setDigestAlgorithm:CURLDigestAlgorithmCRC32C];
+
+    CURLTransfer* transfer = [[CURLTransfer alloc] initWithRequest:request credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue]];
+    [self runUntilPaused];
+
+    STAssertEquals(server.servedCount, (NSUInteger)1, @"the upload should have reached the server");
+    [server stop];
+    [server release];
+
+    return [transfer autorelease];
+}
+
+// Reads the whole of an encoder's output, a little at a time, without ever waiting
+- (NSData*)readEncoder:(CURLContentEncoder*)encoder
+{
+    dispatch_semaphore_t ready = dispatch_semaphore_create(0);
+    encoder.readyHandler = ^{
+        dispatch_semaphore_signal(ready);
+    };
+
+    NSMutableData* output = [NSMutableData data];
+    uint8_t buffer[1000];
+    while (YES)
+    {
+        NSInteger length = [encoder read:buffer maxLength:sizeof(buffer) waitUntilReady:NO];
+        if (length == CURLContentEncoderNotReady)
+        {
+            dispatch_semaphore_wait(ready, DISPATCH_TIME_FOREVER);
+            continue;
+        }
+
+        STAssertTrue(length >= 0, @"reading failed");
+        if (length <= 0) break;
+
+        [output appendBytes:buffer length:length];
+    }
+
+    [encoder cancel];
+    dispatch_release(ready);
+    return output;
+}
+
+- (NSData*)decodeData:(NSData*)data contentEncoding:(NSString*)encoding
+{
+    NSMutableData* output = [NSMutableData data];
+    CURLContentDecoder* decoder = [[CURLContentDecoder alloc] initWithContentEncoding:encoding outputHandler:^(NSData *decoded) {
+        [output appendData:decoded];
+    }];
+
+    [decoder decodeData:data];
+
+    dispatch_semaphore_t finished = dispatch_semaphore_create(0);
+    [decoder finishWithCompletionHandler:^(NSString *failureReason) {
+        dispatch_semaphore_signal(finished);
+    }];
+    dispatch_semaphore_wait(finished, DISPATCH_TIME_FOREVER);
+    dispatch_release(finished);
+    [decoder release];
+
+    return output;
+}
+
+#pragma mark - Tests
+
+- (void)testOptions
+{
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:@"http://example.com/"]];
+    STAssertNil([request curl_uploadContentEncoding], @"uploads should be sent as they are by default");
+    STAssertEquals([request curl_uploadCompressionLevel], (NSInteger)-1, @"zlib's default level should be used by default");
+    STAssertEquals([request curl_minimumCompressedUploadLength], 0ULL, @"there should be no minimum by default");
+
+    [request curl_setUploadContentEncoding:@"gzip" level:9 minimumLength:1024];
+    STAssertEqualObjects([request curl_uploadContentEncoding], @"gzip", @"wrong encoding");
+    STAssertEquals([request curl_uploadCompressionLevel], (NSInteger)9, @"wrong level");
+    STAssertEquals([request curl_minimumCompressedUploadLength], 1024ULL, @"wrong minimum");
+
+    [request curl_setUploadContentEncoding:nil level:-1 minimumLength:0];
+    STAssertNil([request curl_uploadContentEncoding], @"compression should be off again");
+}
+
+- (void)testEncoderRoundTrip
+{
+    NSData* payload = [self payload];
+
+    for (NSString* encoding in @[ @"gzip", @"deflate" ])
+    {
+        // a small buffer has the encoder stop and start again many times over
+        NSInputStream* stream = [NSInputStream inputStreamWithData:payload];
+        [stream open];
+        CURLContentEncoder* encoder = [[CURLContentEncoder alloc] initWithContentEncoding:encoding level:1 inputStream:stream bufferLimit:4096];
+        NSData* encoded = [self readEncoder:encoder];
+        [encoder release];
+        [stream close];
+
+        STAssertTrue([encoded length] < [payload length], @"%@ should have made the body smaller", encoding);
+        STAssertEqualObjects([self decodeData:encoded contentEncoding:encoding], payload, @"%@ should decode to the original body", encoding);
+    }
+}
+
+- (void)testReplacingEncoderDoesntWait
+{
+    NSData* payload = [self payload];
+    NSString* path = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"CURLUploadCompressionTests-%@", [[NSProcessInfo processInfo] globallyUniqueString]]];
+    STAssertTrue([payload writeToFile:path atomically:NO], @"couldn't write the body");
+
+    CURLGatedInputStream* stream = [[CURLGatedInputStream alloc] initWithFileAtPath:path];
+    [stream open];
+
+    // the first encoder is stuck reading, as it might be when the transfer is retried
+    CURLContentEncoder* first = [[CURLContentEncoder alloc] initWithContentEncoding:@"gzip" level:1 inputStream:stream bufferLimit:4096];
+    uint8_t buffer[16];
+    STAssertEquals([first read:buffer maxLength:sizeof(buffer) waitUntilReady:NO], CURLContentEncoderNotReady, @"nothing should have been read yet");
+
+    // replacing it mustn't wait for that read, and the replacement mustn't read alongside it
+    NSDate* start = [NSDate date];
+    CURLContentEncoder* second = [[CURLContentEncoder alloc] initWithContentEncoding:@"gzip" level:1 inputStream:stream bufferLimit:4096 replacingEncoder:first];
+    [first release];
+    STAssertTrue(-[start timeIntervalSinceNow] < 1.0, @"replacing the encoder shouldn't have waited");
+    STAssertEquals([second read:buffer maxLength:sizeof(buffer) waitUntilReady:NO], CURLContentEncoderNotReady, @"the replacement should wait its turn");
+
+    // once the source moves, the replacement starts over from the beginning of it
+    [stream openGate];
+    NSData* encoded = [self readEncoder:second];
+    STAssertEqualObjects([self decodeData:encoded contentEncoding:@"gzip"], payload, @"the replacement should have compressed the whole body");
+
+    [second cancelAndCloseStream];
+    [second release];
+    [stream release];
+    [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+}
+
+- (void)testCompressedUpload
+{
+    NSData* payload = [self payload];
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:@"http://example.com/"]];
+    [request setHTTPBody:payload];
+    [request curl_setUploadContentEncoding:@"gzip" level:-1 minimumLength:1024];
+
+    CURLTransfer* transfer = [self uploadRequest:request];
+
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEquals([(NSHTTPURLResponse*)self.response statusCode], (NSInteger)201, @"wrong status");
+    STAssertTrue([self.transcript rangeOfString:@"Content-Encoding: gzip"].location != NSNotFound, @"the body should have been labelled as compressed");
+    STAssertTrue([self.transcript rangeOfString:@"Transfer-Encoding: chunked"].location != NSNotFound, @"the compressed body should have been sent chunked");
+
+    // zlib compresses the same however the body is split up, so what went out can be compared with compressing it all at once
+    NSData* expected = [CURLStandInServer data:payload encodedWithContentEncoding:@"gzip"];
+    STAssertEqualObjects(transfer.uploadDigest, [CURLDigest digestOfData:expected algorithm:CURLDigestAlgorithmCRC32C], @"the compressed body should have been sent");
+}
+
+- (void)testSmallBodyIsSentAsItIs
+{
+    NSData* payload = [@"too short to bother with" dataUsingEncoding:NSUTF8StringEncoding];
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:@"http://example.com/"]];
+    [request setHTTPBody:payload];
+    [request curl_setUploadContentEncoding:@"gzip" level:-1 minimumLength:1024];
+
+    CURLTransfer* transfer = [self uploadRequest:request];
+
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertTrue([self.transcript rangeOfString:@"Content-Encoding"].location == NSNotFound, @"the body shouldn't have been compressed");
+    STAssertEqualObjects(transfer.uploadDigest, [CURLDigest digestOfData:payload algorithm:CURLDigestAlgorithmCRC32C], @"the body should have been sent as it is");
+}
+
+@end
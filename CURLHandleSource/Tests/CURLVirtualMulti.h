@@ -0,0 +1,127 @@
+//
+//  CURLVirtualMulti.h
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLMultiHandle+TestingSupport.h"
+
+@class CURLTransfer;
+
+/**
+ What a simulated transfer does, in virtual milliseconds.
+
+ The transfer connects, waits for the first byte, then receives chunkCount chunks spaced
+ chunkInterval apart, and completes with result. A negative firstByteDelay means the
+ server never responds; with a timeout set, the transfer then fails with CURLE_OPERATION_TIMEDOUT.
+ */
+
+@interface CURLVirtualScript : NSObject
+{
+    long        _connectDelay;
+    long        _firstByteDelay;
+    NSUInteger  _chunkCount;
+    long        _chunkInterval;
+    long        _timeout;
+    CURLcode    _result;
+}
+
++ (CURLVirtualScript*)scriptWithConnectDelay:(long)connectDelay firstByteDelay:(long)firstByteDelay chunkCount:(NSUInteger)chunkCount chunkInterval:(long)chunkInterval;
+
+@property (assign, nonatomic) long connectDelay;
+@property (assign, nonatomic) long firstByteDelay;
+@property (assign, nonatomic) NSUInteger chunkCount;
+@property (assign, nonatomic) long chunkInterval;
+@property (assign, nonatomic) long timeout;
+@property (assign, nonatomic) CURLcode result;
+
+@end
+
+typedef CURLVirtualScript* (^CURLVirtualScriptProvider)(CURLTransfer* transfer);
+
+/**
+ A CURLMultiHandle which never touches the network or the wall clock.
+
+ It runs in socket action mode, but stands in for libcurl and GCD: transfers added to it are
+ driven through connect, first byte and body phases by a simulated engine, socket readiness is
+ delivered only for the sockets and directions the multi has asked to watch, and the multi's
+ timer runs against a virtual clock.
+
+ Thousands of transfers can be pushed through in milliseconds, and the number of wakeups
+ and events are counted exactly, so scheduler behaviour can be asserted deterministically.
+
+ Real CURLTransfers are used, so their completion and delegate paths are exercised too.
+ */
+
+@interface CURLVirtualMulti : CURLMultiHandle
+{
+    long                        _now;
+    long                        _timerDeadline;
+    NSUInteger                  _sequence;
+    CURLVirtualScript           *_defaultScript;
+    CURLVirtualScriptProvider   _scriptProvider;
+
+    NSMapTable                  *_statesByHandle;
+    NSMutableDictionary         *_statesBySocket;
+    NSMutableDictionary         *_registrations;
+    NSMutableDictionary         *_interest;
+    NSMutableArray              *_events;
+    NSMutableArray              *_completions;
+    curl_socket_t               _nextSocket;
+    CURLMsg                     _message;
+
+    NSUInteger                  _wakeups;
+    NSUInteger                  _timerFirings;
+    NSUInteger                  _timerUpdates;
+    NSUInteger                  _socketEvents;
+    NSUInteger                  _droppedEvents;
+    NSUInteger                  _transferEvents;
+    NSUInteger                  _maxTransferEvents;
+    NSUInteger                  _completed;
+    NSUInteger                  _maxWatchedSockets;
+}
+
+/**
+ The script used for transfers when there's no provider, or it returns nil.
+ */
+
+@property (strong, nonatomic) CURLVirtualScript* defaultScript;
+@property (copy, nonatomic) CURLVirtualScriptProvider scriptProvider;
+
+/**
+ Run the simulation, advancing the virtual clock from event to event, until nothing is left
+ to happen (or limit milliseconds of virtual time have passed).
+
+ Blocks until done. Must not be called on the multi's queue.
+
+ @param limit The most virtual time to simulate, in milliseconds.
+ */
+
+- (void)runUntilIdleOrTime:(long)limit;
+- (void)runUntilIdle;
+
+/** @name Measurements */
+
+@property (readonly, nonatomic) long now;
+
+/** Number of times the multi was woken up, by the timer or a socket. */
+@property (readonly, nonatomic) NSUInteger wakeups;
+@property (readonly, nonatomic) NSUInteger timerFirings;
+
+/** Number of times libcurl changed the timeout. */
+@property (readonly, nonatomic) NSUInteger timerUpdates;
+@property (readonly, nonatomic) NSUInteger socketEvents;
+
+/** Readiness that arrived for a socket the multi wasn't watching in that direction. */
+@property (readonly, nonatomic) NSUInteger droppedEvents;
+
+/** Socket events delivered to transfers, in total and for the busiest transfer. */
+@property (readonly, nonatomic) NSUInteger transferEvents;
+@property (readonly, nonatomic) NSUInteger maxTransferEvents;
+
+@property (readonly, nonatomic) NSUInteger completed;
+@property (readonly, nonatomic) NSUInteger maxWatchedSockets;
+
+@end
@@ -0,0 +1,460 @@
+//
+//  CURLVirtualMulti.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLVirtualMulti.h"
+
+#import "CURLSocketRegistration.h"
+
+static const NSUInteger kWatchRead = 1;
+static const NSUInteger kWatchWrite = 2;
+
+#pragma mark - Script
+
+@implementation CURLVirtualScript
+
+@synthesize connectDelay = _connectDelay;
+@synthesize firstByteDelay = _firstByteDelay;
+@synthesize chunkCount = _chunkCount;
+@synthesize chunkInterval = _chunkInterval;
+@synthesize timeout = _timeout;
+@synthesize result = _result;
+
++ (CURLVirtualScript*)scriptWithConnectDelay:(long)connectDelay firstByteDelay:(long)firstByteDelay chunkCount:(NSUInteger)chunkCount chunkInterval:(long)chunkInterval
+{
+    CURLVirtualScript* result = [[[self alloc] init] autorelease];
+    result.connectDelay = connectDelay;
+    result.firstByteDelay = firstByteDelay;
+    result.chunkCount = chunkCount;
+    result.chunkInterval = chunkInterval;
+    result.result = CURLE_OK;
+
+    return result;
+}
+
+@end
+
+#pragma mark - Simulation State
+
+typedef enum
+{
+    CURLVirtualPending,
+    CURLVirtualConnecting,
+    CURLVirtualWaiting,
+    CURLVirtualReceiving,
+    CURLVirtualDone,
+} CURLVirtualPhase;
+
+@interface CURLVirtualTransferState : NSObject
+{
+@public
+    CURL                *_easy;
+    CURLVirtualScript   *_script;
+    CURLVirtualPhase    _phase;
+    curl_socket_t       _socket;
+    NSUInteger          _chunksRemaining;
+    long                _deadline;
+    NSUInteger          _events;
+    CURLcode            _result;
+}
+@end
+
+@implementation CURLVirtualTransferState
+
+- (void)dealloc
+{
+    [_script release];
+
+    [super dealloc];
+}
+
+@end
+
+@interface CURLVirtualEvent : NSObject
+{
+@public
+    long            _time;
+    NSUInteger      _sequence;
+    curl_socket_t   _socket;
+    int             _action;
+}
+@end
+
+@implementation CURLVirtualEvent
+@end
+
+#pragma mark - Multi
+
+@implementation CURLVirtualMulti
+
+@synthesize defaultScript = _defaultScript;
+@synthesize scriptProvider = _scriptProvider;
+@synthesize now = _now;
+@synthesize wakeups = _wakeups;
+@synthesize timerFirings = _timerFirings;
+@synthesize timerUpdates = _timerUpdates;
+@synthesize socketEvents = _socketEvents;
+@synthesize droppedEvents = _droppedEvents;
+@synthesize transferEvents = _transferEvents;
+@synthesize maxTransferEvents = _maxTransferEvents;
+@synthesize completed = _completed;
+@synthesize maxWatchedSockets = _maxWatchedSockets;
+
+#pragma mark - Object Lifecycle
+
+- (id)init
+{
+    if ((self = [super initUsingSocketActions:YES]) != nil)
+    {
+        _timerDeadline = -1;
+        _nextSocket = 1000;
+        _defaultScript = [[CURLVirtualScript scriptWithConnectDelay:10 firstByteDelay:50 chunkCount:4 chunkInterval:5] retain];
+        _statesByHandle = [[NSMapTable mapTableWithKeyOptions:NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality valueOptions:NSPointerFunctionsStrongMemory] retain];
+        _statesBySocket = [[NSMutableDictionary alloc] init];
+        _registrations = [[NSMutableDictionary alloc] init];
+        _interest = [[NSMutableDictionary alloc] init];
+        _events = [[NSMutableArray alloc] init];
+        _completions = [[NSMutableArray alloc] init];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_defaultScript release];
+    [_scriptProvider release];
+    [_statesByHandle release];
+    [_statesBySocket release];
+    [_registrations release];
+    [_interest release];
+    [_events release];
+    [_completions release];
+
+    [super dealloc];
+}
+
+#pragma mark - Running
+
+- (void)runUntilIdle
+{
+    [self runUntilIdleOrTime:LONG_MAX];
+}
+
+- (void)runUntilIdleOrTime:(long)limit
+{
+    // anything already queued (eg transfers being added) happens first
+    dispatch_sync(self.queue, ^{
+        while (YES)
+        {
+            CURLVirtualEvent* event = [_events count] ? [_events objectAtIndex:0] : nil;
+            BOOL timerIsNext = (_timerDeadline >= 0) && (!event || (_timerDeadline < event->_time));
+            long next = timerIsNext ? _timerDeadline : (event ? event->_time : -1);
+            if ((next < 0) || (next > limit))
+            {
+                break;
+            }
+
+            _now = MAX(_now, next);
+            ++_wakeups;
+
+            if (timerIsNext)
+            {
+                // libcurl expects the timer to be one-shot
+                _timerDeadline = -1;
+                ++_timerFirings;
+                [self processMulti:NULL action:0 forSocket:CURL_SOCKET_TIMEOUT];
+            }
+            else
+            {
+                [[event retain] autorelease];
+                [_events removeObjectAtIndex:0];
+
+                NSUInteger mask = [[_interest objectForKey:@(event->_socket)] unsignedIntegerValue];
+                NSUInteger needed = (event->_action == CURL_CSELECT_IN) ? kWatchRead : kWatchWrite;
+                if (mask & needed)
+                {
+                    ++_socketEvents;
+                    [self processMulti:NULL action:event->_action forSocket:event->_socket];
+                }
+                else
+                {
+                    --_wakeups;
+                    ++_droppedEvents;
+                }
+            }
+        }
+    });
+}
+
+#pragma mark - Simulated Engine
+
+- (void)scheduleAction:(int)action forSocket:(curl_socket_t)socket after:(long)delay
+{
+    CURLVirtualEvent* event = [[CURLVirtualEvent alloc] init];
+    event->_time = _now + delay;
+    event->_sequence = ++_sequence;
+    event->_socket = socket;
+    event->_action = action;
+
+    // keep the events sorted by time, then by the order they were scheduled
+    NSUInteger index = [_events indexOfObject:event inSortedRange:NSMakeRange(0, [_events count]) options:NSBinarySearchingInsertionIndex usingComparator:^NSComparisonResult(CURLVirtualEvent* a, CURLVirtualEvent* b) {
+        if (a->_time != b->_time) return (a->_time < b->_time) ? NSOrderedAscending : NSOrderedDescending;
+        if (a->_sequence != b->_sequence) return (a->_sequence < b->_sequence) ? NSOrderedAscending : NSOrderedDescending;
+        return NSOrderedSame;
+    }];
+
+    [_events insertObject:event atIndex:index];
+    [event release];
+}
+
+- (void)pollSocket:(curl_socket_t)socket what:(int)what
+{
+    // the equivalent of libcurl calling our socket callback
+    CURLSocketRegistration* registration = [_registrations objectForKey:@(socket)];
+    [self updateRegistration:registration forSocket:socket to:what];
+}
+
+- (void)startState:(CURLVirtualTransferState*)state
+{
+    CURLVirtualScript* script = state->_script;
+    state->_phase = CURLVirtualConnecting;
+    state->_socket = _nextSocket++;
+    state->_chunksRemaining = script.chunkCount;
+    state->_deadline = script.timeout ? _now + script.timeout : -1;
+    [_statesBySocket setObject:state forKey:@(state->_socket)];
+
+    [self pollSocket:state->_socket what:CURL_POLL_OUT];
+    [self scheduleAction:CURL_CSELECT_OUT forSocket:state->_socket after:script.connectDelay];
+}
+
+- (void)finishState:(CURLVirtualTransferState*)state code:(CURLcode)code
+{
+    if (state->_phase == CURLVirtualDone) return;
+
+    if (state->_socket)
+    {
+        [self pollSocket:state->_socket what:CURL_POLL_REMOVE];
+        [_statesBySocket removeObjectForKey:@(state->_socket)];
+    }
+
+    state->_phase = CURLVirtualDone;
+    state->_result = code;
+    [_completions addObject:state];
+}
+
+- (void)handleAction:(int)action forState:(CURLVirtualTransferState*)state
+{
+    ++state->_events;
+    ++_transferEvents;
+    _maxTransferEvents = MAX(_maxTransferEvents, state->_events);
+
+    CURLVirtualScript* script = state->_script;
+    switch (state->_phase)
+    {
+        case CURLVirtualConnecting:
+            if (action == CURL_CSELECT_OUT)
+            {
+                // connected and request sent; now wait for the response
+                state->_phase = CURLVirtualWaiting;
+                [self pollSocket:state->_socket what:CURL_POLL_IN];
+                if (script.firstByteDelay >= 0)
+                {
+                    [self scheduleAction:CURL_CSELECT_IN forSocket:state->_socket after:script.firstByteDelay];
+                }
+            }
+            break;
+
+        case CURLVirtualWaiting:
+        case CURLVirtualReceiving:
+            if (action == CURL_CSELECT_IN)
+            {
+                state->_phase = CURLVirtualReceiving;
+                if (state->_chunksRemaining)
+                {
+                    --state->_chunksRemaining;
+                }
+
+                if (state->_chunksRemaining)
+                {
+                    [self scheduleAction:CURL_CSELECT_IN forSocket:state->_socket after:script.chunkInterval];
+                }
+                else
+                {
+                    [self finishState:state code:script.result];
+                }
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+- (void)updateTimer
+{
+    // like libcurl, only report the timeout when it changes
+    long deadline = -1;
+    for (CURLVirtualTransferState* state in [_statesByHandle objectEnumerator])
+    {
+        if (state->_phase == CURLVirtualPending)
+        {
+            deadline = _now;
+            break;
+        }
+
+        if ((state->_phase != CURLVirtualDone) && (state->_deadline >= 0) && ((deadline < 0) || (state->_deadline < deadline)))
+        {
+            deadline = state->_deadline;
+        }
+    }
+
+    if (deadline != _timerDeadline)
+    {
+        [self setTimeout:(deadline < 0) ? -1 : deadline - _now];
+    }
+}
+
+#pragma mark - libcurl Primitives
+
+- (CURLMcode)addEasyHandle:(CURL *)easy
+{
+    CURLTransfer* transfer = nil;
+    curl_easy_getinfo(easy, CURLINFO_PRIVATE, &transfer);
+
+    CURLVirtualScript* script = self.scriptProvider ? self.scriptProvider(transfer) : nil;
+    CURLVirtualTransferState* state = [[CURLVirtualTransferState alloc] init];
+    state->_easy = easy;
+    state->_script = [(script ? script : self.defaultScript) retain];
+    state->_phase = CURLVirtualPending;
+    state->_deadline = -1;
+    [_statesByHandle setObject:state forKey:(id)easy];
+    [state release];
+
+    [self updateTimer];
+    return CURLM_OK;
+}
+
+- (CURLMcode)removeEasyHandle:(CURL *)easy
+{
+    CURLVirtualTransferState* state = [_statesByHandle objectForKey:(id)easy];
+    if (!state)
+    {
+        return CURLM_BAD_EASY_HANDLE;
+    }
+
+    if ((state->_phase != CURLVirtualDone) && state->_socket)
+    {
+        [self pollSocket:state->_socket what:CURL_POLL_REMOVE];
+        [_statesBySocket removeObjectForKey:@(state->_socket)];
+    }
+
+    [_completions removeObjectIdenticalTo:state];
+    [_statesByHandle removeObjectForKey:(id)easy];
+
+    [self updateTimer];
+    return CURLM_OK;
+}
+
+- (CURLMcode)performSocketAction:(int)action forSocket:(curl_socket_t)socket runningHandles:(int *)running
+{
+    if (socket == CURL_SOCKET_TIMEOUT)
+    {
+        for (CURLVirtualTransferState* state in [[_statesByHandle objectEnumerator] allObjects])
+        {
+            if (state->_phase == CURLVirtualPending)
+            {
+                [self startState:state];
+            }
+            else if ((state->_phase != CURLVirtualDone) && (state->_deadline >= 0) && (state->_deadline <= _now))
+            {
+                [self finishState:state code:CURLE_OPERATION_TIMEDOUT];
+            }
+        }
+    }
+    else
+    {
+        CURLVirtualTransferState* state = [_statesBySocket objectForKey:@(socket)];
+        if (state)
+        {
+            [self handleAction:action forState:state];
+        }
+    }
+
+    int count = 0;
+    for (CURLVirtualTransferState* state in [_statesByHandle objectEnumerator])
+    {
+        if (state->_phase != CURLVirtualDone) ++count;
+    }
+    *running = count;
+
+    [self updateTimer];
+    return CURLM_OK;
+}
+
+- (CURLMsg*)readMessage:(int *)remaining
+{
+    if ([_completions count] == 0)
+    {
+        *remaining = 0;
+        return NULL;
+    }
+
+    CURLVirtualTransferState* state = [_completions objectAtIndex:0];
+    _message.msg = CURLMSG_DONE;
+    _message.easy_handle = state->_easy;
+    _message.data.result = state->_result;
+    [_completions removeObjectAtIndex:0];
+    ++_completed;
+
+    *remaining = (int)[_completions count];
+    return &_message;
+}
+
+- (void)assignRegistration:(CURLSocketRegistration *)registration toSocket:(curl_socket_t)socket
+{
+    if (registration)
+    {
+        [_registrations setObject:registration forKey:@(socket)];
+    }
+    else
+    {
+        [_registrations removeObjectForKey:@(socket)];
+    }
+}
+
+#pragma mark - Events
+
+- (void)setTimeout:(long)timeout_ms
+{
+    ++_timerUpdates;
+    _timerDeadline = (timeout_ms < 0) ? -1 : _now + timeout_ms;
+}
+
+- (void)watchSocket:(curl_socket_t)socket reading:(BOOL)reading writing:(BOOL)writing
+{
+    // no real backend; just remember what the multi wants to watch
+    NSUInteger mask = (reading ? kWatchRead : 0) | (writing ? kWatchWrite : 0);
+    if (mask)
+    {
+        [_interest setObject:@(mask) forKey:@(socket)];
+    }
+    else
+    {
+        [_interest removeObjectForKey:@(socket)];
+    }
+
+    _maxWatchedSockets = MAX(_maxWatchedSockets, [_interest count]);
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"<VIRTUAL MULTI %p at %ldms: %lu wakeups, %lu timer, %lu socket, %lu completed>", self, _now,
+            (unsigned long)_wakeups, (unsigned long)_timerFirings, (unsigned long)_socketEvents, (unsigned long)_completed];
+}
+
+@end
@@ -0,0 +1,159 @@
+//
+//  CURLVirtualMultiTests.m
+//  CURLHandle
+//
+//  Created by Karelia Software on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLHandleBasedTest.h"
+#import "CURLTransfer+TestingSupport.h"
+#import "CURLVirtualMulti.h"
+
+#include <libkern/OSAtomic.h>
+
+@interface CURLVirtualMultiTests : CURLHandleBasedTest
+{
+    int32_t _completions;
+    int32_t _failures;
+}
+
+@property (strong, nonatomic) CURLVirtualMulti* multi;
+@property (strong, nonatomic) NSOperationQueue* delegateQueue;
+@property (strong, atomic) NSError* lastError;
+
+@end
+
+@implementation CURLVirtualMultiTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    self.multi = [[[CURLVirtualMulti alloc] init] autorelease];
+    self.delegateQueue = [[[NSOperationQueue alloc] init] autorelease];
+    self.delegateQueue.maxConcurrentOperationCount = 1;
+    _completions = 0;
+    _failures = 0;
+}
+
+- (void)tearDown
+{
+    [self.multi shutdown];
+    self.multi = nil;
+    self.delegateQueue = nil;
+    self.lastError = nil;
+
+    [super tearDown];
+}
+
+- (void)transfer:(CURLTransfer *)transfer didCompleteWithError:(NSError *)error
+{
+    // there can be thousands of these, so don't log like the superclass does
+    if (error)
+    {
+        self.lastError = error;
+        OSAtomicIncrement32(&_failures);
+    }
+
+    OSAtomicIncrement32(&_completions);
+}
+
+- (void)startTransfers:(NSUInteger)count
+{
+    for (NSUInteger n = 0; n < count; ++n)
+    {
+        NSURL* url = [NSURL URLWithString:[NSString stringWithFormat:@"http://virtual.invalid/%lu", (unsigned long)n]];
+        CURLTransfer* transfer = [[CURLTransfer alloc] initWithRequest:[NSURLRequest requestWithURL:url] credential:nil delegate:self delegateQueue:self.delegateQueue multi:self.multi];
+        [transfer release]; // the multi keeps hold of it until it's done
+    }
+}
+
+- (void)runSimulation
+{
+    [self.multi runUntilIdle];
+    [self.delegateQueue waitUntilAllOperationsAreFinished];
+}
+
+#pragma mark - Tests
+
+- (void)testIdleMultiNeverWakes
+{
+    [self runSimulation];
+
+    STAssertEquals(self.multi.wakeups, (NSUInteger)0, @"idle multi shouldn't wake up");
+    STAssertEquals(self.multi.now, 0L, @"no time should have passed");
+}
+
+- (void)testSingleTransfer
+{
+    self.multi.defaultScript = [CURLVirtualScript scriptWithConnectDelay:10 firstByteDelay:50 chunkCount:4 chunkInterval:5];
+    [self startTransfers:1];
+    [self runSimulation];
+
+    STAssertEquals(_completions, 1, @"transfer should have completed");
+    STAssertEquals(_failures, 0, @"transfer failed with %@", self.lastError);
+
+    // one writable event to connect, then one readable event per chunk - and no timer wakeups at all
+    STAssertEquals(self.multi.transferEvents, (NSUInteger)5, @"unexpected events: %@", self.multi);
+    STAssertEquals(self.multi.wakeups, (NSUInteger)5, @"unexpected wakeups: %@", self.multi);
+    STAssertEquals(self.multi.timerFirings, (NSUInteger)0, @"unexpected timer firings: %@", self.multi);
+    STAssertEquals(self.multi.droppedEvents, (NSUInteger)0, @"multi should have been watching every socket that became ready");
+    STAssertEquals(self.multi.now, 75L, @"transfer should have taken 75ms of virtual time");
+}
+
+- (void)testThousandsOfTransfers
+{
+    static const NSUInteger kCount = 5000;
+
+    __block NSUInteger index = 0;
+    self.multi.scriptProvider = ^CURLVirtualScript*(CURLTransfer* transfer) {
+        // spread the transfers out a bit, so that their events interleave
+        ++index;
+        return [CURLVirtualScript scriptWithConnectDelay:1 + (index % 7) firstByteDelay:20 + (index % 13) chunkCount:1 + (index % 5) chunkInterval:3];
+    };
+
+    NSDate* started = [NSDate date];
+    [self startTransfers:kCount];
+    [self runSimulation];
+    NSLog(@"simulated %lu transfers in %.3fs: %@", (unsigned long)kCount, -[started timeIntervalSinceNow], self.multi);
+
+    STAssertEquals(_completions, (int32_t)kCount, @"all transfers should have completed");
+    STAssertEquals(_failures, 0, @"transfers failed, eg with %@", self.lastError);
+    STAssertEquals(self.multi.completed, kCount, @"multi should have reported every completion");
+
+    // every socket event should be for a transfer, and each transfer needs at most one connect plus five chunks
+    STAssertEquals(self.multi.socketEvents, self.multi.transferEvents, @"socket events should all reach a transfer");
+    STAssertTrue(self.multi.maxTransferEvents <= 6, @"busiest transfer had %lu events", (unsigned long)self.multi.maxTransferEvents);
+    STAssertEquals(self.multi.wakeups, self.multi.socketEvents + self.multi.timerFirings, @"every wakeup should be accounted for");
+    STAssertEquals(self.multi.droppedEvents, (NSUInteger)0, @"multi should have been watching every socket that became ready");
+}
+
+- (void)testTimeout
+{
+    CURLVirtualScript* script = [CURLVirtualScript scriptWithConnectDelay:10 firstByteDelay:-1 chunkCount:1 chunkInterval:0];
+    script.timeout = 1000;
+    self.multi.defaultScript = script;
+
+    [self startTransfers:1];
+    [self runSimulation];
+
+    STAssertEquals(_completions, 1, @"transfer should have completed");
+    STAssertEquals([self.lastError code], (NSInteger)NSURLErrorTimedOut, @"expected timeout, got %@", self.lastError);
+    STAssertEquals(self.multi.timerFirings, (NSUInteger)1, @"timer should have fired exactly once: %@", self.multi);
+    STAssertEquals(self.multi.now, 1000L, @"transfer should have timed out after 1000ms of virtual time");
+}
+
+- (void)testTimeLimit
+{
+    self.multi.defaultScript = [CURLVirtualScript scriptWithConnectDelay:10 firstByteDelay:1000 chunkCount:1 chunkInterval:0];
+
+    [self startTransfers:10];
+    [self.multi runUntilIdleOrTime:500];
+    STAssertEquals(self.multi.completed, (NSUInteger)0, @"nothing should have finished yet");
+
+    [self runSimulation];
+    STAssertEquals(_completions, 10, @"all transfers should have completed");
+}
+
+@end
@@ -0,0 +1,22 @@
+#!/usr/bin/env bash
+
+# This script builds the Benchmark tool and runs it, writing the results as JSON.
+# Any arguments are passed on to the tool, eg: Scripts/benchmark.sh -protocols http -concurrency 1,64
+
+base=`dirname $0`
+pushd "$base/.." > /dev/null
+root="$PWD"
+build="$root/benchmark-build"
+popd > /dev/null
+
+sym="$build/sym"
+obj="$build/obj"
+results="$build/results-`date +%Y%m%d-%H%M%S`.json"
+
+mkdir -p "$build"
+
+echo "Building benchmark into $build"
+xcodebuild -project "$root/CURLHandleSource/CURLHandle.xcodeproj" -target "Benchmark" -sdk "macosx" -configuration "Release" build OBJROOT="$obj" SYMROOT="$sym" > "$build/build.log" 2>&1 || { echo "Build failed, see $build/build.log"; exit 1; }
+
+echo "Writing results to $results"
+"$sym/Release/Benchmark" -output "$results" "$@"
@@ -0,0 +1,20 @@
+#!/usr/bin/env bash
+
+# This script builds the LoadGenerator tool and runs it.
+# Any arguments are passed on to the tool, eg: Scripts/loadgen.sh -url http://localhost:8080/ -concurrency 128 -duration 30
+
+base=`dirname $0`
+pushd "$base/.." > /dev/null
+root="$PWD"
+build="$root/loadgen-build"
+popd > /dev/null
+
+sym="$build/sym"
+obj="$build/obj"
+
+mkdir -p "$build"
+
+echo "Building load generator into $build"
+xcodebuild -project "$root/CURLHandleSource/CURLHandle.xcodeproj" -target "LoadGenerator" -sdk "macosx" -configuration "Release" build OBJROOT="$obj" SYMROOT="$sym" > "$build/build.log" 2>&1 || { echo "Build failed, see $build/build.log"; exit 1; }
+
+"$sym/Release/LoadGenerator" "$@"
@@ -0,0 +1,20 @@
+#!/usr/bin/env bash
+
+# This script builds the Replay tool and runs it.
+# Any arguments are passed on to the tool, eg: Scripts/replay.sh -log ~/capture.curlrec -speed 2
+
+base=`dirname $0`
+pushd "$base/.." > /dev/null
+root="$PWD"
+build="$root/replay-build"
+popd > /dev/null
+
+sym="$build/sym"
+obj="$build/obj"
+
+mkdir -p "$build"
+
+echo "Building replay tool into $build"
+xcodebuild -project "$root/CURLHandleSource/CURLHandle.xcodeproj" -target "Replay" -sdk "macosx" -configuration "Release" build OBJROOT="$obj" SYMROOT="$sym" > "$build/build.log" 2>&1 || { echo "Build failed, see $build/build.log"; exit 1; }
+
+"$sym/Release/Replay" "$@"